@@ -17,6 +17,9 @@ include %D%/inst_vars.mk
 ## programs
 bin_PROGRAMS		=
 
+## programs built only on request
+EXTRA_PROGRAMS		=
+
 ## distributed scripts
 bin_SCRIPTS		=
 
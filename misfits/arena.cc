@@ -0,0 +1,66 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <new>
+
+#include <misfits/config.hpp>
+#include <misfits/arena.hpp>
+
+namespace misFITS {
+
+    Arena::~Arena() {
+
+	for ( std::vector<Object>::reverse_iterator object = objects_.rbegin() ;
+	      object != objects_.rend() ; ++object )
+	    object->destroy( object->object );
+
+	for ( std::vector<unsigned char*>::iterator block = blocks_.begin() ;
+	      block != blocks_.end() ; ++block )
+	    ::operator delete( *block );
+    }
+
+    void*
+    Arena::allocate( std::size_t nbytes, std::size_t align ) {
+
+	std::size_t pad = next_ ? ( align - reinterpret_cast<std::size_t>( next_ ) % align ) % align : 0;
+
+	if ( ! next_ || pad + nbytes > remaining_ ) {
+
+	    // requests larger than a block get a block of their own
+	    std::size_t size = std::max( nbytes + align, block_size_ );
+
+	    blocks_.reserve( blocks_.size() + 1 );
+	    next_ = static_cast<unsigned char*>( ::operator new( size ) );
+	    blocks_.push_back( next_ );
+	    remaining_ = size;
+
+	    pad = ( align - reinterpret_cast<std::size_t>( next_ ) % align ) % align;
+	}
+
+	unsigned char* ptr = next_ + pad;
+	next_ = ptr + nbytes;
+	remaining_ -= pad + nbytes;
+
+	return ptr;
+    }
+
+}
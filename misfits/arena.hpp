@@ -0,0 +1,138 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_ARENA_H
+#define misFITS_ARENA_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+namespace misFITS {
+
+    // a simple region allocator. objects are carved out of large
+    // blocks, and are all destroyed (in reverse order of creation)
+    // when the arena is.  memory is never returned to the arena
+    // before then.
+    class Arena : boost::noncopyable {
+
+    public:
+
+	explicit Arena( std::size_t block_size = 4096 ) :
+	    block_size_( block_size ),
+	    next_( NULL ),
+	    remaining_( 0 ) {}
+
+	~Arena();
+
+	void* allocate( std::size_t nbytes, std::size_t align );
+
+	// construct a T( a1, a2, *this ). T is destroyed with the arena.
+	template< class T, class A1, class A2 >
+	T* create( const A1& a1, A2 a2 ) {
+
+	    objects_.reserve( objects_.size() + 1 );
+
+	    T* object = new ( allocate( sizeof(T), boost::alignment_of<T>::value ) ) T( a1, a2, *this );
+	    objects_.push_back( Object( object, &destroy<T> ) );
+
+	    return object;
+	}
+
+	std::size_t num_blocks() const { return blocks_.size(); }
+
+	// allocate the storage of standard containers from an arena
+	template< typename T >
+	class Allocator {
+
+	public:
+
+	    typedef T value_type;
+	    typedef T* pointer;
+	    typedef const T* const_pointer;
+	    typedef T& reference;
+	    typedef const T& const_reference;
+	    typedef std::size_t size_type;
+	    typedef std::ptrdiff_t difference_type;
+
+	    template< typename U > struct rebind { typedef Allocator<U> other; };
+
+	    explicit Allocator( Arena& arena ) : arena_( &arena ) {}
+
+	    template< typename U >
+	    Allocator( const Allocator<U>& other ) : arena_( other.arena() ) {}
+
+	    pointer allocate( size_type n, const void* = 0 ) {
+		return static_cast<pointer>( arena_->allocate( n * sizeof(T), boost::alignment_of<T>::value ) );
+	    }
+
+	    // the memory is reclaimed when the arena is destroyed
+	    void deallocate( pointer, size_type ) {}
+
+	    size_type max_size() const { return std::numeric_limits<size_type>::max() / sizeof(T); }
+
+	    void construct( pointer p, const T& value ) { new ( p ) T( value ); }
+	    void destroy( pointer p ) { p->~T(); }
+
+	    pointer address( reference x ) const { return &x; }
+	    const_pointer address( const_reference x ) const { return &x; }
+
+	    Arena* arena() const { return arena_; }
+
+	    template< typename U >
+	    bool operator==( const Allocator<U>& other ) const { return arena_ == other.arena(); }
+	    template< typename U >
+	    bool operator!=( const Allocator<U>& other ) const { return arena_ != other.arena(); }
+
+	private:
+	    Arena* arena_;
+	};
+
+    private:
+
+	template< class T >
+	static void destroy( void* object ) {
+	    static_cast<T*>( object )->~T();
+	}
+
+	struct Object {
+	    Object( void* object, void (*destroy)( void* ) ) : object( object ), destroy( destroy ) {}
+	    void* object;
+	    void (*destroy)( void* );
+	};
+
+	std::size_t block_size_;
+	std::vector<unsigned char*> blocks_;
+	std::vector<Object> objects_;
+
+	unsigned char* next_;
+	std::size_t remaining_;
+    };
+
+}
+
+#endif // ! misFITS_ARENA_H
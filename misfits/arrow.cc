@@ -0,0 +1,587 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include <misfits/arrow.hpp>
+#include <misfits/table.hpp>
+
+#include "fits_p.hpp"
+#include "decode.hpp"
+
+namespace misFITS {
+
+    namespace {
+
+	///////////////////////////////
+	// ownership of exported data //
+	///////////////////////////////
+
+	// everything hanging off an exported schema or array belongs
+	// to it, and is freed by its release callback.
+
+	struct SchemaData {
+	    string format;
+	    string name;
+	    vector<ArrowSchema*> children;
+	};
+
+	struct ArrayData {
+	    vector< vector<unsigned char> > storage;
+	    vector<const void*> buffers;
+	    vector<ArrowArray*> children;
+
+	    // the block of rows read from the table, if a buffer
+	    // points into it
+	    shared_ptr< vector<unsigned char> > block;
+	};
+
+	void
+	release_schema( ArrowSchema* schema ) {
+
+	    SchemaData* data = static_cast<SchemaData*>( schema->private_data );
+
+	    for ( vector<ArrowSchema*>::iterator child = data->children.begin() ;
+		  child != data->children.end() ; ++child ) {
+
+		if ( (*child)->release )
+		    (*child)->release( *child );
+		delete *child;
+	    }
+
+	    delete data;
+	    schema->release = NULL;
+	}
+
+	void
+	release_array( ArrowArray* array ) {
+
+	    ArrayData* data = static_cast<ArrayData*>( array->private_data );
+
+	    for ( vector<ArrowArray*>::iterator child = data->children.begin() ;
+		  child != data->children.end() ; ++child ) {
+
+		if ( (*child)->release )
+		    (*child)->release( *child );
+		delete *child;
+	    }
+
+	    delete data;
+	    array->release = NULL;
+	}
+
+	void
+	init_schema( ArrowSchema* schema, const string& format, const string& name, int64_t flags ) {
+
+	    SchemaData* data = new SchemaData;
+	    data->format = format;
+	    data->name = name;
+
+	    schema->format = data->format.c_str();
+	    schema->name = data->name.c_str();
+	    schema->metadata = NULL;
+	    schema->flags = flags;
+	    schema->n_children = 0;
+	    schema->children = NULL;
+	    schema->dictionary = NULL;
+	    schema->release = release_schema;
+	    schema->private_data = data;
+	}
+
+	ArrowSchema*
+	new_child( ArrowSchema* parent ) {
+
+	    SchemaData* data = static_cast<SchemaData*>( parent->private_data );
+
+	    ArrowSchema* child = new ArrowSchema();
+	    data->children.push_back( child );
+
+	    parent->n_children = static_cast<int64_t>( data->children.size() );
+	    parent->children = &data->children[0];
+
+	    return child;
+	}
+
+	void
+	init_array( ArrowArray* array, LONGLONG length, std::size_t n_buffers ) {
+
+	    ArrayData* data = new ArrayData;
+	    data->storage.resize( n_buffers );
+	    data->buffers.resize( n_buffers, NULL );
+
+	    array->length = length;
+	    array->null_count = 0;
+	    array->offset = 0;
+	    array->n_buffers = static_cast<int64_t>( n_buffers );
+	    array->n_children = 0;
+	    array->buffers = &data->buffers[0];
+	    array->children = NULL;
+	    array->dictionary = NULL;
+	    array->release = release_array;
+	    array->private_data = data;
+	}
+
+	ArrowArray*
+	new_child( ArrowArray* parent ) {
+
+	    ArrayData* data = static_cast<ArrayData*>( parent->private_data );
+
+	    ArrowArray* child = new ArrowArray();
+	    data->children.push_back( child );
+
+	    parent->n_children = static_cast<int64_t>( data->children.size() );
+	    parent->children = &data->children[0];
+
+	    return child;
+	}
+
+	// allocate a zero filled buffer
+	unsigned char*
+	new_buffer( ArrowArray* array, std::size_t idx, std::size_t nbytes ) {
+
+	    ArrayData* data = static_cast<ArrayData*>( array->private_data );
+
+	    // consumers may not expect a NULL data buffer, even if it's empty
+	    data->storage[idx].resize( nbytes ? nbytes : 1 );
+	    data->buffers[idx] = &data->storage[idx][0];
+
+	    return &data->storage[idx][0];
+	}
+
+	// a column's cells in the block of rows read from the table:
+	// nrows of them, each width bytes long and stride bytes from
+	// the last.  block is set if the cells may be decoded in place
+	// and handed over as they are, i.e. if no other column is
+	// exported from the block.
+	struct Cells {
+
+	    Cells( unsigned char* base, LONGLONG nrows, LONGLONG width, LONGLONG stride,
+		   const shared_ptr< vector<unsigned char> >& block ) :
+		base( base ),
+		nrows( nrows ),
+		width( width ),
+		stride( stride ),
+		block( block ) {}
+
+	    unsigned char* row( LONGLONG idx ) const { return base + idx * stride; }
+
+	    bool contiguous() const { return width == stride; }
+	    bool adoptable() const { return block && nrows > 0 && contiguous(); }
+
+	    unsigned char* base;
+	    LONGLONG nrows;
+	    LONGLONG width;
+	    LONGLONG stride;
+	    shared_ptr< vector<unsigned char> > block;
+	};
+
+	// use the cells as a buffer, without copying them
+	void
+	adopt( ArrowArray* array, std::size_t idx, const Cells& cells ) {
+
+	    ArrayData* data = static_cast<ArrayData*>( array->private_data );
+
+	    data->block = cells.block;
+	    data->buffers[idx] = cells.base;
+	}
+
+	// a validity buffer is optional if there are no nulls
+	void
+	set_null_count( ArrowArray* array, const unsigned char* valid, std::size_t n ) {
+
+	    std::size_t ndefined = 0;
+	    for ( std::size_t idx = 0 ; idx < n ; ++idx )
+		ndefined += ( valid[idx / 8] >> ( idx % 8 ) ) & 1;
+
+	    array->null_count = static_cast<int64_t>( n - ndefined );
+
+	    if ( ! array->null_count )
+		static_cast<ArrayData*>( array->private_data )->buffers[0] = NULL;
+	}
+
+	/////////////
+	// formats //
+	/////////////
+
+	template< typename T > struct Format;
+	template<> struct Format<uint8_t>     { static const char* code() { return "C"; } };
+	template<> struct Format<signed char> { static const char* code() { return "c"; } };
+	template<> struct Format<int16_t>     { static const char* code() { return "s"; } };
+	template<> struct Format<uint16_t>    { static const char* code() { return "S"; } };
+	template<> struct Format<int32_t>     { static const char* code() { return "i"; } };
+	template<> struct Format<uint32_t>    { static const char* code() { return "I"; } };
+	template<> struct Format<int64_t>     { static const char* code() { return "l"; } };
+	template<> struct Format<uint64_t>    { static const char* code() { return "L"; } };
+	template<> struct Format<float>       { static const char* code() { return "f"; } };
+	template<> struct Format<double>      { static const char* code() { return "g"; } };
+
+	//////////////////////
+	// column exporters //
+	//////////////////////
+
+	// decoding kernels, for use by export_values
+	template< typename S, typename T >
+	struct Convert {
+	    void operator()( const unsigned char* src, std::size_t n, T* dst ) const {
+		Decode::convert<S>( src, n, dst );
+	    }
+	};
+
+	template< typename S, typename T >
+	struct Flip {
+	    void operator()( const unsigned char* src, std::size_t n, T* dst ) const {
+		Decode::flip<S>( src, n, dst );
+	    }
+	};
+
+	template< typename S >
+	struct Scale {
+
+	    Scale( double tscal, double tzero ) : tscal( tscal ), tzero( tzero ) {}
+
+	    void operator()( const unsigned char* src, std::size_t n, double* dst ) const {
+		Decode::scale<S>( src, n, tscal, tzero, dst );
+	    }
+
+	    double tscal;
+	    double tzero;
+	};
+
+	// decode the cells' values, stored as S, into the array's
+	// values buffer.  values which are no larger than those stored
+	// are decoded in place and handed over if possible; otherwise
+	// they're decoded directly from the block, a row at a time if
+	// the cells aren't contiguous.
+	template< typename S, typename T, typename Kernel >
+	void
+	export_values( const Cells& cells, LONGLONG nelem, const Kernel& kernel, ArrowArray* array ) {
+
+	    std::size_t n = static_cast<std::size_t>( cells.nrows * nelem );
+
+	    if ( sizeof(T) == sizeof(S) && cells.adoptable() ) {
+		kernel( cells.base, n, reinterpret_cast<T*>( cells.base ) );
+		adopt( array, 1, cells );
+		return;
+	    }
+
+	    T* values = reinterpret_cast<T*>( new_buffer( array, 1, n * sizeof(T) ) );
+
+	    if ( cells.contiguous() )
+		kernel( cells.base, n, values );
+
+	    else
+		for ( LONGLONG row = 0 ; row < cells.nrows ; ++row )
+		    kernel( cells.row( row ), static_cast<std::size_t>( nelem ), values + row * nelem );
+	}
+
+	// the stored values are exported as is, with the TZERO
+	// convention mapped onto Arrow's unsigned (or signed byte)
+	// types.  other scaled values are exported as doubles.
+	template< typename S >
+	void
+	export_numeric( const ColumnInfo& ci, const Cells& cells, LONGLONG nelem,
+			const string& name, ArrowSchema* schema, ArrowArray* array ) {
+
+	    typedef typename Decode::Offset<S>::type U;
+
+	    std::size_t n = static_cast<std::size_t>( cells.nrows * nelem );
+
+	    init_array( array, static_cast<LONGLONG>( n ), 2 );
+
+	    // validity is determined from the stored values, so must be
+	    // found before they're decoded in place
+	    if ( ! std::numeric_limits<S>::is_integer || ci.has_tnull ) {
+
+		const LONGLONG* tnull = ci.has_tnull ? &ci.tnull : NULL;
+		unsigned char* valid = new_buffer( array, 0, ( n + 7 ) / 8 );
+
+		if ( cells.contiguous() )
+		    Decode::validity<S>( cells.base, n, tnull, valid );
+
+		else {
+
+		    std::size_t idx = 0;
+		    for ( LONGLONG row = 0 ; row < cells.nrows ; ++row ) {
+
+			const unsigned char* src = cells.row( row );
+			for ( LONGLONG elem = 0 ; elem < nelem ; ++elem, ++idx, src += sizeof(S) )
+			    if ( Decode::defined( Decode::load<S>( src ), tnull ) )
+				valid[idx / 8] |= static_cast<unsigned char>( 1 << ( idx % 8 ) );
+		    }
+		}
+
+		set_null_count( array, valid, n );
+	    }
+
+	    if ( ci.unscaled() ) {
+
+		init_schema( schema, Format<S>::code(), name, ARROW_FLAG_NULLABLE );
+		export_values<S,S>( cells, nelem, Convert<S,S>(), array );
+	    }
+
+	    else if ( std::numeric_limits<S>::is_integer
+		      && ci.tscal == 1.0 && ci.tzero == Decode::Offset<S>::tzero() ) {
+
+		init_schema( schema, Format<U>::code(), name, ARROW_FLAG_NULLABLE );
+		export_values<S,U>( cells, nelem, Flip<S,U>(), array );
+	    }
+
+	    else {
+
+		init_schema( schema, Format<double>::code(), name, ARROW_FLAG_NULLABLE );
+		export_values<S,double>( cells, nelem, Scale<S>( ci.tscal, ci.tzero ), array );
+	    }
+	}
+
+	// 'T', 'F', or undefined
+	void
+	export_logical( const Cells& cells, LONGLONG nelem,
+			const string& name, ArrowSchema* schema, ArrowArray* array ) {
+
+	    std::size_t n = static_cast<std::size_t>( cells.nrows * nelem );
+
+	    init_schema( schema, "b", name, ARROW_FLAG_NULLABLE );
+	    init_array( array, static_cast<LONGLONG>( n ), 2 );
+
+	    unsigned char* valid = new_buffer( array, 0, ( n + 7 ) / 8 );
+	    unsigned char* values = new_buffer( array, 1, ( n + 7 ) / 8 );
+
+	    std::size_t idx = 0;
+	    for ( LONGLONG row = 0 ; row < cells.nrows ; ++row ) {
+
+		const unsigned char* cell = cells.row( row );
+		for ( LONGLONG elem = 0 ; elem < nelem ; ++elem, ++idx ) {
+		    values[idx / 8] |= static_cast<unsigned char>( ( cell[elem] == 'T' ) << ( idx % 8 ) );
+		    valid[idx / 8]  |= static_cast<unsigned char>( ( cell[elem] != 0 ) << ( idx % 8 ) );
+		}
+	    }
+
+	    set_null_count( array, valid, n );
+	}
+
+	// FITS packs bits most significant first, and pads each cell
+	// to a byte boundary; Arrow packs them least significant first,
+	// with no padding.
+	void
+	export_bits( const Cells& cells, LONGLONG nbits,
+		     const string& name, ArrowSchema* schema, ArrowArray* array ) {
+
+	    std::size_t n = static_cast<std::size_t>( cells.nrows * nbits );
+
+	    init_schema( schema, "b", name, 0 );
+	    init_array( array, static_cast<LONGLONG>( n ), 2 );
+
+	    unsigned char* values = new_buffer( array, 1, ( n + 7 ) / 8 );
+
+	    std::size_t idx = 0;
+	    for ( LONGLONG row = 0 ; row < cells.nrows ; ++row ) {
+
+		const unsigned char* cell = cells.row( row );
+		for ( LONGLONG bit = 0 ; bit < nbits ; ++bit, ++idx )
+		    if ( cell[bit / 8] & ( 0x80 >> ( bit % 8 ) ) )
+			values[idx / 8] |= static_cast<unsigned char>( 1 << ( idx % 8 ) );
+	    }
+	}
+
+	// strings are exported as fixed size binary values, with their
+	// padding
+	void
+	export_string( const Cells& cells,
+		       const string& name, ArrowSchema* schema, ArrowArray* array ) {
+
+	    ostringstream format;
+	    format << "w:" << cells.width;
+
+	    init_schema( schema, format.str(), name, 0 );
+	    init_array( array, cells.nrows, 2 );
+
+	    if ( cells.adoptable() ) {
+		adopt( array, 1, cells );
+		return;
+	    }
+
+	    std::size_t width = static_cast<std::size_t>( cells.width );
+	    unsigned char* values = new_buffer( array, 1, static_cast<std::size_t>( cells.nrows ) * width );
+
+	    for ( LONGLONG row = 0 ; row < cells.nrows ; ++row, values += width )
+		std::copy( cells.row( row ), cells.row( row ) + width, values );
+	}
+
+	bool
+	exportable( const ColumnInfo& ci ) {
+
+	    if ( ci.varlength )
+		return false;
+
+	    switch ( ci.column_type->id() ) {
+
+	    case ColumnType::ID::Complex:
+	    case ColumnType::ID::DoubleComplex:
+		return false;
+
+	    case ColumnType::ID::String:
+		return ci.nbytes > 0;
+
+	    default:
+		return true;
+	    }
+	}
+
+	// cells with more than one element are exported as fixed size lists
+	void
+	export_column( const ColumnInfo& ci, const Cells& cells,
+		       ArrowSchema* schema, ArrowArray* array ) {
+
+	    ColumnType::ID::type id = ci.column_type->id();
+
+	    if ( id == ColumnType::ID::String ) {
+		export_string( cells, ci.ttype, schema, array );
+		return;
+	    }
+
+	    LONGLONG nelem = ci.nelem();
+	    string name = ci.ttype;
+
+	    if ( nelem != 1 ) {
+
+		ostringstream format;
+		format << "+w:" << nelem;
+
+		init_schema( schema, format.str(), name, 0 );
+		init_array( array, cells.nrows, 1 );
+
+		schema = new_child( schema );
+		array = new_child( array );
+		name = "item";
+	    }
+
+	    switch ( id ) {
+
+	    case ColumnType::ID::Bit:
+		export_bits( cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::Logical:
+		export_logical( cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::Byte:
+		export_numeric<uint8_t>( ci, cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::Short:
+		export_numeric<int16_t>( ci, cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::Long:
+		export_numeric<int32_t>( ci, cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::LongLong:
+		export_numeric<int64_t>( ci, cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::Float:
+		export_numeric<float>( ci, cells, nelem, name, schema, array );
+		break;
+
+	    case ColumnType::ID::Double:
+		export_numeric<double>( ci, cells, nelem, name, schema, array );
+		break;
+
+	    default:
+		throw Exception::Assert( "internal error: unexpected column type for '" + ci.ttype + "'" );
+	    }
+	}
+
+    }
+
+    void
+    Table::export_arrow( ArrowSchema* schema, ArrowArray* array,
+			 LONGLONG firstrow, LONGLONG nrows,
+			 const std::vector<std::string>& names ) const {
+
+	set_as_chdu();
+
+	if ( nrows < 0 )
+	    nrows = num_rows() - firstrow + 1;
+
+	if ( firstrow < 1 || nrows < 0 || firstrow - 1 + nrows > num_rows() )
+	    throw Exception::Assert( "rows to export are out of range" );
+
+	vector<const ColumnInfo*> exported;
+
+	if ( names.empty() )
+	    for ( Columns::const_iterator ci = columns.begin() ; ci != columns.end() ; ++ci )
+		exported.push_back( &*ci );
+	else
+	    for ( vector<string>::const_iterator name = names.begin() ; name != names.end() ; ++name )
+		exported.push_back( &colinfo( *name ) );
+
+	for ( vector<const ColumnInfo*>::iterator ci = exported.begin() ; ci != exported.end() ; ++ci )
+	    if ( ! exportable( **ci ) )
+		throw Exception::Assert( "column '" + (*ci)->ttype + "' can't be exported to Arrow" );
+
+	// read the rows in one go, and decode the columns directly
+	// from them.  if there's a single column in the rows, and it's
+	// the only one exported, its values are decoded in place and
+	// the block is handed over, rather than copied.
+	LONGLONG rowlen = columns.empty() ? 0 : columns.back().offset - 1 + columns.back().nbytes;
+
+	shared_ptr< vector<unsigned char> > block
+	    = make_shared< vector<unsigned char> >( static_cast<std::size_t>( nrows * rowlen ) );
+	if ( ! block->empty() )
+	    read_bytes( firstrow, 1, static_cast<LONGLONG>( block->size() ), &(*block)[0] );
+
+	shared_ptr< vector<unsigned char> > adoptable;
+	if ( exported.size() == 1 )
+	    adoptable = block;
+
+	init_schema( schema, "+s", "", 0 );
+	init_array( array, nrows, 1 );
+
+	try {
+
+	    for ( vector<const ColumnInfo*>::iterator ci = exported.begin() ; ci != exported.end() ; ++ci ) {
+
+		const ColumnInfo& info = **ci;
+
+		unsigned char* base = block->empty() ? NULL : &(*block)[0] + info.offset - 1;
+
+		export_column( info, Cells( base, nrows, info.nbytes, rowlen, adoptable ),
+			       new_child( schema ), new_child( array ) );
+	    }
+	}
+
+	catch ( ... ) {
+
+	    schema->release( schema );
+	    array->release( array );
+	    throw;
+	}
+    }
+
+}
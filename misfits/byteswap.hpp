@@ -0,0 +1,112 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: conversion between FITS (big endian) and host byte order
+
+#ifndef misFITS_BYTESWAP_H
+#define misFITS_BYTESWAP_H
+
+#include <cstddef>
+#include <cstring>
+
+#include <boost/predef/other/endian.h>
+
+#include <misfits/config.hpp>
+
+namespace misFITS {
+
+    namespace ByteSwap {
+
+#if BOOST_ENDIAN_BIG_BYTE
+	static const bool required = false;
+#else
+	static const bool required = true;
+#endif
+
+	template< std::size_t N > struct Word;
+	template<> struct Word<1> { typedef uint8_t  type; };
+	template<> struct Word<2> { typedef uint16_t type; };
+	template<> struct Word<4> { typedef uint32_t type; };
+	template<> struct Word<8> { typedef uint64_t type; };
+
+	inline uint8_t swap( uint8_t v ) { return v; }
+
+	inline uint16_t swap( uint16_t v ) {
+	    return static_cast<uint16_t>( ( v << 8 ) | ( v >> 8 ) );
+	}
+
+	inline uint32_t swap( uint32_t v ) {
+#if defined(__GNUC__)
+	    return __builtin_bswap32( v );
+#else
+	    return   ( v << 24 )
+		   | ( ( v << 8 ) & 0x00ff0000U )
+		   | ( ( v >> 8 ) & 0x0000ff00U )
+		   | ( v >> 24 );
+#endif
+	}
+
+	inline uint64_t swap( uint64_t v ) {
+#if defined(__GNUC__)
+	    return __builtin_bswap64( v );
+#else
+	    return   ( static_cast<uint64_t>( swap( static_cast<uint32_t>( v ) ) ) << 32 )
+		   | swap( static_cast<uint32_t>( v >> 32 ) );
+#endif
+	}
+
+	// copy nwords N byte words from src to dst, converting between
+	// FITS and host byte order.  src and dst may be the same. the
+	// loop is simple enough that compilers vectorize it.
+	template< std::size_t N >
+	void copy( const void* src, void* dst, std::size_t nwords ) {
+
+	    if ( ! required ) {
+		if ( src != dst )
+		    std::memmove( dst, src, nwords * N );
+		return;
+	    }
+
+	    typedef typename Word<N>::type word_t;
+
+	    const unsigned char* in = static_cast<const unsigned char*>( src );
+	    unsigned char* out = static_cast<unsigned char*>( dst );
+
+	    for ( std::size_t idx = 0 ; idx < nwords ; ++idx, in += N, out += N ) {
+		word_t w;
+		std::memcpy( &w, in, N );
+		w = swap( w );
+		std::memcpy( out, &w, N );
+	    }
+	}
+
+	template< std::size_t N >
+	void swap( void* data, std::size_t nwords ) {
+	    copy<N>( data, data, nwords );
+	}
+
+    }
+
+}
+
+#endif // ! misFITS_BYTESWAP_H
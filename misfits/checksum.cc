@@ -0,0 +1,473 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fitsio.h>
+
+#include <misfits/table.hpp>
+#include <misfits/trace.hpp>
+
+#include "byteswap.hpp"
+#include "checksum.hpp"
+#include "fits_p.hpp"
+#include "parallel.hpp"
+
+namespace misFITS {
+
+    namespace Checksum {
+
+	unsigned long
+	sum( const unsigned char* data, std::size_t nbytes, LONGLONG offset ) {
+
+	    uint64_t sum = 0;
+
+	    // bytes before the first word boundary
+	    for ( ; nbytes && offset % 4 ; --nbytes, ++offset, ++data )
+		sum += static_cast<uint64_t>( *data ) << ( 8 * ( 3 - offset % 4 ) );
+
+	    // whole words. a 64 bit accumulator can absorb 2^32 words
+	    // before it overflows, and keeps the loop simple enough
+	    // for compilers to vectorize it.
+	    std::size_t nwords = nbytes / 4;
+	    const std::size_t MaxWords = 0xffffffffUL;
+
+	    while ( nwords ) {
+
+		std::size_t nsum = std::min( nwords, MaxWords );
+		uint64_t partial = 0;
+
+		for ( std::size_t idx = 0 ; idx < nsum ; ++idx ) {
+
+		    uint32_t word;
+		    std::memcpy( &word, data + 4 * idx, 4 );
+		    partial += ByteSwap::required ? ByteSwap::swap( word ) : word;
+		}
+
+		sum = fold( sum ) + fold( partial );
+
+		data += 4 * nsum;
+		nbytes -= 4 * nsum;
+		nwords -= nsum;
+	    }
+
+	    // the remainder of the last word
+	    for ( std::size_t idx = 0 ; idx < nbytes ; ++idx )
+		sum += static_cast<uint64_t>( data[idx] ) << ( 8 * ( 3 - idx ) );
+
+	    return fold( sum );
+	}
+    }
+
+    //-----------------------------------------
+
+    void
+    Table::track_datasum( bool flag ) {
+
+	if ( flag && view_ )
+	    throw Exception::Assert( "can't keep a running datasum for a tile compressed table" );
+
+	track_datasum_ = flag;
+	running_datasum_valid_ = false;
+	checksum_stale_ = flag;
+
+	update_pending();
+    }
+
+    void
+    Table::write_checksum() const {
+
+	// the checksums must cover the table as it will be left
+	trim_rows();
+	write_compressed();
+	set_as_chdu();
+
+	Trace::Span span( "Table::write_checksum", hdu_num_ );
+
+	if ( ! track_datasum_ || has_heap_ ) {
+
+	    misFITS_CHECK_CFITSIO_EXPR( fits_write_chksum( file_->fptr(), &status ) );
+
+	    checksum_stale_ = false;
+	    update_pending();
+	    return;
+	}
+
+	unsigned long data = datasum();
+
+	// as fits_write_chksum does, write the keywords with a zero
+	// CHECKSUM and then encode the complement of the HDU's sum
+	char date[FLEN_VALUE];
+	int timeref;
+	misFITS_CHECK_CFITSIO_EXPR( fits_get_system_time( date, &timeref, &status ) );
+
+	char datasum_str[FLEN_VALUE];
+	std::sprintf( datasum_str, "%lu", data );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_update_key_str( file_->fptr(), "CHECKSUM", const_cast<char*>( "0000000000000000" ),
+				  ( std::string( "HDU checksum updated " ) + date ).c_str(), &status );
+	     fits_update_key_str( file_->fptr(), "DATASUM", datasum_str,
+				  ( std::string( "data unit checksum updated " ) + date ).c_str(), &status );
+	     fits_set_hdustruc( file_->fptr(), &status );
+	     );
+
+	char checksum[FLEN_VALUE];
+	fits_encode_chksum( Checksum::add( header_sum(), data ), TRUE, checksum );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_update_key_str( file_->fptr(), "CHECKSUM", checksum, "&", &status ) );
+
+	checksum_stale_ = false;
+	update_pending();
+    }
+
+    // the sum of the header as it will be written: its records, the
+    // END record, and blank fill
+    unsigned long
+    Table::header_sum() const {
+
+	int nkeys, morekeys;
+	LONGLONG headstart, datastart, dataend;
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_get_hdrspace( file_->fptr(), &nkeys, &morekeys, &status );
+	     fits_get_hduaddrll( file_->fptr(), &headstart, &datastart, &dataend, &status );
+	     );
+
+	std::string header;
+	header.reserve( static_cast<std::string::size_type>( datastart - headstart ) );
+
+	char card[FLEN_CARD];
+	for ( int keynum = 1 ; keynum <= nkeys ; ++keynum ) {
+
+	    misFITS_CHECK_CFITSIO_EXPR( fits_read_record( file_->fptr(), keynum, card, &status ) );
+
+	    std::string record( card );
+	    record.resize( 80, ' ' );
+	    header += record;
+	}
+
+	header += std::string( "END" ).append( 77, ' ' );
+	header.resize( static_cast<std::string::size_type>( datastart - headstart ), ' ' );
+
+	return Checksum::sum( reinterpret_cast<const unsigned char*>( header.data() ), header.size() );
+    }
+
+    // the running datasum, recomputed from the data if the table's
+    // layout has changed or tracking has just started
+    unsigned long
+    Table::datasum() const {
+
+	if ( running_datasum_valid_ )
+	    return running_datasum_;
+
+	LONGLONG nrows = num_rows();
+	unsigned long sum = 0;
+
+	if ( rowlen_ ) {
+
+	    LONGLONG block = std::max<LONGLONG>( 1, ( 1 << 20 ) / rowlen_ );
+	    std::vector<unsigned char> buffer;
+
+	    for ( LONGLONG row = 1 ; row <= nrows ; row += block ) {
+
+		LONGLONG nbytes = std::min( block, nrows - row + 1 ) * rowlen_;
+		buffer.resize( static_cast<std::size_t>( nbytes ) );
+
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_read_tblbytes( data_fptr(), row, 1, nbytes, &buffer[0], &status ) );
+
+		sum = Checksum::add( sum, Checksum::sum( &buffer[0], buffer.size(), ( row - 1 ) * rowlen_ ) );
+	    }
+	}
+
+	running_datasum_ = sum;
+	running_datasum_valid_ = true;
+
+	return running_datasum_;
+    }
+
+    unsigned long
+    Table::row_datasum( LONGLONG row ) const {
+
+	if ( ! rowlen_ )
+	    return 0;
+
+	scratch_.resize( static_cast<std::size_t>( rowlen_ ) );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_read_tblbytes( data_fptr(), row, 1, rowlen_, &scratch_[0], &status ) );
+
+	return Checksum::sum( &scratch_[0], scratch_.size(), ( row - 1 ) * rowlen_ );
+    }
+
+    // Row::write calls this before a row is written...
+    void
+    Table::datasum_remove( LONGLONG row ) const {
+
+	unsigned long sum = datasum();
+
+	// rows past the end (including reserved ones) are zero
+	if ( row <= num_rows() )
+	    sum = Checksum::add( sum, Checksum::negate( row_datasum( row ) ) );
+
+	// if the write fails, the sum is recomputed
+	running_datasum_ = sum;
+	running_datasum_valid_ = false;
+    }
+
+    // ... and this afterwards
+    void
+    Table::datasum_add( LONGLONG row ) const {
+
+	running_datasum_ = Checksum::add( running_datasum_, row_datasum( row ) );
+	running_datasum_valid_ = true;
+
+	if ( ! checksum_stale_ ) {
+	    checksum_stale_ = true;
+	    update_pending();
+	}
+    }
+
+    // for changes to the data not made through Row::write
+    void
+    Table::data_changed() const {
+
+	if ( ! track_datasum_ )
+	    return;
+
+	running_datasum_valid_ = false;
+
+	if ( ! checksum_stale_ ) {
+	    checksum_stale_ = true;
+	    update_pending();
+	}
+    }
+
+    //-----------------------------------------
+
+    namespace {
+
+	// the layout of an HDU and its checksum keywords
+	struct Unit {
+	    LONGLONG headstart;
+	    LONGLONG datastart;
+	    LONGLONG dataend;
+	    bool has_datasum;
+	    unsigned long datasum;
+	    bool has_checksum;
+	};
+
+	// a range of bytes in a header or data unit
+	struct Block {
+	    std::size_t unit;
+	    bool data;
+	    LONGLONG start;
+	    LONGLONG nbytes;
+	};
+
+	const LONGLONG BlockSize = 1 << 22;
+
+	// sum blocks of a file using pread, which may be called
+	// concurrently
+	class SumBlocks {
+
+	public:
+
+	    SumBlocks( int fd, const std::vector<Block>& blocks, std::vector<unsigned long>& sums ) :
+		fd_( fd ), blocks_( blocks ), sums_( sums ) {}
+
+	    void operator()( std::size_t idx ) {
+
+		const Block& block = blocks_[idx];
+		std::vector<unsigned char> buffer( static_cast<std::size_t>( block.nbytes ) );
+
+		std::size_t nread = 0;
+		while ( nread < buffer.size() ) {
+
+		    ssize_t n = pread( fd_, &buffer[nread], buffer.size() - nread,
+				       static_cast<off_t>( block.start + nread ) );
+
+		    if ( n < 0 && errno == EINTR )
+			continue;
+
+		    if ( n <= 0 )
+			throw Exception::Assert( std::string( "error reading file for checksum: " )
+						 + ( n ? std::strerror( errno ) : "unexpected end of file" ) );
+
+		    nread += static_cast<std::size_t>( n );
+		}
+
+		// HDUs start on block boundaries, so the offset within
+		// the file places bytes in their words
+		sums_[idx] = Checksum::sum( &buffer[0], buffer.size(), block.start );
+	    }
+
+	private:
+
+	    int fd_;
+	    const std::vector<Block>& blocks_;
+	    std::vector<unsigned long>& sums_;
+	};
+
+	ChecksumStatus::Result
+	result( bool present, bool correct ) {
+	    return ! present ? ChecksumStatus::Missing
+		: correct ? ChecksumStatus::Correct
+		: ChecksumStatus::Incorrect;
+	}
+    }
+
+    std::vector<ChecksumStatus>
+    File::verify_checksums( unsigned int nthreads ) const {
+
+	Trace::Span span( "File::verify_checksums" );
+	span.arg( "file", file );
+
+	// make sure the file is up to date
+	if ( mode == OpenMode::ReadWrite )
+	    flush();
+
+	int chdu = hdu_num();
+	int nhdus = num_hdus();
+
+	std::vector<ChecksumStatus> results( nhdus );
+
+	char urltype[FLEN_FILENAME];
+	char filename[FLEN_FILENAME];
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_url_type( fptr(), urltype, &status );
+	     fits_file_name( fptr(), filename, &status );
+	     );
+
+	int fd = std::string( urltype ) == "file://" ? ::open( filename, O_RDONLY ) : -1;
+
+	// leave anything which isn't a plain disk file to CFITSIO
+	if ( fd < 0 ) {
+
+	    for ( int hdu = 1 ; hdu <= nhdus ; ++hdu ) {
+
+		move_to( hdu );
+
+		int dataok, hduok;
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_verify_chksum( fptr(), &dataok, &hduok, &status ) );
+
+		results[hdu-1].hdu_num = hdu;
+		results[hdu-1].datasum = static_cast<ChecksumStatus::Result>( dataok );
+		results[hdu-1].checksum = static_cast<ChecksumStatus::Result>( hduok );
+	    }
+
+	    move_to( chdu );
+	    return results;
+	}
+
+	std::vector<Unit> units( nhdus );
+	std::vector<Block> blocks;
+
+	try {
+
+	    for ( int hdu = 1 ; hdu <= nhdus ; ++hdu ) {
+
+		Unit& unit = units[hdu-1];
+
+		move_to( hdu );
+
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_get_hduaddrll( fptr(), &unit.headstart, &unit.datastart, &unit.dataend, &status ) );
+
+		char value[FLEN_VALUE];
+		int kstatus = 0;
+
+		fits_read_key_str( fptr(), "DATASUM", value, NULL, &kstatus );
+		unit.has_datasum = kstatus == 0;
+		unit.datasum = unit.has_datasum ? Checksum::fold( std::strtoull( value, NULL, 10 ) ) : 0;
+
+		kstatus = 0;
+		fits_read_key_str( fptr(), "CHECKSUM", value, NULL, &kstatus );
+		unit.has_checksum = kstatus == 0;
+
+		Block header = { static_cast<std::size_t>( hdu - 1 ), false, unit.headstart, unit.datastart - unit.headstart };
+		blocks.push_back( header );
+
+		for ( LONGLONG start = unit.datastart ; start < unit.dataend ; start += BlockSize ) {
+		    Block data = { static_cast<std::size_t>( hdu - 1 ), true, start, std::min( BlockSize, unit.dataend - start ) };
+		    blocks.push_back( data );
+		}
+	    }
+
+	    move_to( chdu );
+
+	    std::vector<unsigned long> sums( blocks.size() );
+	    SumBlocks task( fd, blocks, sums );
+
+	    Parallel::for_each( blocks.size(), nthreads ? nthreads : Parallel::default_threads(), task );
+
+	    ::close( fd );
+	    fd = -1;
+
+	    // the sum is associative, so the partial sums may be
+	    // combined in any order
+	    std::vector<unsigned long> datasum( nhdus, 0 );
+	    std::vector<unsigned long> hdusum( nhdus, 0 );
+
+	    for ( std::size_t idx = 0 ; idx < blocks.size() ; ++idx ) {
+
+		std::size_t unit = blocks[idx].unit;
+
+		if ( blocks[idx].data )
+		    datasum[unit] = Checksum::add( datasum[unit], sums[idx] );
+
+		hdusum[unit] = Checksum::add( hdusum[unit], sums[idx] );
+	    }
+
+	    // a correct CHECKSUM makes the sum of the HDU negative zero
+	    for ( int hdu = 1 ; hdu <= nhdus ; ++hdu ) {
+
+		results[hdu-1].hdu_num = hdu;
+		results[hdu-1].datasum = result( units[hdu-1].has_datasum, datasum[hdu-1] == units[hdu-1].datasum );
+		results[hdu-1].checksum = result( units[hdu-1].has_checksum, hdusum[hdu-1] == 0 );
+	    }
+	}
+
+	catch ( ... ) {
+
+	    if ( fd >= 0 )
+		::close( fd );
+	    throw;
+	}
+
+	return results;
+    }
+}
@@ -0,0 +1,71 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: FITS ones' complement checksums
+
+#ifndef misFITS_CHECKSUM_H
+#define misFITS_CHECKSUM_H
+
+#include <cstddef>
+
+#include <misfits/config.hpp>
+#include <misfits/types.hpp>
+
+namespace misFITS {
+
+    namespace Checksum {
+
+	// FITS checksums are 32 bit ones' complement sums of the big
+	// endian words in an HDU.  ones' complement addition is
+	// addition modulo 2^32 - 1, so sums are kept reduced in
+	// [0, 2^32 - 2]; "negative zero" is represented as zero.
+	// partial sums may be combined in any order, and a block of
+	// data may be removed from a sum by adding its negation.
+
+	inline unsigned long
+	fold( uint64_t sum ) {
+
+	    while ( sum >> 32 )
+		sum = ( sum & 0xffffffffUL ) + ( sum >> 32 );
+
+	    return sum == 0xffffffffUL ? 0 : static_cast<unsigned long>( sum );
+	}
+
+	inline unsigned long
+	add( unsigned long a, unsigned long b ) {
+	    return fold( static_cast<uint64_t>( a ) + b );
+	}
+
+	inline unsigned long
+	negate( unsigned long a ) {
+	    return a ? 0xffffffffUL - a : 0;
+	}
+
+	// the sum of nbytes of data which start offset bytes into the
+	// HDU, so that each byte is placed in the proper position in
+	// its word.
+	unsigned long sum( const unsigned char* data, std::size_t nbytes, LONGLONG offset = 0 );
+    }
+}
+
+#endif // ! misFITS_CHECKSUM_H
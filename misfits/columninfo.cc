@@ -19,6 +19,7 @@
 //
 // -->8-->8-->8-->8--
 
+#include <cstring>
 #include <numeric>
 #include <string>
 #include <sstream>
@@ -36,6 +37,8 @@ namespace misFITS {
     bool ColumnInfo::operator == (const ColumnInfo& col ) const {
 	return
 	    col.column_type->id()  == column_type->id() &&
+	    col.varlength    == varlength &&
+	    col.long_descriptor == long_descriptor &&
 	    col.extent       == extent;
     }
 
@@ -54,8 +57,8 @@ namespace misFITS {
 				    ttype_t, tunit_t,
 				    NULL, // typechar
 				    NULL, // repeat
-				    NULL, // scale,
-				    NULL, // zero,
+				    &tscal,
+				    &tzero,
 				    NULL, // nulval,
 				    NULL, // tdisp,
 				    &status )
@@ -64,6 +67,21 @@ namespace misFITS {
 	tunit = string( tunit_t );
 	ttype = string( ttype_t );
 
+	{
+	    ostringstream tnull_key;
+	    tnull_key << "TNULL" << colnum;
+
+	    int status = 0;
+	    fits_read_key( file.fptr(), TLONGLONG, tnull_key.str().c_str(), &tnull, NULL, &status );
+
+	    if ( status && status != KEY_NO_EXIST )
+		throw Exception::CFITSIO( status );
+
+	    has_tnull = ! status;
+	    if ( ! has_tnull )
+		tnull = 0;
+	}
+
 	int typecode;
 	long width;
 	LONGLONG repeat;
@@ -92,6 +110,32 @@ namespace misFITS {
 	width = twidth;
 #endif // LONGLONG FUDGE
 
+	// CFITSIO flags variable length array columns with a negative
+	// typecode. the repeat count is the maximum length of a cell,
+	// the width that of an element; the row holds only the
+	// descriptor, whose size depends upon whether it's a P or Q
+	// column.
+	varlength = typecode < 0;
+	long_descriptor = false;
+
+	if ( varlength ) {
+
+	    column_type = ColumnType::spec_from_id( -typecode );
+
+	    ostringstream tform_key;
+	    tform_key << "TFORM" << colnum;
+
+	    char tform_t[FLEN_VALUE];
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_read_key_str( file.fptr(), tform_key.str().c_str(), tform_t, NULL, &status ) );
+
+	    long_descriptor = NULL != strchr( tform_t, 'Q' );
+
+	    extent = Extent( repeat );
+	    nbytes = long_descriptor ? 16 : 8;
+	    return;
+	}
+
 	column_type = ColumnType::spec_from_id(typecode);
 
 	int naxis;
@@ -155,15 +199,41 @@ namespace misFITS {
 
     ColumnInfo::ColumnInfo( const std::string& type, ColumnType::ID::type column_type_, const std::string& unit,
 			    const Extent& extent_, TableColumnsType::size_type colnum_ ) :
-	ttype( type ), tunit( unit), column_type( ColumnType::spec_from_id( column_type_ ) ), extent( extent_ ), colnum( colnum_ ) {
+	ttype( type ), tunit( unit), column_type( ColumnType::spec_from_id( column_type_ ) ), tscal( 1.0 ), tzero( 0.0 ),
+	has_tnull( false ), tnull( 0 ),
+	extent( extent_ ), colnum( colnum_ ),
+	varlength( false ), long_descriptor( false ) {
 
 	nbytes = column_type->width( extent.nelem() );
     }
 
+    ColumnInfo::ColumnInfo( const std::string& type, ColumnType::ID::type column_type_, const std::string& unit,
+			    const VarLength& varlength_, TableColumnsType::size_type colnum_ ) :
+	ttype( type ), tunit( unit), column_type( ColumnType::spec_from_id( column_type_ ) ), tscal( 1.0 ), tzero( 0.0 ),
+	has_tnull( false ), tnull( 0 ),
+	extent( varlength_.max ), colnum( colnum_ ),
+	varlength( true ), long_descriptor( varlength_.long_descriptor ) {
+
+	if ( ColumnType::ID::Bit == column_type->id() )
+	    throw Exception::Assert( "variable length bit columns are not supported" );
+
+	nbytes = long_descriptor ? 16 : 8;
+    }
+
     std::string
     ColumnInfo::tform() const {
 
 	ostringstream tform;
+
+	if ( varlength ) {
+
+	    tform << ( long_descriptor ? 'Q' : 'P' ) << column_type->code();
+	    if ( extent.nelem() > 0 )
+		tform << '(' << extent.nelem() << ')';
+
+	    return tform.str();
+	}
+
 	if ( extent.nelem() > 1 )
 	    tform << extent.nelem();
 
@@ -193,7 +263,7 @@ namespace misFITS {
 	// if there's only a single dimension, don't write out a TDIM
 	// keyword, as CIAO can't handle that for bitstrings (and it's
 	// redundant, anyway)
-	if ( extent.squeeze().naxes() > 1 )
+	if ( ! varlength && extent.squeeze().naxes() > 1 )
 	    misFITS_CHECK_CFITSIO_EXPR
 		(
 		 fits_write_tdimll( file.fptr(),
@@ -203,6 +273,24 @@ namespace misFITS {
 				    &status )
 		 );
 
+	if ( has_tnull ) {
+
+	    ostringstream tnull_key;
+	    tnull_key << "TNULL" << colnum;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		(
+		 fits_update_key( file.fptr(), TLONGLONG,
+				  const_cast<char*>( tnull_key.str().c_str() ),
+				  const_cast<LONGLONG*>( &tnull ),
+				  NULL, &status )
+		 );
+
+	    // CFITSIO only reads TNULLn when it parses the header
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_set_btblnull( file.fptr(), static_cast<int>( colnum ), tnull, &status ) );
+	}
+
     }
 }
 
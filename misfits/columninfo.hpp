@@ -29,6 +29,18 @@
 
 namespace misFITS {
 
+    // requests a variable length array column.  max is the maximum
+    // number of elements in a cell, if known. Q descriptors (64 bit
+    // heap offsets) are used if long_descriptor is true.
+    struct VarLength {
+
+	LONGLONG max;
+	bool long_descriptor;
+
+	explicit VarLength( LONGLONG max = 0, bool long_descriptor = false ) :
+	    max( max ), long_descriptor( long_descriptor ) {}
+    };
+
     class ColumnInfo {
 
     public:
@@ -38,6 +50,15 @@ namespace misFITS {
 	std::string tunit;
 	ColumnType::SpecPtr  column_type;
 
+	// TSCALn and TZEROn
+	double tscal;
+	double tzero;
+
+	// TNULLn, the stored value of an undefined integer element.
+	// floating point columns use NaN instead.
+	bool has_tnull;
+	LONGLONG tnull;
+
 	// offset of first byte from start of row. for use in directly
 	// accessing raw data.  This is *not* initialized in the constructor for
 	// this column
@@ -50,10 +71,20 @@ namespace misFITS {
 	// this may be the only unique id for the column
 	TableColumnsType::size_type colnum;
 
+	// variable length array (P or Q) column. the cell holds a
+	// descriptor pointing into the heap, and extent is the maximum
+	// number of elements in a cell.
+	bool varlength;
+	bool long_descriptor;
+
 	ColumnInfo( const std::string& name, ColumnType::ID::type column_type,
 		    const std::string& unit, const Extent& extent,
 		    TableColumnsType::size_type = 0);
 
+	ColumnInfo( const std::string& name, ColumnType::ID::type column_type,
+		    const std::string& unit, const VarLength& varlength,
+		    TableColumnsType::size_type = 0);
+
 	// initialize from the CHDU in a fits file. requires byte offset into table storage for each column to handle
 	// string ('A') columns.
 	ColumnInfo( const misFITS::File& file, const std::string& name, LONGLONG offset );
@@ -70,6 +101,9 @@ namespace misFITS {
 
 	std::string tform () const;
 
+	// true if values are stored unscaled
+	bool unscaled() const { return tscal == 1.0 && tzero == 0.0; }
+
     private:
 	void init( const misFITS::File& file );
 
@@ -232,6 +232,28 @@
 
 #endif
 
+#ifdef HAVE_STD__UINT64_T
+
+#include <cstdint>
+
+    namespace misFITS {
+
+	using std::uint64_t;
+
+    }
+
+#elif HAVE_BOOST__UINT64_T
+
+    #include <boost/cstdint.hpp>
+
+    namespace misFITS {
+
+	using boost::uint64_t;
+
+    }
+
+#endif
+
 
 #endif  // ! misFITS_misCONFIG_H
 
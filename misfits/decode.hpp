@@ -0,0 +1,249 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: conversion between column data in FITS byte order and
+// host types, bypassing CFITSIO.  each kernel combines the byte swap,
+// type conversion and scaling in a single pass over the data.
+
+#ifndef misFITS_DECODE_H
+#define misFITS_DECODE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#include <boost/core/scoped_enum.hpp>
+#include <boost/type_traits/conditional.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+#include <fitsio.h>
+
+#include <misfits/config.hpp>
+
+#include "byteswap.hpp"
+
+namespace misFITS {
+
+    namespace Decode {
+
+	// true if every value of type S is exactly representable as a
+	// T. conversions to floating point types are included as
+	// CFITSIO performs them without range checks; narrowing
+	// between floating point types is not.  char is excluded, as
+	// CFITSIO treats it as unsigned regardless of the platform.
+	template< typename S, typename T >
+	struct Lossless {
+
+	    typedef std::numeric_limits<S> s;
+	    typedef std::numeric_limits<T> t;
+
+	    static const bool value =
+		   ! boost::is_same<T, char>::value
+		&& ! boost::is_same<S, char>::value
+		&& ( t::is_integer
+		     ? s::is_integer && ( t::is_signed || ! s::is_signed ) && s::digits <= t::digits
+		     : s::is_integer || sizeof( S ) <= sizeof( T ) );
+	};
+
+	// unsigned integers are stored as signed integers with a TZERO
+	// of 2^(nbits-1); signed bytes as unsigned bytes with a TZERO of
+	// -128. converting between the two representations is a
+	// matter of flipping the sign bit.
+	template< typename S >
+	struct Offset {
+
+	    typedef typename ByteSwap::Word<sizeof(S)>::type word_t;
+
+	    // the type the values represent
+	    typedef typename boost::conditional< std::numeric_limits<S>::is_signed,
+						 word_t, signed char >::type type;
+
+	    static const word_t mask = static_cast<word_t>( word_t(1) << ( 8 * sizeof(S) - 1 ) );
+
+	    static double tzero() {
+		return std::numeric_limits<S>::is_signed
+		    ? static_cast<double>( mask )
+		    : -static_cast<double>( mask );
+	    }
+	};
+
+	// load a value in FITS byte order
+	template< typename S >
+	inline S load( const unsigned char* src ) {
+
+	    typename ByteSwap::Word<sizeof(S)>::type w;
+	    std::memcpy( &w, src, sizeof(S) );
+	    if ( ByteSwap::required )
+		w = ByteSwap::swap( w );
+
+	    S v;
+	    std::memcpy( &v, &w, sizeof(S) );
+	    return v;
+	}
+
+	// store a value in FITS byte order
+	template< typename S >
+	inline void store( S v, unsigned char* dst ) {
+
+	    typename ByteSwap::Word<sizeof(S)>::type w;
+	    std::memcpy( &w, &v, sizeof(S) );
+	    if ( ByteSwap::required )
+		w = ByteSwap::swap( w );
+	    std::memcpy( dst, &w, sizeof(S) );
+	}
+
+	//-----------------------------------------
+
+	// stored values, no scaling
+	template< typename S, typename T >
+	void convert( const unsigned char* src, std::size_t nelem, T* dst ) {
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx, src += sizeof(S) )
+		dst[idx] = static_cast<T>( load<S>( src ) );
+	}
+
+	// values stored with the TZERO offset convention
+	template< typename S, typename T >
+	void flip( const unsigned char* src, std::size_t nelem, T* dst ) {
+
+	    typedef Offset<S> O;
+	    typedef typename O::word_t word_t;
+	    typedef typename O::type   type;
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx, src += sizeof(S) ) {
+		word_t w = load<word_t>( src ) ^ O::mask;
+		type v;
+		std::memcpy( &v, &w, sizeof(S) );
+		dst[idx] = static_cast<T>( v );
+	    }
+	}
+
+	// stored * tscal + tzero, computed as does CFITSIO
+	template< typename S, typename T >
+	void scale( const unsigned char* src, std::size_t nelem, double tscal, double tzero, T* dst ) {
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx, src += sizeof(S) )
+		dst[idx] = static_cast<T>( static_cast<double>( load<S>( src ) ) * tscal + tzero );
+	}
+
+	//-----------------------------------------
+
+	// stored integers equal to TNULLn and stored NaNs are undefined
+	template< typename S >
+	inline bool defined( S v, const LONGLONG* tnull ) {
+
+	    if ( std::numeric_limits<S>::is_integer )
+		return ! tnull || static_cast<LONGLONG>( v ) != *tnull;
+
+	    return v == v;
+	}
+
+	// pack the validity of the stored values into bytes, least
+	// significant bit first.  a set bit marks a defined element.
+	template< typename S >
+	void validity( const unsigned char* src, std::size_t nelem, const LONGLONG* tnull, uint8_t* valid ) {
+
+	    for ( std::size_t first = 0 ; first < nelem ; first += 8, ++valid ) {
+
+		std::size_t nbits = std::min<std::size_t>( 8, nelem - first );
+		uint8_t bits = 0;
+
+		for ( std::size_t bit = 0 ; bit < nbits ; ++bit, src += sizeof(S) )
+		    bits |= static_cast<uint8_t>( defined( load<S>( src ), tnull ) ) << bit;
+
+		*valid = bits;
+	    }
+	}
+
+	//-----------------------------------------
+
+	template< typename T, typename S >
+	void unconvert( const T* src, std::size_t nelem, unsigned char* dst ) {
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx, dst += sizeof(S) )
+		store<S>( static_cast<S>( src[idx] ), dst );
+	}
+
+	template< typename T, typename S >
+	void unflip( const T* src, std::size_t nelem, unsigned char* dst ) {
+
+	    typedef Offset<S> O;
+	    typedef typename O::word_t word_t;
+	    typedef typename O::type   type;
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx, dst += sizeof(S) ) {
+		type v = static_cast<type>( src[idx] );
+		word_t w;
+		std::memcpy( &w, &v, sizeof(S) );
+		store<word_t>( w ^ O::mask, dst );
+	    }
+	}
+
+	//-----------------------------------------
+
+	BOOST_SCOPED_ENUM_DECLARE_BEGIN( Kernel )
+	{
+	    None, Convert, Flip, Scale
+	}
+	BOOST_SCOPED_ENUM_DECLARE_END( Kernel )
+
+	// which kernel reads values stored as S into a T
+	template< typename S, typename T >
+	Kernel reader( double tscal, double tzero ) {
+
+	    if ( tscal == 1.0 && tzero == 0.0 )
+		return Lossless<S,T>::value ? Kernel::Convert : Kernel::None;
+
+	    if ( std::numeric_limits<S>::is_integer
+		 && std::numeric_limits<T>::is_integer
+		 && tscal == 1.0 && tzero == Offset<S>::tzero()
+		 && Lossless< typename Offset<S>::type, T >::value )
+		return Kernel::Flip;
+
+	    // scaling into anything narrower than a double requires
+	    // range checks
+	    return boost::is_same<T, double>::value ? Kernel::Scale : Kernel::None;
+	}
+
+	// which kernel writes a T into a column stored as S. scaled
+	// writes need rounding and range checks, so are left to CFITSIO.
+	template< typename T, typename S >
+	Kernel writer( double tscal, double tzero ) {
+
+	    if ( tscal == 1.0 && tzero == 0.0 )
+		return Lossless<T,S>::value ? Kernel::Convert : Kernel::None;
+
+	    if ( std::numeric_limits<S>::is_integer
+		 && tscal == 1.0 && tzero == Offset<S>::tzero()
+		 && Lossless< T, typename Offset<S>::type >::value )
+		return Kernel::Flip;
+
+	    return Kernel::None;
+	}
+
+    }
+
+}
+
+#endif // ! misFITS_DECODE_H
@@ -0,0 +1,541 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+
+#include <fitsio.h>
+
+#include <misfits/driver.hpp>
+
+#include "driver_p.hpp"
+#include "fits_p.hpp"
+
+// fits_register_driver is only declared in CFITSIO's private
+// fitsio2.h, which has no C++ guards.  configure checks whether it's
+// installed; if not, the declaration is repeated here.  it's been
+// unchanged from CFITSIO 3.0 through 4.x, and must be checked before
+// other versions are accepted.
+#ifdef HAVE_FITSIO2_H
+extern "C" {
+#include <fitsio2.h>
+}
+#else
+#if ! defined( CFITSIO_MAJOR ) || CFITSIO_MAJOR < 3 || CFITSIO_MAJOR > 4
+#error "check fits_register_driver's prototype against this version of CFITSIO's fitsio2.h"
+#endif
+extern "C" int
+fits_register_driver( char* prefix,
+		      int (*init)( void ),
+		      int (*shutdown)( void ),
+		      int (*setoptions)( int option ),
+		      int (*getoptions)( int* options ),
+		      int (*getversion)( int* version ),
+		      int (*checkfile)( char* urltype, char* infile, char* outfile ),
+		      int (*open)( char* filename, int rwmode, int* driverhandle ),
+		      int (*create)( char* filename, int* driverhandle ),
+		      int (*truncate)( int driverhandle, LONGLONG filesize ),
+		      int (*close)( int driverhandle ),
+		      int (*remove)( char* filename ),
+		      int (*size)( int driverhandle, LONGLONG* size ),
+		      int (*flush)( int driverhandle ),
+		      int (*seek)( int driverhandle, LONGLONG offset ),
+		      int (*read)( int driverhandle, void* buffer, long nbytes ),
+		      int (*write)( int driverhandle, void* buffer, long nbytes ) );
+#endif
+
+namespace misFITS {
+
+    namespace Driver {
+
+	namespace {
+
+	    // a read only region of memory, or a source, and the
+	    // current position within it
+	    struct Region {
+
+		const unsigned char* data;
+		LONGLONG size;
+		LONGLONG pos;
+
+		// if mapped, the region is unmapped when closed
+		bool mapped;
+		bool used;
+
+		Source* source;
+
+		// the region's entry in the registry, if it has one
+		unsigned long id;
+	    };
+
+	    // CFITSIO refers to open files by an integer handle, here an
+	    // index into the regions.  only opening and closing change
+	    // the table; a handle is only ever used by one fitsfile.  a
+	    // deque, so that references to regions aren't invalidated as
+	    // it grows.
+	    boost::mutex regions_mutex;
+	    std::deque<Region> regions;
+
+	    // the memory and sources which buffer_url and source_url
+	    // have been asked for.  the drivers are registered with
+	    // CFITSIO for the whole process, so a URL only names an entry
+	    // here, never an address; any other file name is rejected.
+	    // an entry is claimed when it's opened, so it can only be
+	    // opened once, and is forgotten when it's closed, or when its
+	    // source is destroyed.  guarded by regions_mutex.
+	    struct Registered {
+		const unsigned char* data;
+		LONGLONG size;
+		Source* source;
+		bool claimed;
+	    };
+	    typedef std::map<unsigned long, Registered> Registry;
+	    Registry registry;
+	    unsigned long last_id = 0;
+
+	    unsigned long
+	    add_registered( const unsigned char* data, LONGLONG size, Source* source = NULL ) {
+
+		boost::lock_guard<boost::mutex> lock( regions_mutex );
+
+		Registered entry = { data, size, source, false };
+		registry[++last_id] = entry;
+		return last_id;
+	    }
+
+	    // the id in a URL's file name, or zero if it isn't one
+	    unsigned long
+	    parse_id( const char* filename ) {
+
+		char* end;
+		unsigned long id = std::strtoul( filename, &end, 10 );
+		if ( end == filename || *end != '\0' || *filename == '-' )
+		    return 0;
+
+		return id;
+	    }
+
+	    // claim the entry named by a URL's file name, if it's one of
+	    // a source's or not, as wanted
+	    bool
+	    claim( const char* filename, bool source, unsigned long& id, Registered& entry ) {
+
+		id = parse_id( filename );
+
+		boost::lock_guard<boost::mutex> lock( regions_mutex );
+
+		Registry::iterator found = registry.find( id );
+		if (    found == registry.end()
+		     || found->second.claimed
+		     || ( found->second.source != NULL ) != source )
+		    return false;
+
+		found->second.claimed = true;
+		entry = found->second;
+		return true;
+	    }
+
+	    int
+	    add_region( const unsigned char* data, LONGLONG size, bool mapped,
+			unsigned long id = 0, Source* source = NULL ) {
+
+		boost::lock_guard<boost::mutex> lock( regions_mutex );
+
+		Region region = { data, size, 0, mapped, true, source, id };
+
+		std::deque<Region>::size_type handle = 0;
+		while ( handle < regions.size() && regions[handle].used )
+		    ++handle;
+
+		if ( handle == regions.size() )
+		    regions.push_back( region );
+		else
+		    regions[handle] = region;
+
+		return static_cast<int>( handle );
+	    }
+
+	    Region&
+	    region( int handle ) {
+		boost::lock_guard<boost::mutex> lock( regions_mutex );
+		return regions[handle];
+	    }
+
+	    // CFITSIO can't see exceptions; leave the message on its
+	    // error stack instead
+	    int
+	    source_error( const std::exception& e, int status ) {
+
+		std::string message( e.what() );
+		message = message.substr( 0, message.find( '\n' ) );
+
+		fits_write_errmsg( message.c_str() );
+		return status;
+	    }
+
+	    // CFITSIO is a C library, so the drivers' callbacks have C
+	    // linkage.  C names share a single namespace, so they're
+	    // prefixed to keep them apart from CFITSIO's own drivers.
+	    extern "C" {
+
+	    //-----------------------------------------
+	    // operations common to both drivers
+
+	    int
+	    mf_driver_init( void ) { return 0; }
+
+	    int
+	    mf_driver_shutdown( void ) { return 0; }
+
+	    int
+	    mf_driver_setoptions( int ) { return 0; }
+
+	    int
+	    mf_driver_getoptions( int* options ) {
+		*options = 0;
+		return 0;
+	    }
+
+	    int
+	    mf_driver_getversion( int* version ) {
+		*version = 10;
+		return 0;
+	    }
+
+	    int
+	    mf_driver_create( char*, int* ) { return FILE_NOT_CREATED; }
+
+	    int
+	    mf_driver_truncate( int, LONGLONG ) { return READONLY_FILE; }
+
+	    int
+	    mf_driver_remove( char* ) { return FILE_NOT_CREATED; }
+
+	    int
+	    mf_driver_flush( int ) { return 0; }
+
+	    int
+	    mf_driver_write( int, void*, long ) { return READONLY_FILE; }
+
+	    int
+	    mf_driver_close( int handle ) {
+
+		boost::lock_guard<boost::mutex> lock( regions_mutex );
+
+		Region& r = regions[handle];
+
+		if ( r.mapped && r.size )
+		    munmap( const_cast<unsigned char*>( r.data ), static_cast<size_t>( r.size ) );
+
+		if ( r.id )
+		    registry.erase( r.id );
+
+		r.used = false;
+		return 0;
+	    }
+
+	    int
+	    mf_driver_size( int handle, LONGLONG* size ) {
+		*size = region( handle ).size;
+		return 0;
+	    }
+
+	    int
+	    mf_driver_seek( int handle, LONGLONG offset ) {
+
+		Region& r = region( handle );
+
+		if ( offset > r.size )
+		    return END_OF_FILE;
+
+		r.pos = offset;
+		return 0;
+	    }
+
+	    int
+	    mf_driver_read( int handle, void* buffer, long nbytes ) {
+
+		Region& r = region( handle );
+
+		if ( r.pos + nbytes > r.size )
+		    return END_OF_FILE;
+
+		std::memcpy( buffer, r.data + r.pos, static_cast<size_t>( nbytes ) );
+		r.pos += nbytes;
+		return 0;
+	    }
+
+	    //-----------------------------------------
+	    // mfmap://
+
+	    int
+	    mf_mmap_open( char* filename, int rwmode, int* handle ) {
+
+		if ( rwmode != READONLY )
+		    return READONLY_FILE;
+
+		int fd = ::open( filename, O_RDONLY );
+		if ( fd < 0 )
+		    return FILE_NOT_OPENED;
+
+		struct stat st;
+		if ( fstat( fd, &st ) ) {
+		    ::close( fd );
+		    return FILE_NOT_OPENED;
+		}
+
+		size_t size = static_cast<size_t>( st.st_size );
+		void* data = NULL;
+
+		// the mapping outlives the descriptor
+		if ( size ) {
+
+		    data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+		    if ( data == MAP_FAILED ) {
+			::close( fd );
+			return FILE_NOT_OPENED;
+		    }
+
+		    posix_madvise( data, size, POSIX_MADV_SEQUENTIAL );
+		    posix_madvise( data, size, POSIX_MADV_WILLNEED );
+		}
+
+		::close( fd );
+
+		*handle = add_region( static_cast<const unsigned char*>( data ),
+				      static_cast<LONGLONG>( size ), true );
+		return 0;
+	    }
+
+	    //-----------------------------------------
+	    // mfbuf://
+
+	    int
+	    mf_buffer_open( char* filename, int rwmode, int* handle ) {
+
+		if ( rwmode != READONLY )
+		    return READONLY_FILE;
+
+		// see buffer_url
+		unsigned long id;
+		Registered entry;
+		if ( ! claim( filename, false, id, entry ) )
+		    return FILE_NOT_OPENED;
+
+		*handle = add_region( entry.data, entry.size, false, id );
+		return 0;
+	    }
+
+	    //-----------------------------------------
+	    // mfsrc://
+
+	    int
+	    mf_source_open( char* filename, int, int* handle ) {
+
+		// see source_url
+		unsigned long id;
+		Registered entry;
+		if ( ! claim( filename, true, id, entry ) )
+		    return FILE_NOT_OPENED;
+
+		*handle = add_region( NULL, 0, false, id, entry.source );
+		return 0;
+	    }
+
+	    int
+	    mf_source_truncate( int handle, LONGLONG size ) {
+
+		try {
+		    region( handle ).source->truncate( size );
+		}
+		catch ( Exception::CFITSIO& e ) {
+		    return source_error( e, e.status() );
+		}
+		catch ( std::exception& e ) {
+		    return source_error( e, WRITE_ERROR );
+		}
+
+		return 0;
+	    }
+
+	    int
+	    mf_source_size( int handle, LONGLONG* size ) {
+		*size = region( handle ).source->size();
+		return 0;
+	    }
+
+	    int
+	    mf_source_seek( int handle, LONGLONG offset ) {
+
+		Region& r = region( handle );
+
+		if ( offset > r.source->size() )
+		    return END_OF_FILE;
+
+		r.pos = offset;
+		return 0;
+	    }
+
+	    int
+	    mf_source_read( int handle, void* buffer, long nbytes ) {
+
+		Region& r = region( handle );
+
+		if ( r.pos + nbytes > r.source->size() )
+		    return END_OF_FILE;
+
+		try {
+		    r.source->read( r.pos, static_cast<unsigned char*>( buffer ), nbytes );
+		}
+		catch ( Exception::CFITSIO& e ) {
+		    return source_error( e, e.status() );
+		}
+		catch ( std::exception& e ) {
+		    return source_error( e, READ_ERROR );
+		}
+
+		r.pos += nbytes;
+		return 0;
+	    }
+
+	    int
+	    mf_source_write( int handle, void* buffer, long nbytes ) {
+
+		Region& r = region( handle );
+
+		try {
+		    r.source->write( r.pos, static_cast<const unsigned char*>( buffer ), nbytes );
+		}
+		catch ( Exception::CFITSIO& e ) {
+		    return source_error( e, e.status() );
+		}
+		catch ( std::exception& e ) {
+		    return source_error( e, WRITE_ERROR );
+		}
+
+		r.pos += nbytes;
+		return 0;
+	    }
+
+	    } // extern "C"
+
+	    void
+	    register_drivers() {
+
+		// CFITSIO registers its own drivers when first used; make
+		// sure that happens first.
+		misFITS_CHECK_CFITSIO_EXPR
+		    (
+		     status = fits_init_cfitsio();
+
+		     if ( ! status )
+			 status = fits_register_driver( const_cast<char*>( "mfmap://" ),
+							mf_driver_init, mf_driver_shutdown,
+							mf_driver_setoptions, mf_driver_getoptions,
+							mf_driver_getversion, NULL,
+							mf_mmap_open, mf_driver_create,
+							mf_driver_truncate, mf_driver_close,
+							mf_driver_remove, mf_driver_size,
+							mf_driver_flush, mf_driver_seek,
+							mf_driver_read, mf_driver_write );
+
+		     if ( ! status )
+			 status = fits_register_driver( const_cast<char*>( "mfbuf://" ),
+							mf_driver_init, mf_driver_shutdown,
+							mf_driver_setoptions, mf_driver_getoptions,
+							mf_driver_getversion, NULL,
+							mf_buffer_open, mf_driver_create,
+							mf_driver_truncate, mf_driver_close,
+							mf_driver_remove, mf_driver_size,
+							mf_driver_flush, mf_driver_seek,
+							mf_driver_read, mf_driver_write );
+
+		     if ( ! status )
+			 status = fits_register_driver( const_cast<char*>( "mfsrc://" ),
+							mf_driver_init, mf_driver_shutdown,
+							mf_driver_setoptions, mf_driver_getoptions,
+							mf_driver_getversion, NULL,
+							mf_source_open, mf_driver_create,
+							mf_source_truncate, mf_driver_close,
+							mf_driver_remove, mf_source_size,
+							mf_driver_flush, mf_source_seek,
+							mf_source_read, mf_source_write );
+		     );
+	    }
+
+	    boost::once_flag registered = BOOST_ONCE_INIT;
+	}
+
+	void
+	init() {
+	    boost::call_once( registered, register_drivers );
+	}
+
+	std::string
+	buffer_url( const void* data, std::size_t size ) {
+
+	    unsigned long id = add_registered( static_cast<const unsigned char*>( data ),
+					       static_cast<LONGLONG>( size ) );
+
+	    std::ostringstream os;
+	    os << "mfbuf://" << id;
+	    return os.str();
+	}
+
+	std::string
+	source_url( Source* source ) {
+
+	    init();
+
+	    std::ostringstream os;
+	    os << "mfsrc://" << add_registered( NULL, 0, source );
+	    return os.str();
+	}
+
+	// forget any URLs for the source which weren't opened
+	Source::~Source() {
+
+	    boost::lock_guard<boost::mutex> lock( regions_mutex );
+
+	    Registry::iterator entry = registry.begin();
+	    while ( entry != registry.end() )
+		if ( entry->second.source == this )
+		    registry.erase( entry++ );
+		else
+		    ++entry;
+	}
+    }
+}
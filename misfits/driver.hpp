@@ -0,0 +1,55 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_DRIVER_H
+#define misFITS_DRIVER_H
+
+#include <cstddef>
+#include <string>
+
+namespace misFITS {
+
+    // CFITSIO I/O drivers provided by misFITS.  they're registered
+    // with CFITSIO the first time a file is opened, and are selected
+    // with a URL prefix:
+    //
+    //   mfmap://file   the file is memory mapped, with the kernel
+    //                  advised that it will be read sequentially.
+    //   mfbuf://...    a region of memory supplied by the caller;
+    //                  see buffer_url.
+    //
+    // both are read only.
+    namespace Driver {
+
+	// register the drivers with CFITSIO. safe to call more than once.
+	void init();
+
+	// the URL of a FITS file held in size bytes of memory at data.
+	// the URL names the memory without revealing its address, and
+	// may be opened once; it's forgotten when that file is closed.
+	// the memory must remain valid until then.
+	std::string buffer_url( const void* data, std::size_t size );
+    }
+}
+
+#endif // ! misFITS_DRIVER_H
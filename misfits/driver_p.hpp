@@ -0,0 +1,63 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_DRIVER_P_H
+#define misFITS_DRIVER_P_H
+
+#include <string>
+
+#include <fitsio.h>
+
+// internal: a CFITSIO driver for files whose contents are supplied
+// by an object rather than read from storage.  they're selected with
+// the mfsrc:// URL prefix; see source_url.
+
+namespace misFITS {
+
+    namespace Driver {
+
+	// the contents of a file.  CFITSIO calls these methods while
+	// it's servicing a call on the file, so they mustn't be used
+	// from more than one thread at a time.  exceptions are turned
+	// into CFITSIO errors.
+	class Source {
+
+	public:
+
+	    virtual ~Source();
+
+	    virtual LONGLONG size() const = 0;
+	    virtual void read( LONGLONG offset, unsigned char* buffer, LONGLONG nbytes ) = 0;
+	    virtual void write( LONGLONG offset, const unsigned char* buffer, LONGLONG nbytes ) = 0;
+	    virtual void truncate( LONGLONG size ) = 0;
+	};
+
+	// the URL of a file whose contents are supplied by source,
+	// which must outlive the file.  as with buffer_url, the URL
+	// names a registered source rather than its address, and may be
+	// opened once.
+	std::string source_url( Source* source );
+    }
+}
+
+#endif // ! misFITS_DRIVER_P_H
@@ -20,6 +20,7 @@
 // -->8-->8-->8-->8--
 
 #include <string>
+#include <sstream>
 #include <iostream>
 
 #include <fitsio.h>
@@ -27,6 +28,9 @@
 #include <misfits/fits.hpp>
 #include <misfits/fits_p.hpp>
 #include <misfits/table.hpp>
+#include <misfits/image.hpp>
+#include <misfits/driver.hpp>
+#include <misfits/trace.hpp>
 
 using namespace std;
 
@@ -49,7 +53,9 @@ namespace misFITS {
     }
 
     File::File( const std::string& file_, fitsfile* fitsfile_, OpenMode mode_ ) :
-	fitsptr( FitsPtr_( fitsfile_ ) ), mode( mode_ ), file(file_) {}
+	fitsptr( FitsPtr_( fitsfile_ ) ), mode( mode_ ),
+	uncommitted_( false ), uncommitted_rows_( 0 ), committed_at_( Stats::now() ),
+	file(file_) {}
 
 
     File::~File () {
@@ -62,7 +68,7 @@ namespace misFITS {
 
 	try {
 	    close();
-	} catch ( Exception& e ) {
+	} catch ( std::exception& e ) {
 	    std::cerr << "Client error: misFITS::File::close invoked by misFITS::File::~File.  Error closing file " << file << ": " << e.what() << std::endl;
 	}
 
@@ -173,6 +179,11 @@ namespace misFITS {
     template <Entity::Type Entity, class Mode>
     FilePtr open( const std::string&file )  {
 
+	Trace::Span span( "File::open" );
+	span.arg( "file", file );
+
+	Driver::init();
+
 	return FilePtr( new File(file, Open::open<Entity,Mode>( file ), Mode::mode() ) );
     }
 
@@ -242,6 +253,33 @@ namespace misFITS {
 	return TablePtr( new Table( fp, extname, extver ) );
     }
 
+    ///////////////////
+    // Image Support //
+    ///////////////////
+
+    ImagePtr File::add( const Image& in ) {
+
+	FilePtr fp = get_shared_ptr();
+	return in.copy( fp );
+
+    }
+
+    ImagePtr File::add( const ImagePtr& in ) {
+	return File::add( *in.get() );
+    }
+
+    ImagePtr File::image( int hdu_num_ ) {
+
+	FilePtr fp = get_shared_ptr();
+	return ImagePtr( new Image( fp, hdu_num_ ) );
+    }
+
+    ImagePtr File::image( const std::string& extname, int extver ) {
+
+	FilePtr fp = get_shared_ptr();
+	return ImagePtr( new Image( fp, extname, extver ) );
+    }
+
 
     //////////////////////////////////////
     // Wrappers around CFITSIO routines //
@@ -249,12 +287,67 @@ namespace misFITS {
 
     void
     File::close(  ) {
-	if ( fitsptr )
-	    misFITS_CHECK_CFITSIO_EXPR( fits_close_file( fitsptr.release(), &status ) );
+
+	if ( ! fitsptr )
+	    return;
+
+	Trace::Span span( "File::close" );
+	span.arg( "file", file );
+
+	finish_tables();
+
+	misFITS_CHECK_CFITSIO_EXPR( fits_close_file( fitsptr.release(), &status ) );
+
+	check_discarded();
+    }
+
+    // Table::finish removes most tables from the set, but tile
+    // compressed tables stay in it while they're open
+    void
+    File::finish_tables() const {
+
+	std::set<const Table*> tables( pending_tables_ );
+	for ( std::set<const Table*>::const_iterator table = tables.begin() ; table != tables.end() ; ++table )
+	    (*table)->finish();
     }
 
     void File::flush ( const FlushMode& mode ) const {
 
+	Trace::Span span( "File::flush" );
+	span.arg( "file", file );
+
+	finish_tables();
+	sync( mode );
+	check_discarded();
+    }
+
+    void
+    File::check_discarded() const {
+
+	if ( discarded_tables_.empty() )
+	    return;
+
+	std::ostringstream os;
+	os << "changes to the tile compressed table in HDU";
+	for ( std::vector<int>::const_iterator hdu = discarded_tables_.begin() ; hdu != discarded_tables_.end() ; ++hdu )
+	    os << ' ' << *hdu;
+	os << " of " << file << " were discarded; it was destroyed before it or the file was flushed";
+
+	discarded_tables_.clear();
+	throw Exception::Assert( os.str() );
+    }
+
+    void
+    File::sync( const FlushMode& mode ) const {
+
+	Stats::Timer timer( stats_, Stats::Flush );
+
+	// what's committed must describe only the rows written, not
+	// those reserved for appends
+	std::set<const Table*> tables( pending_tables_ );
+	for ( std::set<const Table*>::const_iterator table = tables.begin() ; table != tables.end() ; ++table )
+	    (*table)->commit_rows();
+
 	switch( boost::native_value( mode ) ) {
 
 	case FlushMode::File :
@@ -265,11 +358,63 @@ namespace misFITS {
 	    misFITS_CHECK_CFITSIO_EXPR( fits_flush_buffer( fptr(), 0, &status ) );
 	    break;
 	}
+
+	uncommitted_ = false;
+	uncommitted_rows_ = 0;
+	committed_at_ = Stats::now();
+    }
+
+    void
+    File::durability( const Durability& durability ) {
+
+	if ( durability.policy == Durability::Rows && durability.rows < 1 )
+	    throw Exception::Assert( "Durability::Rows requires a positive number of rows" );
+
+	durability_ = durability;
+	committed_at_ = Stats::now();
+    }
+
+    void
+    File::commit() const {
+
+	if ( uncommitted_ )
+	    sync( durability_.mode );
+    }
+
+    // writers share the pending state, so a single flush commits
+    // the writes of every Row and Image using the file.
+    void
+    File::wrote( LONGLONG nrows ) const {
+
+	uncommitted_ = true;
+	uncommitted_rows_ += nrows;
+
+	switch ( durability_.policy ) {
+
+	case Durability::Never :
+	    return;
+
+	case Durability::Rows :
+	    if ( uncommitted_rows_ < durability_.rows )
+		return;
+	    break;
+
+	case Durability::Interval :
+	    if ( ( Stats::now() - committed_at_ ) * 1000 < durability_.milliseconds )
+		return;
+	    break;
+
+	case Durability::EachWrite :
+	    break;
+	}
+
+	sync( durability_.mode );
     }
 
 
     void
     File::move_by( int nmove ) const {
+	Stats::Timer timer( stats_, Stats::MoveTo );
 	int hdu_type;
 	misFITS_CHECK_CFITSIO_EXPR( fits_movrel_hdu( fptr(), nmove, &hdu_type, &status ) );
     }
@@ -277,6 +422,8 @@ namespace misFITS {
     void
     File::move_to( int hdu_num_req ) const {
 
+	Stats::Timer timer( stats_, Stats::MoveTo );
+
 	if ( hdu_num() == hdu_num_req )
 	    return ;
 
@@ -286,6 +433,7 @@ namespace misFITS {
 
     void
     File::move_to( const std::string& extname, int extver, HDU_Type hdu_type ) const {
+	Stats::Timer timer( stats_, Stats::MoveTo );
 	misFITS_CHECK_CFITSIO_EXPR( fits_movnam_hdu( fptr(),
 						     boost::underlying_cast<int>(hdu_type),
 						     const_cast<char*>(extname.c_str()),
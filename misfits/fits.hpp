@@ -26,6 +26,7 @@
 
 #include <string>
 #include <iostream>
+#include <set>
 #include <utility>
 #include <vector>
 
@@ -50,6 +51,11 @@ namespace misFITS {
     typedef weak_ptr<Table> WeakTablePtr;
     typedef SharedTablePtr TablePtr;
 
+    class Image;
+    typedef shared_ptr<Image> SharedImagePtr;
+    typedef weak_ptr<Image> WeakImagePtr;
+    typedef SharedImagePtr ImagePtr;
+
     // there must be a beter way to do this
     class ColumnInfo;
     typedef std::vector<ColumnInfo> TableColumnsType;
@@ -92,6 +98,7 @@ namespace misFITS {
 #include <misfits/keyword.hpp>
 #include <misfits/exception.hpp>
 #include <misfits/bitset.hpp>
+#include <misfits/stats.hpp>
 
 namespace misFITS {
 
@@ -101,6 +108,8 @@ namespace misFITS {
 	template<class T> class Column;
     }
     class Row;
+    class StreamWriter;
+    class StreamReader;
 
 
     // declare some enums so can be used as template arguments
@@ -165,6 +174,26 @@ namespace misFITS {
 	FitsPtr fitsptr;
 	OpenMode mode;
 
+	// I/O statistics; updated by const methods
+	mutable Stats stats_;
+
+	// tables with reserved rows, stale checksums or compressed
+	// tiles to write; they're finished when the file is flushed or
+	// closed
+	mutable std::set<const Table*> pending_tables_;
+
+	// the HDUs of tile compressed tables which were destroyed with
+	// changes which hadn't been written; the next flush or close
+	// throws
+	mutable std::vector<int> discarded_tables_;
+
+	// when written data are committed, and what has been written
+	// since the last commit
+	Durability durability_;
+	mutable bool uncommitted_;
+	mutable LONGLONG uncommitted_rows_;
+	mutable double committed_at_;
+
 	/////////////////////////
         // constructors	       //
         /////////////////////////
@@ -188,6 +217,18 @@ namespace misFITS {
 
 	static FitsPtr FitsPtr_( fitsfile* fitsptr );
 
+	void finish_tables() const;
+	void check_discarded() const;
+
+	// record a write of nrows rows (or none, for images), and
+	// commit it if the durability policy requires
+	void wrote( LONGLONG nrows = 0 ) const;
+
+	// give up the tables' reserved rows and flush CFITSIO's
+	// buffers, leaving stale checksums; this is how writes are
+	// committed.
+	void sync( const FlushMode& mode ) const;
+
 	friend FilePtr open<Entity::File, Mode::ReadOnly>( const std::string&file );
 	friend FilePtr open<Entity::File, Mode::ReadWrite>( const std::string&file );
 	friend FilePtr open<Entity::File, Mode::Create>( const std::string&file );
@@ -211,7 +252,11 @@ namespace misFITS {
 
 	friend class HDU;
 	friend class Table;
+	friend class Image;
 	friend class ColumnInfo;
+	friend class Row;
+	friend class StreamWriter;
+	friend class StreamReader;
 
 	inline fitsfile* fptr() const {
 	    return fitsptr.get();
@@ -243,6 +288,14 @@ namespace misFITS {
 	TablePtr add( const Table& table );
 	TablePtr add( const TablePtr& table );
 
+	//////////////////////////
+        // Image support        //
+        //////////////////////////
+	ImagePtr image( int hdu_num = 0);
+	ImagePtr image( const std::string& extname, int extver = 1);
+	ImagePtr add( const Image& image );
+	ImagePtr add( const ImagePtr& image );
+
 
 	/////////////////////////////
         // CFITSIO wrappers	   //
@@ -265,6 +318,35 @@ namespace misFITS {
 
 	void flush ( const FlushMode& mode = FlushMode::File ) const;
 
+	// data written via Row or Image are committed according to the
+	// file's durability policy; the default is to leave it to
+	// CFITSIO and explicit flushes.  a commit gives up the rows
+	// reserved for appends, so that the header on disk describes
+	// only the rows written, and flushes CFITSIO's buffers.  after
+	// a commit, a table reserves no more rows at a time than were
+	// appended between commits.  checksums may be stale until the
+	// file is flushed or closed.
+	void durability( const Durability& durability );
+	const Durability& durability() const { return durability_; }
+
+	// commit with the policy's mode if anything has been written
+	// since the last commit; useful for writers which may pause
+	// under an Interval policy.
+	void commit() const;
+
+	// verify the DATASUM and CHECKSUM keywords of every HDU.  the
+	// HDUs of disk files are summed in blocks using nthreads threads
+	// (one per processor if zero); other files are left to CFITSIO.
+	// defined in checksum.cc
+	std::vector<ChecksumStatus> verify_checksums( unsigned int nthreads = 0 ) const;
+
+	/////////////////////////////
+        // I/O statistics	   //
+        /////////////////////////////
+
+	const Stats& stats() const { return stats_; }
+	void reset_stats() const { stats_.reset(); }
+
     };
 
     //////////////////////////
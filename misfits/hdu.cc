@@ -19,6 +19,7 @@
 //
 // -->8-->8-->8-->8--
 
+#include <cstring>
 #include <string>
 #include <iostream>
 
@@ -28,6 +29,7 @@
 #include <fitsio.h>
 
 #include <misfits/hdu.hpp>
+#include <misfits/trace.hpp>
 
 #include "fits_p.hpp"
 
@@ -55,6 +57,9 @@ namespace misFITS {
 
 	char card[FLEN_CARD];
 
+	Trace::TimedSpan span( "HDU::has_keyword", hdu_num_, file_->stats_, Stats::KeywordRead );
+	span.arg( "keyword", keyname );
+
 	int status = 0;
 
 	fits_read_card( file_->fptr(), keyname.c_str(), card, &status );
@@ -113,21 +118,62 @@ namespace misFITS {
 
     //-----------------------------------------
 
-    Keyword<std::string>
-    HDU::read_keyn( int keynum, const std::string& default_value ) const {
+    static void free_header( char* header ) {
+
+	int status = 0;
+	fits_free_memory( header, &status );
+    }
+
+    shared_ptr<const char>
+    HDU::read_header( int& nkeys ) const {
+
+	set_as_chdu();
+
+	Trace::TimedSpan span( "HDU::read_header", hdu_num_, file_->stats_, Stats::KeywordRead );
+
+	char* header;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_hdr2str( file_->fptr(), 0, NULL, 0, &header, &nkeys, &status ) );
+
+	shared_ptr<const char> snapshot( header, free_header );
+
+	// don't rely upon nkeys including (or not) the END record
+	nkeys = static_cast<int>( std::strlen( header ) / 80 );
+	if ( nkeys && 0 == std::strncmp( header + 80 * ( nkeys - 1 ), "END     ", 8 ) )
+	    --nkeys;
+
+	return snapshot;
+    }
+
+    void
+    HDU::write_header( const char* header, int nkeys ) const {
 
 	set_as_chdu();
 
-       char keyname[FLEN_KEYWORD+1] = { '\0' };
-       char   value[FLEN_VALUE+1]   = { '\0' };
-       char comment[FLEN_COMMENT+1] = { '\0' };
+	int keysexist;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_get_hdrspace( file_->fptr(), &keysexist, NULL, &status ) );
+
+	for ( ; keysexist > nkeys ; --keysexist )
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_delete_record( file_->fptr(), keysexist, &status ) );
+
+	for ( int keynum = 1 ; keynum <= nkeys ; ++keynum ) {
+
+	    char card[FLEN_CARD];
+	    std::strncpy( card, header + 80 * ( keynum - 1 ), 80 );
+	    card[80] = '\0';
 
-       RETURN_KEYWORD
-           ( std::string,
-             fits_read_keyn( file_->fptr(), keynum,
-                             keyname, value, comment, &status )
-             );
+	    if ( keynum <= keysexist )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_modify_record( file_->fptr(), keynum, card, &status ) );
+	    else
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_write_record( file_->fptr(), card, &status ) );
+	}
 
+	// the structural keywords may have been rewritten
+	misFITS_CHECK_CFITSIO_EXPR( fits_set_hdustruc( file_->fptr(), &status ) );
     }
 
     //-----------------------------------------
@@ -138,6 +184,9 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::get_keyword", hdu_num_, file_->stats_, Stats::KeywordRead );
+	span.arg( "keyword", keyname );
+
     	std::string value;
     	char comment[FLEN_COMMENT+1] = { '\0' };
 
@@ -178,6 +227,9 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::get_keyword", hdu_num_, file_->stats_, Stats::KeywordRead );
+	span.arg( "keyword", keyname );
+
     	T value = default_value;
     	char comment[FLEN_COMMENT+1] = { '\0' };
 
@@ -206,6 +258,9 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::set_keyword", hdu_num_, file_->stats_, Stats::KeywordWrite );
+	span.arg( "keyword", kw.keyname );
+
 	if ( kw.value.size() > FLEN_VALUE ) {
 
 	    misFITS_CHECK_CFITSIO_EXPR
@@ -241,6 +296,9 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::set_keyword", hdu_num_, file_->stats_, Stats::KeywordWrite );
+	span.arg( "keyword", kw.keyname );
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
 	     fits_update_key( file_->fptr(),
@@ -267,6 +325,9 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::delete_keyword", hdu_num_, file_->stats_, Stats::KeywordWrite );
+	span.arg( "keyword", keyname );
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
 	     fits_delete_key( file_->fptr(), keyname.c_str(), &status );
@@ -280,6 +341,8 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::add_history", hdu_num_, file_->stats_, Stats::KeywordWrite );
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
 	     fits_write_history( file_->fptr(),
@@ -294,6 +357,8 @@ namespace misFITS {
 
 	set_as_chdu();
 
+	Trace::TimedSpan span( "HDU::add_comment", hdu_num_, file_->stats_, Stats::KeywordWrite );
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
 	     fits_write_comment( file_->fptr(),
@@ -306,6 +371,37 @@ namespace misFITS {
 
     //-----------------------------------------
 
+    void HDU::reserve_keywords( int nkeys ) const {
+
+	set_as_chdu();
+
+	int keysexist, morekeys;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_get_hdrspace( file_->fptr(), &keysexist, &morekeys, &status ) );
+
+	// the header hasn't been closed yet, so just ask CFITSIO to
+	// leave room when it positions the data unit
+	if ( morekeys == -1 ) {
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_set_hdrsize( file_->fptr(), nkeys, &status ) );
+	}
+
+	// otherwise insert all of the header blocks required in one go,
+	// rather than letting CFITSIO shift the data unit a block at a
+	// time.  there's no long name for ffiblk.
+	else if ( morekeys < nkeys ) {
+
+	    long nblocks = ( ( nkeys - morekeys ) * 80L + 2879 ) / 2880;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( ffiblk( file_->fptr(), nblocks, 0, &status ) );
+	}
+
+    }
+
+    //-----------------------------------------
+
     HDU::HDU( WeakFilePtr& file, int hdu_num ) : hdu_num_( hdu_num ) {
 
 	file_.set<own_or_observe::observed>( file );
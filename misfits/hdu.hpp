@@ -37,7 +37,8 @@ namespace misFITS {
 
 	friend class File;
 	friend class resetHDU;
-	friend const Keyword<std::string> KeywordIterator::current();
+	friend class KeywordIterator;
+	friend class HeaderEdit;
 
     public:
 
@@ -56,6 +57,10 @@ namespace misFITS {
 	void add_history(  const std::string& history ) const;
 	void add_comment(  const std::string& comment ) const;
 
+	// make sure there is room for at least nkeys more keywords in
+	// the header, so that adding them won't shift the data unit.
+	void reserve_keywords( int nkeys ) const;
+
 
 	void dump_keywords( );
 
@@ -80,7 +85,12 @@ namespace misFITS {
 	void set_as_chdu() const;
 
     private:
-	Keyword<std::string> read_keyn( int keynum, const std::string& default_value = "" ) const;
+	// the complete header as a single string of 80 character
+	// records, excluding the END record
+	shared_ptr<const char> read_header( int& nkeys ) const;
+
+	// replace the header with one returned by read_header
+	void write_header( const char* header, int nkeys ) const;
 
 
     protected:
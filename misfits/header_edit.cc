@@ -0,0 +1,253 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <string>
+#include <set>
+
+#include <fitsio.h>
+
+#include <misfits/header_edit.hpp>
+#include <misfits/trace.hpp>
+
+#include "fits_p.hpp"
+
+namespace misFITS {
+
+    // number of header records (cards) a batch will add.  keywords
+    // which already exist (or which an earlier edit in the batch will
+    // create) are overwritten in place and need no new space.
+    // deletions free up space, but are not credited, so the estimate
+    // errs on the side of too many records.
+
+    class HeaderEdit::Reservation {
+
+    public:
+
+	Reservation( const HDU& hdu ) : hdu_( hdu ), ncards( 0 ), longwarn( false ) {}
+
+	bool exists( const std::string& keyname ) {
+
+	    std::string name( uppercase( keyname ) );
+
+	    if ( created.count( name ) )
+		return true;
+
+	    bool present = ! deleted.count( name ) && hdu_.has_keyword( keyname );
+	    created.insert( name );
+	    return present;
+	}
+
+	void remove( const std::string& keyname ) {
+
+	    std::string name( uppercase( keyname ) );
+	    created.erase( name );
+	    deleted.insert( name );
+	}
+
+	// fits_write_key_longwarn adds the LONGSTRN keyword and two
+	// COMMENT records, but only once per header.
+	void long_string() {
+
+	    if ( longwarn )
+		return;
+
+	    longwarn = true;
+	    if ( ! exists( "LONGSTRN" ) )
+		ncards += 3;
+	}
+
+    private:
+	const HDU& hdu_;
+	std::set<std::string> created;
+	std::set<std::string> deleted;
+
+	static std::string uppercase( std::string name ) {
+	    fits_uppercase( &name[0] );
+	    return name;
+	}
+
+    public:
+	int ncards;
+	bool longwarn;
+
+    };
+
+    class HeaderEdit::Edit {
+
+    public:
+	virtual void reserve( Reservation& reservation ) const = 0;
+	virtual void apply( const HDU& hdu ) const = 0;
+	virtual ~Edit() {}
+    };
+
+    namespace {
+
+	typedef HeaderEdit::Reservation Reservation;
+
+	template<typename T>
+	class SetKeyword : public HeaderEdit::Edit {
+
+	    Keyword<T> kw;
+
+	public:
+	    SetKeyword( const Keyword<T>& kw ) : kw( kw ) {}
+
+	    void reserve( Reservation& reservation ) const {
+
+		if ( ! reservation.exists( kw.keyname ) )
+		    ++reservation.ncards;
+	    }
+
+	    void apply( const HDU& hdu ) const { hdu.set_keyword( kw ); }
+	};
+
+	// long strings are written as a sequence of CONTINUE records,
+	// and an update replaces all of the existing records, so always
+	// reserve space for the complete value.
+	template<>
+	void SetKeyword<std::string>::reserve( Reservation& reservation ) const {
+
+	    if ( kw.value.size() > FLEN_VALUE ) {
+
+		// a quoted string fills at most 67 characters per record,
+		// less one for the trailing '&' continuation marker
+		reservation.ncards += ( kw.value.size() + 65 ) / 66;
+		reservation.long_string();
+	    }
+
+	    else if ( ! reservation.exists( kw.keyname ) )
+		++reservation.ncards;
+	}
+
+	class DeleteKeyword : public HeaderEdit::Edit {
+
+	    std::string keyname;
+
+	public:
+	    DeleteKeyword( const std::string& keyname ) : keyname( keyname ) {}
+
+	    void reserve( Reservation& reservation ) const { reservation.remove( keyname ); }
+	    void apply( const HDU& hdu ) const { hdu.delete_keyword( keyname ); }
+	};
+
+	// COMMENT and HISTORY text is split into 72 character records
+	class Commentary : public HeaderEdit::Edit {
+
+	    std::string text;
+	    bool history;
+
+	public:
+	    Commentary( const std::string& text, bool history ) : text( text ), history( history ) {}
+
+	    void reserve( Reservation& reservation ) const {
+		reservation.ncards += text.empty() ? 1 : ( text.size() + 71 ) / 72;
+	    }
+
+	    void apply( const HDU& hdu ) const {
+
+		if ( history )
+		    hdu.add_history( text );
+		else
+		    hdu.add_comment( text );
+	    }
+	};
+
+    }
+
+    template<typename T>
+    HeaderEdit& HeaderEdit::set_keyword( const Keyword<T>& kw ) {
+
+	edits_.push_back( make_shared< SetKeyword<T> >( kw ) );
+	return *this;
+    }
+
+#define SET_KEYWORD(r,d,T) \
+    template HeaderEdit& HeaderEdit::set_keyword<T>( const Keyword<T>& kw );
+
+    misFITS_INSTANTIATE_OVER_STORAGE_TYPES(SET_KEYWORD)
+    SET_KEYWORD(~,~,std::string)
+
+    HeaderEdit& HeaderEdit::delete_keyword( const std::string& keyname ) {
+
+	edits_.push_back( make_shared< DeleteKeyword >( keyname ) );
+	return *this;
+    }
+
+    HeaderEdit& HeaderEdit::add_history( const std::string& history ) {
+
+	edits_.push_back( make_shared< Commentary >( history, true ) );
+	return *this;
+    }
+
+    HeaderEdit& HeaderEdit::add_comment( const std::string& comment ) {
+
+	edits_.push_back( make_shared< Commentary >( comment, false ) );
+	return *this;
+    }
+
+    void HeaderEdit::commit() {
+
+	if ( edits_.empty() )
+	    return;
+
+	Trace::Span span( "HeaderEdit::commit", hdu_.hdu_num() );
+	span.arg( "edits", static_cast<LONGLONG>( edits_.size() ) );
+
+	hdu_.set_as_chdu();
+
+	Reservation reservation( hdu_ );
+
+	for ( Edits::const_iterator edit = edits_.begin() ; edit != edits_.end() ; ++edit )
+	    (*edit)->reserve( reservation );
+
+	// the header as it was, in case an edit fails
+	int nkeys;
+	shared_ptr<const char> snapshot = hdu_.read_header( nkeys );
+
+	hdu_.reserve_keywords( reservation.ncards );
+
+	Edits::iterator edit = edits_.begin();
+
+	try {
+
+	    for ( ; edit != edits_.end() ; ++edit )
+		(*edit)->apply( hdu_ );
+	}
+
+	catch ( ... ) {
+
+	    try {
+		hdu_.write_header( snapshot.get(), nkeys );
+	    }
+
+	    // the edits which were applied can't be undone, so make
+	    // sure they aren't applied again
+	    catch ( ... ) {
+		edits_.erase( edits_.begin(), edit );
+	    }
+
+	    throw;
+	}
+
+	edits_.clear();
+    }
+
+}
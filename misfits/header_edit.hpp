@@ -0,0 +1,83 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_HEADER_EDIT_H
+#define misFITS_HEADER_EDIT_H
+
+#include <string>
+#include <vector>
+
+#include <misfits/fits.hpp>
+#include <misfits/hdu.hpp>
+
+namespace misFITS {
+
+    // Collect keyword updates, deletions, HISTORY and COMMENT records
+    // for an HDU and apply them all at once.  Nothing is written to
+    // the HDU until commit() is called.  Before any records are
+    // written, commit() reserves enough header space for the whole
+    // batch, so that the data unit is moved at most once, rather than
+    // once for every header block the edits spill into.
+
+    class HeaderEdit {
+
+    public:
+
+	class Edit;
+	class Reservation;
+	typedef std::vector< shared_ptr<Edit> > Edits;
+
+	explicit HeaderEdit( const HDU& hdu ) : hdu_( hdu ) {}
+
+	template<typename T>
+	HeaderEdit& set_keyword( const Keyword<T>& kw );
+
+	HeaderEdit& delete_keyword( const std::string& keyname );
+
+	HeaderEdit& add_history( const std::string& history );
+	HeaderEdit& add_comment( const std::string& comment );
+
+	Edits::size_type size() const { return edits_.size(); }
+	bool empty() const { return edits_.empty(); }
+	void clear() { edits_.clear(); }
+
+	// apply the edits, in the order they were added.  the batch is
+	// emptied if all of the edits were applied.  if one fails, the
+	// header is restored from a copy taken before the first was
+	// applied, and the batch is left as is, so that it may be
+	// committed again.  if the header can't be restored, the edits
+	// which were applied are dropped from the batch before the
+	// exception is rethrown.  the space reserved for the batch is
+	// kept in either case.
+	void commit();
+
+    private:
+
+	const HDU& hdu_;
+	Edits edits_;
+
+    };
+
+}
+
+#endif // ! misFITS_HEADER_EDIT_H
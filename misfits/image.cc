@@ -0,0 +1,406 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <fitsio.h>
+
+#include <misfits/image.hpp>
+
+#include "fits_p.hpp"
+#include "byteswap.hpp"
+#include "parallel.hpp"
+#include "tiled_image.hpp"
+
+namespace misFITS {
+
+    //////////////
+    // Sections //
+    //////////////
+
+    Section::Section( const Pixel& first, const Pixel& last ) :
+	first( first ), last( last ), inc( first.size(), 1 ) {}
+
+    Section::Section( const Pixel& first, const Pixel& last, const Pixel& inc ) :
+	first( first ), last( last ), inc( inc ) {}
+
+    LONGLONG
+    Section::nelem() const {
+
+	LONGLONG nelem = 1;
+	for ( Pixel::size_type idx = 0 ; idx < first.size() ; ++idx )
+	    nelem *= ( last[idx] - first[idx] ) / inc[idx] + 1;
+
+	return nelem;
+    }
+
+    //////////////////
+    // Constructors //
+    //////////////////
+
+    Image::Image( const std::string& extname, BitPix bitpix, const Pixel& naxes, int extver ) :
+	num_threads_( 0 ) {
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_create_imgll( file_->fptr(),
+				 boost::underlying_cast<int>( bitpix ),
+				 static_cast<int>( naxes.size() ),
+				 const_cast<LONGLONG*>( naxes.empty() ? NULL : &naxes[0] ),
+				 &status ) );
+
+	hdu_num_ = file_->hdu_num();
+
+	set_keyword( Keyword<std::string>( "EXTNAME", extname ) );
+	set_keyword( Keyword<int>( "EXTVER", extver ) );
+
+	refresh();
+    }
+
+    Image::Image( WeakFilePtr file, int hdu_num ) :
+	HDU( file, hdu_num  ),
+	num_threads_( 0 ) {
+	refresh();
+    }
+
+    Image::Image( WeakFilePtr file, const std::string& extname, int extver ) :
+	HDU( file, extname, extver  ),
+	num_threads_( 0 ) {
+	refresh();
+    }
+
+    void
+    Image::refresh() {
+
+	set_as_chdu();
+
+	// make sure we're really at an image (CFITSIO presents tile
+	// compressed images as such)
+	if ( boost::underlying_cast<int>( file_->hdu_type() ) != IMAGE_HDU )
+	    throw Exception::Assert( "Expected CHDU to be an image, but it's not" );
+
+	HDU::refresh();
+
+	int naxis;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_get_img_dim( file_->fptr(), &naxis, &status ) );
+
+	naxes_.resize( static_cast<Pixel::size_type>( naxis ) );
+
+	int bitpix;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_get_img_paramll( file_->fptr(), naxis, &bitpix, &naxis,
+				    naxes_.empty() ? NULL : &naxes_[0],
+				    &status ) );
+
+	bitpix_ = static_cast<BitPix>( bitpix );
+
+	tiled_.reset();
+	if ( compressed() )
+	    tiled_ = TiledImage::create( *this, file_->fptr() );
+    }
+
+    ////////////////
+    // Attributes //
+    ////////////////
+
+    BitPix
+    Image::equiv_bitpix() const {
+
+	set_as_chdu();
+
+	int bitpix;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_get_img_equivtype( file_->fptr(), &bitpix, &status ) );
+
+	return static_cast<BitPix>( bitpix );
+    }
+
+    LONGLONG
+    Image::nelem() const {
+
+	if ( naxes_.empty() )
+	    return 0;
+
+	LONGLONG nelem = 1;
+	for ( Pixel::size_type idx = 0 ; idx < naxes_.size() ; ++idx )
+	    nelem *= naxes_[idx];
+
+	return nelem;
+    }
+
+    bool
+    Image::compressed() const {
+
+	set_as_chdu();
+
+	int status = 0;
+	int compressed = fits_is_compressed_image( file_->fptr(), &status );
+
+	if ( status )
+	    throw Exception::CFITSIO( status );
+
+	return compressed;
+    }
+
+    unsigned int
+    Image::threads() const {
+
+	return num_threads_ ? num_threads_ : Parallel::default_threads();
+    }
+
+    void
+    Image::check( const Section& section ) const {
+
+	if (    section.first.size() != naxes_.size()
+	     || section.last.size() != naxes_.size()
+	     || section.inc.size() != naxes_.size() )
+	    throw Exception::Assert( "image section has the wrong number of axes" );
+
+	for ( Pixel::size_type idx = 0 ; idx < naxes_.size() ; ++idx ) {
+
+	    if (    section.first[idx] < 1
+		 || section.last[idx] > naxes_[idx]
+		 || section.first[idx] > section.last[idx]
+		 || section.inc[idx] < 1 )
+		throw Exception::Assert( "image section is out of bounds" );
+	}
+    }
+
+    //////////
+    // I/O  //
+    //////////
+
+    template< typename T >
+    void
+    Image::read( T* data ) const {
+
+	LONGLONG npix = nelem();
+	if ( ! npix )
+	    return;
+
+	set_as_chdu();
+
+	Pixel first( naxes_.size(), 1 );
+
+	if ( tiled_ ) {
+	    tiled_->read( file_->fptr(), Section( first, naxes_ ), data, threads() );
+	    return;
+	}
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_read_pixll( file_->fptr(), StorageCode<T>::type,
+			       &first[0], npix,
+			       NULL, data, NULL, &status ) );
+    }
+
+    template< typename T >
+    void
+    Image::read( const Section& section, T* data ) const {
+
+	check( section );
+	set_as_chdu();
+
+	if ( tiled_ ) {
+	    tiled_->read( file_->fptr(), section, data, threads() );
+	    return;
+	}
+
+	std::vector<long> first( section.first.begin(), section.first.end() );
+	std::vector<long> last( section.last.begin(), section.last.end() );
+	std::vector<long> inc( section.inc.begin(), section.inc.end() );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_read_subset( file_->fptr(), StorageCode<T>::type,
+				&first[0], &last[0], &inc[0],
+				NULL, data, NULL, &status ) );
+    }
+
+    template< typename T >
+    void
+    Image::write( const T* data ) const {
+
+	LONGLONG npix = nelem();
+	if ( ! npix )
+	    return;
+
+	set_as_chdu();
+
+	Pixel first( naxes_.size(), 1 );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_write_pixll( file_->fptr(), StorageCode<T>::type,
+				&first[0], npix,
+				const_cast<T*>( data ), &status ) );
+
+	file_->wrote();
+    }
+
+    template< typename T >
+    void
+    Image::write( const Section& section, const T* data ) const {
+
+	check( section );
+
+	for ( Pixel::size_type idx = 0 ; idx < section.inc.size() ; ++idx )
+	    if ( section.inc[idx] != 1 )
+		throw Exception::Assert( "can't write a strided image section" );
+
+	set_as_chdu();
+
+	std::vector<long> first( section.first.begin(), section.first.end() );
+	std::vector<long> last( section.last.begin(), section.last.end() );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_write_subset( file_->fptr(), StorageCode<T>::type,
+				 &first[0], &last[0],
+				 const_cast<T*>( data ), &status ) );
+
+	file_->wrote();
+    }
+
+#define IMAGE_IO(r,d,T)							\
+    template void Image::read<T>( T* data ) const;			\
+    template void Image::read<T>( const Section& section, T* data ) const; \
+    template void Image::write<T>( const T* data ) const;		\
+    template void Image::write<T>( const Section& section, const T* data ) const;
+
+    misFITS_INSTANTIATE_OVER_STORAGE_TYPES(IMAGE_IO)
+
+    //-----------------------------------------
+
+    // copy image to other file
+    ImagePtr
+    Image::copy( misFITS::FilePtr& ofile ) const {
+
+	set_as_chdu();
+
+	file_->copy( ofile, FileCopy::CurrentHDU );
+
+	return ImagePtr( new Image( ofile ) );
+    }
+
+    /////////////
+    // Mapping //
+    /////////////
+
+    ImageMapPtr
+    Image::map() const {
+
+	set_as_chdu();
+
+	if ( compressed() )
+	    throw Exception::Assert( "can't map a compressed image" );
+
+	char urltype[FLEN_FILENAME];
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_url_type( file_->fptr(), urltype, &status ) );
+
+	if ( std::strcmp( urltype, "file://" ) )
+	    throw Exception::Assert( "can only map images in disk files" );
+
+	LONGLONG npix = nelem();
+	if ( ! npix )
+	    throw Exception::Assert( "image has no data to map" );
+
+	// make sure the file is up to date
+	file_->flush();
+	set_as_chdu();
+
+	LONGLONG headstart, datastart, dataend;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_get_hduaddrll( file_->fptr(), &headstart, &datastart, &dataend, &status ) );
+
+	char filename[FLEN_FILENAME];
+	char rootname[FLEN_FILENAME];
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_file_name( file_->fptr(), filename, &status );
+	     fits_parse_rootname( filename, rootname, &status );
+	     );
+
+	std::string path( rootname );
+	if ( 0 == path.compare( 0, 7, "file://" ) )
+	    path.erase( 0, 7 );
+
+	bool scaled =    get_keyword<double>( "BSCALE", 1.0 ).value != 1.0
+	              || get_keyword<double>( "BZERO", 0.0 ).value != 0.0;
+
+	std::size_t nbytes = static_cast<std::size_t>( npix )
+	                   * std::abs( boost::underlying_cast<int>( bitpix_ ) ) / CHAR_BIT;
+
+	return ImageMapPtr( new ImageMap( path, datastart, nbytes, bitpix_, naxes_, scaled ) );
+    }
+
+    ImageMap::ImageMap( const std::string& path, LONGLONG offset, std::size_t size,
+			BitPix bitpix, const Pixel& naxes, bool scaled ) :
+	size_( size ), bitpix_( bitpix ), naxes_( naxes ), scaled_( scaled ) {
+
+	using namespace boost::interprocess;
+
+	file_mapping mapping( path.c_str(), read_only );
+	region_ = make_shared<mapped_region>( mapping, read_only,
+					      static_cast<offset_t>( offset ), size );
+    }
+
+    const unsigned char*
+    ImageMap::data() const {
+	return static_cast<const unsigned char*>( region_->get_address() );
+    }
+
+    template< typename T >
+    void
+    ImageMap::read( T* data, LONGLONG first, LONGLONG nelem ) const {
+
+	int bitpix = boost::underlying_cast<int>( bitpix_ );
+
+	if (    sizeof( T ) * CHAR_BIT != static_cast<std::size_t>( std::abs( bitpix ) )
+	     || std::numeric_limits<T>::is_integer != ( bitpix > 0 )
+	     || ( bitpix > 0 && std::numeric_limits<T>::is_signed != ( bitpix != BYTE_IMG ) ) )
+	    throw Exception::Assert( "type does not match the image's BITPIX" );
+
+	if ( scaled_ )
+	    throw Exception::Assert( "can't directly read a scaled image; use Image::read" );
+
+	LONGLONG npix = static_cast<LONGLONG>( size_ / sizeof( T ) );
+
+	if ( nelem < 0 )
+	    nelem = npix - first;
+
+	if ( first < 0 || first + nelem > npix )
+	    throw Exception::Assert( "requested pixels are outside of the image" );
+
+	ByteSwap::copy< sizeof( T ) >( this->data() + first * sizeof( T ), data,
+				       static_cast<std::size_t>( nelem ) );
+    }
+
+#define IMAGE_MAP_READ(r,d,T) \
+    template void ImageMap::read<T>( T* data, LONGLONG first, LONGLONG nelem ) const;
+
+    misFITS_INSTANTIATE_OVER_STORAGE_TYPES(IMAGE_MAP_READ)
+
+}
@@ -0,0 +1,172 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_IMAGE_H
+#define misFITS_IMAGE_H
+
+#include <string>
+#include <vector>
+
+#include <misfits/fits.hpp>
+#include <misfits/hdu.hpp>
+#include <misfits/types.hpp>
+
+namespace boost {
+    namespace interprocess {
+	class mapped_region;
+    }
+}
+
+namespace misFITS {
+
+    // one-based pixel coordinates, one entry per axis
+    typedef std::vector<LONGLONG> Pixel;
+
+    // a rectangular region of an image, from first to last
+    // (inclusive), taking every inc'th pixel along each axis.
+    struct Section {
+
+	Pixel first;
+	Pixel last;
+	Pixel inc;
+
+	Section( const Pixel& first, const Pixel& last );
+	Section( const Pixel& first, const Pixel& last, const Pixel& inc );
+
+	Pixel::size_type naxis() const { return first.size(); }
+
+	// number of pixels in the section
+	LONGLONG nelem() const;
+    };
+
+    class ImageMap;
+    typedef shared_ptr<const ImageMap> ImageMapPtr;
+
+    class TiledImage;
+
+    class Image : public HDU {
+
+    public:
+
+	// create an image in a memory file
+	Image( const std::string& extname, BitPix bitpix, const Pixel& naxes, int extver = 1 );
+
+	Image( WeakFilePtr file, int hdu_num = 0 );
+	Image( WeakFilePtr file, const std::string& extname, int extver = 1 );
+
+	// BITPIX as stored, and as implied by BSCALE and BZERO
+	BitPix bitpix() const { return bitpix_; }
+	BitPix equiv_bitpix() const;
+
+	const Pixel& naxes() const { return naxes_; }
+	Pixel::size_type naxis() const { return naxes_.size(); }
+	LONGLONG nelem() const;
+
+	bool compressed() const;
+
+	// number of threads used to decompress tile compressed images.
+	// zero (the default) uses one per processor.
+	unsigned int num_threads() const { return num_threads_; }
+	void num_threads( unsigned int nthreads ) { num_threads_ = nthreads; }
+
+	// pixels are converted to T as required, and are stored with
+	// the first axis varying fastest.  Rice and GZIP compressed
+	// images are decompressed in parallel, reading only the tiles
+	// which overlap the requested pixels; other compression
+	// schemes are handled by CFITSIO.
+	template< typename T >
+	void read( T* data ) const;
+
+	template< typename T >
+	void read( const Section& section, T* data ) const;
+
+	template< typename T >
+	void write( const T* data ) const;
+
+	// CFITSIO can't write strided sections
+	template< typename T >
+	void write( const Section& section, const T* data ) const;
+
+	// map the data unit of an uncompressed image in a disk file
+	// into memory.  the file is flushed first.
+	ImageMapPtr map() const;
+
+	// copy image to other file
+	ImagePtr copy( FilePtr& file ) const;
+
+	void refresh();
+
+    protected:
+
+	// disable default copy constructors
+	Image( const Image& );
+	Image& operator= (const Image&);
+
+	void check( const Section& section ) const;
+	unsigned int threads() const;
+
+	BitPix bitpix_;
+	Pixel naxes_;
+
+	unsigned int num_threads_;
+	shared_ptr<TiledImage> tiled_;
+    };
+
+    // a read-only view of an image's data unit in a disk file.  the
+    // data are stored as in the file: big endian and unscaled.
+    class ImageMap {
+
+	friend class Image;
+
+    public:
+
+	const unsigned char* data() const;
+	std::size_t size() const { return size_; }
+
+	BitPix bitpix() const { return bitpix_; }
+	const Pixel& naxes() const { return naxes_; }
+
+	// true if BSCALE or BZERO must be applied to the stored values
+	bool scaled() const { return scaled_; }
+
+	// copy nelem pixels, starting at the zero-based index first,
+	// converting them to host byte order.  T must exactly match
+	// the stored type, and the image may not be scaled.
+	template< typename T >
+	void read( T* data, LONGLONG first = 0, LONGLONG nelem = -1 ) const;
+
+    private:
+
+	ImageMap( const std::string& path, LONGLONG offset, std::size_t size,
+		  BitPix bitpix, const Pixel& naxes, bool scaled );
+
+	shared_ptr<boost::interprocess::mapped_region> region_;
+	std::size_t size_;
+	BitPix bitpix_;
+	Pixel naxes_;
+	bool scaled_;
+    };
+
+}
+
+#endif // ! misFITS_IMAGE_H
@@ -1,19 +1,67 @@
+#include <cstring>
+
+#include <fitsio.h>
+
 #include "fits.hpp"
 #include "hdu.hpp"
 
 namespace misFITS {
 
     const Keyword<std::string>
-    KeywordIterator::current() {
+    KeywordIterator::current() const {
+
+	// advancing onto end() mustn't read past the snapshot
+	if ( keynum_ < 1 || keynum_ > nkeys )
+	    return Keyword<std::string>( "", "", "", false );
+
+	// CFITSIO wants a NUL terminated record
+	char card[FLEN_CARD] = { '\0' };
+	std::memcpy( card, header_.get() + 80 * ( keynum_ - 1 ), 80 );
+
+	char keyname[FLEN_KEYWORD+1] = { '\0' };
+	char   value[FLEN_VALUE+1]   = { '\0' };
+	char comment[FLEN_COMMENT+1] = { '\0' };
+
+	int status = 0;
+	int length;
+
+	fits_get_keyname( card, keyname, &length, &status );
+	fits_parse_value( card, value, comment, &status );
+
+	if (    status
+	     && status != VALUE_UNDEFINED )
+	    throw Exception::CFITSIO( status );
+
+	return Keyword<std::string>( keyname, value, comment, status == 0 );
+    }
+
+    // mirror fits_get_keyname, without copying
+    boost::string_ref
+    KeywordIterator::keyname() const {
+
+	boost::string_ref record( card() );
+
+	if ( record.starts_with( "HIERARCH " ) ) {
+
+	    boost::string_ref::size_type eq = record.find( '=' );
+	    record = record.substr( 9, eq == boost::string_ref::npos ? boost::string_ref::npos : eq - 9 );
+
+	    while ( ! record.empty() && record.front() == ' ' )
+		record.remove_prefix( 1 );
+	}
+
+	else
+	    record = record.substr( 0, 8 );
 
-	const Keyword<std::string>& kw = hdup_->read_keyn( keynum_, "" );
-	return kw;
+	while ( ! record.empty() && record.back() == ' ' )
+	    record.remove_suffix( 1 );
 
+	return record;
     }
 
-    KeywordIterator::KeywordIterator( const HDUPtr& hdup, int keynum ) : hdup_(hdup), keynum_(keynum) {
+    KeywordIterator::KeywordIterator( const HDUPtr& hdup, int keynum ) : keynum_(keynum) {
 
-	nkeys =  hdup_->get_hdrpos().first;
+	header_ = hdup->read_header( nkeys );
 
     }
 
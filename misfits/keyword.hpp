@@ -3,6 +3,8 @@
 
 #include <iterator>
 
+#include <boost/utility/string_ref.hpp>
+
 #include <misfits/fits.hpp>
 
 namespace misFITS {
@@ -24,20 +26,25 @@ namespace misFITS {
 	return Keyword<T>( keyname, value, comment, defined );
     }
 
+    // iterate over the header records of an HDU.  the header is read
+    // in a single call when the iterator is created; iterators copied
+    // from it (including end()) share that snapshot, so later changes
+    // to the HDU are not visible.
     class KeywordIterator : public std::iterator <std::forward_iterator_tag, Keyword<std::string>, void >{
 
-	friend class HDU;
-
     private:
-	HDUPtr hdup_;
+	shared_ptr<const char> header_;
 	int keynum_;
 	int nkeys;
-	const Keyword<std::string> current();
+	const Keyword<std::string> current() const;
+
+	KeywordIterator( const shared_ptr<const char>& header, int keynum, int nkeys ) :
+	    header_( header ), keynum_( keynum ), nkeys( nkeys ) {}
 
     public:
 	explicit KeywordIterator( const HDUPtr& hdup_, int keynum = 1 );
 
-	const Keyword<std::string> operator* () { return current(); }
+	const Keyword<std::string> operator* () const { return current(); }
 
 	const Keyword<std::string> operator++ () {
 	    ++keynum_;
@@ -49,12 +56,22 @@ namespace misFITS {
 	    return current();
 	}
 
+	// the raw 80 character record and its keyword name, pointing
+	// into the snapshot; no copies are made.  not valid at end().
+	boost::string_ref card() const {
+	    return boost::string_ref( header_.get() + 80 * ( keynum_ - 1 ), 80 );
+	}
+
+	boost::string_ref keyname() const;
+
+	int keynum() const { return keynum_; }
+
 	KeywordIterator end() const {
-	    return KeywordIterator( hdup_, nkeys + 1 ) ;
+	    return KeywordIterator( header_, nkeys + 1, nkeys ) ;
 	}
 
 	bool operator==( const KeywordIterator& other ) const {
-	    return other.hdup_ 	  == hdup_
+	    return other.header_  == header_
 		&& other.keynum_  == keynum_;
 	}
 
@@ -0,0 +1,116 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+
+#include "parallel.hpp"
+
+namespace misFITS {
+
+    namespace Parallel {
+
+	namespace {
+
+	    Pool* pool;
+	    boost::once_flag created = BOOST_ONCE_INIT;
+
+	    struct InBatch {
+
+		InBatch( const void* batch ) : batch( batch ) {}
+
+		template< typename Ticket >
+		bool operator()( const Ticket& ticket ) const {
+		    return ticket.batch == batch;
+		}
+
+		const void* batch;
+	    };
+	}
+
+	// the pool is never destroyed, so its threads, which are idle
+	// between jobs, don't hold up the process' exit
+	void
+	Pool::create() {
+	    pool = new Pool;
+	}
+
+	Pool&
+	Pool::instance() {
+
+	    boost::call_once( created, create );
+	    return *pool;
+	}
+
+	void
+	Pool::run( const boost::function<void()>& job, std::size_t nhelpers ) {
+
+	    Batch batch;
+
+	    {
+		boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		for ( ; nthreads_ < nhelpers ; ++nthreads_ )
+		    boost::thread( boost::bind( &Pool::serve, this ) ).detach();
+
+		Ticket ticket = { &job, &batch };
+		queue_.insert( queue_.end(), nhelpers, ticket );
+	    }
+
+	    queued_.notify_all();
+
+	    job();
+
+	    boost::unique_lock<boost::mutex> lock( mutex_ );
+
+	    queue_.erase( std::remove_if( queue_.begin(), queue_.end(), InBatch( &batch ) ),
+			  queue_.end() );
+
+	    while ( batch.running )
+		finished_.wait( lock );
+	}
+
+	void
+	Pool::serve() {
+
+	    boost::unique_lock<boost::mutex> lock( mutex_ );
+
+	    for (;;) {
+
+		while ( queue_.empty() )
+		    queued_.wait( lock );
+
+		Ticket ticket = queue_.front();
+		queue_.pop_front();
+		++ticket.batch->running;
+
+		lock.unlock();
+		(*ticket.job)();
+		lock.lock();
+
+		--ticket.batch->running;
+		finished_.notify_all();
+	    }
+	}
+    }
+}
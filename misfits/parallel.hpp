@@ -0,0 +1,206 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: run independent tasks on a pool of threads
+
+#ifndef misFITS_PARALLEL_H
+#define misFITS_PARALLEL_H
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <misfits/exception.hpp>
+
+namespace misFITS {
+
+    namespace Parallel {
+
+	// one thread per processor
+	inline unsigned int
+	default_threads() {
+	    unsigned int nthreads = boost::thread::hardware_concurrency();
+	    return nthreads ? nthreads : 1;
+	}
+
+	// a process wide pool of threads, which are started as they're
+	// first needed and then kept for the life of the process, so
+	// that each parallel operation doesn't pay for starting its own.
+	// defined in parallel.cc
+	class Pool : boost::noncopyable {
+
+	public:
+
+	    static Pool& instance();
+
+	    // call job in the calling thread and in up to nhelpers pool
+	    // threads, returning once all of the calls have finished.
+	    // helpers which haven't started by the time the calling
+	    // thread's call returns are cancelled, so a job run from
+	    // within a pool thread can't wait for itself.  job must not
+	    // throw.
+	    void run( const boost::function<void()>& job, std::size_t nhelpers );
+
+	private:
+
+	    Pool() : nthreads_( 0 ) {}
+	    static void create();
+
+	    // the calls to a job which are running in pool threads
+	    struct Batch {
+		Batch() : running( 0 ) {}
+		std::size_t running;
+	    };
+
+	    struct Ticket {
+		const boost::function<void()>* job;
+		Batch* batch;
+	    };
+
+	    // run by each pool thread
+	    void serve();
+
+	    boost::mutex mutex_;
+	    boost::condition_variable queued_;
+	    boost::condition_variable finished_;
+	    std::deque<Ticket> queue_;
+	    std::size_t nthreads_;
+	};
+
+	// each thread repeatedly grabs the next task until they're
+	// exhausted or one of them fails.
+	template< typename Task >
+	class Worker {
+
+	public:
+
+	    Worker( Task& task, std::size_t ntasks ) :
+		task_( task ),
+		next_( 0 ),
+		ntasks_( ntasks ),
+		failed_( false ),
+		status_( 0 ) {}
+
+	    void operator()() {
+
+		for (;;) {
+
+		    std::size_t idx;
+
+		    {
+			boost::lock_guard<boost::mutex> lock( mutex_ );
+
+			if ( failed_ || next_ == ntasks_ )
+			    return;
+
+			idx = next_++;
+		    }
+
+		    try {
+			task_( idx );
+		    }
+
+		    catch ( Exception::CFITSIO& e ) {
+			fail( e.status(), e.what() );
+			return;
+		    }
+
+		    catch ( std::exception& e ) {
+			fail( 0, e.what() );
+			return;
+		    }
+		}
+	    }
+
+	    // rethrow the first error seen by a thread
+	    void check() const {
+
+		if ( ! failed_ )
+		    return;
+
+		if ( status_ )
+		    throw Exception::CFITSIO( status_ );
+
+		throw Exception::Assert( error_ );
+	    }
+
+	private:
+
+	    void fail( int status, const std::string& error ) {
+
+		boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		if ( failed_ )
+		    return;
+
+		failed_ = true;
+		status_ = status;
+		error_ = error;
+	    }
+
+	    Task& task_;
+
+	    boost::mutex mutex_;
+	    std::size_t next_;
+	    std::size_t ntasks_;
+
+	    bool failed_;
+	    int status_;
+	    std::string error_;
+	};
+
+	// call task( idx ) for idx in [0,ntasks) using at most nthreads
+	// threads: the calling thread and threads from the pool.  the
+	// calls must be independent of each other.  the
+	// first exception thrown by a task is rethrown once all of the
+	// threads have finished.
+	template< typename Task >
+	void
+	for_each( std::size_t ntasks, unsigned int nthreads, Task& task ) {
+
+	    Worker<Task> worker( task, ntasks );
+
+	    std::size_t nworkers = nthreads < ntasks ? nthreads : ntasks;
+
+	    // don't bother with threads if they won't help
+	    if ( nworkers <= 1 )
+		worker();
+
+	    else
+		Pool::instance().run( boost::ref( worker ), nworkers - 1 );
+
+	    worker.check();
+	}
+    }
+}
+
+#endif // ! misFITS_PARALLEL_H
@@ -40,30 +40,42 @@ namespace misFITS {
     Row::init( ) {
 	idx(1);
 	auto_advance( true );
+	raw_ = false;
+	arena_ = make_shared<Arena>();
     }
 
-    Row::Row( own_or_observe::rptr<Table>* table )  {
+    Row::Row( own_or_observe::rptr<Table>* table ) :
+	read_trace_( "Row::read" ),
+	write_trace_( "Row::write" ) {
 	init();
 	table_.set( table );
     }
 
-    Row::Row( TablePtr& table )  {
+    Row::Row( TablePtr& table ) :
+	read_trace_( "Row::read" ),
+	write_trace_( "Row::write" ) {
 	init();
 	table_.set<own_or_observe::observed>( table );
     }
 
-    Row::Row( Table& table ) {
+    Row::Row( Table& table ) :
+	read_trace_( "Row::read" ),
+	write_trace_( "Row::write" ) {
 	init();
 	table_.set<own_or_observe::observed>( &table );
     }
 
-    Row::Row( FilePtr& file, int hdu_num ) {
+    Row::Row( FilePtr& file, int hdu_num ) :
+	read_trace_( "Row::read" ),
+	write_trace_( "Row::write" ) {
 	init();
 	TablePtr fp = TablePtr( new Table( file, hdu_num ) );
 	table_.set<own_or_observe::owned>( fp );
     }
 
-    Row::Row( FilePtr& file, const std::string& extname, int extver ) {
+    Row::Row( FilePtr& file, const std::string& extname, int extver ) :
+	read_trace_( "Row::read" ),
+	write_trace_( "Row::write" ) {
 	init();
 	TablePtr fp = TablePtr( new Table( file, extname, extver ) );
 	table_.set<own_or_observe::owned>( fp );
@@ -80,10 +92,14 @@ namespace misFITS {
 	if ( idx() > table_->num_rows() )
 	    return false;
 
+	Trace::Batch::Scope trace( read_trace_, table_->hdu_num(), idx(), table_->file_->stats_.bytes_read );
+
 	for_each( entries.begin(), entries.end(),
 		  boost::bind( &RowEntry::ColumnBase::read, _1, boost::ref(*table_.get()), idx() )
 		  );
 
+	++table_->file_->stats_.rows_read;
+
 	if ( auto_advance() )
 	    advance();
 
@@ -98,12 +114,28 @@ namespace misFITS {
 	if ( ! entries.size() )
 	    throw Exception::Assert( "row object was not assigned any columns to write" );
 
+	Trace::Batch::Scope trace( write_trace_, table_->hdu_num(), idx(), table_->file_->stats_.bytes_written );
+
+	bool tracking = table_->tracking_datasum();
+	if ( tracking )
+	    table_->datasum_remove( idx() );
+
+	table_->extend_rows( idx() );
+
 	for_each( entries.begin(), entries.end(),
 		  boost::bind( &RowEntry::ColumnBase::write, _1, boost::ref(*table_.get()), idx() )
 		  );
 
+	if ( tracking )
+	    table_->datasum_add( idx() );
+
+	++table_->file_->stats_.rows_written;
+
 	if ( auto_advance() )
 	    advance();
+
+	table_->file_->wrote( 1 );
+	table_->limit_compressed();
     }
 
 
@@ -28,8 +28,10 @@
 #include <boost/dynamic_bitset.hpp>
 
 #include <own_or_observe_ptr.hpp>
+#include <misfits/arena.hpp>
 #include <misfits/types.hpp>
 #include <misfits/table.hpp>
+#include <misfits/trace.hpp>
 
 #include <misfits/row_entry.hpp>
 #include <misfits/memblock.hpp>
@@ -46,7 +48,8 @@ namespace misFITS {
 
     public:
 
-	typedef std::vector< shared_ptr<RowEntry::ColumnBase> >Entries;
+	// the entries are owned by the arena
+	typedef std::vector< RowEntry::ColumnBase* >Entries;
 
 	bool read();
 	bool read( LONGLONG row ) {
@@ -67,7 +70,25 @@ namespace misFITS {
 	Row& add( const std::string& column_name, T* base ) {
 
 	    const misFITS::ColumnInfo& ci = table_->colinfo( column_name );
-	    entries.push_back( make_shared< RowEntry::Column<T> >( ci, base ) );
+	    push_back( arena_->create< RowEntry::Column<T> >( ci, base ) );
+	    return *this;
+	}
+
+	// valid records which elements of the column are defined; it's
+	// resized to match the number of elements read.  when writing,
+	// elements whose bits aren't set are written as nulls.
+	// restricted to numeric columns.
+	template< class T >
+	Row& add( const std::string& column_name, T* base, BitSet* valid ) {
+
+	    const misFITS::ColumnInfo& ci = table_->colinfo( column_name );
+	    RowEntry::ColumnBase* entry = arena_->create< RowEntry::Column<T> >( ci, base );
+
+	    if ( ! entry->has_validity() )
+		throw Exception::Assert( "column '" + ci.ttype + "' doesn't support a validity bitmap" );
+
+	    entry->valid_ = valid;
+	    push_back( entry );
 	    return *this;
 	}
 
@@ -79,7 +100,7 @@ namespace misFITS {
 	    for ( ; entry < end ; ++entry ) {
 
 		const misFITS::ColumnInfo& ci = table_->colinfo( (*entry)->name );
-		entries.push_back( (*entry)->column( ci, base ) ); 
+		push_back( (*entry)->column( ci, base, *arena_ ) );
 	    }
 
 	    return *this;
@@ -112,6 +133,17 @@ namespace misFITS {
 	    return auto_advance_;
 	}
 
+	// in raw mode, numeric columns are read and written as stored,
+	// ignoring TSCALn and TZEROn.  applies to all columns, including
+	// those added later.
+	bool raw() const { return raw_ ; }
+	bool raw( bool flag ) {
+	    raw_ = flag;
+	    for ( Entries::iterator entry = entries.begin() ; entry != entries.end() ; ++entry )
+		(*entry)->raw_ = raw_;
+	    return raw_;
+	}
+
 	Entries::size_type num_columns() const { return entries.size(); }
 
 	LONGLONG num_rows() const { return table_->num_rows() ; }
@@ -122,15 +154,25 @@ namespace misFITS {
 	own_or_observe::ptr<Table> table_;
 
 	void init ();
-	void push_back( shared_ptr<RowEntry::ColumnBase> col ) {
+	void push_back( RowEntry::ColumnBase* col ) {
+	    col->raw_ = raw_;
 	    entries.push_back( col );
 	}
 
 	LONGLONG idx_;
 	bool auto_advance_;
+	bool raw_;
 	// if the row object is copied, don't want two objects
 	// managing the same column entries
 	Entries entries;
+
+	// column entries and their buffers are allocated from a single
+	// arena, shared by copies of the row
+	shared_ptr<Arena> arena_;
+
+	// consecutive rows are traced as a single span
+	Trace::Batch read_trace_;
+	Trace::Batch write_trace_;
     };
 
 
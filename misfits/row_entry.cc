@@ -47,8 +47,8 @@ namespace misFITS {
 	// format is 5X, it is stored in the 8 bit byte as
 	// XXXXX000.
 
-	Column<BitSet>::Column( const ColumnInfo& info, BitSet* base ) :
-	    ColumnBase( info), base_( base )
+	Column<BitSet>::Column( const ColumnInfo& info, BitSet* base, Arena& arena ) :
+	    ColumnBase( info), base_( base ), buffer( Arena::Allocator<BitSet::block_type>( arena ) )
 	{
 
 	    base_->resize( nelem_ );
@@ -138,8 +138,8 @@ namespace misFITS {
 
 	//-----------------------------------------
 
-	Column<bool>::Column( const ColumnInfo& info, bool* base )
-	    : ColumnBase( info ), base_( base ) {
+	Column<bool>::Column( const ColumnInfo& info, bool* base, Arena& arena )
+	    : ColumnBase( info ), base_( base ), buffer( Arena::Allocator<Element>( arena ) ) {
 
 		buffer.resize( natomic_ );
 	}
@@ -179,8 +179,9 @@ namespace misFITS {
 	//-----------------------------------------
 
 
-	Column<std::string>::Column( const ColumnInfo& info, std::string* base ) :
+	Column<std::string>::Column( const ColumnInfo& info, std::string* base, Arena& arena ) :
 	    ColumnBase( info ),
+	    buffer( Arena::Allocator<char>( arena ) ),
 	    base_( base ),
 	    offset( info.offset )
 	{
@@ -26,6 +26,7 @@
 
 #include <misfits/row_entry_fwd.hpp>
 
+#include <misfits/arena.hpp>
 #include <misfits/types.hpp>
 #include <misfits/table.hpp>
 
@@ -48,12 +49,20 @@ namespace misFITS {
 	    virtual void write( const Table& table, LONGLONG firstrow ) = 0;
 
 	protected:
-	    ColumnBase( const ColumnInfo& info )
+	    // only destinations which can be resized to fit a cell may
+	    // be used with variable length array columns
+	    ColumnBase( const ColumnInfo& info, bool resizable = false )
 		: colnum_( info.colnum ),
 		  nelem_( info.nelem() ),
 		  natomic_( nelem_ ),
-		  id_( info.column_type->id() )
-	    {}
+		  id_( info.column_type->id() ),
+		  varlength_( info.varlength ),
+		  raw_( false ),
+		  valid_( NULL )
+	    {
+		if ( varlength_ && ! resizable )
+		    throw Exception::Assert( "variable length array column '" + info.ttype + "' requires a vector destination" );
+	    }
 
 	    virtual ~ColumnBase() {}
 
@@ -65,6 +74,15 @@ namespace misFITS {
 	    LONGLONG natomic_;
 
 	    ColumnType::ID::type id_;
+
+	    bool varlength_;
+
+	    // ignore TSCALn and TZEROn
+	    bool raw_;
+
+	    // which elements are defined. only numeric columns support this.
+	    BitSet* valid_;
+	    virtual bool has_validity() const { return false; }
 	};
 
 	//-----------------------------------------
@@ -76,8 +94,8 @@ namespace misFITS {
 	    typedef T Base;
 
 	public:
-	    ColumnInit( const ColumnInfo& info )
-		: ColumnBase( info )
+	    ColumnInit( const ColumnInfo& info, bool resizable = false )
+		: ColumnBase( info, resizable )
 	    {
 		ColumnInit<T>::init();
 	    }
@@ -103,20 +121,22 @@ namespace misFITS {
 	    typedef ColumnInit<T> Parent;
 
 	public:
-	    Column( const ColumnInfo& info, T* base ) : ColumnInit<T>( info ), base_( base ) {
+	    Column( const ColumnInfo& info, T* base, Arena& ) : ColumnInit<T>( info ), base_( base ) {
 		Column<T>::init();
 	    }
 
 	    void read( const Table& table, LONGLONG firstrow ) {
-		table.read_col( Parent::colnum_, firstrow, 1, Parent::natomic_, base_ );
+		table.read_col( Parent::colnum_, firstrow, 1, Parent::natomic_, base_, Parent::raw_, Parent::valid_ );
 	    }
 	    void write( const Table& table, LONGLONG firstrow ) {
-		table.write_col( Parent::colnum_, firstrow, 1, Parent::natomic_, base_ );
+		table.write_col( Parent::colnum_, firstrow, 1, Parent::natomic_, base_, Parent::raw_, Parent::valid_ );
 	    }
 
 	    void init() {};
 
 	private:
+	    bool has_validity() const { return true; }
+
 	    T* base_;
 
 	};
@@ -132,25 +152,52 @@ namespace misFITS {
 	    typedef VT Base;
 
 	public:
-	    ColumnVector( const ColumnInfo& info, Base* base )
-		: ColumnInit<T>( info ), base_( base )
+	    ColumnVector( const ColumnInfo& info, Base* base, Arena& )
+		: ColumnInit<T>( info, true ), base_( base )
 	    {
 		ColumnVector<T,VT>::init();
-		base_->resize( Parent::natomic_ );
+		if ( ! Parent::varlength_ )
+		    base_->resize( Parent::natomic_ );
 	    }
 
+	    // variable length array cells are resized to fit
 	    void read( const Table& table, LONGLONG firstrow ) {
+
+		if ( Parent::varlength_ ) {
+		    Parent::natomic_ = table.cell_length( Parent::colnum_, firstrow );
+		    base_->resize( Parent::natomic_ );
+		    if ( ! Parent::natomic_ ) {
+			if ( Parent::valid_ )
+			    Parent::valid_->clear();
+			return;
+		    }
+		}
+
 		table.read_col<T>( Parent::colnum_, firstrow, 1,
-				   static_cast<LONGLONG>(Parent::natomic_), &((*base_)[0]) );
+				   static_cast<LONGLONG>(Parent::natomic_), &((*base_)[0]),
+				   Parent::raw_, Parent::valid_ );
 	    }
 	    void write( const Table& table, LONGLONG firstrow ) {
+
+		if ( Parent::varlength_ ) {
+		    Parent::natomic_ = base_->size();
+		    if ( ! Parent::natomic_ ) {
+			table.clear_cell( Parent::colnum_, firstrow );
+			return;
+		    }
+		}
+
 		table.write_col<T>( Parent::colnum_, firstrow, 1,
-				    static_cast<LONGLONG>(Parent::natomic_), &((*base_)[0]) );
+				    static_cast<LONGLONG>(Parent::natomic_), &((*base_)[0]),
+				    Parent::raw_, Parent::valid_ );
 	    }
 
 	protected:
 	    Base* base_;
 	    void init() {}
+
+	private:
+	    bool has_validity() const { return true; }
 	};
 
 
@@ -161,8 +208,8 @@ namespace misFITS {
 	    typedef std::vector<T> Base;
 
 	public:
-	    Column( const ColumnInfo& info, Base* base )
-		: ColumnVector< T, std::vector<T> >( info, base ) {}
+	    Column( const ColumnInfo& info, Base* base, Arena& arena )
+		: ColumnVector< T, std::vector<T> >( info, base, arena ) {}
 	};
 
 
@@ -172,8 +219,8 @@ namespace misFITS {
 	    typedef boost::container::vector<T> Base;
 
 	public:
-	    Column( const ColumnInfo& info, Base* base )
-		: ColumnVector< T, Base >( info, base ) {}
+	    Column( const ColumnInfo& info, Base* base, Arena& arena )
+		: ColumnVector< T, Base >( info, base, arena ) {}
 	};
 
 	//-----------------------------------------
@@ -188,21 +235,32 @@ namespace misFITS {
 	template< typename T, typename VT >
 	class BoolColumnVector : public ColumnInit<T> {
 
-	    typedef std::vector<NativeType<SC_BYTE>::storage_type> Buffer;
+	    typedef NativeType<SC_BYTE>::storage_type Element;
+	    typedef std::vector< Element, Arena::Allocator<Element> > Buffer;
 	    typedef ColumnInit<T> Parent;
 	    typedef VT Base;
 
 	public:
-	    BoolColumnVector( const ColumnInfo& info, Base* base )
-		: ColumnInit<T>( info ), base_( base )
+	    BoolColumnVector( const ColumnInfo& info, Base* base, Arena& arena )
+		: ColumnInit<T>( info, true ), base_( base ), buffer( Arena::Allocator<Element>( arena ) )
 	    {
 		BoolColumnVector<T,VT>::init();
-		base_->resize( Parent::natomic_ );
-		buffer.resize( Parent::natomic_ );
+		if ( ! Parent::varlength_ ) {
+		    base_->resize( Parent::natomic_ );
+		    buffer.resize( Parent::natomic_ );
+		}
 	    }
 
 	    void read( const Table& table, LONGLONG firstrow ) {
 
+		if ( Parent::varlength_ ) {
+		    Parent::natomic_ = table.cell_length( Parent::colnum_, firstrow );
+		    base_->resize( Parent::natomic_ );
+		    buffer.resize( Parent::natomic_ );
+		    if ( ! Parent::natomic_ )
+			return;
+		}
+
 		table.read_col<ColumnType::ID::Logical>( Parent::colnum_, firstrow, 1, static_cast<LONGLONG>( Parent::natomic_ ), &buffer[0] );
 
 		for ( Buffer::size_type idx = 0 ; idx < Parent::natomic_ ; idx++ )
@@ -211,6 +269,15 @@ namespace misFITS {
 	    }
 	    void write( const Table& table, LONGLONG firstrow ) {
 
+		if ( Parent::varlength_ ) {
+		    Parent::natomic_ = base_->size();
+		    buffer.resize( Parent::natomic_ );
+		    if ( ! Parent::natomic_ ) {
+			table.clear_cell( Parent::colnum_, firstrow );
+			return;
+		    }
+		}
+
 		for ( Buffer::size_type idx = 0 ; idx < Parent::natomic_ ; idx++ )
 		    buffer[idx] = (*base_)[idx];
 
@@ -231,8 +298,8 @@ namespace misFITS {
 	    typedef std::vector<bool> Base;
 
 	public:
-	    Column( const ColumnInfo& info, Base* base )
-		: BoolColumnVector< bool, Base >( info, base ) {}
+	    Column( const ColumnInfo& info, Base* base, Arena& arena )
+		: BoolColumnVector< bool, Base >( info, base, arena ) {}
 	};
 
 
@@ -242,8 +309,8 @@ namespace misFITS {
 	    typedef boost::container::vector<bool> Base;
 
 	public:
-	    Column( const ColumnInfo& info, Base* base )
-		: BoolColumnVector< bool, Base >( info, base ) {}
+	    Column( const ColumnInfo& info, Base* base, Arena& arena )
+		: BoolColumnVector< bool, Base >( info, base, arena ) {}
 	};
 
 	//-----------------------------------------
@@ -253,11 +320,11 @@ namespace misFITS {
 
 	    typedef BitSet Base;
 	    typedef Base::size_type size_type;
-	    typedef std::vector<BitSet::block_type> Buffer;
+	    typedef std::vector< BitSet::block_type, Arena::Allocator<BitSet::block_type> > Buffer;
 
 	public:
 
-	    Column( const ColumnInfo& info, BitSet* base );
+	    Column( const ColumnInfo& info, BitSet* base, Arena& arena );
 	    virtual ~Column() { };
 
 	    void read(  const Table& table, LONGLONG firstrow );
@@ -281,10 +348,11 @@ namespace misFITS {
 	class Column< bool > : public ColumnBase {
 
 	    typedef bool Base;
-	    typedef std::vector<NativeType<SC_BYTE>::storage_type> Buffer;
+	    typedef NativeType<SC_BYTE>::storage_type Element;
+	    typedef std::vector< Element, Arena::Allocator<Element> > Buffer;
 
 	public:
-	    Column( const ColumnInfo& info, bool* base );
+	    Column( const ColumnInfo& info, bool* base, Arena& arena );
 	    virtual ~Column() { };
 
 	    virtual void read( const Table& table, LONGLONG firstrow );
@@ -302,11 +370,11 @@ namespace misFITS {
 	class Column<std::string>: public ColumnBase {
 
 	    typedef std::string Base;
-	    typedef std::vector<char> Buffer;
+	    typedef std::vector< char, Arena::Allocator<char> > Buffer;
 
 	public:
 
-	    Column( const ColumnInfo& info, std::string* base );
+	    Column( const ColumnInfo& info, std::string* base, Arena& arena );
 	    virtual ~Column() { };
 
 	    void read(  const Table& table, LONGLONG firstrow );
@@ -331,12 +399,13 @@ namespace misFITS {
 	class StringColumnVector: public ColumnBase {
 
 	    typedef VT Base;
-	    typedef std::vector<char> Buffer;
+	    typedef std::vector< char, Arena::Allocator<char> > Buffer;
 
 	public:
 
-	    StringColumnVector( const ColumnInfo& info, Base* base )
+	    StringColumnVector( const ColumnInfo& info, Base* base, Arena& arena )
 		: ColumnBase( info ), base_( base ),
+		  buffer( Arena::Allocator<char>( arena ) ),
 		  offset( info.offset ),
 		  width( static_cast<Buffer::size_type>(info.extent[0] ) ) {
 
@@ -429,8 +498,8 @@ namespace misFITS {
 	    typedef std::vector<std::string> Base;
 
 	public:
-	    Column( const ColumnInfo& info, Base* base )
-		: StringColumnVector< Base >( info, base ) {}
+	    Column( const ColumnInfo& info, Base* base, Arena& arena )
+		: StringColumnVector< Base >( info, base, arena ) {}
 	};
 
 
@@ -440,8 +509,8 @@ namespace misFITS {
 	    typedef boost::container::vector<std::string> Base;
 
 	public:
-	    Column( const ColumnInfo& info, Base* base )
-		: StringColumnVector< Base >( info, base ) {}
+	    Column( const ColumnInfo& info, Base* base, Arena& arena )
+		: StringColumnVector< Base >( info, base, arena ) {}
 	};
 
 	//-----------------------------------------
@@ -0,0 +1,293 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <cstring>
+
+#include <misfits/table.hpp>
+
+#include "decode.hpp"
+#include "row_order.hpp"
+
+namespace misFITS {
+
+    namespace RowOrder {
+
+	namespace {
+
+	    template< typename S >
+	    inline int
+	    compare_values( const unsigned char* a, const unsigned char* b ) {
+
+		S x = Decode::load<S>( a );
+		S y = Decode::load<S>( b );
+
+		if ( x < y )
+		    return -1;
+
+		if ( y < x )
+		    return 1;
+
+		// equal, or at least one is a NaN
+		return static_cast<int>( x != x ) - static_cast<int>( y != y );
+	    }
+
+	    // the current row of a source
+	    class Cursor {
+
+	    public:
+
+		Cursor( Source* source, std::size_t rowlen ) :
+		    source_( source ),
+		    rowlen_( rowlen ),
+		    row_( NULL ),
+		    end_( NULL ) {
+
+		    load();
+		}
+
+		const unsigned char* row() const { return row_; }
+		bool done() const { return ! row_; }
+
+		void advance() {
+
+		    row_ += rowlen_;
+
+		    if ( row_ == end_ )
+			load();
+		}
+
+	    private:
+
+		void load() {
+
+		    const unsigned char* rows;
+		    std::size_t nrows = 0;
+
+		    // skip empty blocks
+		    while ( source_->next( rows, nrows ) )
+			if ( nrows ) {
+			    row_ = rows;
+			    end_ = rows + nrows * rowlen_;
+			    return;
+			}
+
+		    row_ = end_ = NULL;
+		}
+
+		Source* source_;
+		std::size_t rowlen_;
+		const unsigned char* row_;
+		const unsigned char* end_;
+	    };
+
+	    // a tournament tree over the sources' current rows.  each
+	    // internal node holds the loser of the match played there,
+	    // so once the winner has been taken and its source advanced,
+	    // only the matches on the winner's path to the root need be
+	    // replayed, each against a single stored loser: log2(k)
+	    // comparisons per row.  exhausted sources lose every match;
+	    // ties go to the earlier source.
+	    class LoserTree {
+
+	    public:
+
+		LoserTree( const std::vector<Cursor>& cursors, const Compare& compare ) :
+		    cursors_( cursors ),
+		    compare_( compare ),
+		    size_( cursors.size() ),
+		    tree_( std::max( size_, std::size_t( 1 ) ), 0 ) {
+
+		    // leaves are nodes [size_, 2 * size_), the root is node
+		    // 1, and the overall winner is kept in node 0.
+		    if ( size_ == 0 )
+			return;
+
+		    std::vector<std::size_t> winner( 2 * size_ );
+
+		    for ( std::size_t idx = 0 ; idx < size_ ; ++idx )
+			winner[size_ + idx] = idx;
+
+		    for ( std::size_t node = size_ - 1 ; node >= 1 ; --node ) {
+
+			std::size_t a = winner[2 * node];
+			std::size_t b = winner[2 * node + 1];
+
+			winner[node] = before( a, b ) ? a : b;
+			tree_[node]  = before( a, b ) ? b : a;
+		    }
+
+		    if ( size_ > 1 )
+			tree_[0] = winner[1];
+		}
+
+		// the source whose row is next, if any remain
+		bool done() const { return size_ == 0 || cursors_[tree_[0]].done(); }
+		std::size_t winner() const { return tree_[0]; }
+
+		// replay the winner's matches once its source has moved on
+		void replay() {
+
+		    std::size_t winner = tree_[0];
+
+		    for ( std::size_t node = ( size_ + winner ) / 2 ; node >= 1 ; node /= 2 )
+			if ( before( tree_[node], winner ) )
+			    std::swap( tree_[node], winner );
+
+		    tree_[0] = winner;
+		}
+
+	    private:
+
+		bool before( std::size_t a, std::size_t b ) const {
+
+		    if ( cursors_[a].done() )
+			return false;
+
+		    if ( cursors_[b].done() )
+			return true;
+
+		    int cmp = compare_.compare( cursors_[a].row(), cursors_[b].row() );
+		    return cmp ? cmp < 0 : a < b;
+		}
+
+		const std::vector<Cursor>& cursors_;
+		const Compare& compare_;
+		std::size_t size_;
+		std::vector<std::size_t> tree_;
+	    };
+	}
+
+	Compare::Compare( const Table& table, const std::vector<std::string>& names ) {
+
+	    if ( names.empty() )
+		throw Exception::Assert( "no columns to order rows by" );
+
+	    for ( std::vector<std::string>::const_iterator name = names.begin() ; name != names.end() ; ++name ) {
+
+		const ColumnInfo& ci = table.colinfo( *name );
+
+		Key key;
+		key.offset = static_cast<std::size_t>( ci.offset - 1 );
+		key.nbytes = static_cast<std::size_t>( ci.nbytes );
+		key.descending = false;
+
+		if ( ci.varlength )
+		    throw Exception::Assert( "can't order rows by variable length array column '" + ci.ttype + "'" );
+
+		ColumnType::ID::type id = ci.column_type->id();
+
+		switch ( id ) {
+
+		case ColumnType::ID::Logical:
+		case ColumnType::ID::String:
+		case ColumnType::ID::Bit:
+		    key.type = Key::Bytes;
+		    break;
+
+		case ColumnType::ID::Byte:     key.type = Key::UInt8;   break;
+		case ColumnType::ID::Short:
+		case ColumnType::ID::UShort:   key.type = Key::Int16;   break;
+		case ColumnType::ID::Long:
+		case ColumnType::ID::ULong:    key.type = Key::Int32;   break;
+		case ColumnType::ID::LongLong: key.type = Key::Int64;   break;
+		case ColumnType::ID::Float:    key.type = Key::Float32; break;
+		case ColumnType::ID::Double:   key.type = Key::Float64; break;
+
+		default:
+		    throw Exception::Assert( "can't order rows by column '" + ci.ttype + "' of its type" );
+		}
+
+		if ( key.type != Key::Bytes ) {
+
+		    if ( ci.nelem() != 1 )
+			throw Exception::Assert( "can't order rows by non-scalar column '" + ci.ttype + "'" );
+
+		    key.descending = ci.tscal < 0;
+		}
+
+		keys_.push_back( key );
+	    }
+	}
+
+	int
+	Compare::compare( const unsigned char* a, const unsigned char* b ) const {
+
+	    for ( std::vector<Key>::const_iterator key = keys_.begin() ; key != keys_.end() ; ++key ) {
+
+		const unsigned char* x = a + key->offset;
+		const unsigned char* y = b + key->offset;
+
+		int cmp = 0;
+
+		switch ( key->type ) {
+		case Key::Bytes:   cmp = std::memcmp( x, y, key->nbytes ); break;
+		case Key::UInt8:   cmp = compare_values<uint8_t>( x, y ); break;
+		case Key::Int16:   cmp = compare_values<int16_t>( x, y ); break;
+		case Key::Int32:   cmp = compare_values<int32_t>( x, y ); break;
+		case Key::Int64:   cmp = compare_values<int64_t>( x, y ); break;
+		case Key::Float32: cmp = compare_values<float>( x, y ); break;
+		case Key::Float64: cmp = compare_values<double>( x, y ); break;
+		}
+
+		if ( cmp )
+		    return key->descending ? -cmp : cmp;
+	    }
+
+	    return 0;
+	}
+
+	void
+	merge( const std::vector<Source*>& sources, const Compare& compare,
+	       std::size_t rowlen, Sink& sink, std::size_t batch_rows ) {
+
+	    std::vector<Cursor> cursors;
+	    cursors.reserve( sources.size() );
+
+	    for ( std::size_t idx = 0 ; idx < sources.size() ; ++idx )
+		cursors.push_back( Cursor( sources[idx], rowlen ) );
+
+	    LoserTree tree( cursors, compare );
+
+	    batch_rows = std::max( batch_rows, std::size_t( 1 ) );
+	    std::vector<unsigned char> batch( batch_rows * rowlen );
+	    std::size_t nbatch = 0;
+
+	    while ( ! tree.done() ) {
+
+		Cursor& cursor = cursors[tree.winner()];
+
+		std::memcpy( &batch[nbatch * rowlen], cursor.row(), rowlen );
+
+		if ( ++nbatch == batch_rows ) {
+		    sink.write( &batch[0], nbatch );
+		    nbatch = 0;
+		}
+
+		cursor.advance();
+		tree.replay();
+	    }
+
+	    if ( nbatch )
+		sink.write( &batch[0], nbatch );
+	}
+    }
+}
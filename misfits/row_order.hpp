@@ -0,0 +1,107 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: ordering of rows in FITS format by the values of key
+// columns, without decoding them via CFITSIO
+
+#ifndef misFITS_ROW_ORDER_H
+#define misFITS_ROW_ORDER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <misfits/config.hpp>
+#include <misfits/types.hpp>
+
+namespace misFITS {
+
+    class Table;
+
+    namespace RowOrder {
+
+	// a key column.  scaled values are ordered as their stored
+	// values are, reversed if TSCALn is negative.  logical, bit
+	// and string columns are ordered bytewise.
+	struct Key {
+
+	    enum Type { Bytes, UInt8, Int16, Int32, Int64, Float32, Float64 };
+
+	    Type type;
+
+	    // position of the cell in the row, from zero
+	    std::size_t offset;
+	    std::size_t nbytes;
+
+	    bool descending;
+	};
+
+	// orders rows by their keys, in turn.  NaNs sort after all
+	// other values.
+	class Compare {
+
+	public:
+
+	    Compare( const Table& table, const std::vector<std::string>& names );
+
+	    // negative, zero or positive as a sorts before, with or
+	    // after b
+	    int compare( const unsigned char* a, const unsigned char* b ) const;
+
+	    bool operator()( const unsigned char* a, const unsigned char* b ) const {
+		return compare( a, b ) < 0;
+	    }
+
+	    const std::vector<Key>& keys() const { return keys_; }
+
+	private:
+
+	    std::vector<Key> keys_;
+	};
+
+	// a sorted sequence of rows, delivered in blocks
+	class Source {
+	public:
+	    virtual ~Source() {}
+
+	    // the next block of rows, which remains valid until the
+	    // next call; returns false if there are no more.
+	    virtual bool next( const unsigned char*& rows, std::size_t& nrows ) = 0;
+	};
+
+	// a destination for rows
+	class Sink {
+	public:
+	    virtual ~Sink() {}
+	    virtual void write( unsigned char* rows, std::size_t nrows ) = 0;
+	};
+
+	// merge the sources into sink, which is handed batches of up
+	// to batch_rows rows.  rows with equal keys are taken from the
+	// sources in order.
+	void merge( const std::vector<Source*>& sources, const Compare& compare,
+		    std::size_t rowlen, Sink& sink, std::size_t batch_rows );
+    }
+}
+
+#endif // ! misFITS_ROW_ORDER_H
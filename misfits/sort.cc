@@ -0,0 +1,598 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <misfits/table.hpp>
+#include <misfits/trace.hpp>
+
+#include "fits_p.hpp"
+#include "parallel.hpp"
+#include "row_order.hpp"
+
+namespace misFITS {
+
+    namespace {
+
+	// rows are written in batches of about this size
+	const std::size_t OutputBatch = 1 << 20;
+
+	// runs are read in blocks of at least this size while being
+	// merged, which limits the number merged at once
+	const std::size_t MinMergeBlock = 64 << 10;
+
+	// a sorted run of rows in a temporary file.  the file is
+	// unlinked as soon as it's created, so it disappears when
+	// closed, however that happens.
+	class RunFile : public RowOrder::Sink, public RowOrder::Source, boost::noncopyable {
+
+	public:
+
+	    RunFile( std::size_t rowlen ) :
+		fp_( NULL ),
+		rowlen_( rowlen ) {
+
+		const char* tmpdir = std::getenv( "TMPDIR" );
+		std::string path = std::string( tmpdir && *tmpdir ? tmpdir : "/tmp" ) + "/misfits-sort-XXXXXX";
+
+		std::vector<char> name( path.begin(), path.end() );
+		name.push_back( '\0' );
+
+		int fd = mkstemp( &name[0] );
+		if ( fd < 0 )
+		    fail( "unable to create temporary file in " + path );
+
+		unlink( &name[0] );
+
+		fp_ = fdopen( fd, "w+b" );
+		if ( ! fp_ ) {
+		    close( fd );
+		    fail( "unable to open temporary file" );
+		}
+	    }
+
+	    ~RunFile() {
+		if ( fp_ )
+		    std::fclose( fp_ );
+	    }
+
+	    void write( unsigned char* rows, std::size_t nrows ) {
+
+		if ( std::fwrite( rows, rowlen_, nrows, fp_ ) != nrows )
+		    fail( "error writing temporary file" );
+	    }
+
+	    // start reading the run in blocks of block_rows rows
+	    void rewind( std::size_t block_rows ) {
+
+		if ( std::fflush( fp_ ) || std::fseek( fp_, 0, SEEK_SET ) )
+		    fail( "error rewinding temporary file" );
+
+		block_.resize( std::max( block_rows, std::size_t( 1 ) ) * rowlen_ );
+	    }
+
+	    bool next( const unsigned char*& rows, std::size_t& nrows ) {
+
+		nrows = std::fread( &block_[0], rowlen_, block_.size() / rowlen_, fp_ );
+
+		if ( std::ferror( fp_ ) )
+		    fail( "error reading temporary file" );
+
+		rows = &block_[0];
+		return nrows > 0;
+	    }
+
+	private:
+
+	    static void fail( const std::string& error ) {
+		throw Exception::Assert( error + ": " + std::strerror( errno ) );
+	    }
+
+	    std::FILE* fp_;
+	    std::size_t rowlen_;
+	    std::vector<unsigned char> block_;
+	};
+
+	typedef shared_ptr<RunFile> RunFilePtr;
+    }
+
+    // append rows to the destination table.  if given, the mutex is
+    // that of the destination's file, which other threads may be
+    // reading.
+    class Table::SortOutput : public RowOrder::Sink {
+
+    public:
+
+	SortOutput( Table& dest, boost::mutex* mutex = NULL ) :
+	    dest_( dest ),
+	    mutex_( mutex ) {}
+
+	void write( unsigned char* rows, std::size_t nrows ) {
+
+	    if ( ! mutex_ ) {
+		dest_.append_rows( static_cast<LONGLONG>( nrows ), rows );
+		return;
+	    }
+
+	    boost::lock_guard<boost::mutex> lock( *mutex_ );
+	    dest_.append_rows( static_cast<LONGLONG>( nrows ), rows );
+	}
+
+    private:
+
+	Table& dest_;
+	boost::mutex* mutex_;
+    };
+
+    // sort one run of rows and write it to its sink.  runs are read
+    // from the table one at a time, as CFITSIO can't share a file
+    // between threads; they're sorted concurrently.
+    class Table::SortRun {
+
+    public:
+
+	SortRun( const Table& table, const RowOrder::Compare& compare,
+		 LONGLONG run_rows, const std::vector<RowOrder::Sink*>& sinks ) :
+	    table_( table ),
+	    compare_( compare ),
+	    run_rows_( run_rows ),
+	    sinks_( sinks ) {}
+
+	void operator()( std::size_t run ) {
+
+	    const std::size_t rowlen = static_cast<std::size_t>( table_.rowlen_ );
+
+	    LONGLONG firstrow = static_cast<LONGLONG>( run ) * run_rows_ + 1;
+	    std::size_t nrows;
+	    std::vector<unsigned char> rows;
+
+	    {
+		boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		// the destination may be in the same file
+		table_.set_as_chdu();
+
+		nrows = static_cast<std::size_t>( std::min( run_rows_, table_.num_rows() - firstrow + 1 ) );
+		rows.resize( nrows * rowlen );
+		table_.read_bytes( firstrow, 1, static_cast<LONGLONG>( rows.size() ), &rows[0] );
+	    }
+
+	    std::vector<const unsigned char*> order( nrows );
+	    for ( std::size_t idx = 0 ; idx < nrows ; ++idx )
+		order[idx] = &rows[idx * rowlen];
+
+	    std::stable_sort( order.begin(), order.end(), compare_ );
+
+	    // gather the rows in order into batches
+	    std::size_t batch_rows = std::max( OutputBatch / rowlen, std::size_t( 1 ) );
+	    std::vector<unsigned char> batch( std::min( batch_rows, nrows ) * rowlen );
+
+	    for ( std::size_t first = 0 ; first < nrows ; first += batch_rows ) {
+
+		std::size_t n = std::min( batch_rows, nrows - first );
+
+		for ( std::size_t idx = 0 ; idx < n ; ++idx )
+		    std::memcpy( &batch[idx * rowlen], order[first + idx], rowlen );
+
+		sinks_[run]->write( &batch[0], n );
+	    }
+	}
+
+    private:
+
+	const Table& table_;
+	const RowOrder::Compare& compare_;
+	LONGLONG run_rows_;
+	const std::vector<RowOrder::Sink*>& sinks_;
+
+	boost::mutex mutex_;
+    };
+
+    // an input to merge_sorted, read in blocks.  if prefetching, the
+    // next block is read by the input's own background thread while
+    // the current one is merged; otherwise it's read when it's
+    // needed.  inputs in the same file share a mutex, as CFITSIO
+    // can't use a file from more than one thread at once.
+    class Table::MergeInput : public RowOrder::Source, boost::noncopyable {
+
+    public:
+
+	MergeInput( const Table& table, std::size_t block_rows, boost::mutex& mutex, bool prefetch ) :
+	    table_( table ),
+	    mutex_( mutex ),
+	    rowlen_( static_cast<std::size_t>( table.rowlen_ ) ),
+	    block_rows_( block_rows ),
+	    nrows_( table.num_rows() ),
+	    next_row_( 1 ),
+	    front_( block_rows * rowlen_ ),
+	    back_( block_rows * rowlen_ ),
+	    nback_( 0 ),
+	    prefetch_( prefetch ),
+	    requested_( false ),
+	    stop_( false ),
+	    failed_( false ),
+	    status_( 0 ) {}
+
+	~MergeInput() {
+
+	    if ( ! worker_ )
+		return;
+
+	    wait();
+
+	    {
+		boost::lock_guard<boost::mutex> lock( state_mutex_ );
+		stop_ = true;
+	    }
+
+	    state_changed_.notify_all();
+	    worker_->join();
+	}
+
+	// start the background thread, and read the first block
+	void start() {
+
+	    if ( prefetch_ && nrows_ > 0 )
+		worker_.reset( new boost::thread( boost::bind( &MergeInput::run, this ) ) );
+
+	    fetch_async();
+	}
+
+	bool next( const unsigned char*& rows, std::size_t& nrows ) {
+
+	    wait();
+
+	    if ( failed_ ) {
+
+		if ( status_ )
+		    throw Exception::CFITSIO( status_ );
+
+		throw Exception::Assert( error_ );
+	    }
+
+	    front_.swap( back_ );
+	    nrows = nback_;
+
+	    if ( ! nrows )
+		return false;
+
+	    rows = &front_[0];
+	    fetch_async();
+
+	    return true;
+	}
+
+    private:
+
+	void fetch_async() {
+
+	    if ( next_row_ > nrows_ ) {
+		nback_ = 0;
+		return;
+	    }
+
+	    if ( ! worker_ ) {
+		fetch();
+		return;
+	    }
+
+	    {
+		boost::lock_guard<boost::mutex> lock( state_mutex_ );
+		requested_ = true;
+	    }
+
+	    state_changed_.notify_all();
+	}
+
+	// the background thread; reads a block each time one is
+	// requested
+	void run() {
+
+	    boost::unique_lock<boost::mutex> lock( state_mutex_ );
+
+	    for (;;) {
+
+		while ( ! requested_ && ! stop_ )
+		    state_changed_.wait( lock );
+
+		if ( ! requested_ )
+		    return;
+
+		lock.unlock();
+		fetch();
+		lock.lock();
+
+		requested_ = false;
+		state_changed_.notify_all();
+	    }
+	}
+
+	void fetch() {
+
+	    try {
+
+		std::size_t nrows = static_cast<std::size_t>( std::min<LONGLONG>( block_rows_, nrows_ - next_row_ + 1 ) );
+
+		boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		table_.set_as_chdu();
+		table_.read_bytes( next_row_, 1, static_cast<LONGLONG>( nrows * rowlen_ ), &back_[0] );
+
+		nback_ = nrows;
+		next_row_ += nrows;
+	    }
+
+	    catch ( Exception::CFITSIO& e ) {
+		failed_ = true;
+		status_ = e.status();
+	    }
+
+	    catch ( std::exception& e ) {
+		failed_ = true;
+		error_ = e.what();
+	    }
+	}
+
+	// wait for the block being read in the background
+	void wait() {
+
+	    boost::unique_lock<boost::mutex> lock( state_mutex_ );
+
+	    while ( requested_ )
+		state_changed_.wait( lock );
+	}
+
+	const Table& table_;
+	boost::mutex& mutex_;
+
+	std::size_t rowlen_;
+	std::size_t block_rows_;
+
+	LONGLONG nrows_;
+	LONGLONG next_row_;
+
+	// the block being merged, and the one being read
+	std::vector<unsigned char> front_;
+	std::vector<unsigned char> back_;
+	std::size_t nback_;
+
+	// the background thread and its requests
+	bool prefetch_;
+	unique_ptr<boost::thread> worker_;
+	boost::mutex state_mutex_;
+	boost::condition_variable state_changed_;
+	bool requested_;
+	bool stop_;
+
+	bool failed_;
+	int status_;
+	std::string error_;
+    };
+
+    namespace {
+
+	void
+	merge_runs( const std::vector<RunFilePtr>& runs, std::size_t first, std::size_t last,
+		    const RowOrder::Compare& compare, std::size_t rowlen,
+		    std::size_t memory_budget, RowOrder::Sink& sink ) {
+
+	    // the runs and the output batch share the budget equally
+	    std::size_t block_rows = memory_budget / ( last - first + 1 ) / rowlen;
+
+	    std::vector<RowOrder::Source*> sources;
+
+	    for ( std::size_t idx = first ; idx < last ; ++idx ) {
+		runs[idx]->rewind( block_rows );
+		sources.push_back( runs[idx].get() );
+	    }
+
+	    RowOrder::merge( sources, compare, rowlen, sink, block_rows );
+	}
+    }
+
+    void
+    Table::sort_by( const std::vector<std::string>& names, Table& dest,
+		    std::size_t memory_budget, unsigned int nthreads ) const {
+
+	Trace::Span span( "Table::sort_by", hdu_num_ );
+
+	if ( &dest == this )
+	    throw Exception::Assert( "can't sort a table into itself" );
+
+	check_row_layout( dest );
+
+	RowOrder::Compare compare( *this, names );
+
+	const LONGLONG nrows = num_rows();
+	const std::size_t rowlen = static_cast<std::size_t>( rowlen_ );
+
+	span.arg( "rows", nrows );
+
+	if ( ! nrows )
+	    return;
+
+	if ( ! nthreads )
+	    nthreads = Parallel::default_threads();
+
+	// each row of a run needs room for its data and two pointers
+	// for the sort, and each thread sorts its own run.
+	LONGLONG run_rows = std::max<LONGLONG>( 1, memory_budget / nthreads / ( rowlen + 2 * sizeof( const unsigned char* ) ) );
+	std::size_t nruns = static_cast<std::size_t>( ( nrows + run_rows - 1 ) / run_rows );
+
+	SortOutput output( dest );
+	dest.reserve_rows( dest.num_rows() + nrows );
+
+	// a single run is written straight to the destination
+	if ( nruns == 1 ) {
+
+	    std::vector<RowOrder::Sink*> sinks( 1, &output );
+	    SortRun sort_run( *this, compare, run_rows, sinks );
+	    sort_run( 0 );
+	    return;
+	}
+
+	std::vector<RunFilePtr> runs;
+	std::vector<RowOrder::Sink*> sinks;
+
+	for ( std::size_t run = 0 ; run < nruns ; ++run ) {
+	    runs.push_back( RunFilePtr( new RunFile( rowlen ) ) );
+	    sinks.push_back( runs.back().get() );
+	}
+
+	{
+	    SortRun sort_run( *this, compare, run_rows, sinks );
+	    Parallel::for_each( nruns, nthreads, sort_run );
+	}
+
+	// if there are too many runs to merge at once, merge
+	// consecutive groups of them until there aren't.  merging
+	// consecutive runs keeps the sort stable.
+	std::size_t nblocks = memory_budget / std::max( rowlen, MinMergeBlock );
+	std::size_t max_runs = nblocks > 3 ? nblocks - 1 : 2;
+
+	while ( runs.size() > max_runs ) {
+
+	    std::vector<RunFilePtr> merged;
+
+	    for ( std::size_t first = 0 ; first < runs.size() ; first += max_runs ) {
+
+		std::size_t last = std::min( first + max_runs, runs.size() );
+
+		if ( last - first == 1 ) {
+		    merged.push_back( runs[first] );
+		    continue;
+		}
+
+		RunFilePtr run( new RunFile( rowlen ) );
+		merge_runs( runs, first, last, compare, rowlen, memory_budget, *run );
+		merged.push_back( run );
+
+		// done with these
+		for ( std::size_t idx = first ; idx < last ; ++idx )
+		    runs[idx].reset();
+	    }
+
+	    runs.swap( merged );
+	}
+
+	merge_runs( runs, 0, runs.size(), compare, rowlen, memory_budget, output );
+    }
+
+    void
+    Table::merge_sorted( const std::vector<TablePtr>& inputs,
+			 const std::vector<std::string>& names,
+			 std::size_t memory_budget,
+			 bool prefetch ) {
+
+	Trace::Span span( "Table::merge_sorted", hdu_num_ );
+	span.arg( "inputs", inputs.size() );
+
+	for ( std::vector<TablePtr>::const_iterator input = inputs.begin() ; input != inputs.end() ; ++input ) {
+
+	    if ( ! *input )
+		throw Exception::Assert( "null table passed to merge_sorted" );
+
+	    if ( input->get() == this )
+		throw Exception::Assert( "can't merge a table into itself" );
+
+	    check_row_layout( **input );
+	}
+
+	RowOrder::Compare compare( *this, names );
+
+	if ( inputs.empty() )
+	    return;
+
+	const std::size_t rowlen = static_cast<std::size_t>( rowlen_ );
+
+	// one mutex per file
+	typedef std::map< const File*, shared_ptr<boost::mutex> > FileMutexes;
+	FileMutexes mutexes;
+
+	LONGLONG nrows = 0;
+
+	for ( std::vector<TablePtr>::const_iterator input = inputs.begin() ; input != inputs.end() ; ++input ) {
+
+	    shared_ptr<boost::mutex>& mutex = mutexes[ (*input)->file().get() ];
+	    if ( ! mutex )
+		mutex.reset( new boost::mutex );
+
+	    nrows += (*input)->num_rows();
+	}
+
+	span.arg( "rows", nrows );
+
+	reserve_rows( num_rows() + nrows );
+
+	// each input has two blocks, and there's the output batch
+	std::size_t block_rows = std::max<std::size_t>( 1, memory_budget / ( 2 * inputs.size() + 1 ) / rowlen );
+
+	std::vector< shared_ptr<MergeInput> > merge_inputs;
+	std::vector<RowOrder::Source*> sources;
+
+	for ( std::vector<TablePtr>::const_iterator input = inputs.begin() ; input != inputs.end() ; ++input ) {
+
+	    merge_inputs.push_back( shared_ptr<MergeInput>( new MergeInput( **input, block_rows,
+									     *mutexes[ (*input)->file().get() ],
+									     prefetch ) ) );
+	    sources.push_back( merge_inputs.back().get() );
+	}
+
+	for ( std::vector< shared_ptr<MergeInput> >::iterator input = merge_inputs.begin() ; input != merge_inputs.end() ; ++input )
+	    (*input)->start();
+
+	FileMutexes::iterator own = mutexes.find( file().get() );
+	SortOutput output( *this, own == mutexes.end() ? NULL : own->second.get() );
+
+	RowOrder::merge( sources, compare, rowlen, output, block_rows );
+    }
+
+    void
+    Table::check_row_layout( const Table& other ) const {
+
+	if ( has_heap_ || other.has_heap_ )
+	    throw Exception::Assert( "rows of tables with variable length array columns can't be sorted or merged" );
+
+	bool same = other.rowlen_ == rowlen_ && other.columns.size() == columns.size();
+
+	for ( Columns::size_type idx = 0 ; same && idx < columns.size() ; ++idx )
+	    same = other.columns[idx] == columns[idx] && other.columns[idx].nbytes == columns[idx].nbytes;
+
+	if ( ! same )
+	    throw Exception::Assert( "the tables' columns don't match" );
+    }
+}
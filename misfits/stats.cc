@@ -0,0 +1,92 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <ostream>
+
+#include <time.h>
+#include <sys/time.h>
+
+#include <misfits/stats.hpp>
+
+namespace misFITS {
+
+    void
+    Stats::reset() {
+
+	bytes_read = bytes_written = 0;
+	rows_read = rows_written = 0;
+
+	for ( int category = 0 ; category < NumCategories ; ++category ) {
+	    counters_[category].calls = 0;
+	    counters_[category].seconds = 0;
+	}
+    }
+
+    const char*
+    Stats::name( Category category ) {
+
+	switch ( category ) {
+
+	case ReadCol:      return "read_col";
+	case WriteCol:     return "write_col";
+	case TblBytes:     return "tblbytes";
+	case MoveTo:       return "move_to";
+	case KeywordRead:  return "keyword_read";
+	case KeywordWrite: return "keyword_write";
+	case Flush:        return "flush";
+	default:           return "unknown";
+	}
+    }
+
+    double
+    Stats::now() {
+
+#ifdef CLOCK_MONOTONIC
+	timespec ts;
+	if ( 0 == clock_gettime( CLOCK_MONOTONIC, &ts ) )
+	    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+#endif
+
+	timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+    }
+
+    std::ostream&
+    operator<<( std::ostream& os, const Stats& stats ) {
+
+	for ( int idx = 0 ; idx < Stats::NumCategories ; ++idx ) {
+
+	    Stats::Category category = static_cast<Stats::Category>( idx );
+
+	    os << Stats::name( category ) << ": "
+	       << stats[category].calls << " calls, "
+	       << stats[category].seconds << " s\n";
+	}
+
+	os << "bytes read: " << stats.bytes_read << "\n"
+	   << "bytes written: " << stats.bytes_written << "\n"
+	   << "rows read: " << stats.rows_read << "\n"
+	   << "rows written: " << stats.rows_written << "\n";
+
+	return os;
+    }
+}
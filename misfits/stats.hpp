@@ -0,0 +1,103 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_STATS_H
+#define misFITS_STATS_H
+
+#include <iosfwd>
+
+#include <boost/noncopyable.hpp>
+
+namespace misFITS {
+
+    // counts of, and the wall clock time spent in, the CFITSIO calls
+    // made on behalf of a File, along with the amount of data moved.
+    // the counters are not atomic; like the File, they must not be
+    // shared between threads.
+    class Stats {
+
+    public:
+
+	enum Category {
+	    ReadCol,		// fits_read_col and friends
+	    WriteCol,		// fits_write_col and friends
+	    TblBytes,		// fits_read_tblbytes, fits_write_tblbytes
+	    MoveTo,		// HDU changes, including redundant ones
+	    KeywordRead,
+	    KeywordWrite,
+	    Flush,		// fits_flush_file, fits_flush_buffer
+	    NumCategories
+	};
+
+	struct Counter {
+	    unsigned long long calls;
+	    double seconds;
+	};
+
+	// bytes are counted as seen by the caller, i.e. after any
+	// type conversion
+	unsigned long long bytes_read;
+	unsigned long long bytes_written;
+
+	// rows read or written via misFITS::Row
+	unsigned long long rows_read;
+	unsigned long long rows_written;
+
+	Stats() { reset(); }
+
+	void reset();
+
+	const Counter& operator[]( Category category ) const { return counters_[category]; }
+
+	static const char* name( Category category );
+
+	// monotonic wall clock time, in seconds
+	static double now();
+
+	// record a call in the given category, and the time spent
+	// until the Timer is destroyed
+	class Timer : boost::noncopyable {
+
+	public:
+	    Timer( Stats& stats, Category category ) :
+		counter_( stats.counters_[category] ),
+		start_( now() ) {}
+
+	    ~Timer() {
+		++counter_.calls;
+		counter_.seconds += now() - start_;
+	    }
+
+	private:
+	    Counter& counter_;
+	    double start_;
+	};
+
+    private:
+	Counter counters_[NumCategories];
+    };
+
+    std::ostream& operator<<( std::ostream& os, const Stats& stats );
+}
+
+#endif // ! misFITS_STATS_H
@@ -0,0 +1,104 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_STREAM_P_H
+#define misFITS_STREAM_P_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <fitsio.h>
+
+// manipulation of raw 80 character header records, shared by
+// StreamWriter and StreamReader
+
+namespace misFITS {
+
+    namespace Record {
+
+	const std::string::size_type Length = 80;
+	const std::string::size_type BlockLength = 2880;
+
+	// offset of the named record in a header
+	inline std::string::size_type
+	find( const std::string& header, const char* keyname ) {
+
+	    char name[9];
+	    std::sprintf( name, "%-8.8s", keyname );
+
+	    for ( std::string::size_type offset = 0 ; offset < header.size() ; offset += Length )
+		if ( 0 == header.compare( offset, 8, name ) )
+		    return offset;
+
+	    return std::string::npos;
+	}
+
+	inline bool
+	is_end( const std::string& header, std::string::size_type offset ) {
+	    return 0 == header.compare( offset, 8, "END     " );
+	}
+
+	inline std::string
+	end() {
+	    return std::string( "END" ).append( Length - 3, ' ' );
+	}
+
+	inline std::string
+	integer( const char* keyname, LONGLONG value, const char* comment ) {
+
+	    char record[Length + 1];
+	    std::sprintf( record, "%-8.8s= %20lld / %-47.47s", keyname, static_cast<long long>( value ), comment );
+	    return std::string( record, Length );
+	}
+
+	inline std::string
+	logical( const char* keyname, bool value, const char* comment ) {
+
+	    char record[Length + 1];
+	    std::sprintf( record, "%-8.8s= %20s / %-47.47s", keyname, value ? "T" : "F", comment );
+	    return std::string( record, Length );
+	}
+
+	// the value of the named integer record, or dflt if there's no
+	// such record
+	inline LONGLONG
+	integer_value( const std::string& header, const char* keyname, LONGLONG dflt = 0 ) {
+
+	    std::string::size_type offset = find( header, keyname );
+	    if ( offset == std::string::npos )
+		return dflt;
+
+	    std::string value( header, offset + 10, Length - 10 );
+	    return std::strtoll( value.c_str(), NULL, 10 );
+	}
+
+	// pad a header or data unit to a whole number of FITS blocks
+	inline std::string::size_type
+	padded( LONGLONG nbytes ) {
+	    return static_cast<std::string::size_type>( ( nbytes + BlockLength - 1 ) / BlockLength * BlockLength );
+	}
+    }
+}
+
+#endif // ! misFITS_STREAM_P_H
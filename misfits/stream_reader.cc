@@ -0,0 +1,287 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fitsio.h>
+
+#include <misfits/stream_reader.hpp>
+#include <misfits/driver.hpp>
+
+#include "fits_p.hpp"
+#include "stream_p.hpp"
+
+namespace misFITS {
+
+    StreamReader::StreamReader( std::istream& is, std::size_t block_bytes ) :
+	is_( is ),
+	block_bytes_( block_bytes ),
+	primary_( false ),
+	data_offset_( 0 ),
+	rowlen_( 0 ),
+	block_rows_( 0 ),
+	nrows_( 0 ),
+	nfilled_( 0 ),
+	nread_( 0 ),
+	nstaged_( 0 ),
+	remaining_( 0 ) {}
+
+    StreamReader::~StreamReader() {
+	close_table();
+    }
+
+    TablePtr
+    StreamReader::table() const {
+
+	if ( ! table_ )
+	    throw Exception::Assert( "StreamReader has no current table" );
+
+	return table_;
+    }
+
+    Row&
+    StreamReader::row() {
+
+	if ( ! row_ )
+	    throw Exception::Assert( "StreamReader has no current table" );
+
+	return *row_;
+    }
+
+    bool
+    StreamReader::next_table( const std::string& extname ) {
+
+	while ( next_table() )
+	    if ( table_->extname() == extname )
+		return true;
+
+	return false;
+    }
+
+    bool
+    StreamReader::next_table() {
+
+	close_table();
+	skip( remaining_ );
+	remaining_ = 0;
+
+	std::string header;
+
+	while ( read_header( header ) ) {
+
+	    // size of the data unit
+	    LONGLONG naxis = Record::integer_value( header, "NAXIS" );
+	    LONGLONG nbytes = 0;
+
+	    if ( naxis ) {
+
+		nbytes = 1;
+		for ( LONGLONG axis = 1 ; axis <= naxis ; ++axis ) {
+
+		    char keyname[9];
+		    std::sprintf( keyname, "NAXIS%d", static_cast<int>( axis ) );
+		    nbytes *= Record::integer_value( header, keyname );
+		}
+
+		LONGLONG bitpix = Record::integer_value( header, "BITPIX" );
+
+		nbytes = ( bitpix < 0 ? -bitpix : bitpix ) / 8
+		    * Record::integer_value( header, "GCOUNT", 1 )
+		    * ( Record::integer_value( header, "PCOUNT" ) + nbytes );
+	    }
+
+	    remaining_ = Record::padded( nbytes );
+
+	    if ( ! primary_ ) {
+
+		if ( header.compare( 0, 8, "SIMPLE  " ) )
+		    throw Exception::Assert( "stream doesn't start with a FITS primary header" );
+
+		primary_ = true;
+	    }
+
+	    else if ( header.compare( 0, 8, "XTENSION" ) )
+		throw Exception::Assert( "expected a FITS extension header in stream" );
+
+	    else if ( 0 == header.compare( 0, 20, "XTENSION= 'BINTABLE'" ) ) {
+
+		if ( Record::find( header, "ZTABLE" ) != std::string::npos )
+		    throw Exception::Assert( "can't stream tile compressed table" );
+
+		if ( Record::find( header, "NAXIS2" ) == std::string::npos
+		     || Record::find( header, "PCOUNT" ) == std::string::npos )
+		    throw Exception::Assert( "malformed binary table header in FITS stream" );
+
+		rowlen_ = Record::integer_value( header, "NAXIS1" );
+		nrows_ = Record::integer_value( header, "NAXIS2" );
+
+		block_rows_ = rowlen_ ? std::max<LONGLONG>( 1, static_cast<LONGLONG>( block_bytes_ ) / rowlen_ ) : 1;
+		block_rows_ = std::min( block_rows_, nrows_ );
+
+		// the staging table holds a block of rows and no heap
+		header.replace( Record::find( header, "NAXIS2" ), Record::Length,
+				Record::integer( "NAXIS2", block_rows_, "number of rows in table" ) );
+		header.replace( Record::find( header, "PCOUNT" ), Record::Length,
+				Record::integer( "PCOUNT", 0, "size of special data area" ) );
+
+		std::string::size_type theap = Record::find( header, "THEAP" );
+		if ( theap != std::string::npos )
+		    header.replace( theap, Record::Length, Record::Length, ' ' );
+
+		header += Record::end();
+		header.resize( Record::padded( header.size() ), ' ' );
+
+		std::string primary
+		    = Record::logical( "SIMPLE", true, "file does conform to FITS standard" )
+		    + Record::integer( "BITPIX", 8, "number of bits per data pixel" )
+		    + Record::integer( "NAXIS", 0, "number of data axes" )
+		    + Record::logical( "EXTEND", true, "FITS dataset may contain extensions" )
+		    + Record::end();
+		primary.resize( Record::padded( primary.size() ), ' ' );
+
+		data_offset_ = primary.size() + header.size();
+
+		buffer_.assign( primary.begin(), primary.end() );
+		buffer_.insert( buffer_.end(), header.begin(), header.end() );
+		buffer_.resize( data_offset_ + Record::padded( block_rows_ * rowlen_ ), 0 );
+
+		file_ = open<Entity::File, Mode::ReadOnly>( Driver::buffer_url( &buffer_[0], buffer_.size() ) );
+		table_ = file_->table( 2 );
+
+		for ( Table::Columns::size_type colnum = 1 ; colnum <= table_->num_columns() ; ++colnum )
+		    if ( table_->colinfo( colnum ).varlength )
+			throw Exception::Assert( "can't stream table with variable length array column '"
+						 + table_->colinfo( colnum ).ttype + "'" );
+
+		row_.reset( new Row( table_ ) );
+
+		nfilled_ = 0;
+		nread_ = 0;
+		nstaged_ = 0;
+
+		return true;
+	    }
+
+	    skip( remaining_ );
+	    remaining_ = 0;
+	}
+
+	return false;
+    }
+
+    bool
+    StreamReader::read() {
+
+	if ( ! row_ )
+	    throw Exception::Assert( "StreamReader has no current table" );
+
+	if ( nread_ == nrows_ )
+	    return false;
+
+	if ( nread_ == nfilled_ )
+	    fill();
+
+	row_->read( nread_ - ( nfilled_ - nstaged_ ) + 1 );
+	++nread_;
+
+	return true;
+    }
+
+    void
+    StreamReader::fill() {
+
+	LONGLONG nrows = std::min( block_rows_, nrows_ - nfilled_ );
+	LONGLONG nbytes = nrows * rowlen_;
+
+	get( &buffer_[data_offset_], static_cast<std::size_t>( nbytes ) );
+	remaining_ -= nbytes;
+
+	nfilled_ += nrows;
+	nstaged_ = nrows;
+
+	// CFITSIO's copy of the previous block is stale
+	misFITS_CHECK_CFITSIO_EXPR( fits_flush_buffer( file_->fptr(), TRUE, &status ) );
+    }
+
+    void
+    StreamReader::close_table() {
+
+	row_.reset();
+	table_.reset();
+	file_.reset();
+    }
+
+    bool
+    StreamReader::read_header( std::string& header ) {
+
+	header.clear();
+
+	char block[Record::BlockLength];
+
+	for ( ;; ) {
+
+	    is_.read( block, Record::BlockLength );
+	    std::streamsize nbytes = is_.gcount();
+
+	    if ( nbytes == 0 && header.empty() )
+		return false;
+
+	    if ( nbytes != static_cast<std::streamsize>( Record::BlockLength ) )
+		throw Exception::Assert( "premature end of FITS stream" );
+
+	    for ( std::string::size_type offset = 0 ; offset < Record::BlockLength ; offset += Record::Length ) {
+
+		if ( 0 == std::memcmp( block + offset, "END     ", 8 ) ) {
+		    header.append( block, offset );
+		    return true;
+		}
+	    }
+
+	    header.append( block, Record::BlockLength );
+	}
+    }
+
+    void
+    StreamReader::skip( LONGLONG nbytes ) {
+
+	while ( nbytes > 0 ) {
+
+	    std::streamsize chunk = static_cast<std::streamsize>( std::min<LONGLONG>( nbytes, 1 << 20 ) );
+	    is_.ignore( chunk );
+
+	    if ( is_.gcount() != chunk )
+		throw Exception::Assert( "premature end of FITS stream" );
+
+	    nbytes -= chunk;
+	}
+    }
+
+    void
+    StreamReader::get( char* data, std::size_t nbytes ) {
+
+	is_.read( data, static_cast<std::streamsize>( nbytes ) );
+
+	if ( is_.gcount() != static_cast<std::streamsize>( nbytes ) )
+	    throw Exception::Assert( "premature end of FITS stream" );
+    }
+}
@@ -0,0 +1,134 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_STREAM_READER_H
+#define misFITS_STREAM_READER_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <misfits/fits.hpp>
+#include <misfits/table.hpp>
+#include <misfits/row.hpp>
+
+namespace misFITS {
+
+    // Read binary tables from a stream, such as a pipe, in a single
+    // forward pass.  Headers are parsed as they arrive, and rows are
+    // read in blocks of about block_bytes into a staging table, so
+    // memory use doesn't depend upon the size of the stream.
+    //
+    // There's no random access; rows are read in order, and the
+    // stream can't be rewound to an earlier HDU.  HDUs which aren't
+    // binary tables are skipped, as are the heaps of tables.  Tables
+    // with variable length array columns and tile compressed tables
+    // can't be streamed.
+    //
+    //    StreamReader reader( std::cin );
+    //    while ( reader.next_table( "EVENTS" ) ) {
+    //        reader.row().add( "X", &x ).add( "Y", &y );
+    //        while ( reader.read() )
+    //            ...;
+    //    }
+
+    class StreamReader : boost::noncopyable {
+
+    public:
+
+	StreamReader( std::istream& is, std::size_t block_bytes = 1 << 20 );
+
+	~StreamReader();
+
+	// skip the rest of the current table and advance to the next
+	// binary table; returns false at the end of the stream.
+	bool next_table();
+
+	// ditto, but to the next table with the given EXTNAME
+	bool next_table( const std::string& extname );
+
+	// the staging table, for access to column information and
+	// keywords.  its number of rows is that of a block, not of the
+	// table in the stream.
+	TablePtr table() const;
+
+	// the row whose columns are filled by read(); recreated by
+	// next_table. don't call its read or write methods directly.
+	Row& row();
+
+	// read the next row of the current table; returns false when
+	// there are no more.
+	bool read();
+
+	// the number of rows in the current table, and the number of
+	// them read so far
+	LONGLONG num_rows() const { return nrows_; }
+	LONGLONG idx() const { return nread_; }
+
+    private:
+
+	// read the next header, without END; returns false at the end
+	// of the stream.
+	bool read_header( std::string& header );
+
+	// read the next block of rows into the staging table
+	void fill();
+
+	void close_table();
+	void skip( LONGLONG nbytes );
+	void get( char* data, std::size_t nbytes );
+
+	std::istream& is_;
+	std::size_t block_bytes_;
+
+	// true once the primary HDU has been seen
+	bool primary_;
+
+	// the staging file is opened over buffer_, which holds an empty
+	// primary HDU, the table's header and a block of rows.
+	std::vector<char> buffer_;
+	std::size_t data_offset_;
+
+	FilePtr file_;
+	TablePtr table_;
+	unique_ptr<Row> row_;
+
+	LONGLONG rowlen_;
+	LONGLONG block_rows_;
+
+	// rows in the table, read from the stream, and read by the
+	// caller
+	LONGLONG nrows_;
+	LONGLONG nfilled_;
+	LONGLONG nread_;
+
+	// rows in the staging table, and the bytes of the current
+	// data unit which haven't been read from the stream
+	LONGLONG nstaged_;
+	LONGLONG remaining_;
+    };
+}
+
+#endif // ! misFITS_STREAM_READER_H
@@ -0,0 +1,276 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <iostream>
+
+#include <fitsio.h>
+
+#include <misfits/stream_writer.hpp>
+
+#include "fits_p.hpp"
+#include "stream_p.hpp"
+
+namespace misFITS {
+
+    // the header records of the CHDU, without the END record
+    static std::string
+    header_records( fitsfile* fptr ) {
+
+	char* header;
+	int nkeys;
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_hdr2str( fptr, 0, NULL, 0, &header, &nkeys, &status ) );
+
+	std::string records( header );
+
+	int status = 0;
+	fits_free_memory( header, &status );
+
+	std::string::size_type nrecords = records.size() / Record::Length;
+	if ( nrecords && Record::is_end( records, Record::Length * ( nrecords - 1 ) ) )
+	    --nrecords;
+
+	records.resize( Record::Length * nrecords );
+	return records;
+    }
+
+    //-----------------------------------------
+
+    StreamWriter::StreamWriter( std::ostream& os, const Table& layout, std::size_t block_bytes,
+				bool multiple_hdus ) :
+	os_( os ),
+	file_( open<Entity::Memory>() ),
+	table_( layout.copy( file_, TableCopy::Header ) ),
+	row_( table_ ),
+	seekable_( os.tellp() != std::streampos( -1 ) ),
+	multiple_hdus_( multiple_hdus ),
+	closed_( false ),
+	nstaged_( 0 ),
+	nrows_( 0 ),
+	nhdus_( 0 ),
+	extver_( 1 ),
+	naxis2_offset_( 0 ),
+	hdu_pos_( 0 ),
+	naxis2_pos_( -1 ) {
+
+	for ( Table::Columns::size_type colnum = 1 ; colnum <= table_->num_columns() ; ++colnum )
+	    if ( table_->colinfo( colnum ).varlength )
+		throw Exception::Assert( "can't stream table with variable length array column '"
+					 + table_->colinfo( colnum ).ttype + "'" );
+
+	table_->set_as_chdu();
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_read_key( file_->fptr(), TLONGLONG, "NAXIS1", &rowlen_, NULL, &status ) );
+
+	block_rows_ = rowlen_ ? std::max<LONGLONG>( 1, static_cast<LONGLONG>( block_bytes ) / rowlen_ ) : 1;
+
+	// write the primary header now, so that an unwriteable stream
+	// is noticed early
+	file_->move_to( 1 );
+	std::string primary = header_records( file_->fptr() );
+	table_->set_as_chdu();
+
+	primary += Record::end();
+	primary.resize( Record::padded( primary.size() ), ' ' );
+	put( primary.data(), primary.size() );
+
+	extver_ = table_->extver();
+    }
+
+    StreamWriter::~StreamWriter() {
+
+	// destructors shouldn't throw
+	try {
+	    close();
+	} catch ( std::exception& e ) {
+	    std::cerr << "Client error: misFITS::StreamWriter::close invoked by misFITS::StreamWriter::~StreamWriter: " << e.what() << std::endl;
+	}
+    }
+
+    void
+    StreamWriter::write() {
+
+	if ( closed_ )
+	    throw Exception::Assert( "write to closed StreamWriter" );
+
+	// a table in a stream which can't be sought is written when the
+	// writer is closed, so it must fit in a block, unless it may be
+	// split.  leave the output without a table rather than with a
+	// truncated one.
+	bool split = seekable_ || multiple_hdus_;
+
+	if ( nstaged_ == block_rows_ && ! split ) {
+	    closed_ = true;
+	    throw Exception::Assert( "table is too large to write as a single HDU to a stream which can't be sought;"
+				     " increase StreamWriter's block_bytes or allow multiple HDUs" );
+	}
+
+	row_.write( nstaged_ + 1 );
+	++nstaged_;
+	++nrows_;
+
+	if ( nstaged_ == block_rows_ && split )
+	    emit( false );
+    }
+
+    void
+    StreamWriter::close() {
+
+	if ( closed_ )
+	    return;
+
+	closed_ = true;
+	emit( true );
+
+	os_.flush();
+	if ( ! os_ )
+	    throw Exception::Assert( "error writing FITS stream" );
+    }
+
+    void
+    StreamWriter::emit( bool final ) {
+
+	if ( seekable_ ) {
+
+	    // a single table, whose NAXIS2 is fixed up at the end if it
+	    // isn't known when the header is written
+	    if ( nhdus_ == 0 ) {
+		write_header( final ? nrows_ : 0, extver_ );
+		if ( ! final )
+		    naxis2_pos_ = hdu_pos_ + static_cast<std::streamoff>( naxis2_offset_ );
+		nhdus_ = 1;
+	    }
+
+	    write_data();
+
+	    if ( final ) {
+
+		pad( nrows_ * rowlen_ );
+
+		if ( naxis2_pos_ >= 0 ) {
+
+		    std::streampos end = os_.tellp();
+		    std::string record = Record::integer( "NAXIS2", nrows_, "number of rows in table" );
+
+		    os_.seekp( naxis2_pos_ );
+		    put( record.data(), record.size() );
+		    os_.seekp( end );
+		}
+	    }
+
+	    return;
+	}
+
+	// otherwise every block is a complete table.  make sure that
+	// there's at least one.
+	if ( final && nstaged_ == 0 && nhdus_ )
+	    return;
+
+	LONGLONG nrows = nstaged_;
+
+	write_header( nrows, extver_ + nhdus_ );
+	write_data();
+	pad( nrows * rowlen_ );
+
+	++nhdus_;
+    }
+
+    void
+    StreamWriter::write_header( LONGLONG nrows, int extver ) {
+
+	// the header is read when it's first needed, so that keywords
+	// may be added to the staging table until then
+	if ( header_.empty() ) {
+
+	    table_->set_as_chdu();
+	    header_ = header_records( file_->fptr() );
+
+	    // checksums copied from the layout don't describe the
+	    // table written
+	    const char* stale[] = { "CHECKSUM", "DATASUM" };
+	    for ( std::size_t i = 0 ; i < sizeof( stale ) / sizeof( stale[0] ) ; ++i ) {
+
+		std::string::size_type offset = Record::find( header_, stale[i] );
+		if ( offset != std::string::npos )
+		    header_.erase( offset, Record::Length );
+	    }
+
+	    naxis2_offset_ = Record::find( header_, "NAXIS2" );
+	    if ( naxis2_offset_ == std::string::npos )
+		throw Exception::Assert( "staging table has no NAXIS2 record" );
+	}
+
+	std::string header( header_ );
+
+	header.replace( naxis2_offset_, Record::Length, Record::integer( "NAXIS2", nrows, "number of rows in table" ) );
+
+	std::string::size_type extver_offset = Record::find( header, "EXTVER" );
+	std::string extver_record = Record::integer( "EXTVER", extver, "extension version" );
+
+	if ( extver_offset == std::string::npos )
+	    header += extver_record;
+	else
+	    header.replace( extver_offset, Record::Length, extver_record );
+
+	header += Record::end();
+	header.resize( Record::padded( header.size() ), ' ' );
+
+	if ( seekable_ )
+	    hdu_pos_ = os_.tellp();
+
+	put( header.data(), header.size() );
+    }
+
+    void
+    StreamWriter::write_data() {
+
+	if ( ! nstaged_ )
+	    return;
+
+	buffer_.resize( static_cast<std::size_t>( nstaged_ * rowlen_ ) );
+	table_->read_bytes( 1, 1, nstaged_ * rowlen_, &buffer_[0] );
+
+	put( reinterpret_cast<const char*>( &buffer_[0] ), buffer_.size() );
+
+	nstaged_ = 0;
+    }
+
+    // pad a data unit of nbytes to a whole number of FITS blocks
+    void
+    StreamWriter::pad( LONGLONG nbytes ) {
+
+	static const char zeroes[Record::BlockLength] = { 0 };
+
+	std::size_t npad = Record::padded( nbytes ) - static_cast<std::size_t>( nbytes );
+	put( zeroes, npad );
+    }
+
+    void
+    StreamWriter::put( const char* data, std::size_t nbytes ) {
+
+	os_.write( data, static_cast<std::streamsize>( nbytes ) );
+
+	if ( ! os_ )
+	    throw Exception::Assert( "error writing FITS stream" );
+    }
+}
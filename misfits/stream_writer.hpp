@@ -0,0 +1,136 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_STREAM_WRITER_H
+#define misFITS_STREAM_WRITER_H
+
+#include <ios>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <misfits/fits.hpp>
+#include <misfits/table.hpp>
+#include <misfits/row.hpp>
+
+namespace misFITS {
+
+    // Write a binary table to a stream, such as a pipe, without
+    // knowing the number of rows in advance.  Rows are staged in
+    // memory and written out in blocks of about block_bytes.
+    //
+    // If the stream is seekable, a single table is written, with a
+    // placeholder NAXIS2 which is corrected when the writer is
+    // closed.  Otherwise the rows are held until the writer is
+    // closed, and writing more than a block's worth throws, unless
+    // multiple_hdus is true.  Then each block is written as a
+    // complete table HDU with the same layout, and with EXTVER
+    // incremented for each block, so readers must be prepared to
+    // read them all.
+    //
+    // The output starts with an empty primary HDU.  Any CHECKSUM
+    // and DATASUM keywords are dropped, as they can't be known until
+    // the table has been written.  Tables with variable length array
+    // columns can't be streamed.
+    //
+    //    StreamWriter writer( std::cout, layout );
+    //    writer.row().add( "X", &x ).add( "Y", &y );
+    //    while ( ... ) {
+    //        x = ...; y = ...;
+    //        writer.write();
+    //    }
+    //    writer.close();
+
+    class StreamWriter : boost::noncopyable {
+
+    public:
+
+	// the columns and keywords are copied from layout
+	StreamWriter( std::ostream& os, const Table& layout, std::size_t block_bytes = 1 << 20,
+		      bool multiple_hdus = false );
+
+	// closes the writer if that hasn't been done, logging any errors
+	~StreamWriter();
+
+	// the row whose columns are written by write(). don't call its
+	// read or write methods directly.
+	Row& row() { return row_; }
+
+	// the staging table; may be used to add keywords before the
+	// first block is written.
+	TablePtr table() const { return table_; }
+
+	void write();
+
+	// write any remaining rows and complete the output
+	void close();
+
+	LONGLONG num_rows() const { return nrows_; }
+
+    private:
+
+	// write out the staged rows
+	void emit( bool final );
+
+	void write_header( LONGLONG nrows, int extver );
+	void write_data();
+	void pad( LONGLONG nbytes );
+	void put( const char* data, std::size_t nbytes );
+
+	std::ostream& os_;
+	FilePtr file_;
+	TablePtr table_;
+	Row row_;
+
+	bool seekable_;
+	bool multiple_hdus_;
+	bool closed_;
+
+	LONGLONG rowlen_;
+	LONGLONG block_rows_;
+
+	// rows in the staging table, and written overall
+	LONGLONG nstaged_;
+	LONGLONG nrows_;
+
+	// number of table HDUs written
+	int nhdus_;
+
+	// the header of the table, without END, and the offset of its
+	// NAXIS2 record
+	std::string header_;
+	int extver_;
+	std::string::size_type naxis2_offset_;
+
+	// in a seekable stream, where the table's header and its
+	// placeholder NAXIS2 record (if any) were written
+	std::streamoff hdu_pos_;
+	std::streamoff naxis2_pos_;
+
+	std::vector<unsigned char> buffer_;
+    };
+}
+
+#endif // ! misFITS_STREAM_WRITER_H
@@ -24,15 +24,27 @@
 #include <memory>
 #include <cstdarg>
 #include <numeric>
+#include <algorithm>
+#include <iostream>
 
 using namespace std;
 
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/bind.hpp>
+
 #include <misfits/types.hpp>
 #include <misfits/fits.hpp>
 #include <misfits/table.hpp>
 #include <misfits/row.hpp>
+#include <misfits/trace.hpp>
 
 #include "fits_p.hpp"
+#include "byteswap.hpp"
+#include "checksum.hpp"
+#include "decode.hpp"
+#include "driver_p.hpp"
+#include "parallel.hpp"
+#include "tiled_table.hpp"
 
 namespace misFITS {
 
@@ -41,15 +53,42 @@ namespace misFITS {
     // Constructors //
     ///////////
 
-    Table::Table( WeakFilePtr file, int hdu_num ) : HDU( file, hdu_num  ) {
+    Table::Table( WeakFilePtr file, int hdu_num ) :
+	HDU( file, hdu_num  ),
+	nrows_reserved_( 0 ),
+	nrows_growth_( 0 ),
+	nrows_committed_( 0 ),
+	track_datasum_( false ),
+	running_datasum_valid_( false ),
+	running_datasum_( 0 ),
+	checksum_stale_( false ) {
+
+	open_compressed();
 	refresh();
     }
 
-    Table::Table( WeakFilePtr file, const std::string& extname, int extver ) : HDU( file, extname, extver  ) {
+    Table::Table( WeakFilePtr file, const std::string& extname, int extver ) :
+	HDU( file, extname, extver  ),
+	nrows_reserved_( 0 ),
+	nrows_growth_( 0 ),
+	nrows_committed_( 0 ),
+	track_datasum_( false ),
+	running_datasum_valid_( false ),
+	running_datasum_( 0 ),
+	checksum_stale_( false ) {
+
+	open_compressed();
 	refresh();
     }
 
-    Table::Table( const std::string& extname, int extver ) {
+    Table::Table( const std::string& extname, int extver ) :
+	nrows_reserved_( 0 ),
+	nrows_growth_( 0 ),
+	nrows_committed_( 0 ),
+	track_datasum_( false ),
+	running_datasum_valid_( false ),
+	running_datasum_( 0 ),
+	checksum_stale_( false ) {
 
 	HDU_Type hdu_type = HDU_Type::BinaryTable;
 
@@ -65,9 +104,148 @@ namespace misFITS {
 	refresh();
     }
 
+    Table::~Table() {
+
+	SharedFilePtr file = file_.get();
+
+	// destructors shouldn't throw, and the file may already have
+	// been closed.
+	try {
+	    if ( ! view_ && ( nrows_reserved_ || checksum_stale_ ) && file && file->fptr() )
+		finish();
+	}
+	catch ( Exception& e ) {
+	    std::cerr << "misFITS::Table::~Table: error trimming reserved rows or writing checksum: " << e.what() << std::endl;
+	}
+
+	if ( file )
+	    file->pending_tables_.erase( this );
+
+	// recompressing a compressed table's modified tiles may fail,
+	// so it's only done by flushing the table or flushing or
+	// closing the file, where errors can be reported.  closing the
+	// view writes CFITSIO's buffers to it, after which it's known
+	// whether anything was modified.  if so, the changes are lost,
+	// and the file's next flush or close throws.
+	view_file_.reset();
+
+	if ( view_ && view_->dirty() ) {
+
+	    std::cerr << "misFITS::Table::~Table: changes to the tile compressed table in HDU " << hdu_num_
+		      << " were discarded; flush the table or file before destroying it" << std::endl;
+
+	    if ( file && file->fptr() )
+		file->discarded_tables_.push_back( hdu_num_ );
+	}
+
+	view_.reset();
+    }
+
+    void
+    Table::flush( const FlushMode& mode ) const {
+
+	finish();
+	file_->flush( mode );
+    }
+
+    //-----------------------------------------
+
+    void
+    Table::open_compressed() {
+
+	set_as_chdu();
+
+	if ( ! TiledTable::compressed( file_->fptr() ) )
+	    return;
+
+	view_.reset( new TiledTable::View( boost::bind( &Table::compressed_input, this ),
+					   Parallel::default_threads() ) );
+
+	int mode;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_file_mode( file_->fptr(), &mode, &status ) );
+
+	std::string url = Driver::source_url( view_.get() );
+	if ( mode == READWRITE && view_->writable() )
+	    view_file_ = open<Entity::File, Mode::ReadWrite>( url );
+	else
+	    view_file_ = open<Entity::File, Mode::ReadOnly>( url );
+
+	view_file_->move_to( 2 );
+
+	// the view is committed when the file is flushed or closed
+	update_pending();
+    }
+
+    // the compressed table, for the view to read tiles from
+    fitsfile*
+    Table::compressed_input() const {
+
+	SharedFilePtr file = file_.get();
+	if ( ! file || ! file->fptr() )
+	    throw Exception::CFITSIO( FILE_NOT_OPENED );
+
+	set_as_chdu();
+	return file->fptr();
+    }
+
+    // compress modified tiles back into the table
+    void
+    Table::write_compressed() const {
+
+	if ( ! view_ )
+	    return;
+
+	Trace::Span span( "Table::write_compressed", hdu_num_ );
+
+	trim_rows();
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_flush_buffer( view_file_->fptr(), 0, &status ) );
+
+	if ( ! view_->commit( view_file_->fptr() ) )
+	    return;
+
+	set_as_chdu();
+	if ( has_keyword( "CHECKSUM" ) ) {
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_write_chksum( file_->fptr(), &status ) );
+	}
+    }
+
+    // modified tiles are held in memory until they're committed, so
+    // commit them before they outgrow the view's cache
+    void
+    Table::limit_compressed() const {
+
+	if ( view_ && view_->pending() > view_->cache_size() )
+	    write_compressed();
+    }
+
+    void
+    Table::check_layout( const char* what ) const {
+
+	if ( view_ )
+	    throw Exception::Assert( std::string( "can't " ) + what + " a tile compressed table" );
+    }
+
+    fitsfile*
+    Table::data_fptr() const {
+
+	return view_ ? view_file_->fptr() : file_->fptr();
+    }
+
+    const File&
+    Table::data_file() const {
+
+	return view_ ? *view_file_ : *file_.get();
+    }
+
     void
     Table::refresh( ) {
 
+	Trace::Span span( "Table::refresh", hdu_num_ );
+
 	set_as_chdu();
 
 	// make sure we're really at a table
@@ -80,11 +258,28 @@ namespace misFITS {
 	Columns::size_type ncols = num_columns();
 	columns.clear();
 
+	column_index.clear();
+	descriptors_.clear();
+	has_heap_ = false;
+
 	LONGLONG offset = 1;
 	for ( Columns::size_type colnum = 1 ; colnum <= ncols ; colnum++ ) {
-	    columns.push_back( ColumnInfo( *file_.get(), colnum, offset ) );
+	    columns.push_back( ColumnInfo( data_file(), colnum, offset ) );
 	    offset += columns[colnum-1].nbytes;
+
+	    std::pair<ColumnIndex::iterator,bool> entry
+		= column_index.insert( std::make_pair( boost::algorithm::to_upper_copy( columns.back().ttype ),
+						       colnum ) );
+	    if ( ! entry.second )
+		entry.first->second = 0;
+
+	    has_heap_ = has_heap_ || columns.back().varlength;
 	}
+
+	rowlen_ = offset - 1;
+	running_datasum_valid_ = false;
+
+	span.arg( "columns", static_cast<LONGLONG>( ncols ) );
     }
 
 
@@ -93,15 +288,42 @@ namespace misFITS {
     ///////////////////////////
 
 
+    // exact names are looked up in the index.  templates with
+    // wildcards, or names which aren't unique, are left to CFITSIO so
+    // that its matching rules (and errors) apply.
+    Table::Columns::size_type
+    Table::find_column( const std::string& templt, int& status ) const {
+
+	if ( templt.find_first_of( "*?#" ) == std::string::npos ) {
+
+	    ColumnIndex::const_iterator entry
+		= column_index.find( boost::algorithm::to_upper_copy( templt ) );
+
+	    if ( entry == column_index.end() ) {
+		status = COL_NOT_FOUND;
+		return 0;
+	    }
+
+	    if ( entry->second )
+		return entry->second;
+	}
+
+	int colnum = 0;
+
+	set_as_chdu();
+	fits_get_colnum( data_fptr(), CASEINSEN, const_cast<char*>(templt.c_str()),
+			 &colnum, &status );
+
+	return static_cast<Columns::size_type>( colnum );
+    }
+
     bool
     Table::has_column( const std::string& templt ) const {
-	int colnum;
-	int status = 0;
 
-	set_as_chdu();
+	int status = 0;
+	find_column( templt, status );
 
-	return ! fits_get_colnum( file_->fptr(), CASEINSEN, const_cast<char*>(templt.c_str()),
-					   &colnum, &status );
+	return ! status;
     }
 
     const ColumnInfo&
@@ -111,19 +333,24 @@ namespace misFITS {
 
     const ColumnInfo&
     Table::colinfo( const string& colname ) const {
-	int colnum;
 
-	set_as_chdu();
+	int status = 0;
+	Columns::size_type colnum = find_column( colname, status );
 
-	misFITS_CHECK_CFITSIO_EXPR
-	    ( fits_get_colnum( file_->fptr(), 0, const_cast<char*>(colname.c_str()), &colnum, &status )
-	      );
-	return columns.at( static_cast<Columns::size_type>( colnum ) - 1);
+	if ( status )
+	    throw Exception::CFITSIO( status );
+
+	return columns.at( colnum - 1 );
     }
 
     Table&
     Table::add( const ColumnInfo& ci) {
 
+	Trace::Span span( "Table::add", hdu_num_ );
+	span.arg( "column", ci.ttype );
+
+	check_layout( "add a column to" );
+
 	ColumnInfo copy = ci;
 
 	set_as_chdu();
@@ -134,6 +361,7 @@ namespace misFITS {
 	copy.insert( *file_.get() );
 
 	refresh();
+	data_changed();
 
 	return *this;
     }
@@ -145,6 +373,11 @@ namespace misFITS {
 		const Extent& extent,
 		Columns::size_type colnum ) {
 
+	Trace::Span span( "Table::add", hdu_num_ );
+	span.arg( "column", ttype );
+
+	check_layout( "add a column to" );
+
 	set_as_chdu();
 
 	if ( colnum == 0 )
@@ -153,6 +386,32 @@ namespace misFITS {
 	ColumnInfo( ttype, column_type, tunit, extent, colnum ).insert( *file_.get() );
 
 	refresh();
+	data_changed();
+
+	return *this;
+    }
+
+    Table&
+    Table::add( const std::string& ttype,
+		ColumnType::ID::type column_type,
+		const VarLength& varlength,
+		const std::string& tunit,
+		Columns::size_type colnum ) {
+
+	Trace::Span span( "Table::add", hdu_num_ );
+	span.arg( "column", ttype );
+
+	check_layout( "add a column to" );
+
+	set_as_chdu();
+
+	if ( colnum == 0 )
+	    colnum = num_columns() + 1;
+
+	ColumnInfo( ttype, column_type, tunit, varlength, colnum ).insert( *file_.get() );
+
+	refresh();
+	data_changed();
 
 	return *this;
     }
@@ -160,6 +419,8 @@ namespace misFITS {
     void
     Table::resize( Columns::size_type colnum, const Extent& extent ) {
 
+	check_layout( "resize a column of" );
+
 	set_as_chdu();
 
 	ColumnInfo info = columns.at(colnum - 1);
@@ -200,6 +461,7 @@ namespace misFITS {
 	}
 
 	refresh();
+	data_changed();
     }
 
 
@@ -213,6 +475,11 @@ namespace misFITS {
     void
     Table::delete_column( Columns::size_type colnum ) {
 
+	Trace::Span span( "Table::delete_column", hdu_num_ );
+	span.arg( "colnum", static_cast<LONGLONG>( colnum ) );
+
+	check_layout( "delete a column of" );
+
 	set_as_chdu();
 
 	misFITS_CHECK_CFITSIO_EXPR
@@ -221,17 +488,13 @@ namespace misFITS {
 	     );
 
 	refresh();
+	data_changed();
     }
 
     void
     Table::delete_column( const std::string& name ) {
 
-	set_as_chdu();
-
-	misFITS_CHECK_CFITSIO_EXPR
-	    (
-	     fits_delete_col( file_->fptr(), static_cast<int>( colinfo(name).colnum ), &status )
-	     );
+	delete_column( colinfo(name).colnum );
     }
 
     Table::Columns::size_type
@@ -241,7 +504,7 @@ namespace misFITS {
 	set_as_chdu();
 
 	misFITS_CHECK_CFITSIO_EXPR
-	    ( fits_get_num_cols( file_->fptr(), &num_cols, &status )
+	    ( fits_get_num_cols( data_fptr(), &num_cols, &status )
 	      );
 
 	return static_cast<Columns::size_type>( num_cols );
@@ -280,6 +543,15 @@ namespace misFITS {
 	if ( names.empty() )
 	    return;
 
+	Trace::Span span( "Table::copy_columns", hdu_num_ );
+	span.arg( "dest_hdu", dest.hdu_num_ )
+	    .arg( "columns", static_cast<LONGLONG>( names.size() ) )
+	    .arg( "rows", num_rows() );
+
+	dest.check_layout( "copy columns into" );
+
+	trim_rows();
+	dest.trim_rows();
 	set_as_chdu();
 	dest.set_as_chdu();
 
@@ -372,7 +644,7 @@ namespace misFITS {
 	for( std::vector<ColumnInfo>::size_type idx = 0 ; idx < src_ci.size() ; ++idx ) {
 
 	    misFITS_CHECK_CFITSIO_EXPR
-		( fits_copy_col( file_->fptr(), dest.file_->fptr(),
+		( fits_copy_col( data_fptr(), dest.file_->fptr(),
 				 static_cast<int>( src_ci[idx].colnum ),
 				 static_cast<int>( dest.colinfo( src_ci[idx].ttype).colnum ),
 				 0,
@@ -381,6 +653,8 @@ namespace misFITS {
 
 	}
 
+	// CFITSIO doesn't know about the running datasum
+	dest.data_changed();
     }
 
     //-----------------------------------------
@@ -388,9 +662,12 @@ namespace misFITS {
     void
     Table::read_bytes( LONGLONG firstrow, LONGLONG offset, LONGLONG nbytes, unsigned char* data ) const {
 
+	Stats::Timer timer( file_->stats_, Stats::TblBytes );
+	file_->stats_.bytes_read += nbytes;
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
-	     fits_read_tblbytes( file_->fptr(), firstrow, offset,
+	     fits_read_tblbytes( data_fptr(), firstrow, offset,
 				 nbytes,
 				 data,
 				 &status )
@@ -400,58 +677,378 @@ namespace misFITS {
     void
     Table::write_bytes( LONGLONG firstrow, LONGLONG offset, LONGLONG nbytes, unsigned char* data ) const {
 
+	Stats::Timer timer( file_->stats_, Stats::TblBytes );
+	file_->stats_.bytes_written += nbytes;
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
-	     fits_write_tblbytes( file_->fptr(), firstrow, offset,
+	     fits_write_tblbytes( data_fptr(), firstrow, offset,
 				  nbytes,
 				  data,
 				  &status )
 	     );
     }
 
+    void
+    Table::append_rows( LONGLONG nrows, unsigned char* data ) {
+
+	if ( nrows <= 0 )
+	    return;
+
+	set_as_chdu();
+
+	LONGLONG firstrow = num_rows() + 1;
+
+	// the rows are appended to zeroes, so their sums can simply be
+	// added to the running datasum.
+	bool tracking = tracking_datasum();
+	unsigned long sum = tracking ? datasum() : 0;
+
+	extend_rows( firstrow - 1 + nrows );
+	write_bytes( firstrow, 1, nrows * rowlen_, data );
+
+	if ( tracking ) {
+
+	    running_datasum_ = Checksum::add( sum,
+					      Checksum::sum( data,
+							     static_cast<std::size_t>( nrows * rowlen_ ),
+							     ( firstrow - 1 ) * rowlen_ ) );
+	    running_datasum_valid_ = true;
+	    checksum_stale_ = true;
+	    update_pending();
+	}
+
+	file_->stats_.rows_written += nrows;
+	file_->wrote( nrows );
+
+	limit_compressed();
+    }
+
+
+    //-----------------------------------------
+
+    // the data must be in a single, fixed length cell
+    static bool
+    in_cell( const ColumnInfo& ci, LONGLONG firstelem, LONGLONG nelem ) {
+
+	return ! ci.varlength
+	    && nelem > 0
+	    && firstelem - 1 + nelem <= ci.nelem();
+    }
+
+    template< typename T >
+    bool
+    Table::read_decoded( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw, BitSet* valid ) const {
+
+	const ColumnInfo& ci = colinfo( colnum );
+
+	if ( ! in_cell( ci, firstelem, nelem ) )
+	    return false;
+
+	double tscal = raw ? 1.0 : ci.tscal;
+	double tzero = raw ? 0.0 : ci.tzero;
+
+	switch ( ci.column_type->id() ) {
+
+	case ColumnType::ID::Byte:
+	    return read_decoded<uint8_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero, valid );
+
+	case ColumnType::ID::Short:
+	    return read_decoded<int16_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero, valid );
+
+	case ColumnType::ID::Long:
+	    return read_decoded<int32_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero, valid );
+
+	case ColumnType::ID::LongLong:
+	    return read_decoded<int64_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero, valid );
+
+	case ColumnType::ID::Float:
+	    return read_decoded<float>( ci, firstrow, firstelem, nelem, data, tscal, tzero, valid );
+
+	case ColumnType::ID::Double:
+	    return read_decoded<double>( ci, firstrow, firstelem, nelem, data, tscal, tzero, valid );
+
+	default:
+	    return false;
+	}
+    }
+
+    template< typename S, typename T >
+    bool
+    Table::read_decoded( const ColumnInfo& ci, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, double tscal, double tzero, BitSet* valid ) const {
+
+	Decode::Kernel kernel = Decode::reader<S,T>( tscal, tzero );
+
+	if ( kernel == Decode::Kernel::None )
+	    return false;
+
+	std::size_t n = static_cast<std::size_t>( nelem );
+	std::size_t nbytes = n * sizeof( S );
+	if ( scratch_.size() < nbytes )
+	    scratch_.resize( nbytes );
+
+	read_bytes( firstrow, ci.offset + ( firstelem - 1 ) * sizeof( S ),
+		    static_cast<LONGLONG>( nbytes ), &scratch_[0] );
+
+	switch ( boost::native_value( kernel ) ) {
+
+	case Decode::Kernel::Convert:
+	    Decode::convert<S>( &scratch_[0], n, data );
+	    break;
+
+	case Decode::Kernel::Flip:
+	    Decode::flip<S>( &scratch_[0], n, data );
+	    break;
+
+	case Decode::Kernel::Scale:
+	    Decode::scale<S>( &scratch_[0], n, tscal, tzero, data );
+	    break;
+
+	default:
+	    throw Exception::Assert( "internal error: unknown decoding kernel" );
+	}
+
+	if ( valid ) {
+
+	    std::vector<byte_t> blocks( ( n + 7 ) / 8 );
+	    Decode::validity<S>( &scratch_[0], n, ci.has_tnull ? &ci.tnull : NULL, &blocks[0] );
+
+	    valid->resize( n );
+	    boost::from_block_range( blocks.begin(), blocks.end(), *valid );
+	}
+
+	return true;
+    }
+
+    template< typename T >
+    bool
+    Table::write_encoded( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw ) const {
+
+	const ColumnInfo& ci = colinfo( colnum );
+
+	if ( ! in_cell( ci, firstelem, nelem ) )
+	    return false;
+
+	double tscal = raw ? 1.0 : ci.tscal;
+	double tzero = raw ? 0.0 : ci.tzero;
+
+	switch ( ci.column_type->id() ) {
+
+	case ColumnType::ID::Byte:
+	    return write_encoded<T, uint8_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero );
+
+	case ColumnType::ID::Short:
+	    return write_encoded<T, int16_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero );
+
+	case ColumnType::ID::Long:
+	    return write_encoded<T, int32_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero );
+
+	case ColumnType::ID::LongLong:
+	    return write_encoded<T, int64_t>( ci, firstrow, firstelem, nelem, data, tscal, tzero );
+
+	case ColumnType::ID::Float:
+	    return write_encoded<T, float>( ci, firstrow, firstelem, nelem, data, tscal, tzero );
+
+	case ColumnType::ID::Double:
+	    return write_encoded<T, double>( ci, firstrow, firstelem, nelem, data, tscal, tzero );
+
+	default:
+	    return false;
+	}
+    }
+
+    template< typename T, typename S >
+    bool
+    Table::write_encoded( const ColumnInfo& ci, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, double tscal, double tzero ) const {
+
+	Decode::Kernel kernel = Decode::writer<T,S>( tscal, tzero );
+
+	if ( kernel == Decode::Kernel::None )
+	    return false;
+
+	std::size_t n = static_cast<std::size_t>( nelem );
+	std::size_t nbytes = n * sizeof( S );
+	if ( scratch_.size() < nbytes )
+	    scratch_.resize( nbytes );
+
+	switch ( boost::native_value( kernel ) ) {
+
+	case Decode::Kernel::Convert:
+	    Decode::unconvert<T,S>( data, n, &scratch_[0] );
+	    break;
+
+	case Decode::Kernel::Flip:
+	    Decode::unflip<T,S>( data, n, &scratch_[0] );
+	    break;
+
+	default:
+	    throw Exception::Assert( "internal error: unknown encoding kernel" );
+	}
+
+	write_bytes( firstrow, ci.offset + ( firstelem - 1 ) * sizeof( S ),
+		     static_cast<LONGLONG>( nbytes ), &scratch_[0] );
+
+	return true;
+    }
 
     //-----------------------------------------
 
+    // CFITSIO applies a column's scaling itself.  raw access
+    // temporarily replaces it with the identity.
+    class RawScaling {
+
+    public:
+	RawScaling( fitsfile* fptr, const ColumnInfo& ci, bool raw ) :
+	    fptr_( fptr ),
+	    ci_( ci ),
+	    active_( raw && ! ci.unscaled() ) {
+
+	    if ( active_ )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_set_tscale( fptr_, static_cast<int>( ci_.colnum ), 1.0, 0.0, &status ) );
+	}
+
+	~RawScaling() {
+
+	    if ( active_ ) {
+		int status = 0;
+		fits_set_tscale( fptr_, static_cast<int>( ci_.colnum ), ci_.tscal, ci_.tzero, &status );
+	    }
+	}
+
+    private:
+	fitsfile* fptr_;
+	const ColumnInfo& ci_;
+	bool active_;
+    };
+
     template<typename T>
-    void Table::read_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data ) const {
+    void Table::read_cfitsio( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw, BitSet* valid ) const {
 
-    	misFITS_CHECK_CFITSIO_EXPR
-    	    (
-    	     fits_read_col( file_->fptr(),
-    			    StorageCode<T>::type,
-    			    static_cast<int>( colnum ),
-    			    firstrow, firstelem,
-    			    nelem,
-    			    NULL,
-    			    data, NULL, &status)
-    	     );
+	RawScaling scaling( data_fptr(), colinfo( colnum ), raw );
 
+	Stats::Timer timer( file_->stats_, Stats::ReadCol );
+	file_->stats_.bytes_read += nelem * sizeof( T );
+
+	if ( ! valid ) {
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		(
+		 fits_read_col( data_fptr(),
+				StorageCode<T>::type,
+				static_cast<int>( colnum ),
+				firstrow, firstelem,
+				nelem,
+				NULL,
+				data, NULL, &status)
+		 );
+
+	    return;
+	}
+
+	std::vector<char> nulls( static_cast<std::size_t>( nelem ) );
+	int anynul;
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_read_colnull( data_fptr(),
+				StorageCode<T>::type,
+				static_cast<int>( colnum ),
+				firstrow, firstelem,
+				nelem,
+				data, &nulls[0], &anynul, &status)
+	     );
+
+	valid->resize( nulls.size() );
+	for ( std::vector<char>::size_type idx = 0 ; idx < nulls.size() ; ++idx )
+	    (*valid)[idx] = ! nulls[idx];
+    }
+
+    template<typename T>
+    void Table::read_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw, BitSet* valid ) const {
+
+	if ( ! read_decoded( colnum, firstrow, firstelem, nelem, data, raw, valid ) )
+	    read_cfitsio( colnum, firstrow, firstelem, nelem, data, raw, valid );
     }
 
 #define READ_COL(r,d,T) \
-    template void Table::read_col<T>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, T* data ) const;
+    template void Table::read_col<T>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, T* data, bool raw, BitSet* valid ) const;
 
     misFITS_INSTANTIATE_OVER_STORAGE_TYPES(READ_COL)
 
     //-----------------------------------------
 
     template<typename T>
-    void Table::write_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data ) const {
+    void Table::write_cfitsio( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw ) const {
+
+	if ( has_heap_ )
+	    descriptors_.erase( colnum );
+
+	RawScaling scaling( data_fptr(), colinfo( colnum ), raw );
+
+	Stats::Timer timer( file_->stats_, Stats::WriteCol );
+	file_->stats_.bytes_written += nelem * sizeof( T );
 
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
-	     fits_write_col( file_->fptr(),
+	     fits_write_col( data_fptr(),
 			     StorageCode<T>::type,
 			     static_cast<int>( colnum ),
 			     firstrow, firstelem,
 			     nelem,
 			     const_cast<T*>(data), &status)
 	     );
+    }
+
+    // CFITSIO writes TNULLn or NaN, as appropriate, into each run of
+    // undefined elements
+    void
+    Table::write_nulls( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const BitSet& valid ) const {
+
+	if ( static_cast<LONGLONG>( valid.size() ) != nelem )
+	    throw Exception::Assert( "validity bitmap for column '" + colinfo( colnum ).ttype
+				     + "' doesn't match the number of elements" );
 
+	if ( valid.count() == valid.size() )
+	    return;
+
+	Stats::Timer timer( file_->stats_, Stats::WriteCol );
+
+	for ( BitSet::size_type first = 0 ; first < valid.size() ; ++first ) {
+
+	    if ( valid[first] )
+		continue;
+
+	    BitSet::size_type last = first;
+	    while ( last + 1 < valid.size() && ! valid[last + 1] )
+		++last;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		(
+		 fits_write_col_null( data_fptr(),
+				      static_cast<int>( colnum ),
+				      firstrow,
+				      firstelem + static_cast<LONGLONG>( first ),
+				      static_cast<LONGLONG>( last - first + 1 ),
+				      &status )
+		 );
+
+	    first = last;
+	}
+    }
+
+    template<typename T>
+    void Table::write_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw, const BitSet* valid ) const {
+
+	if ( ! write_encoded( colnum, firstrow, firstelem, nelem, data, raw ) )
+	    write_cfitsio( colnum, firstrow, firstelem, nelem, data, raw );
+
+	if ( valid )
+	    write_nulls( colnum, firstrow, firstelem, nelem, *valid );
     }
 
 #define WRITE_COL(r,d,T) \
-    template void Table::write_col<T>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data ) const;
+    template void Table::write_col<T>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw, const BitSet* valid ) const;
 
     misFITS_INSTANTIATE_OVER_STORAGE_TYPES(WRITE_COL)
 
@@ -460,9 +1057,12 @@ namespace misFITS {
     template<>
     void Table::read_col<ColumnType::ID::Logical>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, NativeType<SC_BYTE>::storage_type* data ) const {
 
+	Stats::Timer timer( file_->stats_, Stats::ReadCol );
+	file_->stats_.bytes_read += nelem;
+
     	misFITS_CHECK_CFITSIO_EXPR
     	    (
-    	     fits_read_col( file_->fptr(),
+    	     fits_read_col( data_fptr(),
     			    static_cast<int>(ColumnType::ID::Logical),
     			    static_cast<int>( colnum ),
     			    firstrow, firstelem,
@@ -476,9 +1076,15 @@ namespace misFITS {
     template<>
     void Table::write_col<ColumnType::ID::Logical>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const NativeType<SC_BYTE>::storage_type* data ) const {
 
+	if ( has_heap_ )
+	    descriptors_.erase( colnum );
+
+	Stats::Timer timer( file_->stats_, Stats::WriteCol );
+	file_->stats_.bytes_written += nelem;
+
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
-	     fits_write_col( file_->fptr(),
+	     fits_write_col( data_fptr(),
 			     static_cast<int>(ColumnType::ID::Logical),
 			     static_cast<int>( colnum ),
 			     firstrow, firstelem,
@@ -489,6 +1095,92 @@ namespace misFITS {
     }
 
 
+    //-----------------------------------------
+
+    // layout of types which may be copied directly from a column
+    template< typename T > struct NativeLayout;
+
+    template<> struct NativeLayout< std::complex<float> > {
+	static const ColumnType::ID::type id = ColumnType::ID::Complex;
+	static const std::size_t word = sizeof( float );
+	static const std::size_t nwords = 2;
+    };
+
+    template<> struct NativeLayout< std::complex<double> > {
+	static const ColumnType::ID::type id = ColumnType::ID::DoubleComplex;
+	static const std::size_t word = sizeof( double );
+	static const std::size_t nwords = 2;
+    };
+
+    // the data must be in a single cell, and the column must be
+    // stored as the native type without scaling.
+    static bool
+    is_native( const ColumnInfo& ci, ColumnType::ID::type id, LONGLONG firstelem, LONGLONG nelem, bool raw ) {
+
+	return ci.column_type->id() == id
+	    && ( raw || ci.unscaled() )
+	    && in_cell( ci, firstelem, nelem );
+    }
+
+    template< typename T >
+    bool
+    Table::read_native( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw ) const {
+
+	const ColumnInfo& ci = colinfo( colnum );
+
+	if ( ! is_native( ci, NativeLayout<T>::id, firstelem, nelem, raw ) )
+	    return false;
+
+	read_bytes( firstrow, ci.offset + ( firstelem - 1 ) * sizeof( T ),
+		    nelem * sizeof( T ),
+		    reinterpret_cast<unsigned char*>( data ) );
+
+	ByteSwap::swap< NativeLayout<T>::word >( data, static_cast<std::size_t>( nelem ) * NativeLayout<T>::nwords );
+
+	return true;
+    }
+
+    template< typename T >
+    bool
+    Table::write_native( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw ) const {
+
+	const ColumnInfo& ci = colinfo( colnum );
+
+	if ( ! is_native( ci, NativeLayout<T>::id, firstelem, nelem, raw ) )
+	    return false;
+
+	std::size_t nbytes = static_cast<std::size_t>( nelem ) * sizeof( T );
+	if ( scratch_.size() < nbytes )
+	    scratch_.resize( nbytes );
+
+	ByteSwap::copy< NativeLayout<T>::word >( data, &scratch_[0], static_cast<std::size_t>( nelem ) * NativeLayout<T>::nwords );
+
+	write_bytes( firstrow, ci.offset + ( firstelem - 1 ) * sizeof( T ),
+		     static_cast<LONGLONG>( nbytes ), &scratch_[0] );
+
+	return true;
+    }
+
+#define COMPLEX_COL(r,d,T)						\
+    template<>								\
+    void Table::read_col<T>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw, BitSet* valid ) const { \
+									\
+	if ( valid || ! read_native( colnum, firstrow, firstelem, nelem, data, raw ) ) \
+	    read_cfitsio( colnum, firstrow, firstelem, nelem, data, raw, valid ); \
+    }									\
+									\
+    template<>								\
+    void Table::write_col<T>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw, const BitSet* valid ) const { \
+									\
+	if ( ! write_native( colnum, firstrow, firstelem, nelem, data, raw ) ) \
+	    write_cfitsio( colnum, firstrow, firstelem, nelem, data, raw ); \
+									\
+	if ( valid )							\
+	    write_nulls( colnum, firstrow, firstelem, nelem, *valid );	\
+    }
+
+    BOOST_PP_SEQ_FOR_EACH( COMPLEX_COL, ~, (std::complex<float>)(std::complex<double>) )
+
     //-----------------------------------------
 
     ////////////////////////
@@ -510,10 +1202,152 @@ namespace misFITS {
 
 	misFITS_CHECK_CFITSIO_EXPR
 	    (
-	     fits_get_num_rowsll( file_->fptr(), &num_rows, &status )
+	     fits_get_num_rowsll( data_fptr(), &num_rows, &status )
+	     );
+
+	return num_rows - nrows_reserved_;
+    }
+
+    void
+    Table::reserve_rows( LONGLONG nrows ) {
+
+	LONGLONG nrows_alloc = num_rows() + nrows_reserved_;
+
+	if ( nrows <= nrows_alloc )
+	    return;
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_insert_rows( data_fptr(), nrows_alloc, nrows - nrows_alloc, &status )
+	     );
+
+	nrows_reserved_ += nrows - nrows_alloc;
+	update_pending();
+    }
+
+    void
+    Table::extend_rows( LONGLONG nrows ) {
+
+	LONGLONG nrows_now = num_rows();
+
+	if ( nrows <= nrows_now )
+	    return;
+
+	// at least double the number of rows, so that the data unit
+	// is extended O(log N) times rather than O(N), unless commits
+	// limit the growth.  a compressed table's view has nothing
+	// after its rows to move, and reserved rows would only be
+	// written back as zeroes.
+	LONGLONG nrows_alloc = nrows_now + nrows_reserved_;
+
+	if ( nrows > nrows_alloc ) {
+
+	    LONGLONG target = std::max( nrows, 2 * nrows_alloc );
+	    if ( nrows_growth_ )
+		target = std::min( target, std::max( nrows, nrows_alloc + nrows_growth_ ) );
+
+	    reserve_rows( view_ ? nrows : target );
+	}
+
+	nrows_reserved_ -= nrows - nrows_now;
+    }
+
+    void
+    Table::trim_rows() const {
+
+	if ( ! nrows_reserved_ )
+	    return;
+
+	LONGLONG nrows = num_rows();
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_delete_rows( data_fptr(), nrows + 1, nrows_reserved_, &status )
 	     );
 
-	return num_rows;
+	nrows_reserved_ = 0;
+	descriptors_.clear();
+	update_pending();
+    }
+
+    void
+    Table::commit_rows() const {
+
+	if ( ! nrows_reserved_ )
+	    return;
+
+	LONGLONG nrows = num_rows();
+	nrows_growth_ = std::max( nrows - nrows_committed_, static_cast<LONGLONG>( 1 ) );
+	nrows_committed_ = nrows;
+
+	trim_rows();
+    }
+
+    void
+    Table::finish() const {
+
+	trim_rows();
+	write_compressed();
+
+	if ( checksum_stale_ )
+	    write_checksum();
+    }
+
+    void
+    Table::update_pending() const {
+
+	if ( nrows_reserved_ || checksum_stale_ || view_ )
+	    file_->pending_tables_.insert( this );
+	else
+	    file_->pending_tables_.erase( this );
+    }
+
+    //-----------------------------------------
+
+    // descriptors are read for this many rows at a time
+    static const LONGLONG DescriptorBlock = 1024;
+
+    LONGLONG
+    Table::cell_length( Columns::size_type colnum, LONGLONG row ) const {
+
+	Descriptors& desc = descriptors_[colnum];
+
+	if (    desc.length.empty()
+	     || row < desc.firstrow
+	     || row >= desc.firstrow + static_cast<LONGLONG>( desc.length.size() ) ) {
+
+	    LONGLONG nrows = std::min( DescriptorBlock, num_rows() - row + 1 );
+
+	    if ( nrows < 1 )
+		throw Exception::CFITSIO( BAD_ROW_NUM );
+
+	    desc.firstrow = row;
+	    desc.length.resize( static_cast<std::size_t>( nrows ) );
+	    desc.heapaddr.resize( static_cast<std::size_t>( nrows ) );
+
+	    set_as_chdu();
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		(
+		 fits_read_descriptsll( data_fptr(), static_cast<int>( colnum ),
+					row, nrows,
+					&desc.length[0], &desc.heapaddr[0],
+					&status )
+		 );
+	}
+
+	return desc.length[ static_cast<std::size_t>( row - desc.firstrow ) ];
+    }
+
+    void
+    Table::clear_cell( Columns::size_type colnum, LONGLONG row ) const {
+
+	descriptors_.erase( colnum );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    (
+	     fits_write_descript( data_fptr(), static_cast<int>( colnum ), row, 0, 0, &status )
+	     );
     }
 
     ///////////////////////////
@@ -525,12 +1359,18 @@ namespace misFITS {
     TablePtr
     Table::copy( misFITS::FilePtr& ofile, const TableCopy& what, int morekeys ) const {
 
+	Trace::Span span( "Table::copy", hdu_num_ );
+	span.arg( "file", ofile->file );
+
+	finish();
 	set_as_chdu();
 
 	switch( boost::native_value( what ) ) {
 
+	// the header of a compressed table as it's seen, rather than
+	// as it's stored
 	case TableCopy::Header :
-	    file_->copy( ofile, FileCopy::CurrentHeader );
+	    data_file().copy( ofile, FileCopy::CurrentHeader );
 	    break;
 
 	case TableCopy::HDU :
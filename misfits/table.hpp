@@ -22,10 +22,12 @@
 #ifndef misFITS_TABLE_H
 #define misFITS_TABLE_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 #include <boost/core/scoped_enum.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <misfits/fits.hpp>
 #include <misfits/hdu.hpp>
@@ -36,9 +38,16 @@
 
 #include <misfits/row_entry_fwd.hpp>
 
+// Arrow C data interface; see misfits/arrow.hpp
+struct ArrowSchema;
+struct ArrowArray;
+
 namespace misFITS {
 
     class Row;
+    class StreamWriter;
+
+    namespace TiledTable { class View; }
 
     BOOST_SCOPED_ENUM_DECLARE_BEGIN( TableCopy )
     {
@@ -65,6 +74,10 @@ namespace misFITS {
 
 	template<typename T> friend class RowEntry::Column;
 
+	friend class File;
+	friend class Row;
+	friend class StreamWriter;
+
 
     public:
 
@@ -74,6 +87,8 @@ namespace misFITS {
 	Table( WeakFilePtr file, int hdu_num = 0 );
 	Table( WeakFilePtr file, const std::string& extname, int extver = 1 );
 
+	virtual ~Table();
+
 	const ColumnInfo& colinfo( Columns::size_type colnum ) const;
 	const ColumnInfo& colinfo( const std::string& name ) const;
 
@@ -96,15 +111,20 @@ namespace misFITS {
 	    return add( ttype, typecode, "", extent, colnum );
 	}
 
+	// add a variable length array column
+	Table& add( const std::string& ttype,
+		    ColumnType::ID::type typecode,
+		    const VarLength& varlength,
+		    const std::string& tunit = "",
+		    Columns::size_type colnum = 0);
+
 	void resize( Columns::size_type colnum, const Extent& extent );
 	void resize( const std::string& name, const Extent& extent );
 
 	Columns::size_type num_columns() const;
 	LONGLONG num_rows() const;
 
-	void flush ( const FlushMode& mode = FlushMode::File ) const {
-	    file_->flush( mode );
-	};
+	void flush ( const FlushMode& mode = FlushMode::File ) const;
 
 	bool has_column( const std::string& templt )  const;
 	bool exists_column( const std::string& templt )  const {
@@ -124,13 +144,82 @@ namespace misFITS {
 
 	misFITS::Row row();
 
+	// make room for at least nrows rows without further extending
+	// the data unit. rows beyond the end of the table are reserved
+	// rather than added; unused ones are removed when the table or
+	// its file is flushed, when the table is copied or destroyed,
+	// and when the file is closed.
+	void reserve_rows( LONGLONG nrows );
+
+	// keep a running DATASUM as rows are written via Row, so that
+	// the CHECKSUM and DATASUM keywords can be written without
+	// reading the data unit.  the keywords are updated whenever
+	// the reserved rows are removed.  the sums of tables with a
+	// heap are left to CFITSIO.  defined in checksum.cc
+	void track_datasum( bool flag = true );
+	bool tracks_datasum() const { return track_datasum_; }
+
+	// write the CHECKSUM and DATASUM keywords
+	void write_checksum() const;
+
+	// export nrows rows, starting at firstrow, of the named columns
+	// (all of them, if none are named) as an Arrow struct array. a
+	// negative nrows exports the remainder of the table.  the
+	// caller owns the results and must release them via their
+	// release callbacks.  defined in arrow.cc
+	void export_arrow( ArrowSchema* schema, ArrowArray* array,
+			   LONGLONG firstrow = 1, LONGLONG nrows = -1,
+			   const std::vector<std::string>& names = std::vector<std::string>() ) const;
+
+	// append the rows of this table to dest, which must have the
+	// same columns, in order of the named columns.  the sort is
+	// stable.  sorted runs of rows which fit in memory_budget are
+	// written to temporary files in $TMPDIR using nthreads threads
+	// (one per processor if zero), and then merged, so the table
+	// may be larger than memory.  key columns must be scalar
+	// numeric, logical, bit or string columns; tables with
+	// variable length array columns can't be sorted.  defined in
+	// sort.cc
+	void sort_by( const std::vector<std::string>& names, Table& dest,
+		      std::size_t memory_budget = 256 << 20,
+		      unsigned int nthreads = 0 ) const;
+
+	// append the rows of the inputs, each of which must already be
+	// sorted by the named columns and have the same columns as this
+	// table, in a single sorted pass.  the blocks of rows read from
+	// the inputs and the output batch share memory_budget.  rows
+	// with equal keys are taken from the inputs in order.
+	//
+	// if prefetch is true, each input has a thread which reads its
+	// next block while earlier ones are merged.  inputs in
+	// different files are then read concurrently with each other
+	// and with the writes to this table, so CFITSIO must have been
+	// built to be reentrant; otherwise, all reads are done in the
+	// calling thread.  defined in sort.cc
+	void merge_sorted( const std::vector<TablePtr>& inputs,
+			   const std::vector<std::string>& names,
+			   std::size_t memory_budget = 64 << 20,
+			   bool prefetch = true );
+
 
     private:
 
+	// if raw is true, the column's TSCALn and TZEROn are ignored.
+	// if valid is not NULL, it records which elements are defined
+	// (bit set) and which are null (TNULLn or NaN).
 	template< typename T>
-	void read_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, T* data ) const;
+	void read_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, T* data, bool raw = false, BitSet* valid = NULL ) const;
 	template< typename T>
-	void write_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, const T* data ) const;
+	void write_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, const T* data, bool raw = false, const BitSet* valid = NULL ) const;
+
+	// the general case, via CFITSIO
+	template< typename T>
+	void read_cfitsio( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, T* data, bool raw, BitSet* valid ) const;
+	template< typename T>
+	void write_cfitsio( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, const T* data, bool raw ) const;
+
+	// mark the elements which aren't valid as null
+	void write_nulls( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const BitSet& valid ) const;
 
 	// in rare cases (i.e. TLOGICAL), can't uniquely map CFITSIO storage type to required datatype
 	template< ColumnType::ID::type T>
@@ -139,9 +228,90 @@ namespace misFITS {
 	template< ColumnType::ID::type T>
 	void write_col( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem_, const NativeType<SC_BYTE>::storage_type* data ) const;
 
+	// look up a column by name or template; sets status (to
+	// COL_NOT_FOUND, etc.) if there's no unique match
+	Columns::size_type find_column( const std::string& templt, int& status ) const;
+
+	// move data between a column and memory without going through
+	// CFITSIO's type conversion machinery.  returns false if the
+	// column's type or scaling requires a conversion.
+	template< typename T >
+	bool read_native( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw ) const;
+	template< typename T >
+	bool write_native( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw ) const;
+
+	// move numeric data between a column and memory, byte swapping,
+	// converting and scaling in a single pass.  returns false if
+	// the conversion requires CFITSIO's range checking.
+	template< typename T >
+	bool read_decoded( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, bool raw, BitSet* valid ) const;
+	template< typename S, typename T >
+	bool read_decoded( const ColumnInfo& ci, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, T* data, double tscal, double tzero, BitSet* valid ) const;
+	template< typename T >
+	bool write_encoded( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, bool raw ) const;
+	template< typename T, typename S >
+	bool write_encoded( const ColumnInfo& ci, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const T* data, double tscal, double tzero ) const;
+
+	// number of elements in a variable length array cell
+	LONGLONG cell_length( Columns::size_type colnum, LONGLONG row ) const;
+
+	// empty a variable length array cell
+	void clear_cell( Columns::size_type colnum, LONGLONG row ) const;
+
+	// make sure there are at least nrows rows in the table, and
+	// delete any rows reserved in anticipation of more.
+	void extend_rows( LONGLONG nrows );
+	void trim_rows() const;
+
+	// trim reserved rows and update stale checksums, and keep the
+	// file's list of tables for which that's required up to date
+	void finish() const;
+	void update_pending() const;
+
+	// give up reserved rows for a commit; see nrows_growth_
+	void commit_rows() const;
+
+	// the running datasum, and its upkeep by Row::write
+	unsigned long datasum() const;
+	unsigned long row_datasum( LONGLONG row ) const;
+	unsigned long header_sum() const;
+	void datasum_remove( LONGLONG row ) const;
+	void datasum_add( LONGLONG row ) const;
+	void data_changed() const;
+	bool tracking_datasum() const { return track_datasum_ && ! has_heap_; }
+
+	// tile compressed tables are read and written through a view
+	// which decompresses tiles as they're needed.  modified tiles
+	// are compressed back into the table when it's flushed or
+	// finished, or once they'd take more memory than the view's
+	// cache.  the table's layout can't be changed.
+	void open_compressed();
+	fitsfile* compressed_input() const;
+	void write_compressed() const;
+	void limit_compressed() const;
+	void check_layout( const char* what ) const;
+
+	// where the table's rows are; the view of a tile compressed
+	// table, otherwise the table itself
+	fitsfile* data_fptr() const;
+	const File& data_file() const;
+
 	void read_bytes( LONGLONG firstrow, LONGLONG offset, LONGLONG nbytes, unsigned char* data ) const;
 	void write_bytes( LONGLONG firstrow, LONGLONG offset, LONGLONG nbytes, unsigned char* data ) const;
 
+	// append whole rows in FITS format, keeping the running datasum
+	void append_rows( LONGLONG nrows, unsigned char* data );
+
+	// the stages of sort_by and merge_sorted; defined in sort.cc
+	class SortRun;
+	class SortOutput;
+	class MergeInput;
+
+	// throw unless other's rows have the same layout as this
+	// table's and neither has a heap, so that rows may be copied
+	// between them byte for byte
+	void check_row_layout( const Table& other ) const;
+
     protected:
 
 	// disable default copy constructors
@@ -151,10 +321,68 @@ namespace misFITS {
 	LONGLONG row_idx_;
 	Columns columns;
 
+	// upper-cased TTYPE => column number.  a column number of zero
+	// marks a name shared by more than one column.
+	typedef boost::unordered_map<std::string, Columns::size_type> ColumnIndex;
+	ColumnIndex column_index;
+
+	// true if any of the columns store their data in the heap
+	bool has_heap_;
+
+	// width of a row, in bytes
+	LONGLONG rowlen_;
+
+	// extending a table may shift its heap and any following HDUs,
+	// so rows are appended in increasingly large blocks. these are
+	// the trailing rows which haven't been written to yet.
+	mutable LONGLONG nrows_reserved_;
+
+	// a commit gives up the reserved rows, so that the header
+	// written describes only the rows written.  after that, no more
+	// rows are reserved at a time than were appended between the
+	// last two commits (nrows_growth_), so that frequent commits
+	// don't repeatedly insert and delete large blocks.  zero until
+	// the first commit.
+	mutable LONGLONG nrows_growth_;
+	mutable LONGLONG nrows_committed_;
+
+	// descriptors of variable length array cells are read in blocks
+	// of rows.
+	struct Descriptors {
+	    LONGLONG firstrow;
+	    std::vector<LONGLONG> length;
+	    std::vector<LONGLONG> heapaddr;
+	};
+	typedef boost::unordered_map<Columns::size_type, Descriptors> DescriptorCache;
+	mutable DescriptorCache descriptors_;
+
+	// staging area for byte swapping on output
+	mutable std::vector<unsigned char> scratch_;
+
+	// the decompressed view of a tile compressed table, and the
+	// file CFITSIO accesses it through, which must be closed
+	// before the view is destroyed
+	shared_ptr<TiledTable::View> view_;
+	FilePtr view_file_;
+
+	// the running datasum; it's invalidated when the layout of the
+	// table changes.  the CHECKSUM and DATASUM keywords are stale
+	// if rows have been written since they were last updated.
+	bool track_datasum_;
+	mutable bool running_datasum_valid_;
+	mutable unsigned long running_datasum_;
+	mutable bool checksum_stale_;
+
     };
 
     template<> void Table::read_col<ColumnType::ID::Logical>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, NativeType<SC_BYTE>::storage_type* data ) const;
     template<> void Table::write_col<ColumnType::ID::Logical>( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const NativeType<SC_BYTE>::storage_type* data ) const;
+
+    // complex values are copied directly when possible
+    template<> void Table::read_col< std::complex<float> >( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, std::complex<float>* data, bool raw, BitSet* valid ) const;
+    template<> void Table::read_col< std::complex<double> >( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, std::complex<double>* data, bool raw, BitSet* valid ) const;
+    template<> void Table::write_col< std::complex<float> >( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const std::complex<float>* data, bool raw, const BitSet* valid ) const;
+    template<> void Table::write_col< std::complex<double> >( Columns::size_type colnum, LONGLONG firstrow, LONGLONG firstelem, LONGLONG nelem, const std::complex<double>* data, bool raw, const BitSet* valid ) const;
 }
 
 
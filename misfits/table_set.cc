@@ -0,0 +1,484 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <misfits/table_set.hpp>
+
+#include "parallel.hpp"
+
+namespace misFITS {
+
+    namespace {
+
+	// scan one member per task
+	struct ScanTask {
+
+	    ScanTask( const TableSet& set, TableSet::Scanner& scanner ) :
+		set( set ),
+		scanner( scanner ) {}
+
+	    void operator()( std::size_t member ) {
+
+		// hold the file so the member can't be closed by
+		// another thread while it's being scanned
+		FilePtr file = set.file( member );
+		TablePtr table = set.table( member );
+		scanner( member, *table );
+	    }
+
+	    const TableSet& set;
+	    TableSet::Scanner& scanner;
+	};
+    }
+
+    //////////////
+    // TableSet //
+    //////////////
+
+    TableSet::TableSet( const std::vector<std::string>& files,
+			const std::string& extname,
+			std::size_t max_open ) :
+	extname_( extname ),
+	max_open_( std::max( max_open, std::size_t( 1 ) ) ),
+	have_schema_( false ),
+	schema_member_( 0 ) {
+
+	if ( files.empty() )
+	    throw Exception::Assert( "a table set requires at least one file" );
+
+	members_.reserve( files.size() );
+
+	for ( std::vector<std::string>::const_iterator file = files.begin() ; file != files.end() ; ++file )
+	    members_.push_back( Member( *file ) );
+
+	starts_.reserve( files.size() + 1 );
+	starts_.push_back( 1 );
+    }
+
+    const std::string&
+    TableSet::member_file( std::size_t member ) const {
+	return members_.at( member ).file;
+    }
+
+    LONGLONG
+    TableSet::num_rows() const {
+
+	return start( members_.size() ) - 1;
+    }
+
+    LONGLONG
+    TableSet::member_rows( std::size_t member ) const {
+
+	{
+	    boost::lock_guard<boost::mutex> lock( mutex_ );
+
+	    if ( members_.at( member ).nrows >= 0 )
+		return members_[member].nrows;
+	}
+
+	FilePtr file;
+	TablePtr table;
+	acquire( member, file, table );
+
+	return table->num_rows();
+    }
+
+    LONGLONG
+    TableSet::first_row( std::size_t member ) const {
+
+	if ( member >= members_.size() )
+	    throw Exception::Assert( "table set member index is out of range" );
+
+	return start( member );
+    }
+
+    std::pair<std::size_t, LONGLONG>
+    TableSet::locate( LONGLONG row ) const {
+
+	if ( row < 1 )
+	    throw Exception::Assert( "table set row indices start at 1" );
+
+	for (;;) {
+
+	    std::size_t known;
+
+	    {
+		boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		if ( row < starts_.back() ) {
+
+		    // empty members share their start with the next
+		    // member; upper_bound skips past them
+		    std::size_t member
+			= std::upper_bound( starts_.begin(), starts_.end(), row ) - starts_.begin() - 1;
+
+		    return std::make_pair( member, row - starts_[member] + 1 );
+		}
+
+		known = starts_.size() - 1;
+
+		if ( known == members_.size() )
+		    return std::make_pair( known, row - starts_.back() + 1 );
+	    }
+
+	    extend_starts( known );
+	}
+    }
+
+    FilePtr
+    TableSet::file( std::size_t member ) const {
+
+	FilePtr file;
+	TablePtr table;
+	acquire( member, file, table );
+
+	return file;
+    }
+
+    TablePtr
+    TableSet::table( std::size_t member ) const {
+
+	FilePtr file;
+	TablePtr table;
+	acquire( member, file, table );
+
+	return table;
+    }
+
+    std::size_t
+    TableSet::num_open() const {
+
+	boost::lock_guard<boost::mutex> lock( mutex_ );
+	return open_.size();
+    }
+
+    Table::Columns::size_type
+    TableSet::num_columns() const {
+
+	load_schema();
+	return schema_.size();
+    }
+
+    const ColumnInfo&
+    TableSet::colinfo( Table::Columns::size_type colnum ) const {
+
+	load_schema();
+	return schema_.at( colnum - 1 );
+    }
+
+    const ColumnInfo&
+    TableSet::colinfo( const std::string& name ) const {
+
+	load_schema();
+
+	for ( Table::Columns::const_iterator col = schema_.begin() ; col != schema_.end() ; ++col )
+	    if ( boost::algorithm::iequals( col->ttype, name ) )
+		return *col;
+
+	throw Exception::Assert( "table set has no column named '" + name + "'" );
+    }
+
+    void
+    TableSet::scan( Scanner& scanner, unsigned int nthreads ) const {
+
+	ScanTask task( *this, scanner );
+
+	Parallel::for_each( members_.size(),
+			    nthreads ? nthreads : Parallel::default_threads(),
+			    task );
+    }
+
+    void
+    TableSet::acquire( std::size_t member, FilePtr& file, TablePtr& table ) const {
+
+	std::string spec;
+
+	{
+	    boost::lock_guard<boost::mutex> lock( mutex_ );
+
+	    Member& m = members_.at( member );
+
+	    if ( m.table ) {
+		touch( member );
+		file = m.fileptr;
+		table = m.table;
+		evict();
+		return;
+	    }
+
+	    spec = m.file;
+	}
+
+	// open without holding the lock, so that other threads can
+	// open other members in the meantime
+	FilePtr newfile;
+	TablePtr newtable;
+
+	if ( extname_.empty() ) {
+	    newfile = open<Entity::Table, Mode::ReadOnly>( spec );
+	    newtable = newfile->table();
+	}
+
+	else {
+	    newfile = open<Entity::File, Mode::ReadOnly>( spec );
+	    newtable = newfile->table( extname_ );
+	}
+
+	check_schema( member, *newtable );
+
+	boost::lock_guard<boost::mutex> lock( mutex_ );
+
+	Member& m = members_[member];
+
+	// another thread got there first; use its copy and discard
+	// ours.
+	if ( m.table ) {
+	    touch( member );
+	    file = m.fileptr;
+	    table = m.table;
+	    evict();
+	    return;
+	}
+
+	m.fileptr = newfile;
+	m.table = newtable;
+	m.nrows = newtable->num_rows();
+	open_.push_front( member );
+
+	file = newfile;
+	table = newtable;
+
+	evict();
+    }
+
+    void
+    TableSet::check_schema( std::size_t member, const Table& table ) const {
+
+	boost::lock_guard<boost::mutex> lock( mutex_ );
+
+	if ( ! have_schema_ ) {
+
+	    for ( Table::Columns::size_type colnum = 1 ; colnum <= table.num_columns() ; ++colnum )
+		schema_.push_back( table.colinfo( colnum ) );
+
+	    schema_member_ = member;
+	    have_schema_ = true;
+	    return;
+	}
+
+	std::string error = "table in '" + members_[member].file
+	    + "' doesn't match that in '" + members_[schema_member_].file + "': ";
+
+	if ( table.num_columns() != schema_.size() )
+	    throw Exception::Assert( error + "different number of columns" );
+
+	for ( Table::Columns::size_type idx = 0 ; idx < schema_.size() ; ++idx ) {
+
+	    const ColumnInfo& expected = schema_[idx];
+	    const ColumnInfo& got = table.colinfo( idx + 1 );
+
+	    if ( ! boost::algorithm::iequals( expected.ttype, got.ttype )
+		 || expected != got
+		 || expected.tform() != got.tform() )
+		throw Exception::Assert( error + "column " + expected.ttype + " differs" );
+	}
+    }
+
+    void
+    TableSet::touch( std::size_t member ) const {
+
+	open_.remove( member );
+	open_.push_front( member );
+    }
+
+    void
+    TableSet::evict() const {
+
+	std::list<std::size_t>::iterator idx = open_.end();
+
+	while ( open_.size() > max_open_ && idx != open_.begin() ) {
+
+	    --idx;
+
+	    Member& m = members_[*idx];
+
+	    // in use elsewhere
+	    if ( m.table.use_count() > 1 || m.fileptr.use_count() > 1 )
+		continue;
+
+	    // the table refers to the file, so must go first
+	    m.table.reset();
+	    m.fileptr.reset();
+
+	    idx = open_.erase( idx );
+	}
+    }
+
+    LONGLONG
+    TableSet::start( std::size_t member ) const {
+
+	for (;;) {
+
+	    std::size_t known;
+
+	    {
+		boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		if ( member < starts_.size() )
+		    return starts_[member];
+
+		known = starts_.size() - 1;
+	    }
+
+	    extend_starts( known );
+	}
+    }
+
+    void
+    TableSet::extend_starts( std::size_t member ) const {
+
+	// this may open the member, so mustn't hold the lock
+	LONGLONG nrows = member_rows( member );
+
+	boost::lock_guard<boost::mutex> lock( mutex_ );
+
+	// another thread may have got there first
+	if ( starts_.size() == member + 1 )
+	    starts_.push_back( starts_.back() + nrows );
+    }
+
+    void
+    TableSet::load_schema() const {
+
+	{
+	    boost::lock_guard<boost::mutex> lock( mutex_ );
+
+	    if ( have_schema_ )
+		return;
+	}
+
+	FilePtr file;
+	TablePtr table;
+	acquire( 0, file, table );
+    }
+
+    /////////////////
+    // TableSetRow //
+    /////////////////
+
+    TableSetRow::TableSetRow( const TableSet& set ) :
+	set_( set ),
+	raw_( false ),
+	member_( 0 ) {}
+
+    TableSetRow&
+    TableSetRow::bind( const std::string& column_name, Binding* binding ) {
+
+	shared_ptr<Binding> ptr( binding );
+
+	// throws if there's no such column
+	set_.colinfo( column_name );
+
+	bindings_.push_back( ptr );
+
+	if ( row_ )
+	    ptr->bind( *row_ );
+
+	return *this;
+    }
+
+    void
+    TableSetRow::attach( std::size_t member ) {
+
+	if ( row_ && member == member_ )
+	    return;
+
+	// release the current member first, so it may be closed if
+	// the new one needs its place
+	row_.reset();
+	table_.reset();
+	file_.reset();
+
+	file_ = set_.file( member );
+	table_ = set_.table( member );
+
+	row_.reset( new Row( table_ ) );
+	row_->raw( raw_ );
+	member_ = member;
+
+	for ( std::vector< shared_ptr<Binding> >::iterator binding = bindings_.begin() ; binding != bindings_.end() ; ++binding )
+	    (*binding)->bind( *row_ );
+    }
+
+    bool
+    TableSetRow::read() {
+
+	if ( ! row_ )
+	    attach( member_ );
+
+	while ( ! row_->read() ) {
+
+	    if ( member_ + 1 >= set_.num_members() )
+		return false;
+
+	    attach( member_ + 1 );
+	}
+
+	return true;
+    }
+
+    bool
+    TableSetRow::read( LONGLONG row ) {
+
+	std::pair<std::size_t, LONGLONG> where = set_.locate( row );
+
+	if ( where.first == set_.num_members() )
+	    return false;
+
+	attach( where.first );
+
+	return row_->read( where.second );
+    }
+
+    LONGLONG
+    TableSetRow::idx() const {
+
+	if ( ! row_ )
+	    return 1;
+
+	return set_.first_row( member_ ) + row_->idx() - 1;
+    }
+
+    bool
+    TableSetRow::raw( bool flag ) {
+
+	raw_ = flag;
+
+	if ( row_ )
+	    row_->raw( raw_ );
+
+	return raw_;
+    }
+}
@@ -0,0 +1,268 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+#ifndef misFITS_TABLE_SET_H
+#define misFITS_TABLE_SET_H
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <misfits/fits.hpp>
+#include <misfits/table.hpp>
+#include <misfits/row.hpp>
+
+namespace misFITS {
+
+    // A read only view of the tables in many files, which must share
+    // the same columns, as a single table.  Rows are numbered
+    // globally, starting at 1 with the first row of the first
+    // member.
+    //
+    // Members are opened when they're first needed, and at most
+    // max_open of them are kept open; the least recently used are
+    // closed as others are opened.  Members which are in use, i.e.
+    // whose file or table is still referenced elsewhere, aren't
+    // closed, so the limit may be exceeded while they're held.
+    //
+    //    std::vector<std::string> files = ...;
+    //    TableSet set( files, "EVENTS" );
+    //
+    //    TableSetRow row( set );
+    //    row.add( "X", &x ).add( "Y", &y );
+    //    while ( row.read() )
+    //        ...;
+
+    class TableSet : boost::noncopyable {
+
+    public:
+
+	// process the members of the set in parallel.  operator() is
+	// called once per member, possibly concurrently for different
+	// members, so it must be thread safe.
+	class Scanner {
+	public:
+	    virtual ~Scanner() {}
+	    virtual void operator()( std::size_t member, Table& table ) = 0;
+	};
+
+	// the table is the one named extname, or the first binary
+	// table in each file if extname is empty.
+	TableSet( const std::vector<std::string>& files,
+		  const std::string& extname = "",
+		  std::size_t max_open = 64 );
+
+	std::size_t num_members() const { return members_.size(); }
+	const std::string& member_file( std::size_t member ) const;
+
+	// the number of rows in the set; this opens every member
+	// whose length isn't yet known.
+	LONGLONG num_rows() const;
+
+	// the number of rows in a member, and the global index of its
+	// first row
+	LONGLONG member_rows( std::size_t member ) const;
+	LONGLONG first_row( std::size_t member ) const;
+
+	// the member holding a global row and the row's index within
+	// the member's table.  if the row is past the end of the set
+	// the member is num_members().
+	std::pair<std::size_t, LONGLONG> locate( LONGLONG row ) const;
+
+	// a member's file and table, opening it if necessary.  the
+	// table is usable only while its file is open; hold on to
+	// either to keep the member from being closed.
+	FilePtr file( std::size_t member ) const;
+	TablePtr table( std::size_t member ) const;
+
+	// the number of members currently open
+	std::size_t num_open() const;
+
+	// the columns shared by the members; this opens the first
+	// member if none are open.
+	Table::Columns::size_type num_columns() const;
+	const ColumnInfo& colinfo( Table::Columns::size_type colnum ) const;
+	const ColumnInfo& colinfo( const std::string& name ) const;
+
+	// call scanner for each member using nthreads threads (one per
+	// processor if zero).  each thread opens the member it's
+	// working on, so CFITSIO must have been built to be reentrant
+	// if nthreads is greater than one.  the first exception thrown
+	// by scanner is rethrown once all of the threads are done.
+	void scan( Scanner& scanner, unsigned int nthreads = 0 ) const;
+
+    private:
+
+	struct Member {
+
+	    std::string file;
+
+	    // -1 if not yet known
+	    LONGLONG nrows;
+
+	    // null if the member isn't open
+	    FilePtr fileptr;
+	    TablePtr table;
+
+	    explicit Member( const std::string& file ) :
+		file( file ),
+		nrows( -1 ) {}
+	};
+
+	// open a member if necessary and mark it as most recently used
+	void acquire( std::size_t member, FilePtr& file, TablePtr& table ) const;
+
+	// ensure the table matches the schema of the set
+	void check_schema( std::size_t member, const Table& table ) const;
+
+	// close the least recently used members which aren't in use
+	// until no more than max_open_ remain open
+	void evict() const;
+
+	// move a member to the front of the list of open members
+	void touch( std::size_t member ) const;
+
+	void load_schema() const;
+
+	// the global index of a member's first row, or, for
+	// num_members(), one past the last row of the set
+	LONGLONG start( std::size_t member ) const;
+
+	// record where the member after the last with a known start
+	// begins, opening that member if its length isn't known
+	void extend_starts( std::size_t member ) const;
+
+	std::string extname_;
+	std::size_t max_open_;
+
+	// guards the members, the list of open members, the starts of
+	// the members and the schema
+	mutable boost::mutex mutex_;
+	mutable std::vector<Member> members_;
+
+	// the global index of the first row of each member, for the
+	// leading members whose lengths are known, followed by one past
+	// the last row of the last of them.  it's extended as members
+	// are counted, so that locating a row is a binary search.
+	mutable std::vector<LONGLONG> starts_;
+
+	// open members, most recently used first
+	mutable std::list<std::size_t> open_;
+
+	// columns of the first member opened, and which it was
+	mutable bool have_schema_;
+	mutable Table::Columns schema_;
+	mutable std::size_t schema_member_;
+    };
+
+    // A row which reads from a TableSet.  Columns are bound by name,
+    // as for Row, and are rebound to each member's table as the row
+    // moves through the set.
+    class TableSetRow {
+
+    public:
+
+	TableSetRow( const TableSet& set );
+
+	template< class T >
+	TableSetRow& add( const std::string& column_name, T* base ) {
+	    return bind( column_name, new ColumnBinding<T>( column_name, base, NULL ) );
+	}
+
+	template< class T >
+	TableSetRow& add( const std::string& column_name, T* base, BitSet* valid ) {
+	    return bind( column_name, new ColumnBinding<T>( column_name, base, valid ) );
+	}
+
+	// read the row at idx() and advance to the next, moving on to
+	// the next member at the end of each one; returns false after
+	// the last row of the set.
+	bool read();
+
+	// read a global row
+	bool read( LONGLONG row );
+
+	// the global index of the next row to be read, and the member
+	// it's in
+	LONGLONG idx() const;
+	std::size_t member() const { return member_; }
+
+	bool raw() const { return raw_ ; }
+	bool raw( bool flag );
+
+	const TableSet& table_set() const { return set_; }
+
+    private:
+
+	struct Binding {
+	    virtual ~Binding() {}
+	    virtual void bind( Row& row ) const = 0;
+	};
+
+	template< class T >
+	struct ColumnBinding : public Binding {
+
+	    ColumnBinding( const std::string& name, T* base, BitSet* valid ) :
+		name( name ),
+		base( base ),
+		valid( valid ) {}
+
+	    void bind( Row& row ) const {
+		if ( valid )
+		    row.add( name, base, valid );
+		else
+		    row.add( name, base );
+	    }
+
+	    std::string name;
+	    T* base;
+	    BitSet* valid;
+	};
+
+	// bindings are checked against the set's columns when added
+	TableSetRow& bind( const std::string& column_name, Binding* binding );
+
+	// switch to reading from a member
+	void attach( std::size_t member );
+
+	const TableSet& set_;
+
+	std::vector< shared_ptr<Binding> > bindings_;
+	bool raw_;
+
+	// the member being read and its row.  the file and table are
+	// held so the member isn't closed while it's being read; the
+	// row only observes them.
+	std::size_t member_;
+	FilePtr file_;
+	TablePtr table_;
+	unique_ptr<Row> row_;
+    };
+}
+
+#endif // ! misFITS_TABLE_SET_H
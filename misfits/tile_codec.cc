@@ -0,0 +1,292 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <zlib.h>
+
+#include <fitsio.h>
+
+#include "tile_codec.hpp"
+#include "byteswap.hpp"
+#include "exception.hpp"
+
+namespace misFITS {
+
+    namespace TileCodec {
+
+	Type
+	type( const std::string& zcmptype ) {
+
+	    if ( zcmptype == "RICE_1" || zcmptype == "RICE_ONE" )
+		return Type::Rice;
+
+	    if ( zcmptype == "GZIP_1" )
+		return Type::Gzip;
+
+	    if ( zcmptype == "GZIP_2" )
+		return Type::Gzip2;
+
+	    return Type::Unsupported;
+	}
+
+	static void
+	decode_rice( const unsigned char* src, std::size_t nbytes,
+		     void* dst, std::size_t nelem,
+		     int bytepix, int blocksize ) {
+
+	    if (    nbytes > static_cast<std::size_t>( std::numeric_limits<int>::max() )
+		 || nelem > static_cast<std::size_t>( std::numeric_limits<int>::max() ) )
+		throw Exception::CFITSIO( DATA_DECOMPRESSION_ERR );
+
+	    // the decoders don't modify their input, but aren't
+	    // declared that way
+	    unsigned char* c = const_cast<unsigned char*>( src );
+	    int clen = static_cast<int>( nbytes );
+	    int nx = static_cast<int>( nelem );
+
+	    int status;
+	    switch ( bytepix ) {
+
+	    case 1:
+		status = fits_rdecomp_byte( c, clen, static_cast<unsigned char*>( dst ), nx, blocksize );
+		break;
+
+	    case 2:
+		status = fits_rdecomp_short( c, clen, static_cast<unsigned short*>( dst ), nx, blocksize );
+		break;
+
+	    case 4:
+		status = fits_rdecomp( c, clen, static_cast<unsigned int*>( dst ), nx, blocksize );
+		break;
+
+	    default:
+		throw Exception::Assert( "unsupported Rice BYTEPIX" );
+	    }
+
+	    if ( status )
+		throw Exception::CFITSIO( DATA_DECOMPRESSION_ERR );
+	}
+
+	// GZIP_2 groups the most significant bytes of all of the
+	// values together, followed by the next most significant, etc.
+	static void
+	shuffle( const unsigned char* src, unsigned char* dst,
+		 std::size_t nelem, int bytepix ) {
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx )
+		for ( int byte = 0 ; byte < bytepix ; ++byte )
+		    dst[ byte * nelem + idx ] = *src++;
+	}
+
+	static void
+	unshuffle( const unsigned char* src, unsigned char* dst,
+		   std::size_t nelem, int bytepix ) {
+
+	    for ( std::size_t idx = 0 ; idx < nelem ; ++idx )
+		for ( int byte = 0 ; byte < bytepix ; ++byte )
+		    *dst++ = src[ byte * nelem + idx ];
+	}
+
+	// GZIP tiles are a gzip'd stream of big endian values
+	static void
+	decode_gzip( const unsigned char* src, std::size_t nbytes,
+		     void* dst, std::size_t nelem,
+		     int bytepix, bool shuffled ) {
+
+	    std::size_t size = nelem * bytepix;
+
+	    z_stream stream;
+	    std::memset( &stream, 0, sizeof( stream ) );
+
+	    // accept either gzip or zlib headers
+	    if ( inflateInit2( &stream, 15 + 32 ) != Z_OK )
+		throw Exception::CFITSIO( DATA_DECOMPRESSION_ERR );
+
+	    stream.next_in = const_cast<Bytef*>( src );
+	    stream.avail_in = static_cast<uInt>( nbytes );
+	    stream.next_out = static_cast<Bytef*>( dst );
+	    stream.avail_out = static_cast<uInt>( size );
+
+	    int zstatus = inflate( &stream, Z_FINISH );
+	    std::size_t produced = size - stream.avail_out;
+	    inflateEnd( &stream );
+
+	    if ( zstatus != Z_STREAM_END || produced != size )
+		throw Exception::CFITSIO( DATA_DECOMPRESSION_ERR );
+
+	    if ( shuffled && bytepix > 1 ) {
+		std::vector<unsigned char> tmp( static_cast<unsigned char*>( dst ),
+						static_cast<unsigned char*>( dst ) + size );
+		unshuffle( &tmp[0], static_cast<unsigned char*>( dst ), nelem, bytepix );
+	    }
+
+	    switch ( bytepix ) {
+
+	    case 1:
+		break;
+
+	    case 2:
+		ByteSwap::swap<2>( dst, nelem );
+		break;
+
+	    case 4:
+		ByteSwap::swap<4>( dst, nelem );
+		break;
+
+	    case 8:
+		ByteSwap::swap<8>( dst, nelem );
+		break;
+
+	    default:
+		throw Exception::Assert( "unsupported GZIP BYTEPIX" );
+	    }
+	}
+
+	void
+	decode( Type codec,
+		const unsigned char* src, std::size_t nbytes,
+		void* dst, std::size_t nelem,
+		int bytepix, int blocksize ) {
+
+	    switch ( boost::native_value( codec ) ) {
+
+	    case Type::Rice:
+		decode_rice( src, nbytes, dst, nelem, bytepix, blocksize );
+		break;
+
+	    case Type::Gzip:
+		decode_gzip( src, nbytes, dst, nelem, bytepix, false );
+		break;
+
+	    case Type::Gzip2:
+		decode_gzip( src, nbytes, dst, nelem, bytepix, true );
+		break;
+
+	    default:
+		throw Exception::Assert( "unsupported tile compression algorithm" );
+	    }
+	}
+
+	static void
+	encode_rice( const unsigned char* src, std::size_t nelem, int bytepix,
+		     int blocksize, std::vector<unsigned char>& dst ) {
+
+	    std::size_t size = nelem * bytepix;
+
+	    // room for the first value, and for every block to be
+	    // stored verbatim
+	    std::size_t bound = size + size / 8 + 16;
+
+	    if ( bound > static_cast<std::size_t>( std::numeric_limits<int>::max() ) )
+		throw Exception::CFITSIO( DATA_COMPRESSION_ERR );
+
+	    int nx = static_cast<int>( nelem );
+	    int clen = static_cast<int>( bound );
+
+	    // the encoders take values in host byte order
+	    std::vector<unsigned char> values( src, src + size );
+	    dst.resize( bound );
+
+	    int nbytes;
+	    switch ( bytepix ) {
+
+	    case 1:
+		nbytes = fits_rcomp_byte( reinterpret_cast<signed char*>( &values[0] ), nx, &dst[0], clen, blocksize );
+		break;
+
+	    case 2:
+		ByteSwap::swap<2>( &values[0], nelem );
+		nbytes = fits_rcomp_short( reinterpret_cast<short*>( &values[0] ), nx, &dst[0], clen, blocksize );
+		break;
+
+	    case 4:
+		ByteSwap::swap<4>( &values[0], nelem );
+		nbytes = fits_rcomp( reinterpret_cast<int*>( &values[0] ), nx, &dst[0], clen, blocksize );
+		break;
+
+	    default:
+		throw Exception::Assert( "unsupported Rice BYTEPIX" );
+	    }
+
+	    if ( nbytes < 0 )
+		throw Exception::CFITSIO( DATA_COMPRESSION_ERR );
+
+	    dst.resize( static_cast<std::size_t>( nbytes ) );
+	}
+
+	void
+	encode( Type codec,
+		const unsigned char* src, std::size_t nelem,
+		int bytepix, int blocksize,
+		std::vector<unsigned char>& dst ) {
+
+	    std::size_t size = nelem * bytepix;
+
+	    std::vector<unsigned char> shuffled;
+
+	    switch ( boost::native_value( codec ) ) {
+
+	    case Type::Rice:
+		encode_rice( src, nelem, bytepix, blocksize, dst );
+		return;
+
+	    case Type::Gzip:
+		break;
+
+	    case Type::Gzip2:
+		if ( bytepix > 1 && size ) {
+		    shuffled.resize( size );
+		    shuffle( src, &shuffled[0], nelem, bytepix );
+		    src = &shuffled[0];
+		}
+		break;
+
+	    default:
+		throw Exception::Assert( "unsupported tile compression algorithm" );
+	    }
+
+	    z_stream stream;
+	    std::memset( &stream, 0, sizeof( stream ) );
+
+	    // write a gzip header, as does CFITSIO
+	    if ( deflateInit2( &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			       15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+		throw Exception::CFITSIO( DATA_COMPRESSION_ERR );
+
+	    dst.resize( deflateBound( &stream, static_cast<uLong>( size ) ) + 32 );
+
+	    stream.next_in = const_cast<Bytef*>( src );
+	    stream.avail_in = static_cast<uInt>( size );
+	    stream.next_out = &dst[0];
+	    stream.avail_out = static_cast<uInt>( dst.size() );
+
+	    int zstatus = deflate( &stream, Z_FINISH );
+	    dst.resize( dst.size() - stream.avail_out );
+	    deflateEnd( &stream );
+
+	    if ( zstatus != Z_STREAM_END )
+		throw Exception::CFITSIO( DATA_COMPRESSION_ERR );
+	}
+    }
+}
@@ -0,0 +1,69 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: encoders and decoders for tile compressed data, used to
+// (de)compress tiles outside of CFITSIO (and thus in parallel).
+
+#ifndef misFITS_TILE_CODEC_H
+#define misFITS_TILE_CODEC_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/core/scoped_enum.hpp>
+
+namespace misFITS {
+
+    namespace TileCodec {
+
+	BOOST_SCOPED_ENUM_DECLARE_BEGIN( Type ) {
+	    Unsupported,
+	    Rice,
+	    Gzip,
+	    Gzip2		// GZIP with the bytes shuffled by significance
+	}
+	BOOST_SCOPED_ENUM_DECLARE_END( Type )
+
+	// map a ZCMPTYPE value to a codec
+	Type type( const std::string& zcmptype );
+
+	// decompress a tile of nelem bytepix sized values from src
+	// (nbytes long) into dst, leaving them in host byte order.
+	// blocksize is used only by Rice.  throws
+	// Exception::CFITSIO on corrupt data.
+	void decode( Type codec,
+		     const unsigned char* src, std::size_t nbytes,
+		     void* dst, std::size_t nelem,
+		     int bytepix, int blocksize );
+
+	// compress nelem bytepix sized values, which are in FITS (big
+	// endian) byte order.  blocksize is used only by Rice.
+	void encode( Type codec,
+		     const unsigned char* src, std::size_t nelem,
+		     int bytepix, int blocksize,
+		     std::vector<unsigned char>& dst );
+    }
+}
+
+#endif // ! misFITS_TILE_CODEC_H
@@ -0,0 +1,573 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fits_p.hpp"
+#include "parallel.hpp"
+#include "tiled_image.hpp"
+
+namespace misFITS {
+
+    struct TiledImage::Tile {
+
+	LONGLONG row;		// row in the compressed table
+
+	Pixel first;		// extent of the tile in the image
+	Pixel last;
+	LONGLONG nelem;
+
+	// set if a pixel didn't fit in the output type
+	bool overflow;
+
+	// raw tile data.  if not compressed, it's already in
+	// host byte order.
+	bool compressed;
+	std::vector<unsigned char> raw;
+    };
+
+    static bool
+    has_column( fitsfile* fptr, const char* name, int& colnum ) {
+
+	int status = 0;
+	fits_get_colnum( fptr, CASEINSEN, const_cast<char*>( name ), &colnum, &status );
+
+	if ( status == COL_NOT_FOUND )
+	    return false;
+
+	if ( status )
+	    throw Exception::CFITSIO( status );
+
+	return true;
+    }
+
+    static bool
+    has_column( fitsfile* fptr, const char* name ) {
+	int colnum;
+	return has_column( fptr, name, colnum );
+    }
+
+    static std::string
+    keyname( const char* root, std::size_t idx ) {
+	std::ostringstream name;
+	name << root << idx;
+	return name.str();
+    }
+
+    shared_ptr<TiledImage>
+    TiledImage::create( const HDU& hdu, fitsfile* fptr ) {
+
+	shared_ptr<TiledImage> none;
+
+	TileCodec::Type codec
+	    = TileCodec::type( hdu.get_keyword<std::string>( "ZCMPTYPE" ).value );
+
+	if ( codec == TileCodec::Type::Unsupported )
+	    return none;
+
+	// leave quantized data and null substitution to CFITSIO
+	if (    has_column( fptr, "ZSCALE" )
+	     || has_column( fptr, "ZZERO" )
+	     || has_column( fptr, "ZBLANK" )
+	     || has_column( fptr, "GZIP_COMPRESSED_DATA" )
+	     || hdu.has_keyword( "ZBLANK" ) )
+	    return none;
+
+	shared_ptr<TiledImage> tiled( new TiledImage );
+
+	tiled->codec_ = codec;
+	tiled->zbitpix_ = hdu.get_keyword<int>( "ZBITPIX" ).value;
+
+	if ( tiled->zbitpix_ < 0 && hdu.get_keyword<std::string>( "ZQUANTIZ", "NONE" ).value != "NONE" )
+	    return none;
+
+	tiled->bytepix_ = std::abs( tiled->zbitpix_ ) / 8;
+	tiled->blocksize_ = 32;
+
+	for ( std::size_t idx = 1 ; hdu.has_keyword( keyname( "ZNAME", idx ) ) ; ++idx ) {
+
+	    std::string zname = hdu.get_keyword<std::string>( keyname( "ZNAME", idx ) ).value;
+	    int zval = hdu.get_keyword<int>( keyname( "ZVAL", idx ) ).value;
+
+	    if ( zname == "BLOCKSIZE" )
+		tiled->blocksize_ = zval;
+
+	    else if ( zname == "BYTEPIX" )
+		tiled->bytepix_ = zval;
+	}
+
+	// Rice only handles integer data stored in its natural size
+	if (    codec == TileCodec::Type::Rice
+	     && (    tiled->zbitpix_ < 0
+		  || tiled->zbitpix_ == LONGLONG_IMG
+		  || tiled->bytepix_ != tiled->zbitpix_ / 8 ) )
+	    return none;
+
+	int znaxis = hdu.get_keyword<int>( "ZNAXIS" ).value;
+
+	tiled->znaxes_.resize( znaxis );
+	tiled->ztile_.resize( znaxis );
+	tiled->ntiles_.resize( znaxis );
+
+	for ( int idx = 0 ; idx < znaxis ; ++idx ) {
+
+	    tiled->znaxes_[idx] = hdu.get_keyword<LONGLONG>( keyname( "ZNAXIS", idx + 1 ) ).value;
+	    tiled->ztile_[idx] = hdu.get_keyword<LONGLONG>( keyname( "ZTILE", idx + 1 ),
+							   idx ? 1 : tiled->znaxes_[idx] ).value;
+
+	    if ( tiled->ztile_[idx] < 1 )
+		return none;
+
+	    tiled->ntiles_[idx] = ( tiled->znaxes_[idx] + tiled->ztile_[idx] - 1 ) / tiled->ztile_[idx];
+	}
+
+	if ( ! has_column( fptr, "COMPRESSED_DATA", tiled->cdata_ ) )
+	    return none;
+
+	if ( ! has_column( fptr, "UNCOMPRESSED_DATA", tiled->udata_ ) )
+	    tiled->udata_ = 0;
+
+	tiled->bscale_ = hdu.get_keyword<double>( "BSCALE", 1.0 ).value;
+	tiled->bzero_ = hdu.get_keyword<double>( "BZERO", 0.0 ).value;
+
+	return tiled;
+    }
+
+    //-----------------------------------------
+
+    // read a tile's raw data from the file.  not thread safe.
+    void
+    TiledImage::read_tile( fitsfile* fptr, Tile& tile ) const {
+
+	LONGLONG length, offset;
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_read_descriptll( fptr, cdata_, tile.row, &length, &offset, &status ) );
+
+	if ( length ) {
+
+	    tile.compressed = true;
+	    tile.raw.resize( static_cast<std::size_t>( length ) );
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_read_col( fptr, TBYTE, cdata_, tile.row, 1, length,
+				 NULL, &tile.raw[0], NULL, &status ) );
+	    return;
+	}
+
+	// tiles which couldn't be compressed are stored as is
+	if ( ! udata_ )
+	    throw Exception::CFITSIO( NO_COMPRESSED_TILE );
+
+	int type;
+	switch ( zbitpix_ ) {
+	case BYTE_IMG:     type = TBYTE;     break;
+	case SHORT_IMG:    type = TSHORT;    break;
+	case LONG_IMG:     type = TINT;      break;
+	case LONGLONG_IMG: type = TLONGLONG; break;
+	case FLOAT_IMG:    type = TFLOAT;    break;
+	case DOUBLE_IMG:   type = TDOUBLE;   break;
+	default:
+	    throw Exception::CFITSIO( BAD_BITPIX );
+	}
+
+	tile.compressed = false;
+	tile.raw.resize( static_cast<std::size_t>( tile.nelem ) * std::abs( zbitpix_ ) / 8 );
+
+	misFITS_CHECK_CFITSIO_EXPR
+	    ( fits_read_col( fptr, type, udata_, tile.row, 1, tile.nelem,
+			     NULL, &tile.raw[0], NULL, &status ) );
+    }
+
+    //-----------------------------------------
+
+    // true if every value of S can be stored in a T without
+    // overflow
+    template< typename S, typename T >
+    struct Covers {
+
+	typedef std::numeric_limits<S> source;
+	typedef std::numeric_limits<T> target;
+
+	static const bool value = target::is_integer
+	    ? source::is_integer && target::digits >= source::digits
+	      && ( target::is_signed || ! source::is_signed )
+	    : source::is_integer || target::digits >= source::digits;
+    };
+
+    // convert a value to T as CFITSIO does: floating point values
+    // are truncated towards zero, and those which don't fit are
+    // clamped to T's range and flagged, so that the read can fail
+    // with NUM_OVERFLOW.
+    template< typename T >
+    static inline T
+    convert( double value, bool& overflow ) {
+
+	typedef std::numeric_limits<T> limits;
+
+	if ( ! limits::is_integer ) {
+
+	    if ( sizeof( T ) < sizeof( double ) ) {
+
+		if ( value > static_cast<double>( limits::max() ) ) {
+		    overflow = true;
+		    return limits::max();
+		}
+
+		if ( value < -static_cast<double>( limits::max() ) ) {
+		    overflow = true;
+		    return -limits::max();
+		}
+	    }
+
+	    return static_cast<T>( value );
+	}
+
+	// CFITSIO accepts values within half a unit of the limits
+	double lo = static_cast<double>( limits::min() ) - 0.49;
+	double hi = static_cast<double>( limits::max() ) + 0.49;
+
+	if ( value < lo ) {
+	    overflow = true;
+	    return limits::min();
+	}
+
+	// the maximum of a 64 bit type rounds up to a power of two,
+	// which is itself out of range
+	if ( value > hi
+	     || ( value == hi && limits::digits >= std::numeric_limits<double>::digits ) ) {
+	    overflow = true;
+	    return limits::max();
+	}
+
+	// NaNs have no integer value
+	if ( value != value ) {
+	    overflow = true;
+	    return 0;
+	}
+
+	return static_cast<T>( value );
+    }
+
+    template< typename S, typename T, bool integer = std::numeric_limits<S>::is_integer >
+    struct Convert {
+
+	static T
+	apply( S value, bool& overflow ) {
+	    return convert<T>( static_cast<double>( value ), overflow );
+	}
+    };
+
+    // integers are compared in whichever of the two types is wider,
+    // so that 64 bit values don't lose precision
+    template< typename S, typename T >
+    struct Convert<S, T, true> {
+
+	static T
+	apply( S value, bool& overflow ) {
+
+	    typedef std::numeric_limits<T> limits;
+
+	    bool wider = std::numeric_limits<S>::digits >= limits::digits;
+
+	    if ( value < static_cast<S>( 0 ) ) {
+
+		if ( ! limits::is_signed
+		     || ( wider && value < static_cast<S>( limits::min() ) ) ) {
+		    overflow = true;
+		    return limits::min();
+		}
+	    }
+
+	    else if ( wider && value > static_cast<S>( limits::max() ) ) {
+		overflow = true;
+		return limits::max();
+	    }
+
+	    return static_cast<T>( value );
+	}
+    };
+
+    // copy the pixels in the intersection of the tile and the
+    // section to the output buffer, converting them to T.  returns
+    // true if any of them overflowed T.
+    template< typename S, typename T >
+    bool
+    TiledImage::extract( const S* pixels, const Tile& tile,
+			 const Section& section, T* data ) const {
+
+	Pixel::size_type naxis = section.naxis();
+
+	Pixel lo( naxis ), hi( naxis ), tstride( naxis ), ostride( naxis );
+
+	LONGLONG ts = 1;
+	LONGLONG os = 1;
+	for ( Pixel::size_type idx = 0 ; idx < naxis ; ++idx ) {
+
+	    LONGLONG inc = section.inc[idx];
+	    LONGLONG start = std::max( section.first[idx], tile.first[idx] );
+
+	    // first sampled pixel in the tile
+	    lo[idx] = section.first[idx] + ( start - section.first[idx] + inc - 1 ) / inc * inc;
+	    hi[idx] = std::min( section.last[idx], tile.last[idx] );
+
+	    tstride[idx] = ts;
+	    ostride[idx] = os;
+
+	    ts *= tile.last[idx] - tile.first[idx] + 1;
+	    os *= ( section.last[idx] - section.first[idx] ) / inc + 1;
+	}
+
+	bool scaled = bscale_ != 1.0 || bzero_ != 0.0;
+	bool overflow = false;
+
+	LONGLONG inc = section.inc[0];
+	LONGLONG n = ( hi[0] - lo[0] ) / inc + 1;
+
+	Pixel pix( lo );
+
+	for (;;) {
+
+	    LONGLONG toff = lo[0] - tile.first[0];
+	    LONGLONG ooff = ( lo[0] - section.first[0] ) / inc;
+
+	    for ( Pixel::size_type idx = 1 ; idx < naxis ; ++idx ) {
+		toff += ( pix[idx] - tile.first[idx] ) * tstride[idx];
+		ooff += ( pix[idx] - section.first[idx] ) / section.inc[idx] * ostride[idx];
+	    }
+
+	    const S* in = pixels + toff;
+	    T* out = data + ooff;
+
+	    if ( scaled )
+		for ( LONGLONG idx = 0 ; idx < n ; ++idx )
+		    out[idx] = convert<T>( in[ idx * inc ] * bscale_ + bzero_, overflow );
+	    else if ( Covers<S, T>::value )
+		for ( LONGLONG idx = 0 ; idx < n ; ++idx )
+		    out[idx] = static_cast<T>( in[ idx * inc ] );
+	    else
+		for ( LONGLONG idx = 0 ; idx < n ; ++idx )
+		    out[idx] = Convert<S, T>::apply( in[ idx * inc ], overflow );
+
+	    // move to the next line of pixels
+	    Pixel::size_type idx = 1;
+	    for ( ; idx < naxis ; ++idx ) {
+
+		pix[idx] += section.inc[idx];
+		if ( pix[idx] <= hi[idx] )
+		    break;
+		pix[idx] = lo[idx];
+	    }
+
+	    if ( idx >= naxis )
+		break;
+	}
+
+	return overflow;
+    }
+
+    // decompress a tile and copy it into the output buffer.  returns
+    // true if any pixels overflowed T.  thread safe.
+    template< typename T >
+    bool
+    TiledImage::decode_tile( const Tile& tile, const Section& section,
+			     std::vector<unsigned char>& scratch, T* data ) const {
+
+	const void* pixels = tile.raw.empty() ? NULL : &tile.raw[0];
+
+	if ( tile.compressed ) {
+
+	    scratch.resize( static_cast<std::size_t>( tile.nelem ) * std::abs( zbitpix_ ) / 8 );
+
+	    TileCodec::decode( codec_,
+			       &tile.raw[0], tile.raw.size(),
+			       &scratch[0], static_cast<std::size_t>( tile.nelem ),
+			       bytepix_, blocksize_ );
+
+	    pixels = &scratch[0];
+	}
+
+	switch ( zbitpix_ ) {
+
+	case BYTE_IMG:
+	    return extract( static_cast<const unsigned char*>( pixels ), tile, section, data );
+
+	case SHORT_IMG:
+	    return extract( static_cast<const short*>( pixels ), tile, section, data );
+
+	case LONG_IMG:
+	    return extract( static_cast<const int*>( pixels ), tile, section, data );
+
+	case LONGLONG_IMG:
+	    return extract( static_cast<const LONGLONG*>( pixels ), tile, section, data );
+
+	case FLOAT_IMG:
+	    return extract( static_cast<const float*>( pixels ), tile, section, data );
+
+	case DOUBLE_IMG:
+	    return extract( static_cast<const double*>( pixels ), tile, section, data );
+
+	default:
+	    throw Exception::CFITSIO( BAD_BITPIX );
+	}
+    }
+
+    //-----------------------------------------
+
+    // decompress a tile and release its compressed data.  tiles
+    // write to disjoint parts of the output buffer, so they may be
+    // decoded in parallel.
+    template< typename T >
+    class Decoder {
+
+    public:
+
+	Decoder( const TiledImage& image,
+		 std::vector<TiledImage::Tile>::iterator begin,
+		 const Section& section, T* data ) :
+	    image_( image ),
+	    begin_( begin ),
+	    section_( section ),
+	    data_( data ) {}
+
+	void operator()( std::size_t idx ) {
+
+	    TiledImage::Tile& tile = begin_[idx];
+
+	    std::vector<unsigned char> scratch;
+	    tile.overflow = image_.decode_tile( tile, section_, scratch, data_ );
+
+	    std::vector<unsigned char>().swap( tile.raw );
+	}
+
+    private:
+
+	const TiledImage& image_;
+	std::vector<TiledImage::Tile>::iterator begin_;
+	const Section& section_;
+	T* data_;
+    };
+
+    template< typename T >
+    void
+    TiledImage::read( fitsfile* fptr, const Section& section, T* data, unsigned int nthreads ) const {
+
+	Pixel::size_type naxis = znaxes_.size();
+
+	if ( ! naxis )
+	    return;
+
+	// find the tiles which overlap the section.  a strided
+	// section may skip over some of them entirely.
+	Pixel lo( naxis ), hi( naxis );
+	for ( Pixel::size_type idx = 0 ; idx < naxis ; ++idx ) {
+	    lo[idx] = ( section.first[idx] - 1 ) / ztile_[idx];
+	    hi[idx] = ( section.last[idx] - 1 ) / ztile_[idx];
+	}
+
+	std::vector<Tile> tiles;
+
+	for ( Pixel tidx( lo ) ;; ) {
+
+	    Tile tile;
+	    tile.row = 1;
+	    tile.nelem = 1;
+	    tile.overflow = false;
+	    tile.first.resize( naxis );
+	    tile.last.resize( naxis );
+
+	    bool sampled = true;
+	    LONGLONG stride = 1;
+
+	    for ( Pixel::size_type idx = 0 ; idx < naxis ; ++idx ) {
+
+		tile.first[idx] = tidx[idx] * ztile_[idx] + 1;
+		tile.last[idx] = std::min( tile.first[idx] + ztile_[idx] - 1, znaxes_[idx] );
+		tile.nelem *= tile.last[idx] - tile.first[idx] + 1;
+
+		tile.row += tidx[idx] * stride;
+		stride *= ntiles_[idx];
+
+		LONGLONG inc = section.inc[idx];
+		LONGLONG start = std::max( section.first[idx], tile.first[idx] );
+		LONGLONG first = section.first[idx] + ( start - section.first[idx] + inc - 1 ) / inc * inc;
+
+		if ( first > std::min( section.last[idx], tile.last[idx] ) )
+		    sampled = false;
+	    }
+
+	    if ( sampled )
+		tiles.push_back( tile );
+
+	    Pixel::size_type idx = 0;
+	    for ( ; idx < naxis ; ++idx ) {
+		if ( ++tidx[idx] <= hi[idx] )
+		    break;
+		tidx[idx] = lo[idx];
+	    }
+
+	    if ( idx == naxis )
+		break;
+	}
+
+	if ( ! nthreads )
+	    nthreads = 1;
+
+	// bound the amount of compressed data held in memory by
+	// reading and decompressing the tiles in batches.  the reads
+	// are serial, as CFITSIO file handles may not be shared
+	// between threads.
+	std::size_t batch = 16 * nthreads;
+
+	bool overflow = false;
+
+	for ( std::vector<Tile>::iterator begin = tiles.begin() ; begin != tiles.end() ; ) {
+
+	    std::vector<Tile>::iterator end
+		= begin + std::min<std::size_t>( batch, tiles.end() - begin );
+
+	    for ( std::vector<Tile>::iterator tile = begin ; tile != end ; ++tile )
+		read_tile( fptr, *tile );
+
+	    Decoder<T> decoder( *this, begin, section, data );
+	    Parallel::for_each( end - begin, nthreads, decoder );
+
+	    for ( std::vector<Tile>::iterator tile = begin ; tile != end ; ++tile )
+		overflow = overflow || tile->overflow;
+
+	    begin = end;
+	}
+
+	// as with CFITSIO, the out of range pixels are clamped and
+	// the rest of the section is read before reporting the error
+	if ( overflow )
+	    throw Exception::CFITSIO( NUM_OVERFLOW );
+    }
+
+#define TILED_IMAGE_READ(r,d,T) \
+    template void TiledImage::read<T>( fitsfile* fptr, const Section& section, T* data, unsigned int nthreads ) const;
+
+    misFITS_INSTANTIATE_OVER_STORAGE_TYPES(TILED_IMAGE_READ)
+}
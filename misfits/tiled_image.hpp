@@ -0,0 +1,89 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: read tile compressed images, decompressing the tiles in
+// parallel outside of CFITSIO.  CFITSIO is only used to read the raw
+// (compressed) tiles from the file.
+
+#ifndef misFITS_TILED_IMAGE_H
+#define misFITS_TILED_IMAGE_H
+
+#include <fitsio.h>
+
+#include <misfits/image.hpp>
+
+#include "tile_codec.hpp"
+
+namespace misFITS {
+
+    class TiledImage {
+
+    public:
+
+	// returns an empty pointer if the compression scheme isn't
+	// handled here (e.g. HCOMPRESS, PLIO, or quantized and
+	// dithered floating point images), in which case the caller
+	// should fall back to CFITSIO.  the HDU must be the CHDU.
+	static shared_ptr<TiledImage> create( const HDU& hdu, fitsfile* fptr );
+
+	// read a section using nthreads threads.  fptr must be
+	// positioned at the image's HDU.
+	template< typename T >
+	void read( fitsfile* fptr, const Section& section, T* data, unsigned int nthreads ) const;
+
+	struct Tile;
+
+    private:
+
+	TiledImage() {}
+
+	void read_tile( fitsfile* fptr, Tile& tile ) const;
+
+	template< typename T >
+	bool decode_tile( const Tile& tile, const Section& section,
+			  std::vector<unsigned char>& scratch, T* data ) const;
+
+	template< typename S, typename T >
+	bool extract( const S* pixels, const Tile& tile,
+		      const Section& section, T* data ) const;
+
+	template< typename T > friend class Decoder;
+
+	TileCodec::Type codec_;
+	int zbitpix_;
+	int bytepix_;
+	int blocksize_;
+
+	Pixel znaxes_;
+	Pixel ztile_;
+	Pixel ntiles_;
+
+	int cdata_;		// COMPRESSED_DATA column
+	int udata_;		// UNCOMPRESSED_DATA column; 0 if not present
+
+	double bscale_;
+	double bzero_;
+    };
+}
+
+#endif // ! misFITS_TILED_IMAGE_H
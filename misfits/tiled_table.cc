@@ -0,0 +1,957 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "fits_p.hpp"
+#include "byteswap.hpp"
+#include "parallel.hpp"
+#include "stream_p.hpp"
+#include "tile_codec.hpp"
+#include "tiled_table.hpp"
+
+namespace misFITS {
+
+    namespace TiledTable {
+
+	// Rice compressed columns always use this block size
+	static const int RiceBlockSize = 32;
+
+	// tiles are (de)compressed in batches of this many per thread
+	static const std::size_t TilesPerThread = 2;
+
+	static const LONGLONG BlockLength = Record::BlockLength;
+
+	struct Tile {
+
+	    LONGLONG row;		// row in the compressed table
+
+	    LONGLONG firstrow;		// rows in the uncompressed table
+	    LONGLONG nrows;
+
+	    std::vector<unsigned char> rows;
+	    std::vector< std::vector<unsigned char> > cells;
+	};
+
+	// a file used while building a view, closed however that ends
+	struct Scratch {
+
+	    Scratch() : fptr( NULL ) {}
+
+	    ~Scratch() {
+		int status = 0;
+		if ( fptr )
+		    fits_close_file( fptr, &status );
+	    }
+
+	    fitsfile* fptr;
+	};
+
+	//-----------------------------------------
+
+	static std::string
+	keyname( const char* root, int idx ) {
+	    std::ostringstream name;
+	    name << root << idx;
+	    return name.str();
+	}
+
+	static LONGLONG
+	read_key( fitsfile* fptr, const std::string& keyname, LONGLONG default_value ) {
+
+	    LONGLONG value;
+	    int status = 0;
+	    fits_read_key( fptr, TLONGLONG, keyname.c_str(), &value, NULL, &status );
+
+	    if ( status == KEY_NO_EXIST )
+		return default_value;
+
+	    if ( status )
+		throw Exception::CFITSIO( status );
+
+	    return value;
+	}
+
+	static std::string
+	read_key( fitsfile* fptr, const std::string& keyname, const std::string& default_value ) {
+
+	    char value[FLEN_VALUE];
+	    int status = 0;
+	    fits_read_key( fptr, TSTRING, keyname.c_str(), value, NULL, &status );
+
+	    if ( status == KEY_NO_EXIST )
+		return default_value;
+
+	    if ( status )
+		throw Exception::CFITSIO( status );
+
+	    return value;
+	}
+
+	// fill in the size of a column's values.  returns false for
+	// variable length arrays.
+	static bool
+	parse_tform( Column& column ) {
+
+	    int typecode;
+	    LONGLONG repeat;
+	    long width;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_binary_tformll( const_cast<char*>( column.tform.c_str() ),
+				       &typecode, &repeat, &width, &status ) );
+
+	    if ( typecode < 0 )
+		return false;
+
+	    column.integer = false;
+
+	    switch ( typecode ) {
+
+	    case TBIT:
+		column.elsize = 1;
+		column.nbytes = ( repeat + 7 ) / 8;
+		break;
+
+	    case TSTRING:
+	    case TLOGICAL:
+		column.elsize = 1;
+		column.nbytes = repeat;
+		break;
+
+	    // the real and imaginary parts are compressed separately
+	    case TCOMPLEX:
+	    case TDBLCOMPLEX:
+		column.elsize = static_cast<int>( width / 2 );
+		column.nbytes = repeat * width;
+		break;
+
+	    case TBYTE:
+	    case TSHORT:
+	    case TLONG:
+		column.integer = true;
+		// fall through
+
+	    default:
+		column.elsize = static_cast<int>( width );
+		column.nbytes = repeat * width;
+		break;
+	    }
+
+	    return true;
+	}
+
+	// keywords which describe the structure of either form of
+	// the table, and so aren't copied between them
+	static bool
+	structural( const std::string& keyname ) {
+
+	    static const char* const fixed[] = {
+		"XTENSION", "BITPIX", "NAXIS", "NAXIS1", "NAXIS2",
+		"PCOUNT", "GCOUNT", "TFIELDS", "THEAP",
+		"ZTABLE", "ZTILELEN", "ZNAXIS1", "ZNAXIS2", "ZPCOUNT", "ZTHEAP",
+		"CHECKSUM", "DATASUM", "ZHECKSUM", "ZDATASUM", "END"
+	    };
+
+	    static const char* const indexed[] = {
+		"TTYPE", "TFORM", "ZFORM", "ZCTYP"
+	    };
+
+	    for ( std::size_t idx = 0 ; idx < sizeof( fixed ) / sizeof( fixed[0] ) ; ++idx )
+		if ( keyname == fixed[idx] )
+		    return true;
+
+	    for ( std::size_t idx = 0 ; idx < sizeof( indexed ) / sizeof( indexed[0] ) ; ++idx ) {
+
+		std::size_t len = std::strlen( indexed[idx] );
+
+		if (    boost::algorithm::starts_with( keyname, indexed[idx] )
+		     && keyname.size() > len
+		     && keyname.find_first_not_of( "0123456789", len ) == std::string::npos )
+		    return true;
+	    }
+
+	    return false;
+	}
+
+	static void
+	copy_keywords( fitsfile* in, fitsfile* out ) {
+
+	    int nkeys;
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_get_hdrspace( in, &nkeys, NULL, &status ) );
+
+	    bool skipping = false;
+
+	    for ( int keynum = 1 ; keynum <= nkeys ; ++keynum ) {
+
+		char card[FLEN_CARD];
+		char name[FLEN_KEYWORD];
+		int length;
+
+		misFITS_CHECK_CFITSIO_EXPR
+		    (
+		     fits_read_record( in, keynum, card, &status );
+		     fits_get_keyname( card, name, &length, &status );
+		     );
+
+		// continuation records follow their keyword
+		if ( std::strcmp( name, "CONTINUE" ) )
+		    skipping = structural( name );
+
+		if ( ! skipping )
+		    misFITS_CHECK_CFITSIO_EXPR
+			( fits_write_record( out, card, &status ) );
+	    }
+	}
+
+	// convert between host and FITS byte order
+	static void
+	swap( unsigned char* data, std::size_t nbytes, int elsize ) {
+
+	    switch ( elsize ) {
+	    case 2: ByteSwap::swap<2>( data, nbytes / 2 ); break;
+	    case 4: ByteSwap::swap<4>( data, nbytes / 4 ); break;
+	    case 8: ByteSwap::swap<8>( data, nbytes / 8 ); break;
+	    default: break;
+	    }
+	}
+
+	//-----------------------------------------
+
+	bool
+	compressed( fitsfile* fptr ) {
+
+	    int ztable;
+	    int status = 0;
+	    fits_read_key( fptr, TLOGICAL, "ZTABLE", &ztable, NULL, &status );
+
+	    if ( status == KEY_NO_EXIST )
+		return false;
+
+	    if ( status )
+		throw Exception::CFITSIO( status );
+
+	    return ztable;
+	}
+
+	//-----------------------------------------
+
+	// each task decodes one column of one tile into the tile's rows
+	class Decoder {
+
+	public:
+
+	    Decoder( const std::vector<Column>& columns, LONGLONG rowlen,
+		     std::vector<Tile>::iterator tiles ) :
+		columns_( columns ),
+		rowlen_( rowlen ),
+		tiles_( tiles ) {}
+
+	    void operator()( std::size_t idx ) {
+
+		Tile& tile = tiles_[ idx / columns_.size() ];
+		const Column& column = columns_[ idx % columns_.size() ];
+		std::vector<unsigned char>& cell = tile.cells[ idx % columns_.size() ];
+
+		std::size_t size = static_cast<std::size_t>( tile.nrows * column.nbytes );
+		if ( ! size )
+		    return;
+
+		if ( cell.empty() )
+		    throw Exception::CFITSIO( NO_COMPRESSED_TILE );
+
+		std::vector<unsigned char> data( size );
+
+		TileCodec::decode( column.codec, &cell[0], cell.size(),
+				   &data[0], size / column.elsize,
+				   column.elsize, RiceBlockSize );
+
+		// decoders return values in host byte order
+		swap( &data[0], size, column.elsize );
+
+		for ( LONGLONG row = 0 ; row < tile.nrows ; ++row )
+		    std::memcpy( &tile.rows[ row * rowlen_ + column.offset ],
+				 &data[ row * column.nbytes ],
+				 column.nbytes );
+
+		std::vector<unsigned char>().swap( cell );
+	    }
+
+	private:
+
+	    const std::vector<Column>& columns_;
+	    LONGLONG rowlen_;
+	    std::vector<Tile>::iterator tiles_;
+	};
+
+	// each task encodes one column of one tile from the tile's rows
+	class Encoder {
+
+	public:
+
+	    Encoder( const std::vector<Column>& columns, LONGLONG rowlen,
+		     std::vector<Tile>::iterator tiles ) :
+		columns_( columns ),
+		rowlen_( rowlen ),
+		tiles_( tiles ) {}
+
+	    void operator()( std::size_t idx ) {
+
+		Tile& tile = tiles_[ idx / columns_.size() ];
+		const Column& column = columns_[ idx % columns_.size() ];
+		std::vector<unsigned char>& cell = tile.cells[ idx % columns_.size() ];
+
+		std::size_t size = static_cast<std::size_t>( tile.nrows * column.nbytes );
+		if ( ! size ) {
+		    cell.clear();
+		    return;
+		}
+
+		std::vector<unsigned char> data( size );
+
+		for ( LONGLONG row = 0 ; row < tile.nrows ; ++row )
+		    std::memcpy( &data[ row * column.nbytes ],
+				 &tile.rows[ row * rowlen_ + column.offset ],
+				 column.nbytes );
+
+		TileCodec::encode( column.codec, &data[0], size / column.elsize,
+				   column.elsize, RiceBlockSize, cell );
+	    }
+
+	private:
+
+	    const std::vector<Column>& columns_;
+	    LONGLONG rowlen_;
+	    std::vector<Tile>::iterator tiles_;
+	};
+
+	//-----------------------------------------
+
+	// the header records of the CHDU, without the END record
+	static std::string
+	records( fitsfile* fptr ) {
+
+	    char* header;
+	    int nkeys;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_hdr2str( fptr, 0, NULL, 0, &header, &nkeys, &status ) );
+
+	    std::string records( header );
+
+	    int status = 0;
+	    fits_free_memory( header, &status );
+
+	    std::string::size_type nrecords = records.size() / Record::Length;
+	    if ( nrecords && Record::is_end( records, Record::Length * ( nrecords - 1 ) ) )
+		--nrecords;
+
+	    records.resize( Record::Length * nrecords );
+	    return records;
+	}
+
+	static void
+	append_header( std::vector<unsigned char>& headers, std::string records ) {
+
+	    records += Record::end();
+	    records.resize( Record::padded( records.size() ), ' ' );
+	    headers.insert( headers.end(), records.begin(), records.end() );
+	}
+
+	// the primary header, and the header of the decompressed form
+	// of the CHDU of in, which has nrows rows
+	static std::vector<unsigned char>
+	headers( fitsfile* in, const std::vector<Column>& columns, LONGLONG nrows ) {
+
+	    int ncols = static_cast<int>( columns.size() );
+
+	    std::vector<char*> ttype( ncols );
+	    std::vector<char*> tform( ncols );
+
+	    for ( int idx = 0 ; idx < ncols ; ++idx ) {
+		ttype[idx] = const_cast<char*>( columns[idx].ttype.c_str() );
+		tform[idx] = const_cast<char*>( columns[idx].tform.c_str() );
+	    }
+
+	    // an empty table, so that CFITSIO doesn't write the rows
+	    Scratch scratch;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		(
+		 fits_create_file( &scratch.fptr, "mem://", &status );
+		 fits_create_tbl( scratch.fptr, BINARY_TBL, 0, ncols,
+				  ncols ? &ttype[0] : NULL,
+				  ncols ? &tform[0] : NULL,
+				  NULL, NULL, &status );
+		 );
+
+	    copy_keywords( in, scratch.fptr );
+
+	    std::string table = records( scratch.fptr );
+
+	    std::string::size_type naxis2 = Record::find( table, "NAXIS2" );
+	    table.replace( naxis2, Record::Length,
+			   Record::integer( "NAXIS2", nrows, "number of rows in table" ) );
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_movabs_hdu( scratch.fptr, 1, NULL, &status ) );
+
+	    std::vector<unsigned char> headers;
+	    append_header( headers, records( scratch.fptr ) );
+	    append_header( headers, table );
+
+	    return headers;
+	}
+
+	// a file holding the CHDU of in, decompressed by CFITSIO
+	static std::vector<unsigned char>
+	uncompressed( fitsfile* in ) {
+
+	    struct Memory {
+		Memory() : data( NULL ), size( 0 ) {}
+		~Memory() { std::free( data ); }
+		void* data;
+		std::size_t size;
+	    } memory;
+
+	    LONGLONG headstart, datastart, dataend;
+
+	    {
+		Scratch scratch;
+
+		misFITS_CHECK_CFITSIO_EXPR
+		    (
+		     fits_create_memfile( &scratch.fptr, &memory.data, &memory.size,
+					  1 << 20, std::realloc, &status );
+		     fits_create_img( scratch.fptr, BYTE_IMG, 0, NULL, &status );
+		     fits_uncompress_table( in, scratch.fptr, &status );
+		     fits_flush_file( scratch.fptr, &status );
+		     fits_get_hduaddrll( scratch.fptr, &headstart, &datastart, &dataend, &status );
+		     );
+	    }
+
+	    const unsigned char* data = static_cast<const unsigned char*>( memory.data );
+	    return std::vector<unsigned char>( data, data + dataend );
+	}
+
+	//-----------------------------------------
+
+	View::View( const Input& input, unsigned int nthreads, std::size_t cache_size ) :
+	    input_( input ),
+	    nthreads_( nthreads ? nthreads : 1 ),
+	    cache_size_( cache_size ),
+	    decoded_( true ),
+	    rowlen_( 0 ),
+	    ztilelen_( 0 ),
+	    ztilelen_written_( true ),
+	    nrows_( 0 ),
+	    size_( 0 ),
+	    backed_( 0 ),
+	    dirty_( false ),
+	    cached_( 0 ) {
+
+	    fitsfile* in = input_();
+
+	    rowlen_ = read_key( in, "ZNAXIS1", 0 );
+	    nrows_ = read_key( in, "ZNAXIS2", 0 );
+	    ztilelen_ = read_key( in, "ZTILELEN", 0 );
+	    LONGLONG zpcount = read_key( in, "ZPCOUNT", 0 );
+	    int ncols = static_cast<int>( read_key( in, "TFIELDS", 0 ) );
+
+	    // without ZTILELEN, the table is a single tile.  tiles of
+	    // a few MB are used for rows added to an empty table.
+	    if ( ztilelen_ <= 0 ) {
+		ztilelen_ = nrows_ ? nrows_ : std::max<LONGLONG>( 1, ( 4 << 20 ) / std::max<LONGLONG>( rowlen_, 1 ) );
+		ztilelen_written_ = false;
+	    }
+
+	    // the heap of a compressed table with variable length
+	    // arrays has its own layout; leave that to CFITSIO
+	    decoded_ = zpcount == 0;
+
+	    columns_.resize( ncols );
+
+	    LONGLONG offset = 0;
+	    for ( int idx = 0 ; decoded_ && idx < ncols ; ++idx ) {
+
+		Column& column = columns_[idx];
+
+		column.ttype = read_key( in, keyname( "TTYPE", idx + 1 ), "" );
+		column.tform = read_key( in, keyname( "ZFORM", idx + 1 ), "" );
+		column.codec = TileCodec::type( read_key( in, keyname( "ZCTYP", idx + 1 ), "" ) );
+
+		if ( ! parse_tform( column ) )
+		    decoded_ = false;
+
+		// GZIP_1 compresses the bytes as is
+		if ( column.codec == TileCodec::Type::Gzip )
+		    column.elsize = 1;
+
+		if (    column.codec == TileCodec::Type::Unsupported
+		     || ( column.codec == TileCodec::Type::Rice
+			  && ! ( column.integer && column.elsize <= 4 ) ) )
+		    decoded_ = false;
+
+		column.offset = offset;
+		offset += column.nbytes;
+	    }
+
+	    if ( decoded_ && offset == rowlen_ ) {
+
+		header_ = headers( in, columns_, nrows_ );
+
+		LONGLONG hsize = static_cast<LONGLONG>( header_.size() );
+		size_ = hsize + static_cast<LONGLONG>( Record::padded( nrows_ * rowlen_ ) );
+		backed_ = hsize + nrows_ * rowlen_;
+	    }
+
+	    else {
+
+		decoded_ = false;
+		header_ = uncompressed( in );
+		size_ = backed_ = static_cast<LONGLONG>( header_.size() );
+	    }
+	}
+
+	View::~View() {}
+
+	std::size_t
+	View::pending() const {
+	    return blocks_.size() * Record::BlockLength;
+	}
+
+	//-----------------------------------------
+
+	void
+	View::read( LONGLONG offset, unsigned char* buffer, LONGLONG nbytes ) {
+
+	    while ( nbytes > 0 ) {
+
+		LONGLONG block = offset / BlockLength;
+		LONGLONG skip = offset - block * BlockLength;
+		LONGLONG n = std::min( nbytes, BlockLength - skip );
+
+		Blocks::const_iterator modified = blocks_.find( block );
+
+		if ( modified != blocks_.end() )
+		    std::memcpy( buffer, &modified->second[ skip ], n );
+		else
+		    read_unmodified( offset, buffer, n );
+
+		offset += n;
+		buffer += n;
+		nbytes -= n;
+	    }
+	}
+
+	void
+	View::write( LONGLONG offset, const unsigned char* buffer, LONGLONG nbytes ) {
+
+	    dirty_ = true;
+
+	    while ( nbytes > 0 ) {
+
+		LONGLONG block = offset / BlockLength;
+		LONGLONG skip = offset - block * BlockLength;
+		LONGLONG n = std::min( nbytes, BlockLength - skip );
+
+		Blocks::iterator modified = blocks_.find( block );
+
+		// CFITSIO fills new blocks with zeroes; past the
+		// unmodified contents, they needn't be kept
+		bool zero = modified == blocks_.end() && block * BlockLength >= backed_;
+		for ( LONGLONG idx = 0 ; zero && idx < n ; ++idx )
+		    zero = ! buffer[idx];
+
+		if ( ! zero ) {
+
+		    if ( modified == blocks_.end() ) {
+
+			modified = blocks_.insert( std::make_pair( block, std::vector<unsigned char>( Record::BlockLength ) ) ).first;
+
+			if ( n < BlockLength )
+			    read_unmodified( block * BlockLength, &modified->second[0], BlockLength );
+		    }
+
+		    std::memcpy( &modified->second[ skip ], buffer, n );
+		}
+
+		offset += n;
+		buffer += n;
+		nbytes -= n;
+
+		size_ = std::max( size_, offset );
+	    }
+	}
+
+	void
+	View::truncate( LONGLONG size ) {
+
+	    dirty_ = true;
+
+	    size_ = size;
+	    backed_ = std::min( backed_, size );
+
+	    // zero the tail of a block which straddles the end, in
+	    // case the file grows again
+	    LONGLONG last = size / BlockLength;
+	    Blocks::iterator block = blocks_.find( last );
+
+	    if ( block != blocks_.end() )
+		std::memset( &block->second[ size - last * BlockLength ], 0,
+			     static_cast<std::size_t>( ( last + 1 ) * BlockLength - size ) );
+
+	    blocks_.erase( blocks_.upper_bound( last ), blocks_.end() );
+	}
+
+	void
+	View::read_unmodified( LONGLONG offset, unsigned char* buffer, LONGLONG nbytes ) {
+
+	    LONGLONG hsize = static_cast<LONGLONG>( header_.size() );
+	    LONGLONG end = offset + std::max<LONGLONG>( 0, std::min( nbytes, backed_ - offset ) );
+
+	    std::memset( buffer + ( end - offset ), 0, static_cast<std::size_t>( nbytes - ( end - offset ) ) );
+
+	    LONGLONG pos = offset;
+
+	    if ( pos < std::min( hsize, end ) ) {
+		std::memcpy( buffer, &header_[ pos ], static_cast<std::size_t>( std::min( hsize, end ) - pos ) );
+		pos = std::min( hsize, end );
+	    }
+
+	    LONGLONG tilelen = ztilelen_ * rowlen_;
+
+	    while ( pos < end ) {
+
+		LONGLONG byte = pos - hsize;
+		LONGLONG idx = byte / tilelen;
+		LONGLONG skip = byte - idx * tilelen;
+
+		Rows rows = tile( idx );
+		LONGLONG n = std::min( end - pos, static_cast<LONGLONG>( rows->size() ) - skip );
+
+		std::memcpy( buffer + ( pos - offset ), &(*rows)[ skip ], static_cast<std::size_t>( n ) );
+		pos += n;
+	    }
+	}
+
+	//-----------------------------------------
+
+	View::Rows
+	View::tile( LONGLONG idx ) {
+
+	    std::map<LONGLONG,Cached>::iterator cached = tiles_.find( idx );
+
+	    if ( cached == tiles_.end() ) {
+		load( idx );
+		cached = tiles_.find( idx );
+	    }
+
+	    used_.splice( used_.begin(), used_, cached->second.use );
+	    return cached->second.rows;
+	}
+
+	// decompress a tile, and enough of those following it to keep
+	// the threads busy, unless they're already cached
+	void
+	View::load( LONGLONG first ) {
+
+	    LONGLONG ntiles = ( nrows_ + ztilelen_ - 1 ) / ztilelen_;
+	    LONGLONG last = std::min( first + static_cast<LONGLONG>( TilesPerThread * nthreads_ ), ntiles );
+
+	    int ncols = static_cast<int>( columns_.size() );
+
+	    fitsfile* in = input_();
+
+	    // the reads are serial, as CFITSIO file handles may not be
+	    // shared between threads
+	    std::vector<Tile> tiles;
+
+	    for ( LONGLONG idx = first ; idx < last && ( idx == first || ! tiles_.count( idx ) ) ; ++idx ) {
+
+		tiles.push_back( Tile() );
+		Tile& tile = tiles.back();
+
+		tile.row = idx + 1;
+		tile.firstrow = idx * ztilelen_ + 1;
+		tile.nrows = std::min( ztilelen_, nrows_ - idx * ztilelen_ );
+		tile.rows.resize( static_cast<std::size_t>( tile.nrows * rowlen_ ) );
+		tile.cells.resize( ncols );
+
+		for ( int colnum = 1 ; colnum <= ncols ; ++colnum ) {
+
+		    std::vector<unsigned char>& cell = tile.cells[colnum-1];
+
+		    LONGLONG length, heapaddr;
+		    misFITS_CHECK_CFITSIO_EXPR
+			( fits_read_descriptll( in, colnum, tile.row, &length, &heapaddr, &status ) );
+
+		    cell.resize( static_cast<std::size_t>( length ) );
+
+		    if ( length )
+			misFITS_CHECK_CFITSIO_EXPR
+			    ( fits_read_col( in, TBYTE, colnum, tile.row, 1, length,
+					     NULL, &cell[0], NULL, &status ) );
+		}
+	    }
+
+	    Decoder decoder( columns_, rowlen_, tiles.begin() );
+	    Parallel::for_each( tiles.size() * ncols, nthreads_, decoder );
+
+	    // the requested tile is the most recently used
+	    for ( std::vector<Tile>::reverse_iterator tile = tiles.rbegin() ; tile != tiles.rend() ; ++tile ) {
+
+		shared_ptr< std::vector<unsigned char> > rows( new std::vector<unsigned char> );
+		rows->swap( tile->rows );
+
+		used_.push_front( tile->row - 1 );
+
+		Cached& cached = tiles_[ tile->row - 1 ];
+		cached.rows = rows;
+		cached.use = used_.begin();
+
+		cached_ += rows->size();
+	    }
+
+	    while ( cached_ > cache_size_ && tiles_.size() > tiles.size() )
+		evict( used_.back() );
+	}
+
+	void
+	View::evict( LONGLONG idx ) {
+
+	    std::map<LONGLONG,Cached>::iterator cached = tiles_.find( idx );
+	    if ( cached == tiles_.end() )
+		return;
+
+	    cached_ -= cached->second.rows->size();
+	    used_.erase( cached->second.use );
+	    tiles_.erase( cached );
+	}
+
+	//-----------------------------------------
+
+	std::pair<LONGLONG,LONGLONG>
+	View::block_rows( LONGLONG block ) const {
+
+	    LONGLONG hsize = static_cast<LONGLONG>( header_.size() );
+	    LONGLONG begin = std::max( block * BlockLength, hsize ) - hsize;
+	    LONGLONG end = ( block + 1 ) * BlockLength - hsize;
+
+	    if ( end <= begin || ! rowlen_ )
+		return std::make_pair( 0LL, 0LL );
+
+	    return std::make_pair( begin / rowlen_, ( end + rowlen_ - 1 ) / rowlen_ );
+	}
+
+	bool
+	View::commit( fitsfile* view ) {
+
+	    if ( ! dirty_ )
+		return false;
+
+	    if ( ! decoded_ )
+		throw Exception::Assert( "can't write tile compressed tables with variable length array columns, "
+					 "or compressed other than with GZIP_1, GZIP_2 or RICE_1" );
+
+	    LONGLONG nrows, headstart, datastart, dataend;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		(
+		 fits_get_num_rowsll( view, &nrows, &status );
+		 fits_get_hduaddrll( view, &headstart, &datastart, &dataend, &status );
+		 );
+
+	    LONGLONG hsize = static_cast<LONGLONG>( header_.size() );
+
+	    if ( datastart != hsize )
+		throw Exception::Assert( "the header of a decompressed table can't change size" );
+
+	    int ncols = static_cast<int>( columns_.size() );
+
+	    // the tiles holding modified rows, added rows, or a
+	    // different number of rows than before
+	    std::set<LONGLONG> modified;
+
+	    if ( ncols ) {
+
+		LONGLONG unchanged = std::min( nrows, nrows_ );
+		if ( rowlen_ )
+		    unchanged = std::min( unchanged, std::max<LONGLONG>( 0, backed_ - hsize ) / rowlen_ );
+
+		for ( LONGLONG row = unchanged / ztilelen_ * ztilelen_ ; row < nrows ; row += ztilelen_ )
+		    modified.insert( row / ztilelen_ );
+
+		for ( Blocks::const_iterator block = blocks_.begin() ; block != blocks_.end() ; ++block ) {
+
+		    std::pair<LONGLONG,LONGLONG> rows = block_rows( block->first );
+		    rows.second = std::min( rows.second, nrows );
+
+		    if ( rows.first < rows.second )
+			for ( LONGLONG idx = rows.first / ztilelen_ ; idx <= ( rows.second - 1 ) / ztilelen_ ; ++idx )
+			    modified.insert( idx );
+		}
+	    }
+
+	    fitsfile* in = input_();
+
+	    LONGLONG ntiles = ( nrows + ztilelen_ - 1 ) / ztilelen_;
+	    LONGLONG ntiles_in;
+
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_get_num_rowsll( in, &ntiles_in, &status ) );
+
+	    if ( ntiles > ntiles_in )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_insert_rows( in, ntiles_in, ntiles - ntiles_in, &status ) );
+
+	    std::vector<LONGLONG> order( modified.begin(), modified.end() );
+	    std::size_t batch = TilesPerThread * nthreads_;
+
+	    std::vector<Tile> tiles;
+
+	    for ( std::size_t first = 0 ; first < order.size() ; first += batch ) {
+
+		std::size_t last = std::min( first + batch, order.size() );
+
+		tiles.resize( last - first );
+
+		// the tiles' blocks are kept in memory until the
+		// commit is complete, so that no tile is decompressed
+		// once it's been replaced.  tiles are replaced in
+		// order, so a block holding rows of an earlier tile
+		// has already been kept.
+		for ( std::size_t idx = first ; idx < last ; ++idx ) {
+
+		    Tile& tile = tiles[ idx - first ];
+
+		    tile.row = order[idx] + 1;
+		    tile.firstrow = order[idx] * ztilelen_ + 1;
+		    tile.nrows = std::min( ztilelen_, nrows - order[idx] * ztilelen_ );
+		    tile.rows.resize( static_cast<std::size_t>( tile.nrows * rowlen_ ) );
+		    tile.cells.resize( ncols );
+
+		    LONGLONG begin = hsize + ( tile.firstrow - 1 ) * rowlen_;
+		    LONGLONG end = begin + tile.nrows * rowlen_;
+
+		    for ( LONGLONG block = begin / BlockLength ; block * BlockLength < std::min( end, backed_ ) ; ++block )
+			if ( ! blocks_.count( block ) ) {
+			    std::vector<unsigned char>& kept = blocks_[ block ];
+			    kept.resize( Record::BlockLength );
+			    read_unmodified( block * BlockLength, &kept[0], BlockLength );
+			}
+		}
+
+		for ( std::vector<Tile>::iterator tile = tiles.begin() ; tile != tiles.end() ; ++tile )
+		    if ( rowlen_ )
+			misFITS_CHECK_CFITSIO_EXPR
+			    ( fits_read_tblbytes( view, tile->firstrow, 1, tile->nrows * rowlen_,
+						  &tile->rows[0], &status ) );
+
+		Encoder encoder( columns_, rowlen_, tiles.begin() );
+		Parallel::for_each( tiles.size() * ncols, nthreads_, encoder );
+
+		for ( std::vector<Tile>::iterator tile = tiles.begin() ; tile != tiles.end() ; ++tile ) {
+
+		    for ( int colnum = 1 ; colnum <= ncols ; ++colnum ) {
+
+			std::vector<unsigned char>& cell = tile->cells[colnum-1];
+
+			if ( cell.empty() )
+			    misFITS_CHECK_CFITSIO_EXPR
+				( fits_write_descript( in, colnum, tile->row, 0, 0, &status ) );
+			else
+			    misFITS_CHECK_CFITSIO_EXPR
+				( fits_write_col( in, TBYTE, colnum, tile->row, 1,
+						  static_cast<LONGLONG>( cell.size() ),
+						  &cell[0], &status ) );
+		    }
+
+		    evict( tile->row - 1 );
+		}
+	    }
+
+	    if ( ntiles < ntiles_in )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_delete_rows( in, ntiles + 1, ntiles_in - ntiles, &status ) );
+
+	    if ( ! ztilelen_written_ )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_update_key( in, TLONGLONG, "ZTILELEN", &ztilelen_, "number of rows in each tile", &status ) );
+
+	    ztilelen_written_ = true;
+
+	    // the table is only complete once it has the new number
+	    // of rows
+	    if ( nrows != nrows_ )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_update_key( in, TLONGLONG, "ZNAXIS2", &nrows, NULL, &status ) );
+
+	    // replaced tiles may be left in the heap
+	    LONGLONG heapsize, used = 0;
+	    misFITS_CHECK_CFITSIO_EXPR
+		( fits_read_key( in, TLONGLONG, "PCOUNT", &heapsize, NULL, &status ) );
+
+	    if ( ntiles ) {
+
+		std::vector<LONGLONG> length( static_cast<std::size_t>( ntiles ) );
+		std::vector<LONGLONG> heapaddr( static_cast<std::size_t>( ntiles ) );
+
+		for ( int colnum = 1 ; colnum <= ncols ; ++colnum ) {
+
+		    misFITS_CHECK_CFITSIO_EXPR
+			( fits_read_descriptsll( in, colnum, 1, ntiles, &length[0], &heapaddr[0], &status ) );
+
+		    for ( std::size_t idx = 0 ; idx < length.size() ; ++idx )
+			used += length[idx];
+		}
+	    }
+
+	    if ( heapsize > 2 * used )
+		misFITS_CHECK_CFITSIO_EXPR
+		    ( fits_compress_heap( in, &status ) );
+
+	    // the view now matches the table
+	    for ( Blocks::iterator block = blocks_.begin() ; block != blocks_.end() && block->first * BlockLength < hsize ; ++block )
+		std::memcpy( &header_[ block->first * BlockLength ], &block->second[0], Record::BlockLength );
+
+	    blocks_.clear();
+
+	    while ( ! tiles_.empty() && tiles_.rbegin()->first >= nrows / ztilelen_ )
+		evict( tiles_.rbegin()->first );
+
+	    nrows_ = nrows;
+	    backed_ = hsize + nrows_ * rowlen_;
+	    dirty_ = false;
+
+	    return true;
+	}
+    }
+}
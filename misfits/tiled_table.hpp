@@ -0,0 +1,180 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// internal: conversion between tile compressed (ZTABLE) binary
+// tables and ordinary ones.  column tiles are (de)compressed in
+// parallel; CFITSIO is only used to move the raw bytes.
+
+#ifndef misFITS_TILED_TABLE_H
+#define misFITS_TILED_TABLE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <fitsio.h>
+
+#include <misfits/fits.hpp>
+
+#include "driver_p.hpp"
+#include "tile_codec.hpp"
+
+namespace misFITS {
+
+    namespace TiledTable {
+
+	struct Column {
+
+	    std::string ttype;
+	    std::string tform;		// as in the uncompressed table
+
+	    TileCodec::Type codec;
+	    int elsize;			// size of the values seen by the codec
+	    bool integer;		// Rice may be used
+
+	    LONGLONG offset;		// position in an uncompressed row
+	    LONGLONG nbytes;
+	};
+
+	// true if the CHDU is a tile compressed table
+	bool compressed( fitsfile* fptr );
+
+	// a tile compressed table presented as an ordinary one, in a
+	// file whose second HDU is the table.  open source_url( view )
+	// to read and write its rows.
+	//
+	// tiles are decompressed in parallel as they're read, along
+	// with the tiles following them, and the most recently used
+	// are kept in a cache of cache_size bytes.  modified blocks of
+	// the file are kept in memory until they're committed, when
+	// only the tiles which hold them are compressed again, with
+	// their original algorithms.  tables with variable length
+	// array columns, or compressed with algorithms other than
+	// GZIP_1, GZIP_2 and RICE_1, are decompressed whole by CFITSIO
+	// when opened, and can't be committed.
+	class View : public Driver::Source {
+
+	public:
+
+	    // returns the file holding the compressed table, with the
+	    // table as its CHDU
+	    typedef boost::function<fitsfile* ()> Input;
+
+	    static const std::size_t DefaultCacheSize = 64 << 20;
+
+	    View( const Input& input, unsigned int nthreads,
+		  std::size_t cache_size = DefaultCacheSize );
+	    ~View();
+
+	    // true if modified rows may be committed
+	    bool writable() const { return decoded_; }
+
+	    // true if the file has been written to since it was
+	    // opened or committed
+	    bool dirty() const { return dirty_; }
+
+	    // the memory held by modified blocks
+	    std::size_t pending() const;
+	    std::size_t cache_size() const { return cache_size_; }
+
+	    // compress the modified tiles back into the table, and
+	    // return true if there were any.  view is the file opened
+	    // on this, whose buffers must have been flushed.  tiles are
+	    // replaced in place, and the number of rows is updated
+	    // last, so a failure leaves the table with a mix of old and
+	    // new tiles, but never a second copy; the view remains
+	    // dirty, and may be committed again.
+	    bool commit( fitsfile* view );
+
+	    LONGLONG size() const { return size_; }
+	    void read( LONGLONG offset, unsigned char* buffer, LONGLONG nbytes );
+	    void write( LONGLONG offset, const unsigned char* buffer, LONGLONG nbytes );
+	    void truncate( LONGLONG size );
+
+	private:
+
+	    View( const View& );
+	    View& operator=( const View& );
+
+	    typedef shared_ptr< const std::vector<unsigned char> > Rows;
+
+	    // read bytes as they were when the view was opened or last
+	    // committed.  the range must lie within one block.
+	    void read_unmodified( LONGLONG offset, unsigned char* buffer, LONGLONG nbytes );
+
+	    // the rows of a tile (zero based), which are decompressed
+	    // with those following if they aren't cached
+	    Rows tile( LONGLONG tile );
+	    void load( LONGLONG tile );
+	    void evict( LONGLONG tile );
+
+	    // the rows held by a block of the file
+	    std::pair<LONGLONG,LONGLONG> block_rows( LONGLONG block ) const;
+
+	    Input input_;
+	    unsigned int nthreads_;
+	    std::size_t cache_size_;
+
+	    // false if CFITSIO decompressed the whole table
+	    bool decoded_;
+
+	    std::vector<Column> columns_;
+	    LONGLONG rowlen_;
+	    LONGLONG ztilelen_;
+	    bool ztilelen_written_;
+
+	    // the rows in the compressed table
+	    LONGLONG nrows_;
+
+	    // the headers of the file, or for tables which aren't
+	    // decoded here, the whole file
+	    std::vector<unsigned char> header_;
+
+	    // the size of the file, and the extent of its unmodified
+	    // contents; anything past that is zero
+	    LONGLONG size_;
+	    LONGLONG backed_;
+
+	    // modified blocks, by block number
+	    typedef std::map< LONGLONG, std::vector<unsigned char> > Blocks;
+	    Blocks blocks_;
+	    bool dirty_;
+
+	    // decompressed tiles, by tile, and their use, most recent
+	    // first
+	    struct Cached {
+		Rows rows;
+		std::list<LONGLONG>::iterator use;
+	    };
+	    std::map<LONGLONG, Cached> tiles_;
+	    std::list<LONGLONG> used_;
+	    std::size_t cached_;
+	};
+    }
+}
+
+#endif // ! misFITS_TILED_TABLE_H
\ No newline at end of file
@@ -0,0 +1,239 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+#include <unistd.h>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <misfits/trace.hpp>
+
+namespace misFITS {
+
+    namespace Trace {
+
+	namespace {
+
+	    // writes events to the file named by MISFITS_TRACE as a
+	    // JSON array, which is closed when the program exits.
+	    //
+	    // the Writer is never destroyed, so that spans ending during
+	    // static destruction, e.g. in the destructor of a static
+	    // File, may still use it; events recorded after the array
+	    // has been closed are dropped.
+	    class Writer {
+
+	    public:
+
+		Writer() :
+		    fp_( NULL ),
+		    nevents_( 0 ),
+		    pid_( static_cast<long>( getpid() ) ),
+		    origin_( Stats::now() ) {
+
+		    const char* file = std::getenv( "MISFITS_TRACE" );
+
+		    if ( ! file || ! *file )
+			return;
+
+		    fp_ = std::fopen( file, "w" );
+
+		    if ( ! fp_ ) {
+			std::cerr << "misFITS: unable to open trace file " << file << std::endl;
+			return;
+		    }
+
+		    std::fputs( "[\n", fp_ );
+		}
+
+		void close() {
+
+		    boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		    if ( fp_ ) {
+			std::fputs( "\n]\n", fp_ );
+			std::fclose( fp_ );
+			fp_ = NULL;
+		    }
+		}
+
+		bool enabled() const { return fp_ != NULL; }
+
+		void write( const char* name, double start, double end, const std::string& args ) {
+
+		    boost::lock_guard<boost::mutex> lock( mutex_ );
+
+		    if ( ! fp_ )
+			return;
+
+		    // Chrome wants small integer thread ids
+		    std::map<boost::thread::id, int>::iterator tid
+			= tids_.insert( std::make_pair( boost::this_thread::get_id(),
+							static_cast<int>( tids_.size() + 1 ) ) ).first;
+
+		    std::fprintf( fp_,
+				  "%s{\"name\":\"%s\",\"cat\":\"misfits\",\"ph\":\"X\","
+				  "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%d,\"args\":{%s}}",
+				  nevents_++ ? ",\n" : "",
+				  name,
+				  1e6 * ( start - origin_ ),
+				  1e6 * ( end - start ),
+				  pid_,
+				  tid->second,
+				  args.c_str() );
+		}
+
+	    private:
+		boost::mutex mutex_;
+		std::FILE* fp_;
+		unsigned long nevents_;
+		long pid_;
+		double origin_;
+		std::map<boost::thread::id, int> tids_;
+	    };
+
+	    Writer& writer();
+
+	    extern "C" void
+	    close_writer() {
+		writer().close();
+	    }
+
+	    Writer*
+	    create_writer() {
+		Writer* writer = new Writer;
+		std::atexit( close_writer );
+		return writer;
+	    }
+
+	    Writer&
+	    writer() {
+		static Writer* const writer = create_writer();
+		return *writer;
+	    }
+	}
+
+	bool
+	enabled() {
+	    static const bool enabled = writer().enabled();
+	    return enabled;
+	}
+
+	void
+	record( const char* name, double start, double end, const std::string& args ) {
+	    writer().write( name, start, end, args );
+	}
+
+	void
+	append( std::string& args, const char* key, LONGLONG value ) {
+
+	    char buffer[32];
+	    std::sprintf( buffer, "%lld", static_cast<long long>( value ) );
+
+	    if ( ! args.empty() )
+		args += ',';
+
+	    args += '"';
+	    args += key;
+	    args += "\":";
+	    args += buffer;
+	}
+
+	void
+	append( std::string& args, const char* key, const std::string& value ) {
+
+	    if ( ! args.empty() )
+		args += ',';
+
+	    args += '"';
+	    args += key;
+	    args += "\":\"";
+
+	    for ( std::string::const_iterator c = value.begin() ; c != value.end() ; ++c ) {
+
+		if ( *c == '"' || *c == '\\' ) {
+		    args += '\\';
+		    args += *c;
+		}
+
+		else if ( static_cast<unsigned char>( *c ) < 0x20 ) {
+		    char buffer[8];
+		    std::sprintf( buffer, "\\u%04x", static_cast<unsigned char>( *c ) );
+		    args += buffer;
+		}
+
+		else
+		    args += *c;
+	    }
+
+	    args += '"';
+	}
+
+	//-----------------------------------------
+
+	void
+	Batch::add( int hdu_num, LONGLONG row, double start, double end, unsigned long long nbytes ) {
+
+	    if ( nrows_ && ( hdu_num != hdu_num_ || row != firstrow_ + nrows_ ) )
+		flush();
+
+	    if ( ! nrows_ ) {
+		hdu_num_ = hdu_num;
+		firstrow_ = row;
+		start_ = start;
+		busy_ = 0;
+		nbytes_ = 0;
+	    }
+
+	    ++nrows_;
+	    end_ = end;
+	    busy_ += end - start;
+	    nbytes_ += nbytes;
+
+	    if ( nrows_ == MaxRows )
+		flush();
+	}
+
+	void
+	Batch::flush() {
+
+	    if ( ! nrows_ )
+		return;
+
+	    std::string args;
+	    append( args, "hdu", hdu_num_ );
+	    append( args, "firstrow", firstrow_ );
+	    append( args, "rows", nrows_ );
+	    append( args, "bytes", static_cast<LONGLONG>( nbytes_ ) );
+	    append( args, "busy_us", static_cast<LONGLONG>( 1e6 * busy_ ) );
+
+	    record( name_, start_, end_, args );
+
+	    nrows_ = 0;
+	}
+    }
+}
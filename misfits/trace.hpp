@@ -0,0 +1,175 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// -*-c++-*-
+
+// record timed spans in Chrome trace event format.
+//
+// tracing is enabled by setting the MISFITS_TRACE environment
+// variable to the name of the output file, which may be loaded into
+// chrome://tracing or Perfetto.
+
+#ifndef misFITS_TRACE_H
+#define misFITS_TRACE_H
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <fitsio.h>
+
+#include <misfits/stats.hpp>
+
+namespace misFITS {
+
+    namespace Trace {
+
+	// true if MISFITS_TRACE names a writeable file
+	bool enabled();
+
+	// write a "complete" event. args is a comma separated list of
+	// JSON members.
+	void record( const char* name, double start, double end, const std::string& args );
+
+	// append a JSON member to args
+	void append( std::string& args, const char* key, LONGLONG value );
+	void append( std::string& args, const char* key, const std::string& value );
+
+	// a span covering the lifetime of the object
+	class Span : boost::noncopyable {
+
+	public:
+
+	    explicit Span( const char* name ) :
+		name_( name ),
+		active_( enabled() ),
+		start_( active_ ? Stats::now() : 0 ) {}
+
+	    // a span for an operation on an HDU
+	    Span( const char* name, int hdu_num ) :
+		name_( name ),
+		active_( enabled() ),
+		start_( active_ ? Stats::now() : 0 ) {
+		arg( "hdu", hdu_num );
+	    }
+
+	    ~Span() {
+		if ( active_ )
+		    record( name_, start_, Stats::now(), args_ );
+	    }
+
+	    template< typename T >
+	    Span& arg( const char* key, const T& value ) {
+		if ( active_ )
+		    append( args_, key, value );
+		return *this;
+	    }
+
+	private:
+	    const char* name_;
+	    bool active_;
+	    double start_;
+	    std::string args_;
+	};
+
+	// a span for an operation on an HDU which is also counted in
+	// one of its File's Stats categories
+	class TimedSpan : public Span {
+
+	public:
+	    TimedSpan( const char* name, int hdu_num, Stats& stats, Stats::Category category ) :
+		Span( name, hdu_num ),
+		timer_( stats, category ) {}
+
+	private:
+	    Stats::Timer timer_;
+	};
+
+	// consecutive rows read or written one at a time are recorded
+	// as a single span, which includes the time spent by the
+	// caller between rows; the time spent in misFITS is recorded
+	// as the "busy_us" argument.
+	class Batch {
+
+	public:
+
+	    // rows per span
+	    enum { MaxRows = 4096 };
+
+	    explicit Batch( const char* name ) : name_( name ), nrows_( 0 ) {}
+
+	    // copies start afresh, so that a row isn't recorded twice
+	    Batch( const Batch& other ) : name_( other.name_ ), nrows_( 0 ) {}
+	    Batch& operator=( const Batch& other ) {
+		flush();
+		name_ = other.name_;
+		return *this;
+	    }
+
+	    ~Batch() { flush(); }
+
+	    void add( int hdu_num, LONGLONG row, double start, double end, unsigned long long nbytes );
+	    void flush();
+
+	    // times a row.  nbytes is a running count of the bytes
+	    // moved, e.g. one of the File's Stats counters.
+	    class Scope : boost::noncopyable {
+
+	    public:
+		Scope( Batch& batch, int hdu_num, LONGLONG row, const unsigned long long& nbytes ) :
+		    batch_( batch ),
+		    hdu_num_( hdu_num ),
+		    row_( row ),
+		    nbytes_( nbytes ),
+		    active_( enabled() ),
+		    start_( active_ ? Stats::now() : 0 ),
+		    start_nbytes_( nbytes ) {}
+
+		~Scope() {
+		    if ( active_ )
+			batch_.add( hdu_num_, row_, start_, Stats::now(), nbytes_ - start_nbytes_ );
+		}
+
+	    private:
+		Batch& batch_;
+		int hdu_num_;
+		LONGLONG row_;
+		const unsigned long long& nbytes_;
+		bool active_;
+		double start_;
+		unsigned long long start_nbytes_;
+	    };
+
+	private:
+	    const char* name_;
+
+	    int hdu_num_;
+	    LONGLONG firstrow_;
+	    LONGLONG nrows_;
+	    double start_;
+	    double end_;
+	    double busy_;
+	    unsigned long long nbytes_;
+	};
+    }
+}
+
+#endif // ! misFITS_TRACE_H
@@ -74,9 +74,8 @@ namespace misFITS {
 	template <> char Impl<ID::UShort>::code() 	 { return 'U'; }
 	template <> char Impl<ID::ULong>::code()  	 { return 'V'; }
 
-	// no support for complex as of yet
-	// template <> char Impl<ID::Complex>::code() 	 { return 'C'; }
-	// template <> char Impl<ID::DoubleComplex>::code() { return 'M'; }
+	template <> char Impl<ID::Complex>::code() 	 { return 'C'; }
+	template <> char Impl<ID::DoubleComplex>::code() { return 'M'; }
 
 	SpecPtr
 	spec_from_id( ID::type id ) {
@@ -120,14 +119,13 @@ namespace misFITS {
 		return make_shared< Impl<ID::Double> >();
 		break;
 
-	    // no support for complex as of yet
-	    // case ID::Complex:
-	    // 	return make_shared< Impl<ID::Complex> >();
-	    // 	break;
+	    case ID::Complex:
+		return make_shared< Impl<ID::Complex> >();
+		break;
 
-	    // case ID::DoubleComplex:
-	    // 	return make_shared< Impl<ID::DoubleComplex> >();
-	    // 	break;
+	    case ID::DoubleComplex:
+		return make_shared< Impl<ID::DoubleComplex> >();
+		break;
 
 	    case ID::UShort:
 		return make_shared< Impl<ID::UShort> >();
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <complex>
 
 #include <boost/core/scoped_enum.hpp>
 #include <boost/container/vector.hpp>
@@ -51,6 +52,8 @@ namespace misFITS {
 	SC_ULONG       = TULONG,
 	SC_USHORT      = TUSHORT,
 	SC_LOGICAL     = TLOGICAL,
+	SC_COMPLEX     = TCOMPLEX,
+	SC_DBLCOMPLEX  = TDBLCOMPLEX,
 	SC_UNDEF       = 0
     };
 
@@ -63,6 +66,20 @@ namespace misFITS {
     }
     BOOST_SCOPED_ENUM_DECLARE_END( HDU_Type)
 
+    BOOST_SCOPED_ENUM_DECLARE_BEGIN( BitPix )
+    {
+	Byte 	 = BYTE_IMG,
+	SByte    = SBYTE_IMG,
+	Short    = SHORT_IMG,
+	UShort   = USHORT_IMG,
+	Long     = LONG_IMG,
+	ULong    = ULONG_IMG,
+	LongLong = LONGLONG_IMG,
+	Float    = FLOAT_IMG,
+	Double   = DOUBLE_IMG
+    }
+    BOOST_SCOPED_ENUM_DECLARE_END( BitPix )
+
 
     template <typename T> struct StorageCode;
     template <> struct StorageCode<double>         {
@@ -121,6 +138,16 @@ namespace misFITS {
 	static unsigned char default_value () { return 0; }
     };
 
+    template <> struct StorageCode< std::complex<float> > {
+	static const StorageType type = SC_COMPLEX;
+	static std::complex<float> default_value () { return 0; }
+    };
+
+    template <> struct StorageCode< std::complex<double> > {
+	static const StorageType type = SC_DBLCOMPLEX;
+	static std::complex<double> default_value () { return 0; }
+    };
+
     template <> struct StorageCode<bool>          {
 	static const StorageType type = SC_LOGICAL;
 	static short default_value () { return 0; }
@@ -153,6 +180,8 @@ namespace misFITS {
     template <> struct NativeType<SC_ULONG>   { typedef unsigned long   storage_type; };
     template <> struct NativeType<SC_USHORT>  { typedef unsigned short  storage_type; };
     template <> struct NativeType<SC_LOGICAL> { typedef bool  		storage_type; };
+    template <> struct NativeType<SC_COMPLEX>    { typedef std::complex<float>  storage_type; };
+    template <> struct NativeType<SC_DBLCOMPLEX> { typedef std::complex<double> storage_type; };
 
 
 
@@ -199,9 +228,8 @@ namespace misFITS {
 	    template <> struct NativeType<ULong>   	    { typedef uint32_t 	  		storage_type; };
 
 
-	    // we don't  support complex types yet
-	    // template <> struct NativeType<Complex>       { typedef std::complex<float> 	storage_type; };
-	    // template <> struct NativeType<DoubleComplex> { typedef std::complex<double> 	storage_type; };
+	    template <> struct NativeType<Complex>          { typedef std::complex<float> 	storage_type; };
+	    template <> struct NativeType<DoubleComplex>    { typedef std::complex<double> 	storage_type; };
 
 	}
 
@@ -278,6 +306,50 @@ namespace misFITS {
     }
     BOOST_SCOPED_ENUM_DECLARE_END( FlushMode )
 
+    // when a File commits data written via Row or Image; see
+    // File::durability.  all of the writers to a file share a
+    // single commit.
+    struct Durability {
+
+	enum Policy {
+	    Never,	// only when explicitly flushed or closed
+	    Rows,	// once every rows rows
+	    Interval,	// on the first write after milliseconds have passed
+	    EachWrite	// after every write
+	};
+
+	Policy policy;
+	LONGLONG rows;
+	unsigned long milliseconds;
+	FlushMode mode;
+
+	Durability( Policy policy_ = Never, FlushMode mode_ = FlushMode::File ) :
+	    policy( policy_ ), rows( 0 ), milliseconds( 0 ), mode( mode_ ) {}
+
+	static Durability every_rows( LONGLONG rows, FlushMode mode = FlushMode::File ) {
+	    Durability durability( Rows, mode );
+	    durability.rows = rows;
+	    return durability;
+	}
+
+	static Durability every_interval( unsigned long milliseconds, FlushMode mode = FlushMode::File ) {
+	    Durability durability( Interval, mode );
+	    durability.milliseconds = milliseconds;
+	    return durability;
+	}
+    };
+
+    // the state of an HDU's DATASUM and CHECKSUM keywords; see
+    // File::verify_checksums.  the values follow fits_verify_chksum.
+    struct ChecksumStatus {
+
+	enum Result { Incorrect = -1, Missing = 0, Correct = 1 };
+
+	int hdu_num;
+	Result datasum;
+	Result checksum;
+    };
+
 }
 
 #endif // ! misFITS_TYPES_H
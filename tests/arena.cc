@@ -0,0 +1,97 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/config.hpp"
+#include "misfits/arena.hpp"
+
+using misFITS::Arena;
+
+// record the order in which objects are destroyed
+struct Tracked {
+
+    Tracked( int id, std::vector<int>* log, Arena& ) : id( id ), log( log ) {}
+    ~Tracked() { log->push_back( id ); }
+
+    int id;
+    std::vector<int>* log;
+    double aligned;
+};
+
+TEST( Arena, Alignment ) {
+
+    Arena arena;
+
+    for ( int i = 0 ; i < 100 ; ++i ) {
+	arena.allocate( 1, 1 );
+	void* ptr = arena.allocate( sizeof( double ), sizeof( double ) );
+	EXPECT_EQ( 0U, reinterpret_cast<std::size_t>( ptr ) % sizeof( double ) );
+    }
+}
+
+TEST( Arena, Blocks ) {
+
+    Arena arena( 1024 );
+
+    for ( int i = 0 ; i < 100 ; ++i )
+	arena.allocate( 8, 8 );
+    EXPECT_EQ( 1U, arena.num_blocks() );
+
+    // too big for a block
+    arena.allocate( 4096, 8 );
+    EXPECT_EQ( 2U, arena.num_blocks() );
+}
+
+TEST( Arena, Destruction ) {
+
+    std::vector<int> log;
+
+    {
+	Arena arena;
+	for ( int i = 0 ; i < 5 ; ++i ) {
+	    Tracked* tracked = arena.create<Tracked>( i, &log );
+	    EXPECT_EQ( i, tracked->id );
+	}
+	EXPECT_TRUE( log.empty() );
+    }
+
+    ASSERT_EQ( 5U, log.size() );
+    for ( int i = 0 ; i < 5 ; ++i )
+	EXPECT_EQ( 4 - i, log[i] );
+}
+
+TEST( Arena, Allocator ) {
+
+    Arena arena( 256 );
+
+    std::vector< int, Arena::Allocator<int> > values( ( Arena::Allocator<int>( arena ) ) );
+
+    for ( int i = 0 ; i < 1000 ; ++i )
+	values.push_back( i );
+
+    for ( int i = 0 ; i < 1000 ; ++i )
+	EXPECT_EQ( i, values[i] );
+
+    EXPECT_LT( 1U, arena.num_blocks() );
+}
@@ -0,0 +1,283 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+#include "misfits/arrow.hpp"
+
+using namespace misFITS::ColumnType;
+
+static bool bit( const void* buffer, int64_t idx ) {
+    return ( static_cast<const unsigned char*>( buffer )[idx / 8] >> ( idx % 8 ) ) & 1;
+}
+
+class ArrowTest : public ::testing::Test {
+
+protected:
+
+    ArrowTest() : table( "ARROW" ) {}
+
+    void SetUp() {
+
+	misFITS::ColumnInfo i( "i", ID::Short, "", misFITS::Extent( 1 ) );
+	i.has_tnull = true;
+	i.tnull = -1;
+
+	table.add( i )
+	    .add( "u", ID::UShort )
+	    .add( "v", ID::Float, misFITS::Extent( 3 ) )
+	    .add( "s", ID::String, 8 )
+	    .add( "l", ID::Logical )
+	    .add( "x", ID::Bit, misFITS::Extent( 10 ) );
+
+	short ival;
+	unsigned short u;
+	std::vector<float> v;
+	std::string s;
+	bool l;
+	misFITS::BitSet x( 10 ), ivalid( 1 ), vvalid( 3 );
+
+	misFITS::Row row( table );
+	row.add( "i", &ival, &ivalid )
+	    .add( "u", &u )
+	    .add( "v", &v, &vvalid )
+	    .add( "s", &s )
+	    .add( "l", &l )
+	    .add( "x", &x );
+
+	for ( int n = 0 ; n < nrows ; ++n ) {
+
+	    ival = static_cast<short>( n );
+	    ivalid[0] = n % 4 != 0;
+
+	    u = static_cast<unsigned short>( 60000 + n );
+
+	    for ( int j = 0 ; j < 3 ; ++j ) {
+		v[j] = n + j / 4.0f;
+		vvalid[j] = n != 2;
+	    }
+
+	    s = std::string( "row" ) + static_cast<char>( 'a' + n );
+	    l = n % 2;
+
+	    x.reset();
+	    x[n] = true;
+
+	    row.write();
+	}
+    }
+
+    static const int nrows = 10;
+    misFITS::Table table;
+};
+
+TEST_F( ArrowTest, Schema ) {
+
+    ArrowSchema schema;
+    ArrowArray array;
+
+    table.export_arrow( &schema, &array );
+
+    EXPECT_STREQ( "+s", schema.format );
+    ASSERT_EQ( 6, schema.n_children );
+
+    EXPECT_STREQ( "i", schema.children[0]->name );
+    EXPECT_STREQ( "s", schema.children[0]->format );
+    EXPECT_STREQ( "S", schema.children[1]->format );
+    EXPECT_STREQ( "+w:3", schema.children[2]->format );
+    ASSERT_EQ( 1, schema.children[2]->n_children );
+    EXPECT_STREQ( "f", schema.children[2]->children[0]->format );
+    EXPECT_STREQ( "w:8", schema.children[3]->format );
+    EXPECT_STREQ( "b", schema.children[4]->format );
+    EXPECT_STREQ( "+w:10", schema.children[5]->format );
+    EXPECT_STREQ( "b", schema.children[5]->children[0]->format );
+
+    EXPECT_EQ( nrows, array.length );
+    ASSERT_EQ( 6, array.n_children );
+
+    schema.release( &schema );
+    array.release( &array );
+
+    EXPECT_TRUE( NULL == schema.release );
+    EXPECT_TRUE( NULL == array.release );
+}
+
+TEST_F( ArrowTest, Values ) {
+
+    ArrowSchema schema;
+    ArrowArray array;
+
+    // skip the first two rows
+    table.export_arrow( &schema, &array, 3 );
+
+    const int first = 2;
+    const int64_t length = nrows - first;
+
+    ASSERT_EQ( length, array.length );
+
+    ArrowArray* i = array.children[0];
+    ArrowArray* u = array.children[1];
+    ArrowArray* v = array.children[2]->children[0];
+    ArrowArray* s = array.children[3];
+    ArrowArray* l = array.children[4];
+    ArrowArray* x = array.children[5]->children[0];
+
+    // rows 4 and 8 (n = 4, 8) are null
+    EXPECT_EQ( 2, i->null_count );
+    // row 3 (n = 2) is null
+    EXPECT_EQ( 3, v->null_count );
+    EXPECT_EQ( 0, u->null_count );
+    EXPECT_TRUE( NULL == u->buffers[0] );
+
+    ASSERT_EQ( 3 * length, v->length );
+    ASSERT_EQ( 10 * length, x->length );
+
+    for ( int64_t idx = 0 ; idx < length ; ++idx ) {
+
+	int n = static_cast<int>( idx ) + first;
+	SCOPED_TRACE( n );
+
+	EXPECT_EQ( n % 4 != 0, bit( i->buffers[0], idx ) );
+	if ( n % 4 ) {
+	    EXPECT_EQ( n, static_cast<const int16_t*>( i->buffers[1] )[idx] );
+	}
+
+	EXPECT_EQ( 60000 + n, static_cast<const uint16_t*>( u->buffers[1] )[idx] );
+
+	for ( int j = 0 ; j < 3 ; ++j ) {
+	    EXPECT_EQ( n != 2, bit( v->buffers[0], 3 * idx + j ) );
+	    if ( n != 2 ) {
+		EXPECT_EQ( n + j / 4.0f, static_cast<const float*>( v->buffers[1] )[3 * idx + j] );
+	    }
+	}
+
+	// strings retain their padding
+	std::string value( static_cast<const char*>( s->buffers[1] ) + 8 * idx, 8 );
+	value.erase( value.find_last_not_of( std::string( " \0", 2 ) ) + 1 );
+	EXPECT_EQ( std::string( "row" ) + static_cast<char>( 'a' + n ), value );
+
+	EXPECT_EQ( n % 2 == 1, bit( l->buffers[1], idx ) );
+
+	for ( int b = 0 ; b < 10 ; ++b )
+	    EXPECT_EQ( b == n, bit( x->buffers[1], 10 * idx + b ) );
+    }
+
+    schema.release( &schema );
+    array.release( &array );
+}
+
+TEST_F( ArrowTest, Columns ) {
+
+    ArrowSchema schema;
+    ArrowArray array;
+
+    std::vector<std::string> names;
+    names.push_back( "s" );
+    names.push_back( "i" );
+
+    table.export_arrow( &schema, &array, 1, 2, names );
+
+    ASSERT_EQ( 2, schema.n_children );
+    EXPECT_STREQ( "s", schema.children[0]->name );
+    EXPECT_STREQ( "i", schema.children[1]->name );
+    EXPECT_EQ( 2, array.length );
+    EXPECT_EQ( 2, array.children[1]->length );
+
+    schema.release( &schema );
+    array.release( &array );
+
+    EXPECT_THROW( table.export_arrow( &schema, &array, 5, 10 ), misFITS::Exception::Assert );
+}
+
+// a table with a single column is decoded in place and handed over,
+// unless the column is exported more than once
+TEST( Arrow, SingleColumn ) {
+
+    misFITS::Table ushort( "USHORT" );
+    ushort.add( "u", ID::UShort, misFITS::Extent( 2 ) );
+
+    misFITS::Table str( "STRING" );
+    str.add( "s", ID::String, 4 );
+
+    {
+	std::vector<unsigned short> u( 2 );
+	std::string s;
+
+	misFITS::Row urow( ushort );
+	urow.add( "u", &u );
+
+	misFITS::Row srow( str );
+	srow.add( "s", &s );
+
+	for ( int n = 0 ; n < 5 ; ++n ) {
+
+	    u[0] = static_cast<unsigned short>( 60000 + n );
+	    u[1] = static_cast<unsigned short>( n );
+	    urow.write();
+
+	    s = std::string( "abc" ) + static_cast<char>( 'a' + n );
+	    srow.write();
+	}
+    }
+
+    for ( int twice = 0 ; twice < 2 ; ++twice ) {
+
+	SCOPED_TRACE( twice );
+
+	std::vector<std::string> names( twice ? 2 : 1, "u" );
+
+	ArrowSchema schema;
+	ArrowArray array;
+
+	ushort.export_arrow( &schema, &array, 1, -1, names );
+
+	for ( int col = 0 ; col <= twice ; ++col ) {
+
+	    ArrowArray* u = array.children[col]->children[0];
+	    ASSERT_EQ( 10, u->length );
+
+	    for ( int n = 0 ; n < 5 ; ++n ) {
+		EXPECT_EQ( 60000 + n, static_cast<const uint16_t*>( u->buffers[1] )[2 * n] );
+		EXPECT_EQ( n, static_cast<const uint16_t*>( u->buffers[1] )[2 * n + 1] );
+	    }
+	}
+
+	schema.release( &schema );
+	array.release( &array );
+    }
+
+    ArrowSchema schema;
+    ArrowArray array;
+
+    str.export_arrow( &schema, &array );
+
+    ASSERT_EQ( 5, array.children[0]->length );
+    EXPECT_EQ( "abcbabccabcd", std::string( static_cast<const char*>( array.children[0]->buffers[1] ) + 4, 12 ) );
+
+    schema.release( &schema );
+    array.release( &array );
+}
@@ -0,0 +1,861 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// throughput benchmarks for misFITS, with the equivalent CFITSIO
+// calls as a baseline.  a synthetic table with the fiducial column set
+// is generated, and the results are written as JSON.
+//
+// usage: benchmark [-n nrows] [-r repeats] [-k nkeys] [-t ntables]
+//                  [-f scratch file] [-o output file]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <fitsio.h>
+
+#include <misfits/exception.hpp>
+#include <misfits/fits.hpp>
+#include <misfits/row.hpp>
+#include <misfits/stats.hpp>
+#include <misfits/table.hpp>
+
+#include "util.hpp"
+#include "fiducial_data.hpp"
+
+using namespace std;
+using namespace misFITS_Test;
+
+// only the public misFITS headers are used here, so CFITSIO calls
+// are checked locally
+#define CHECK_CFITSIO( expr )					\
+    do {							\
+	int status = 0;						\
+	expr;							\
+	if ( status )						\
+	    throw misFITS::Exception::CFITSIO( status );	\
+    } while (0)
+
+namespace {
+
+    struct Options {
+
+	LONGLONG nrows;
+	int repeats;
+	int nkeys;
+	int ntables;
+	string file;
+	string output;
+
+	Options() :
+	    nrows( 100000 ),
+	    repeats( 3 ),
+	    nkeys( 1000 ),
+	    ntables( 100 ),
+	    file( "benchmark.fits" ) {}
+    };
+
+    using misFITS::Stats;
+
+    struct Benchmark {
+
+	virtual ~Benchmark() {}
+
+	// setup and teardown aren't timed
+	virtual void setup() {}
+	virtual void run() = 0;
+	virtual void teardown() {}
+    };
+
+    // the fastest of the repeated runs
+    double
+    best_of( Benchmark& benchmark, int repeats ) {
+
+	double best = 0;
+
+	for ( int i = 0 ; i < repeats ; ++i ) {
+
+	    benchmark.setup();
+
+	    double start = Stats::now();
+	    benchmark.run();
+	    double elapsed = Stats::now() - start;
+
+	    benchmark.teardown();
+
+	    if ( i == 0 || elapsed < best )
+		best = elapsed;
+	}
+
+	return best;
+    }
+
+    struct Result {
+
+	string name;
+	string impl;
+	string column;
+
+	// what's counted; e.g. rows or keywords
+	string unit;
+	double count;
+	double nbytes;
+	double seconds;
+    };
+
+    class Results {
+
+    public:
+
+	void add( const string& name, const string& impl, const string& column,
+		  const string& unit, double count, double nbytes, double seconds ) {
+
+	    Result result = { name, impl, column, unit, count, nbytes, seconds };
+	    results_.push_back( result );
+	}
+
+	void json( ostream& os, const Options& opts, long rowlen ) const {
+
+	    os << "{\n"
+	       << "  \"nrows\": " << opts.nrows << ",\n"
+	       << "  \"row_bytes\": " << rowlen << ",\n"
+	       << "  \"repeats\": " << opts.repeats << ",\n"
+	       << "  \"results\": [\n";
+
+	    for ( vector<Result>::const_iterator result = results_.begin() ;
+		  result != results_.end() ; ++result ) {
+
+		double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+
+		os << "    { \"benchmark\": \"" << result->name << "\""
+		   << ", \"impl\": \"" << result->impl << "\"";
+
+		if ( ! result->column.empty() )
+		    os << ", \"column\": \"" << result->column << "\"";
+
+		os << ", \"" << result->unit << "\": " << result->count
+		   << ", \"bytes\": " << result->nbytes
+		   << ", \"seconds\": " << result->seconds
+		   << ", \"" << result->unit << "_per_sec\": " << result->count / seconds
+		   << ", \"mb_per_sec\": " << result->nbytes / seconds / 1e6
+		   << " }"
+		   << ( result + 1 == results_.end() ? "\n" : ",\n" );
+	    }
+
+	    os << "  ]\n"
+	       << "}\n";
+	}
+
+    private:
+	vector<Result> results_;
+    };
+
+
+    ///////////////////////////////
+    // synthetic table generator //
+    ///////////////////////////////
+
+    // write the fiducial table, then replicate its rows until there
+    // are nrows of them.
+    void
+    generate( const string& file, LONGLONG nrows ) {
+
+	// limit the size of the staging buffer
+	const LONGLONG max_block = 65536;
+
+	TestFitsPtr fpp( createFitsFile( file ) );
+	writeFidData( fpp, "stuff" );
+
+	fitsfile* fp = fpp.get();
+
+	LONGLONG have = Fiducial::Data::nrows;
+
+	if ( nrows < have ) {
+	    CHECK_CFITSIO( fits_delete_rows( fp, nrows + 1, have - nrows, &status ) );
+	    return;
+	}
+
+	LONGLONG rowlen;
+	CHECK_CFITSIO( fits_read_key( fp, TLONGLONG, "NAXIS1", &rowlen, NULL, &status ) );
+
+	vector<unsigned char> buffer;
+
+	while ( have < nrows ) {
+
+	    LONGLONG n = std::min( std::min( have, nrows - have ), max_block );
+	    buffer.resize( n * rowlen );
+
+	    CHECK_CFITSIO
+		(
+		 fits_read_tblbytes( fp, 1, 1, n * rowlen, &buffer[0], &status );
+		 fits_write_tblbytes( fp, have + 1, 1, n * rowlen, &buffer[0], &status );
+		 );
+
+	    have += n;
+	}
+    }
+
+    // CFITSIO type code and element size used to read or write a column
+    struct CfitsioType {
+
+	int datatype;
+	size_t size;
+
+	explicit CfitsioType( const misFITS::ColumnInfo& ci ) {
+
+	    switch ( ci.column_type->id() ) {
+
+	    case misFITS::ColumnType::ID::Short:
+		datatype = TSHORT;   size = sizeof( short );  break;
+	    case misFITS::ColumnType::ID::Long:
+		datatype = TINT;     size = sizeof( int );    break;
+	    case misFITS::ColumnType::ID::Float:
+		datatype = TFLOAT;   size = sizeof( float );  break;
+	    case misFITS::ColumnType::ID::Double:
+		datatype = TDOUBLE;  size = sizeof( double ); break;
+	    case misFITS::ColumnType::ID::Logical:
+		datatype = TLOGICAL; size = sizeof( char );   break;
+	    case misFITS::ColumnType::ID::Bit:
+		datatype = TBIT;     size = sizeof( char );   break;
+	    case misFITS::ColumnType::ID::String:
+		datatype = TSTRING;  size = sizeof( char );   break;
+	    default:
+		throw misFITS::Exception::Assert( "no benchmark for the type of column " + ci.ttype );
+	    }
+	}
+    };
+
+    // a cell's worth of CFITSIO data
+    struct CfitsioCell {
+
+	CfitsioType type;
+	LONGLONG nelem;
+	vector<char> buffer;
+	vector<char*> strings;
+
+	explicit CfitsioCell( const misFITS::ColumnInfo& ci ) :
+	    type( ci ) {
+
+	    if ( type.datatype == TSTRING ) {
+
+		// a single string spanning the cell
+		nelem = 1;
+		buffer.resize( ci.nbytes + 1 );
+		strings.push_back( &buffer[0] );
+	    }
+
+	    else {
+		nelem = ci.nelem();
+		buffer.resize( nelem * type.size );
+	    }
+	}
+
+	void* data() {
+	    return type.datatype == TSTRING
+		? static_cast<void*>( &strings[0] )
+		: static_cast<void*>( &buffer[0] );
+	}
+    };
+
+
+    ///////////////
+    // Row::read //
+    ///////////////
+
+    template< typename T >
+    class RowRead : public Benchmark {
+
+    public:
+	RowRead( misFITS::TablePtr& table, const string& column ) :
+	    table_( table ), column_( column ) {}
+
+	void run() {
+	    misFITS::Row row( table_ );
+	    row.add( column_, &value_ );
+	    while ( row.read() )
+		;
+	}
+
+    private:
+	misFITS::TablePtr table_;
+	string column_;
+	T value_;
+    };
+
+    class CfitsioRead : public Benchmark {
+
+    public:
+	CfitsioRead( fitsfile* fp, const misFITS::ColumnInfo& ci, LONGLONG nrows ) :
+	    fp_( fp ), colnum_( static_cast<int>( ci.colnum ) ), nrows_( nrows ), cell_( ci ) {}
+
+	void run() {
+
+	    int anynul;
+
+	    for ( LONGLONG row = 1 ; row <= nrows_ ; ++row )
+		CHECK_CFITSIO
+		    ( fits_read_col( fp_, cell_.type.datatype, colnum_, row, 1, cell_.nelem,
+				     NULL, cell_.data(), &anynul, &status ) );
+	}
+
+    private:
+	fitsfile* fp_;
+	int colnum_;
+	LONGLONG nrows_;
+	CfitsioCell cell_;
+    };
+
+
+    ////////////////
+    // Row::write //
+    ////////////////
+
+    // a table in a new memory file with a copy of the column
+    misFITS::TablePtr
+    single_column_table( const misFITS::ColumnInfo& ci ) {
+
+	misFITS::ColumnInfo copy = ci;
+	copy.colnum = 0;
+
+	misFITS::TablePtr table( new misFITS::Table( "bench" ) );
+	table->add( copy );
+	return table;
+    }
+
+    template< typename T >
+    class RowWrite : public Benchmark {
+
+    public:
+	RowWrite( misFITS::TablePtr& table, const string& column, LONGLONG nrows ) :
+	    column_( column ), info_( table->colinfo( column ) ), nrows_( nrows ) {
+
+	    // something representative to write
+	    misFITS::Row row( table );
+	    row.add( column_, &value_ );
+	    row.read( 1 );
+	}
+
+	void setup() {
+	    table_ = single_column_table( info_ );
+	}
+
+	void run() {
+	    misFITS::Row row( table_ );
+	    row.add( column_, &value_ );
+	    for ( LONGLONG i = 0 ; i < nrows_ ; ++i )
+		row.write();
+	    table_->flush();
+	}
+
+	void teardown() {
+	    table_.reset();
+	}
+
+    private:
+	string column_;
+	misFITS::ColumnInfo info_;
+	LONGLONG nrows_;
+	misFITS::TablePtr table_;
+	T value_;
+    };
+
+    class CfitsioWrite : public Benchmark {
+
+    public:
+	CfitsioWrite( fitsfile* fp, const misFITS::ColumnInfo& ci, LONGLONG nrows ) :
+	    ttype_( ci.ttype ), tform_( ci.tform() ), nrows_( nrows ), cell_( ci ), fp_( NULL ) {
+
+	    int anynul;
+	    CHECK_CFITSIO
+		( fits_read_col( fp, cell_.type.datatype, static_cast<int>( ci.colnum ), 1, 1,
+				 cell_.nelem, NULL, cell_.data(), &anynul, &status ) );
+	}
+
+	void setup() {
+
+	    char* ttype = const_cast<char*>( ttype_.c_str() );
+	    char* tform = const_cast<char*>( tform_.c_str() );
+
+	    CHECK_CFITSIO
+		(
+		 fits_create_file( &fp_, "mem://", &status );
+		 fits_create_tbl( fp_, BINARY_TBL, 0, 1, &ttype, &tform, NULL, "bench", &status );
+		 );
+	}
+
+	void run() {
+
+	    for ( LONGLONG row = 1 ; row <= nrows_ ; ++row )
+		CHECK_CFITSIO
+		    ( fits_write_col( fp_, cell_.type.datatype, 1, row, 1, cell_.nelem,
+				      cell_.data(), &status ) );
+
+	    CHECK_CFITSIO( fits_flush_buffer( fp_, 0, &status ) );
+	}
+
+	void teardown() {
+	    CHECK_CFITSIO( fits_close_file( fp_, &status ) );
+	    fp_ = NULL;
+	}
+
+    private:
+	string ttype_;
+	string tform_;
+	LONGLONG nrows_;
+	CfitsioCell cell_;
+	fitsfile* fp_;
+    };
+
+
+    //////////////
+    // keywords //
+    //////////////
+
+    string
+    keyname( int i ) {
+	ostringstream os;
+	os << "BENCH" << i;
+	return os.str();
+    }
+
+    class KeywordWrite : public Benchmark {
+
+    public:
+	explicit KeywordWrite( int nkeys ) : nkeys_( nkeys ) {}
+
+	void setup() {
+	    table_.reset( new misFITS::Table( "keys" ) );
+	}
+
+	void run() {
+	    for ( int i = 0 ; i < nkeys_ ; ++i )
+		table_->set_keyword( misFITS::keyword( keyname( i ), 1.0 * i ) );
+	}
+
+	void teardown() {
+	    table_.reset();
+	}
+
+    protected:
+	int nkeys_;
+	misFITS::TablePtr table_;
+    };
+
+    class KeywordRead : public KeywordWrite {
+
+    public:
+	explicit KeywordRead( int nkeys ) : KeywordWrite( nkeys ) {}
+
+	void setup() {
+	    KeywordWrite::setup();
+	    KeywordWrite::run();
+	}
+
+	void run() {
+	    double sum = 0;
+	    for ( int i = 0 ; i < nkeys_ ; ++i )
+		sum += table_->get_keyword<double>( keyname( i ) ).value;
+	}
+    };
+
+    class CfitsioKeywordWrite : public Benchmark {
+
+    public:
+	explicit CfitsioKeywordWrite( int nkeys ) : nkeys_( nkeys ), fp_( NULL ) {}
+
+	void setup() {
+	    CHECK_CFITSIO
+		(
+		 fits_create_file( &fp_, "mem://", &status );
+		 fits_create_tbl( fp_, BINARY_TBL, 0, 0, NULL, NULL, NULL, "keys", &status );
+		 );
+	}
+
+	void run() {
+	    for ( int i = 0 ; i < nkeys_ ; ++i ) {
+		double value = i;
+		CHECK_CFITSIO
+		    ( fits_update_key( fp_, TDOUBLE, keyname( i ).c_str(), &value, NULL, &status ) );
+	    }
+	}
+
+	void teardown() {
+	    CHECK_CFITSIO( fits_close_file( fp_, &status ) );
+	    fp_ = NULL;
+	}
+
+    protected:
+	int nkeys_;
+	fitsfile* fp_;
+    };
+
+    class CfitsioKeywordRead : public CfitsioKeywordWrite {
+
+    public:
+	explicit CfitsioKeywordRead( int nkeys ) : CfitsioKeywordWrite( nkeys ) {}
+
+	void setup() {
+	    CfitsioKeywordWrite::setup();
+	    CfitsioKeywordWrite::run();
+	}
+
+	void run() {
+	    double sum = 0;
+	    for ( int i = 0 ; i < nkeys_ ; ++i ) {
+		double value;
+		CHECK_CFITSIO
+		    ( fits_read_key( fp_, TDOUBLE, keyname( i ).c_str(), &value, NULL, &status ) );
+		sum += value;
+	    }
+	}
+    };
+
+
+    ////////////////////
+    // table creation //
+    ////////////////////
+
+    class CreateTable : public Benchmark {
+
+    public:
+	CreateTable( const misFITS::Table::Columns& columns, int ntables ) :
+	    columns_( columns ), ntables_( ntables ) {
+
+	    for ( misFITS::Table::Columns::iterator ci = columns_.begin() ;
+		  ci != columns_.end() ; ++ci )
+		ci->colnum = 0;
+	}
+
+	void run() {
+
+	    for ( int i = 0 ; i < ntables_ ; ++i ) {
+
+		misFITS::Table table( "bench" );
+
+		for ( misFITS::Table::Columns::const_iterator ci = columns_.begin() ;
+		      ci != columns_.end() ; ++ci )
+		    table.add( *ci );
+	    }
+	}
+
+    private:
+	misFITS::Table::Columns columns_;
+	int ntables_;
+    };
+
+    class CfitsioCreateTable : public Benchmark {
+
+    public:
+	CfitsioCreateTable( const misFITS::Table::Columns& columns, int ntables ) :
+	    ntables_( ntables ) {
+
+	    for ( misFITS::Table::Columns::const_iterator ci = columns.begin() ;
+		  ci != columns.end() ; ++ci ) {
+		ttype_.push_back( ci->ttype );
+		tform_.push_back( ci->tform() );
+	    }
+	}
+
+	void run() {
+
+	    vector<char*> ttype;
+	    vector<char*> tform;
+
+	    for ( vector<string>::size_type i = 0 ; i < ttype_.size() ; ++i ) {
+		ttype.push_back( const_cast<char*>( ttype_[i].c_str() ) );
+		tform.push_back( const_cast<char*>( tform_[i].c_str() ) );
+	    }
+
+	    for ( int i = 0 ; i < ntables_ ; ++i ) {
+
+		fitsfile* fp;
+
+		CHECK_CFITSIO
+		    (
+		     fits_create_file( &fp, "mem://", &status );
+		     fits_create_tbl( fp, BINARY_TBL, 0, static_cast<int>( ttype.size() ),
+				      &ttype[0], &tform[0], NULL, "bench", &status );
+		     fits_close_file( fp, &status );
+		     );
+	    }
+	}
+
+    private:
+	vector<string> ttype_;
+	vector<string> tform_;
+	int ntables_;
+    };
+
+
+    /////////////////
+    // column copy //
+    /////////////////
+
+    class CopyColumn : public Benchmark {
+
+    public:
+	CopyColumn( misFITS::TablePtr& table, const string& column ) :
+	    table_( table ), column_( column ) {}
+
+	void setup() {
+	    dest_.reset( new misFITS::Table( "dest" ) );
+	}
+
+	void run() {
+	    table_->copy_column( *dest_, column_ );
+	    dest_->flush();
+	}
+
+	void teardown() {
+	    dest_.reset();
+	}
+
+    private:
+	misFITS::TablePtr table_;
+	string column_;
+	misFITS::TablePtr dest_;
+    };
+
+    class CfitsioCopyColumn : public Benchmark {
+
+    public:
+	CfitsioCopyColumn( fitsfile* fp, const misFITS::ColumnInfo& ci ) :
+	    fp_( fp ), colnum_( static_cast<int>( ci.colnum ) ), dest_( NULL ) {}
+
+	void setup() {
+	    CHECK_CFITSIO
+		(
+		 fits_create_file( &dest_, "mem://", &status );
+		 fits_create_tbl( dest_, BINARY_TBL, 0, 0, NULL, NULL, NULL, "dest", &status );
+		 );
+	}
+
+	void run() {
+	    CHECK_CFITSIO
+		(
+		 fits_copy_col( fp_, dest_, colnum_, 1, TRUE, &status );
+		 fits_flush_buffer( dest_, 0, &status );
+		 );
+	}
+
+	void teardown() {
+	    CHECK_CFITSIO( fits_close_file( dest_, &status ) );
+	    dest_ = NULL;
+	}
+
+    private:
+	fitsfile* fp_;
+	int colnum_;
+	fitsfile* dest_;
+    };
+
+
+    ////////////
+    // driver //
+    ////////////
+
+    class Driver {
+
+    public:
+	Driver( const Options& opts ) :
+	    opts_( opts ), fp_( NULL ) {
+
+	    double start = Stats::now();
+	    generate( opts_.file, opts_.nrows );
+	    double elapsed = Stats::now() - start;
+
+	    file_ = misFITS::open<misFITS::Entity::Data, misFITS::Mode::ReadOnly>( opts_.file );
+	    table_ = file_->table();
+
+	    CHECK_CFITSIO
+		(
+		 fits_open_data( &fp_, opts_.file.c_str(), READONLY, &status );
+		 fits_read_key( fp_, TLONG, "NAXIS1", &rowlen_, NULL, &status );
+		 );
+
+	    results_.add( "generate", "cfitsio", "", "rows", opts_.nrows,
+			  static_cast<double>( opts_.nrows ) * rowlen_, elapsed );
+	}
+
+	~Driver() {
+	    int status = 0;
+	    fits_close_file( fp_, &status );
+	    table_.reset();
+	    file_.reset();
+	    std::remove( opts_.file.c_str() );
+	}
+
+	template< typename T >
+	void rows( const string& column ) {
+
+	    const misFITS::ColumnInfo& ci = table_->colinfo( column );
+	    double nbytes = static_cast<double>( opts_.nrows ) * ci.nbytes;
+
+	    RowRead<T> read( table_, column );
+	    results_.add( "row_read", "misfits", column, "rows", opts_.nrows, nbytes,
+			  best_of( read, opts_.repeats ) );
+
+	    CfitsioRead cread( fp_, ci, opts_.nrows );
+	    results_.add( "row_read", "cfitsio", column, "rows", opts_.nrows, nbytes,
+			  best_of( cread, opts_.repeats ) );
+
+	    RowWrite<T> write( table_, column, opts_.nrows );
+	    results_.add( "row_write", "misfits", column, "rows", opts_.nrows, nbytes,
+			  best_of( write, opts_.repeats ) );
+
+	    CfitsioWrite cwrite( fp_, ci, opts_.nrows );
+	    results_.add( "row_write", "cfitsio", column, "rows", opts_.nrows, nbytes,
+			  best_of( cwrite, opts_.repeats ) );
+
+	    CopyColumn copy( table_, column );
+	    results_.add( "copy_column", "misfits", column, "rows", opts_.nrows, nbytes,
+			  best_of( copy, opts_.repeats ) );
+
+	    CfitsioCopyColumn ccopy( fp_, ci );
+	    results_.add( "copy_column", "cfitsio", column, "rows", opts_.nrows, nbytes,
+			  best_of( ccopy, opts_.repeats ) );
+	}
+
+	void keywords() {
+
+	    double nbytes = 80.0 * opts_.nkeys;
+
+	    KeywordWrite write( opts_.nkeys );
+	    results_.add( "keyword_write", "misfits", "", "keywords", opts_.nkeys, nbytes,
+			  best_of( write, opts_.repeats ) );
+
+	    CfitsioKeywordWrite cwrite( opts_.nkeys );
+	    results_.add( "keyword_write", "cfitsio", "", "keywords", opts_.nkeys, nbytes,
+			  best_of( cwrite, opts_.repeats ) );
+
+	    KeywordRead read( opts_.nkeys );
+	    results_.add( "keyword_read", "misfits", "", "keywords", opts_.nkeys, nbytes,
+			  best_of( read, opts_.repeats ) );
+
+	    CfitsioKeywordRead cread( opts_.nkeys );
+	    results_.add( "keyword_read", "cfitsio", "", "keywords", opts_.nkeys, nbytes,
+			  best_of( cread, opts_.repeats ) );
+	}
+
+	void create() {
+
+	    misFITS::Table::Columns columns;
+	    for ( misFITS::Table::Columns::size_type colnum = 1 ; colnum <= table_->num_columns() ; ++colnum )
+		columns.push_back( table_->colinfo( colnum ) );
+
+	    // the header of each table
+	    double nbytes = 2880.0 * opts_.ntables;
+
+	    CreateTable create( columns, opts_.ntables );
+	    results_.add( "create_table", "misfits", "", "tables", opts_.ntables, nbytes,
+			  best_of( create, opts_.repeats ) );
+
+	    CfitsioCreateTable ccreate( columns, opts_.ntables );
+	    results_.add( "create_table", "cfitsio", "", "tables", opts_.ntables, nbytes,
+			  best_of( ccreate, opts_.repeats ) );
+	}
+
+	void json( ostream& os ) const {
+	    results_.json( os, opts_, rowlen_ );
+	}
+
+    private:
+	Options opts_;
+	misFITS::FilePtr file_;
+	misFITS::TablePtr table_;
+	fitsfile* fp_;
+	long rowlen_;
+	Results results_;
+    };
+
+    void
+    usage( const char* prog ) {
+	cerr << "usage: " << prog
+	     << " [-n nrows] [-r repeats] [-k nkeys] [-t ntables] [-f scratch file] [-o output file]\n";
+	exit( EXIT_FAILURE );
+    }
+}
+
+int main( int argc, char* argv[] ) {
+
+    Options opts;
+    int c;
+
+    while ( ( c = getopt( argc, argv, "n:r:k:t:f:o:" ) ) != -1 ) {
+
+	switch ( c ) {
+
+	case 'n': opts.nrows   = atoll( optarg ); break;
+	case 'r': opts.repeats = atoi( optarg );  break;
+	case 'k': opts.nkeys   = atoi( optarg );  break;
+	case 't': opts.ntables = atoi( optarg );  break;
+	case 'f': opts.file    = optarg;          break;
+	case 'o': opts.output  = optarg;          break;
+	default:  usage( argv[0] );
+	}
+    }
+
+    if ( opts.nrows < 1 || opts.repeats < 1 || opts.nkeys < 1 || opts.ntables < 1 )
+	usage( argv[0] );
+
+    try {
+
+	Driver driver( opts );
+
+	driver.rows< Fiducial::Data::I_TYPE >( "I1" );
+	driver.rows< vector<Fiducial::Data::I_TYPE> >( "IV1" );
+	driver.rows< Fiducial::Data::J_TYPE >( "J1" );
+	driver.rows< vector<Fiducial::Data::J_TYPE> >( "JV1" );
+	driver.rows< Fiducial::Data::E_TYPE >( "E1" );
+	driver.rows< vector<Fiducial::Data::E_TYPE> >( "EV1" );
+	driver.rows< Fiducial::Data::D_TYPE >( "D1" );
+	driver.rows< vector<Fiducial::Data::D_TYPE> >( "DV1" );
+	driver.rows< Fiducial::Data::L_TYPE >( "L1" );
+	driver.rows< vector<Fiducial::Data::L_TYPE> >( "LV1" );
+	driver.rows< misFITS::BitSet >( "X1" );
+	driver.rows< string >( "A1" );
+
+	driver.keywords();
+	driver.create();
+
+	if ( opts.output.empty() )
+	    driver.json( cout );
+
+	else {
+	    ofstream os( opts.output.c_str() );
+	    driver.json( os );
+	}
+    }
+
+    catch ( const std::exception& e ) {
+	cerr << argv[0] << ": " << e.what() << endl;
+	return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
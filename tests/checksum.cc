@@ -0,0 +1,234 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fitsio.h>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using namespace misFITS::ColumnType;
+
+namespace Entity = misFITS::Entity;
+namespace Mode = misFITS::Mode;
+
+// use CFITSIO to verify the checksums of the EVENTS table
+static void
+verify( const std::string& file ) {
+
+    int status = 0;
+    fitsfile* fptr;
+    int dataok, hduok;
+
+    fits_open_file( &fptr, ( file + "[EVENTS]" ).c_str(), READONLY, &status );
+    fits_verify_chksum( fptr, &dataok, &hduok, &status );
+    fits_close_file( fptr, &status );
+
+    ASSERT_EQ( 0, status );
+    EXPECT_EQ( 1, dataok );
+    EXPECT_EQ( 1, hduok );
+}
+
+class ChecksumTest : public ::testing::Test {
+
+protected:
+
+    ChecksumTest() : layout( "EVENTS" ) {}
+
+    void SetUp() {
+
+	// an odd row length, so that rows don't start on word
+	// boundaries
+	layout.add( "i", ID::Long ).add( "d", ID::Double, misFITS::Extent( 3 ) ).add( "s", ID::String, 7 );
+    }
+
+    void write( misFITS::TablePtr& table, int first, int last ) {
+
+	int ival;
+	std::vector<double> dval( 3 );
+	std::string sval;
+
+	misFITS::Row row( table );
+	row.add( "i", &ival ).add( "d", &dval ).add( "s", &sval );
+
+	for ( int n = first ; n <= last ; ++n ) {
+
+	    ival = n * 7919;
+	    dval[0] = n / 3.0; dval[1] = -n; dval[2] = n * 1e10;
+
+	    char s[8];
+	    std::sprintf( s, "r%d", n );
+	    sval = s;
+
+	    row.write( n );
+	}
+    }
+
+    misFITS::Table layout;
+};
+
+TEST_F( ChecksumTest, Append ) {
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "checksum.fits" );
+	misFITS::TablePtr table = file->add( layout );
+
+	table->track_datasum();
+	EXPECT_TRUE( table->tracks_datasum() );
+
+	write( table, 1, 1000 );
+	file->close();
+    }
+
+    verify( "checksum.fits" );
+}
+
+// overwrite rows in place, and change the layout of the table
+TEST_F( ChecksumTest, Update ) {
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "checksum.fits" );
+	misFITS::TablePtr table = file->add( layout );
+
+	table->track_datasum();
+
+	write( table, 1, 500 );
+	write( table, 3, 5 );
+	table->flush();
+
+	write( table, 100, 700 );
+
+	table->add( "x", ID::Short );
+	write( table, 1, 10 );
+	write( table, 701, 800 );
+    }
+
+    verify( "checksum.fits" );
+}
+
+// columns copied in by CFITSIO, after the checksums have been written
+TEST_F( ChecksumTest, CopyColumns ) {
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "checksum.fits" );
+	misFITS::TablePtr table = file->add( layout );
+
+	table->track_datasum();
+	write( table, 1, 100 );
+	table->flush();
+
+	misFITS::TablePtr src = file->add( misFITS::Table( "SRC" ).add( "x", ID::Short ) );
+	short x;
+	misFITS::Row row( src );
+	row.add( "x", &x );
+	for ( x = 1 ; x <= 100 ; ++x )
+	    row.write( x );
+
+	src->copy_column( *table, "x" );
+    }
+
+    verify( "checksum.fits" );
+}
+
+// tracking may be started after the table has been written
+TEST_F( ChecksumTest, Existing ) {
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "checksum.fits" );
+	misFITS::TablePtr table = file->add( layout );
+
+	write( table, 1, 100 );
+
+	table->track_datasum();
+	write( table, 50, 150 );
+    }
+
+    verify( "checksum.fits" );
+}
+
+TEST_F( ChecksumTest, Verify ) {
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "verify.fits" );
+
+	misFITS::TablePtr tracked = file->add( layout );
+	tracked->track_datasum();
+	write( tracked, 1, 1000 );
+
+	misFITS::TablePtr summed = file->add( layout );
+	write( summed, 1, 100 );
+	summed->write_checksum();
+    }
+
+    misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadOnly>( "verify.fits" );
+
+    std::vector<misFITS::ChecksumStatus> status = file->verify_checksums( 4 );
+    ASSERT_EQ( 3U, status.size() );
+
+    EXPECT_EQ( 1, status[0].hdu_num );
+    EXPECT_EQ( misFITS::ChecksumStatus::Missing, status[0].datasum );
+    EXPECT_EQ( misFITS::ChecksumStatus::Missing, status[0].checksum );
+
+    for ( int hdu = 2 ; hdu <= 3 ; ++hdu ) {
+	EXPECT_EQ( hdu, status[hdu-1].hdu_num );
+	EXPECT_EQ( misFITS::ChecksumStatus::Correct, status[hdu-1].datasum );
+	EXPECT_EQ( misFITS::ChecksumStatus::Correct, status[hdu-1].checksum );
+    }
+
+    file->close();
+
+    // corrupt the fill at the end of the last data unit
+    {
+	std::fstream fs( "verify.fits", std::ios::in | std::ios::out | std::ios::binary );
+	fs.seekp( -1, std::ios::end );
+	fs.put( 'x' );
+    }
+
+    file = misFITS::open<Entity::File, Mode::ReadOnly>( "verify.fits" );
+    status = file->verify_checksums();
+
+    EXPECT_EQ( misFITS::ChecksumStatus::Correct, status[1].datasum );
+    EXPECT_EQ( misFITS::ChecksumStatus::Correct, status[1].checksum );
+    EXPECT_EQ( misFITS::ChecksumStatus::Incorrect, status[2].datasum );
+    EXPECT_EQ( misFITS::ChecksumStatus::Incorrect, status[2].checksum );
+}
+
+// files in memory are verified by CFITSIO
+TEST_F( ChecksumTest, VerifyMemory ) {
+
+    misFITS::FilePtr file = layout.file();
+    misFITS::TablePtr table = file->table( 2 );
+
+    write( table, 1, 10 );
+    table->write_checksum();
+
+    std::vector<misFITS::ChecksumStatus> status = file->verify_checksums();
+    ASSERT_EQ( 2U, status.size() );
+    EXPECT_EQ( misFITS::ChecksumStatus::Correct, status[1].datasum );
+    EXPECT_EQ( misFITS::ChecksumStatus::Correct, status[1].checksum );
+}
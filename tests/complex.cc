@@ -0,0 +1,127 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <complex>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using namespace misFITS::ColumnType;
+
+typedef std::complex<float> cfloat;
+typedef std::complex<double> cdouble;
+
+class ComplexTest : public ::testing::Test {
+
+protected:
+
+    ComplexTest() : table( "MYEXTENT" ) {}
+
+    void SetUp() {
+
+	table.add( "c", ID::Complex );
+	table.add( "m", ID::DoubleComplex, misFITS::Extent( 3 ) );
+
+	cfloat c;
+	std::vector<cdouble> m;
+
+	misFITS::Row row( table );
+	row.add( "c", &c );
+	row.add( "m", &m );
+
+	for ( int i = 0 ; i < nrows ; ++i ) {
+
+	    c = cfloat( i, -i );
+	    for ( std::size_t j = 0 ; j < m.size() ; ++j )
+		m[j] = cdouble( i + j / 10.0, -( i + j / 100.0 ) );
+
+	    row.write();
+	}
+    }
+
+    static const int nrows = 10;
+    misFITS::Table table;
+};
+
+TEST_F( ComplexTest, ColumnInfo ) {
+
+    EXPECT_EQ( ID::Complex, table.colinfo( "c" ).column_type->id() );
+    EXPECT_EQ( "C", table.colinfo( "c" ).tform() );
+    EXPECT_EQ( 8, table.colinfo( "c" ).nbytes );
+
+    EXPECT_EQ( ID::DoubleComplex, table.colinfo( "m" ).column_type->id() );
+    EXPECT_EQ( "3M", table.colinfo( "m" ).tform() );
+    EXPECT_EQ( 48, table.colinfo( "m" ).nbytes );
+}
+
+TEST_F( ComplexTest, Read ) {
+
+    ASSERT_EQ( nrows, table.num_rows() );
+
+    cfloat c;
+    std::vector<cdouble> m;
+
+    misFITS::Row row( table );
+    row.add( "c", &c );
+    row.add( "m", &m );
+
+    for ( int i = 0 ; row.read() ; ++i ) {
+
+	SCOPED_TRACE( i );
+
+	EXPECT_EQ( cfloat( i, -i ), c );
+
+	ASSERT_EQ( 3, m.size() );
+	for ( std::size_t j = 0 ; j < m.size() ; ++j )
+	    EXPECT_EQ( cdouble( i + j / 10.0, -( i + j / 100.0 ) ), m[j] );
+    }
+}
+
+// reading into a different precision goes through CFITSIO
+TEST_F( ComplexTest, Convert ) {
+
+    cdouble c;
+    std::vector<cfloat> m;
+
+    misFITS::Row row( table );
+    row.add( "c", &c );
+    row.add( "m", &m );
+
+    int i = 0;
+    for ( ; row.read() ; ++i ) {
+
+	SCOPED_TRACE( i );
+
+	EXPECT_EQ( cdouble( i, -i ), c );
+
+	ASSERT_EQ( 3u, m.size() );
+	for ( std::size_t j = 0 ; j < m.size() ; ++j ) {
+	    EXPECT_FLOAT_EQ( static_cast<float>( i + j / 10.0 ), m[j].real() );
+	    EXPECT_FLOAT_EQ( static_cast<float>( -( i + j / 100.0 ) ), m[j].imag() );
+	}
+    }
+
+    EXPECT_EQ( nrows, i );
+}
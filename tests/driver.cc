@@ -0,0 +1,121 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include <misfits/fits.hpp>
+#include <misfits/table.hpp>
+#include <misfits/row.hpp>
+#include <misfits/driver.hpp>
+
+#include "util.hpp"
+
+using namespace misFITS;
+
+class DriverTest : public GenFits {
+
+protected:
+
+    // the contents of the file opened via the driver must match those
+    // read through CFITSIO's own driver
+    void compare( const std::string& url ) {
+
+	FilePtr expected_file( open<Entity::Data, Mode::ReadOnly>( TEST_FITS_QFILENAME ) );
+	FilePtr got_file( open<Entity::Data, Mode::ReadOnly>( url ) );
+
+	TablePtr expected_table( expected_file->table() );
+	TablePtr got_table( got_file->table() );
+
+	ASSERT_EQ( expected_table->num_rows(), got_table->num_rows() );
+	ASSERT_EQ( expected_table->num_columns(), got_table->num_columns() );
+
+	double expected_d1, got_d1;
+	std::vector<int> expected_jv1, got_jv1;
+	std::string expected_a1, got_a1;
+
+	Row expected( expected_table );
+	expected.add( "D1", &expected_d1 ).add( "JV1", &expected_jv1 ).add( "A1", &expected_a1 );
+
+	Row got( got_table );
+	got.add( "D1", &got_d1 ).add( "JV1", &got_jv1 ).add( "A1", &got_a1 );
+
+	while ( expected.read() ) {
+
+	    ASSERT_TRUE( got.read() );
+
+	    EXPECT_EQ( expected_d1, got_d1 );
+	    EXPECT_EQ( expected_jv1, got_jv1 );
+	    EXPECT_EQ( expected_a1, got_a1 );
+	}
+
+	EXPECT_FALSE( got.read() );
+    }
+};
+
+TEST_F( DriverTest, MemoryMap ) {
+
+    compare( std::string( "mfmap://" ) + TEST_FITS_QFILENAME );
+}
+
+TEST_F( DriverTest, Buffer ) {
+
+    std::ifstream is( TEST_FITS_QFILENAME, std::ios::binary );
+    std::vector<char> buffer( ( std::istreambuf_iterator<char>( is ) ),
+			      std::istreambuf_iterator<char>() );
+    ASSERT_FALSE( buffer.empty() );
+
+    compare( Driver::buffer_url( &buffer[0], buffer.size() ) );
+}
+
+// a buffer can only be reached through the URL made for it, and only
+// until that file is closed
+TEST_F( DriverTest, BufferRegistry ) {
+
+    std::ifstream is( TEST_FITS_QFILENAME, std::ios::binary );
+    std::vector<char> buffer( ( std::istreambuf_iterator<char>( is ) ),
+			      std::istreambuf_iterator<char>() );
+    ASSERT_FALSE( buffer.empty() );
+
+    std::string url = Driver::buffer_url( &buffer[0], buffer.size() );
+
+    {
+	FilePtr file( open<Entity::File, Mode::ReadOnly>( url ) );
+	EXPECT_THROW( ( open<Entity::File, Mode::ReadOnly>( url ) ), Exception::CFITSIO );
+    }
+
+    EXPECT_THROW( ( open<Entity::File, Mode::ReadOnly>( url ) ), Exception::CFITSIO );
+    EXPECT_THROW( ( open<Entity::File, Mode::ReadOnly>( "mfbuf://123456789" ) ), Exception::CFITSIO );
+    EXPECT_THROW( ( open<Entity::File, Mode::ReadOnly>( "mfbuf://7f0012340000_2880" ) ), Exception::CFITSIO );
+}
+
+TEST_F( DriverTest, ReadOnly ) {
+
+    EXPECT_THROW( ( open<Entity::File, Mode::ReadWrite>( std::string( "mfmap://" ) + TEST_FITS_QFILENAME ) ),
+		  Exception::CFITSIO );
+
+    EXPECT_THROW( ( open<Entity::File, Mode::ReadOnly>( "mfmap://no-such-file.fits" ) ),
+		  Exception::CFITSIO );
+}
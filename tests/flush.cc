@@ -19,11 +19,16 @@
 //
 // -->8-->8-->8-->8--
 
+#include <fstream>
+#include <iterator>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "misfits/fits.hpp"
 #include "misfits/table.hpp"
 #include "misfits/row.hpp"
+#include "misfits/driver.hpp"
 
 using namespace misFITS;
 
@@ -43,31 +48,213 @@ TEST( FlushTest, FlushAwayRay ) {
     row.add( "col1", &col1 );
     row.write();
 
+    // rows appended via Row are inserted by misFITS in geometrically
+    // growing blocks, so NAXIS2 counts the rows allocated, which may
+    // include reserved rows, until the table is flushed.
     Keyword<long> nrows = table.get_keyword<long>( "NAXIS2" );
-    ASSERT_EQ( 0, nrows.value );
+    ASSERT_EQ( 1, nrows.value );
+    ASSERT_EQ( 1, table.num_rows() );
 
-    // explicit buffer flush, doesn't affect NAXIS2 keyword
     table.flush( FlushMode::Buffer );
 
     nrows = table.get_keyword<long>( "NAXIS2" );
-    ASSERT_EQ( 0, nrows.value );
+    ASSERT_EQ( 1, nrows.value );
 
-    // explicit file flush, updates NAXIS2 keyword
     table.flush( FlushMode::File );
 
     nrows = table.get_keyword<long>( "NAXIS2" );
     ASSERT_EQ( 1, nrows.value );
 
+    row.write();
     row.write();
 
+    // room was made for a fourth row
     nrows = table.get_keyword<long>( "NAXIS2" );
-    ASSERT_EQ( 1, nrows.value );
+    ASSERT_EQ( 4, nrows.value );
+    ASSERT_EQ( 3, table.num_rows() );
 
-    // default flush (which is a file flush), updates NAXIS2 keyword
+    // default flush (which is a file flush) removes it
     table.flush( );
 
     nrows = table.get_keyword<long>( "NAXIS2" );
-    ASSERT_EQ( 2, nrows.value );
+    ASSERT_EQ( 3, nrows.value );
+    ASSERT_EQ( 3, table.num_rows() );
+
+}
+
+
+// commits are counted as flushes in the file's statistics
+class DurabilityTest : public ::testing::Test {
+
+protected:
+
+    DurabilityTest() : table( "MyEXTENT" ), row( table ), col1( 0 ) {}
+
+    void SetUp() {
+	table.add( "col1", ID::Double );
+	row.add( "col1", &col1 );
+	table.file()->reset_stats();
+    }
+
+    unsigned long long commits() {
+	return table.file()->stats()[Stats::Flush].calls;
+    }
+
+    long naxis2() {
+	return table.get_keyword<long>( "NAXIS2" ).value;
+    }
+
+    void write( int nrows ) {
+	while ( nrows-- )
+	    row.write();
+    }
+
+    misFITS::Table table;
+    misFITS::Row row;
+    double col1;
+};
+
+TEST_F( DurabilityTest, Never ) {
+
+    EXPECT_EQ( Durability::Never, table.file()->durability().policy );
+
+    write( 10 );
+    EXPECT_EQ( 0U, commits() );
+
+    table.file()->commit();
+    EXPECT_EQ( 1U, commits() );
+
+    // nothing new to commit
+    table.file()->commit();
+    EXPECT_EQ( 1U, commits() );
+}
+
+TEST_F( DurabilityTest, EachWrite ) {
+
+    table.file()->durability( Durability( Durability::EachWrite ) );
+
+    write( 3 );
+    EXPECT_EQ( 3U, commits() );
+}
+
+TEST_F( DurabilityTest, Rows ) {
+
+    table.file()->durability( Durability::every_rows( 5 ) );
+
+    write( 4 );
+    EXPECT_EQ( 0U, commits() );
+
+    write( 1 );
+    EXPECT_EQ( 1U, commits() );
+
+    EXPECT_THROW( table.file()->durability( Durability::every_rows( 0 ) ), Exception::Assert );
+}
+
+TEST_F( DurabilityTest, Interval ) {
+
+    table.file()->durability( Durability::every_interval( 3600 * 1000 ) );
 
+    write( 1 );
+    EXPECT_EQ( 0U, commits() );
+
+    // an explicit commit when writes pause
+    table.file()->commit();
+    EXPECT_EQ( 1U, commits() );
+
+    table.file()->durability( Durability::every_interval( 0 ) );
+
+    write( 1 );
+    EXPECT_EQ( 2U, commits() );
+}
+
+// all of the writers to a file share a commit
+TEST_F( DurabilityTest, GroupCommit ) {
+
+    misFITS::Table layout( "OTHER" );
+    layout.add( "col1", ID::Double );
+
+    FilePtr file = table.file();
+    TablePtr other = file->add( layout );
+
+    misFITS::Row other_row( other );
+    other_row.add( "col1", &col1 );
+
+    file->durability( Durability::every_rows( 4 ) );
+    file->reset_stats();
+
+    write( 2 );
+    other_row.write();
+    EXPECT_EQ( 0U, commits() );
+
+    other_row.write();
+    EXPECT_EQ( 1U, commits() );
+}
+
+// commits give up the rows reserved for appends, so that the header
+// describes only the rows written; after the first, no more than a
+// commit's worth of rows are reserved at a time
+TEST_F( DurabilityTest, Appends ) {
+
+    table.file()->durability( Durability::every_rows( 100 ) );
+
+    unsigned long long last = commits();
+
+    for ( long n = 1 ; n <= 10000 ; ++n ) {
+
+	row.write();
+
+	if ( commits() != last ) {
+	    ASSERT_EQ( n, naxis2() );
+	    last = commits();
+	}
+
+	else if ( n > 100 ) {
+	    ASSERT_LE( naxis2() - n, 100 );
+	}
+    }
+
+    EXPECT_EQ( 100U, commits() );
+    EXPECT_EQ( 10000, naxis2() );
+
+    table.file()->flush();
+    EXPECT_EQ( 10000, naxis2() );
 }
 
+// the file on disk after a commit, without a close, holds the rows
+// committed and no more
+TEST( DurabilityFile, Reopen ) {
+
+    FilePtr file = open<Entity::File, Mode::CreateOverWrite>( "durability.fits" );
+
+    misFITS::Table layout( "EVENTS" );
+    layout.add( "col1", ID::Double );
+    TablePtr table = file->add( layout );
+
+    file->durability( Durability::every_rows( 10 ) );
+
+    double col1;
+    misFITS::Row row( table );
+    row.add( "col1", &col1 );
+
+    for ( int n = 1 ; n <= 25 ; ++n ) {
+	col1 = n;
+	row.write();
+    }
+
+    std::ifstream is( "durability.fits", std::ios::binary );
+    std::vector<char> contents( ( std::istreambuf_iterator<char>( is ) ),
+				std::istreambuf_iterator<char>() );
+    ASSERT_FALSE( contents.empty() );
+
+    FilePtr committed_file = open<Entity::File, Mode::ReadOnly>( Driver::buffer_url( &contents[0], contents.size() ) );
+    TablePtr committed = committed_file->table( 2 );
+
+    EXPECT_EQ( 20, committed->get_keyword<long>( "NAXIS2" ).value );
+    ASSERT_EQ( 20, committed->num_rows() );
+
+    misFITS::Row committed_row( committed );
+    committed_row.add( "col1", &col1 );
+
+    for ( int n = 1 ; committed_row.read() ; ++n )
+	EXPECT_EQ( n, col1 );
+}
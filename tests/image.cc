@@ -0,0 +1,285 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/image.hpp"
+
+using misFITS::BitPix;
+using misFITS::Pixel;
+using misFITS::Section;
+
+namespace {
+
+    Pixel
+    pixel( LONGLONG x, LONGLONG y ) {
+	Pixel p( 2 );
+	p[0] = x;
+	p[1] = y;
+	return p;
+    }
+
+    // pixel values encode their (one based) position
+    std::vector<int>
+    pattern( LONGLONG nx, LONGLONG ny ) {
+
+	std::vector<int> data;
+	for ( LONGLONG y = 1 ; y <= ny ; ++y )
+	    for ( LONGLONG x = 1 ; x <= nx ; ++x )
+		data.push_back( static_cast<int>( 100 * y + x ) );
+	return data;
+    }
+}
+
+TEST( Image, Create ) {
+
+    misFITS::Image image( "EXPMAP", BitPix::Float, pixel( 10, 20 ) );
+
+    EXPECT_EQ( "EXPMAP", image.get_keyword<std::string>( "EXTNAME" ).value );
+    EXPECT_EQ( 1, image.get_keyword<int>( "EXTVER" ).value );
+    EXPECT_EQ( BitPix::Float, image.bitpix() );
+    EXPECT_EQ( 2, image.naxis() );
+    EXPECT_EQ( pixel( 10, 20 ), image.naxes() );
+    EXPECT_EQ( 200, image.nelem() );
+    EXPECT_FALSE( image.compressed() );
+}
+
+TEST( Image, ReadWrite ) {
+
+    misFITS::Image image( "IMAGE", BitPix::Long, pixel( 10, 20 ) );
+
+    std::vector<int> data = pattern( 10, 20 );
+    image.write( &data[0] );
+
+    // read back, converting type
+    std::vector<double> dbl( data.size() );
+    image.read( &dbl[0] );
+
+    for ( std::size_t idx = 0 ; idx < data.size() ; ++idx )
+	EXPECT_DOUBLE_EQ( data[idx], dbl[idx] );
+}
+
+TEST( Image, Section ) {
+
+    misFITS::Image image( "IMAGE", BitPix::Long, pixel( 10, 20 ) );
+
+    std::vector<int> data = pattern( 10, 20 );
+    image.write( &data[0] );
+
+    {
+	Section section( pixel( 2, 3 ), pixel( 4, 7 ) );
+	EXPECT_EQ( 15, section.nelem() );
+
+	std::vector<int> sub( section.nelem() );
+	image.read( section, &sub[0] );
+
+	std::vector<int>::const_iterator pix = sub.begin();
+	for ( int y = 3 ; y <= 7 ; ++y )
+	    for ( int x = 2 ; x <= 4 ; ++x )
+		EXPECT_EQ( 100 * y + x, *pix++ );
+    }
+
+    // strided
+    {
+	Section section( pixel( 1, 1 ), pixel( 10, 20 ), pixel( 3, 5 ) );
+	EXPECT_EQ( 16, section.nelem() );
+
+	std::vector<int> sub( section.nelem() );
+	image.read( section, &sub[0] );
+
+	std::vector<int>::const_iterator pix = sub.begin();
+	for ( int y = 1 ; y <= 20 ; y += 5 )
+	    for ( int x = 1 ; x <= 10 ; x += 3 )
+		EXPECT_EQ( 100 * y + x, *pix++ );
+    }
+
+    // write a section
+    {
+	Section section( pixel( 5, 5 ), pixel( 6, 6 ) );
+	std::vector<int> zero( section.nelem(), 0 );
+	image.write( section, &zero[0] );
+
+	image.read( &data[0] );
+	EXPECT_EQ( 0, data[ 4 * 10 + 4 ] );
+	EXPECT_EQ( 0, data[ 5 * 10 + 5 ] );
+	EXPECT_EQ( 504, data[ 4 * 10 + 3 ] );
+    }
+
+    // out of bounds
+    EXPECT_THROW( image.read( Section( pixel( 0, 1 ), pixel( 2, 2 ) ), &data[0] ),
+		  misFITS::Exception::Assert );
+    EXPECT_THROW( image.read( Section( pixel( 1, 1 ), pixel( 11, 2 ) ), &data[0] ),
+		  misFITS::Exception::Assert );
+
+    // no strided writes
+    EXPECT_THROW( image.write( Section( pixel( 1, 1 ), pixel( 10, 20 ), pixel( 2, 2 ) ), &data[0] ),
+		  misFITS::Exception::Assert );
+}
+
+TEST( Image, Map ) {
+
+    std::vector<int> data = pattern( 10, 20 );
+
+    misFITS::FilePtr file = misFITS::open<misFITS::Entity::File, misFITS::Mode::CreateOverWrite>( "image.fits" );
+
+    {
+	misFITS::Image image( "IMAGE", BitPix::Long, pixel( 10, 20 ) );
+	image.write( &data[0] );
+	file->add( image );
+    }
+
+    misFITS::ImagePtr image = file->image();
+
+    misFITS::ImageMapPtr map = image->map();
+
+    EXPECT_EQ( data.size() * sizeof( int ), map->size() );
+    EXPECT_FALSE( map->scaled() );
+
+    std::vector<int> mapped( data.size() );
+    map->read( &mapped[0] );
+    EXPECT_EQ( data, mapped );
+
+    // partial read
+    map->read( &mapped[0], 15, 5 );
+    EXPECT_EQ( data[15], mapped[0] );
+    EXPECT_EQ( data[19], mapped[4] );
+
+    // must match BITPIX exactly
+    std::vector<short> wrong( data.size() );
+    EXPECT_THROW( map->read( &wrong[0] ), misFITS::Exception::Assert );
+
+    // memory files can't be mapped
+    misFITS::Image mem( "IMAGE", BitPix::Long, pixel( 10, 20 ) );
+    EXPECT_THROW( mem.map(), misFITS::Exception::Assert );
+}
+
+// write a tile compressed image and make sure the parallel reader
+// returns the same pixels as CFITSIO would
+static void
+test_compressed( const std::string& spec, BitPix bitpix ) {
+
+    std::vector<int> data = pattern( 23, 17 );
+
+    {
+	misFITS::FilePtr file = misFITS::open<misFITS::Entity::File, misFITS::Mode::CreateOverWrite>( "tiled.fits" + spec );
+
+	misFITS::Image image( "IMAGE", bitpix, pixel( 23, 17 ) );
+	image.write( &data[0] );
+	file->add( image );
+    }
+
+    misFITS::FilePtr file = misFITS::open<misFITS::Entity::File, misFITS::Mode::ReadOnly>( "tiled.fits" );
+    misFITS::ImagePtr image = file->image( "IMAGE" );
+
+    ASSERT_TRUE( image->compressed() );
+    EXPECT_EQ( pixel( 23, 17 ), image->naxes() );
+
+    image->num_threads( 4 );
+
+    std::vector<int> all( data.size() );
+    image->read( &all[0] );
+    EXPECT_EQ( data, all );
+
+    // a section spanning several tiles
+    {
+	Section section( pixel( 3, 4 ), pixel( 21, 13 ) );
+	std::vector<double> sub( section.nelem() );
+	image->read( section, &sub[0] );
+
+	std::vector<double>::const_iterator pix = sub.begin();
+	for ( int y = 4 ; y <= 13 ; ++y )
+	    for ( int x = 3 ; x <= 21 ; ++x )
+		EXPECT_DOUBLE_EQ( 100 * y + x, *pix++ );
+    }
+
+    // strided, skipping some tiles entirely
+    {
+	Section section( pixel( 2, 1 ), pixel( 23, 17 ), pixel( 4, 6 ) );
+	std::vector<int> sub( section.nelem() );
+	image->read( section, &sub[0] );
+
+	std::vector<int>::const_iterator pix = sub.begin();
+	for ( int y = 1 ; y <= 17 ; y += 6 )
+	    for ( int x = 2 ; x <= 23 ; x += 4 )
+		EXPECT_EQ( 100 * y + x, *pix++ );
+    }
+
+    // compressed images can't be mapped
+    EXPECT_THROW( image->map(), misFITS::Exception::Assert );
+}
+
+TEST( Image, Rice ) {
+
+    test_compressed( "[compress R 5,3]", BitPix::Long );
+    test_compressed( "[compress R 5,3]", BitPix::Short );
+}
+
+TEST( Image, Gzip ) {
+
+    test_compressed( "[compress G 5,3]", BitPix::Long );
+    test_compressed( "[compress G 5,3; q 0]", BitPix::Float );
+}
+
+// pixels which don't fit in the output type are clamped and
+// reported, as CFITSIO does
+TEST( Image, Overflow ) {
+
+    std::vector<int> data = pattern( 23, 17 );
+
+    {
+	misFITS::FilePtr file = misFITS::open<misFITS::Entity::File, misFITS::Mode::CreateOverWrite>( "tiled.fits[compress R 5,3]" );
+
+	misFITS::Image image( "IMAGE", BitPix::Long, pixel( 23, 17 ) );
+	image.write( &data[0] );
+	file->add( image );
+    }
+
+    misFITS::FilePtr file = misFITS::open<misFITS::Entity::File, misFITS::Mode::ReadOnly>( "tiled.fits" );
+    misFITS::ImagePtr image = file->image( "IMAGE" );
+    image->num_threads( 4 );
+
+    std::vector<short> wide( data.size() );
+    image->read( &wide[0] );
+    EXPECT_EQ( std::vector<short>( data.begin(), data.end() ), wide );
+
+    std::vector<unsigned char> narrow( data.size() );
+
+    try {
+	image->read( &narrow[0] );
+	FAIL() << "expected NUM_OVERFLOW";
+    }
+    catch ( misFITS::Exception::CFITSIO& e ) {
+	EXPECT_EQ( NUM_OVERFLOW, e.status() );
+    }
+
+    for ( std::size_t idx = 0 ; idx < data.size() ; ++idx )
+	EXPECT_EQ( std::min( data[idx], 255 ), narrow[idx] );
+}
+
+// HCOMPRESS isn't decoded by misFITS, so this goes through CFITSIO
+TEST( Image, HCompress ) {
+
+    test_compressed( "[compress H 6,6]", BitPix::Long );
+}
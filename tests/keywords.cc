@@ -21,11 +21,17 @@
 
 #include "gtest/gtest.h"
 
+#include <cstdlib>
+#include <sstream>
+
 #include "util.hpp"
+#include "fiducial_data.hpp"
 
 #include "misfits/fits.hpp"
 #include "misfits/table.hpp"
 #include "misfits/keyword.hpp"
+#include "misfits/header_edit.hpp"
+#include "misfits/row.hpp"
 
 namespace Entity = misFITS::Entity;
 namespace Mode = misFITS::Mode;
@@ -84,6 +90,128 @@ TEST_F( FiducialTableRWFptr, deleteKeyword ) {
 
 }
 
+TEST( Keywords, headerEdit ) {
+
+    misFITS::Table table( "MYEXTENT" );
+
+    misFITS::HeaderEdit edit( table );
+
+    edit.set_keyword( misFITS::keyword<double>( "PIE", 3.14159 ) )
+	.set_keyword( misFITS::keyword<std::string>( "LONG", std::string( 1000, 'X' ) ) )
+	.add_history( "baked" )
+	.add_comment( std::string( 200, 'C' ) );
+
+    EXPECT_EQ( 4, edit.size() );
+
+    // nothing is written until the edit is committed
+    EXPECT_FALSE( table.has_keyword( "PIE" ) );
+    EXPECT_FALSE( table.has_keyword( "LONG" ) );
+
+    edit.commit();
+    EXPECT_TRUE( edit.empty() );
+
+    EXPECT_DOUBLE_EQ( 3.14159, table.get_keyword<double>( "PIE" ).value );
+    EXPECT_EQ( std::string( 1000, 'X' ), table.get_keyword<std::string>( "LONG" ).value );
+
+    edit.delete_keyword( "PIE" )
+	.set_keyword( misFITS::keyword<int>( "PIE", 3 ) );
+    edit.commit();
+
+    EXPECT_EQ( 3, table.get_keyword<int>( "PIE" ).value );
+}
+
+// a failed edit leaves the header as it was
+TEST( Keywords, headerEditRollback ) {
+
+    misFITS::Table table( "MYEXTENT" );
+    table.set_keyword( misFITS::keyword<int>( "PIE", 3 ) );
+
+    int nkeys = table.get_hdrpos().first;
+
+    misFITS::HeaderEdit edit( table );
+
+    edit.set_keyword( misFITS::keyword<double>( "PIE", 3.14159 ) )
+	.add_history( "baked" )
+	.delete_keyword( "NONESUCH" );
+
+    EXPECT_THROW( edit.commit(), misFITS::Exception::CFITSIO );
+
+    EXPECT_EQ( nkeys, table.get_hdrpos().first );
+    EXPECT_EQ( 3, table.get_keyword<int>( "PIE" ).value );
+    EXPECT_EQ( 3, edit.size() );
+
+    // without the failing edit, only the new records are added
+    edit.clear();
+    edit.add_history( "baked" );
+    edit.commit();
+
+    EXPECT_EQ( nkeys + 1, table.get_hdrpos().first );
+}
+
+TEST_F( FiducialTableRWFptr, headerEditProvenance ) {
+
+    using namespace misFITS_Test;
+
+    misFITS::Table table( file );
+
+    std::pair<int,int> hdrpos = table.get_hdrpos();
+
+    misFITS::HeaderEdit edit( table );
+
+    // enough keywords to spill over several header blocks
+    for ( int i = 0 ; i < 100 ; ++i ) {
+
+	std::ostringstream keyname;
+	keyname << "PROV" << i;
+	edit.set_keyword( misFITS::keyword<int>( keyname.str(), i, "provenance" ) );
+    }
+
+    EXPECT_EQ( hdrpos, table.get_hdrpos() );
+
+    edit.commit();
+
+    EXPECT_EQ( hdrpos.first + 100, table.get_hdrpos().first );
+    EXPECT_EQ( 42, table.get_keyword<int>( "PROV42" ).value );
+
+    // the data unit must have survived the move
+    Fiducial::Data fid;
+
+    misFITS::Row row( table );
+
+    double d1;
+    row.add( "d1", &d1 );
+
+    while ( row.read() )
+	EXPECT_DOUBLE_EQ( fid.d1.data[ static_cast<std::size_t>(row.idx()) - 2 ], d1 );
+
+    EXPECT_EQ( static_cast<LONGLONG>( Fiducial::Data::nrows ), row.idx() - 1 );
+}
+
+TEST_F( FiducialTableROFptr, iterate ) {
+
+    misFITS::TablePtr table = file->table();
+
+    misFITS::KeywordIterator kw( table );
+    misFITS::KeywordIterator end( kw.end() );
+
+    int nkeys = 0;
+    bool found = false;
+
+    for ( ; kw != end ; ++kw, ++nkeys ) {
+
+	EXPECT_EQ( 80, kw.card().size() );
+	EXPECT_EQ( (*kw).keyname, kw.keyname().to_string() );
+
+	if ( kw.keyname() == "PIE" ) {
+	    found = true;
+	    EXPECT_DOUBLE_EQ( 3.14159, std::atof( (*kw).value.c_str() ) );
+	}
+    }
+
+    EXPECT_TRUE( found );
+    EXPECT_EQ( table->get_hdrpos().first, nkeys );
+    EXPECT_EQ( "XTENSION", misFITS::KeywordIterator( table ).keyname() );
+}
 
 // TODO:
 
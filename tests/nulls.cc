@@ -0,0 +1,207 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using namespace misFITS::ColumnType;
+
+// every third element of a row is null, starting with the row number
+static bool is_null( int row, int elem ) { return ( row + elem ) % 3 == 0; }
+
+class NullTest : public ::testing::Test {
+
+protected:
+
+    NullTest() : table( "NULLS" ) {}
+
+    void SetUp() {
+
+	misFITS::ColumnInfo i( "i", ID::Short, "", misFITS::Extent( 1 ) );
+	i.has_tnull = true;
+	i.tnull = -1;
+
+	misFITS::ColumnInfo v( "v", ID::Long, "", misFITS::Extent( 4 ) );
+	v.has_tnull = true;
+	v.tnull = 99;
+
+	table.add( i ).add( v ).add( "d", ID::Double, misFITS::Extent( 3 ) );
+
+	short ival;
+	std::vector<int> vval;
+	std::vector<double> dval;
+	misFITS::BitSet ivalid, vvalid, dvalid;
+
+	misFITS::Row row( table );
+	row.add( "i", &ival, &ivalid )
+	    .add( "v", &vval, &vvalid )
+	    .add( "d", &dval, &dvalid );
+
+	for ( int n = 0 ; n < nrows ; ++n ) {
+
+	    ival = static_cast<short>( n );
+	    ivalid.resize( 1 );
+	    ivalid[0] = ! is_null( n, 0 );
+
+	    vvalid.resize( vval.size() );
+	    for ( std::size_t j = 0 ; j < vval.size() ; ++j ) {
+		vval[j] = n * 10 + static_cast<int>( j );
+		vvalid[j] = ! is_null( n, static_cast<int>( j ) );
+	    }
+
+	    dvalid.resize( dval.size() );
+	    for ( std::size_t j = 0 ; j < dval.size() ; ++j ) {
+		dval[j] = n + j / 10.0;
+		dvalid[j] = ! is_null( n, static_cast<int>( j ) );
+	    }
+
+	    row.write();
+	}
+    }
+
+    static const int nrows = 10;
+    misFITS::Table table;
+};
+
+TEST_F( NullTest, ColumnInfo ) {
+
+    EXPECT_TRUE( table.colinfo( "i" ).has_tnull );
+    EXPECT_EQ( -1, table.colinfo( "i" ).tnull );
+
+    EXPECT_TRUE( table.colinfo( "v" ).has_tnull );
+    EXPECT_EQ( 99, table.colinfo( "v" ).tnull );
+
+    EXPECT_FALSE( table.colinfo( "d" ).has_tnull );
+}
+
+// nulls are written as TNULLn or NaN
+TEST_F( NullTest, Stored ) {
+
+    short ival;
+    std::vector<int> vval;
+    std::vector<double> dval;
+
+    misFITS::Row row( table );
+    row.add( "i", &ival ).add( "v", &vval ).add( "d", &dval );
+
+    for ( int n = 0 ; row.read() ; ++n ) {
+
+	SCOPED_TRACE( n );
+
+	EXPECT_EQ( is_null( n, 0 ) ? -1 : n, ival );
+
+	for ( std::size_t j = 0 ; j < vval.size() ; ++j )
+	    EXPECT_EQ( is_null( n, static_cast<int>( j ) ) ? 99 : n * 10 + static_cast<int>( j ), vval[j] );
+
+	for ( std::size_t j = 0 ; j < dval.size() ; ++j )
+	    EXPECT_EQ( is_null( n, static_cast<int>( j ) ), dval[j] != dval[j] );
+    }
+}
+
+// both the conversions performed by misFITS and those performed by
+// CFITSIO must detect the same nulls
+template< typename I, typename V, typename D >
+static void
+check_validity( misFITS::Table& table, int nrows ) {
+
+    I ival;
+    std::vector<V> vval;
+    std::vector<D> dval;
+    misFITS::BitSet ivalid, vvalid, dvalid;
+
+    misFITS::Row row( table );
+    row.add( "i", &ival, &ivalid )
+	.add( "v", &vval, &vvalid )
+	.add( "d", &dval, &dvalid );
+
+    int n;
+    for ( n = 0 ; row.read() ; ++n ) {
+
+	SCOPED_TRACE( n );
+
+	ASSERT_EQ( 1, ivalid.size() );
+	EXPECT_EQ( ! is_null( n, 0 ), ivalid[0] );
+	if ( ivalid[0] ) {
+	    EXPECT_EQ( n, ival );
+	}
+
+	ASSERT_EQ( 4, vvalid.size() );
+	for ( std::size_t j = 0 ; j < vvalid.size() ; ++j ) {
+	    EXPECT_EQ( ! is_null( n, static_cast<int>( j ) ), vvalid[j] );
+	    if ( vvalid[j] ) {
+		EXPECT_EQ( n * 10 + static_cast<int>( j ), vval[j] );
+	    }
+	}
+
+	ASSERT_EQ( 3, dvalid.size() );
+	for ( std::size_t j = 0 ; j < dvalid.size() ; ++j ) {
+	    EXPECT_EQ( ! is_null( n, static_cast<int>( j ) ), dvalid[j] );
+	    if ( dvalid[j] ) {
+		EXPECT_FLOAT_EQ( static_cast<D>( n + j / 10.0 ), dval[j] );
+	    }
+	}
+    }
+
+    EXPECT_EQ( nrows, n );
+}
+
+TEST_F( NullTest, Decoded ) {
+    check_validity< short, int, double >( table, nrows );
+}
+
+TEST_F( NullTest, CFITSIO ) {
+    check_validity< char, short, float >( table, nrows );
+}
+
+// the bitmap is packed least significant bit first
+TEST_F( NullTest, Layout ) {
+
+    std::vector<int> vval;
+    misFITS::BitSet valid;
+
+    misFITS::Row row( table );
+    row.add( "v", &vval, &valid );
+    row.read( 2 );
+
+    std::vector<misFITS::byte_t> blocks( valid.num_blocks() );
+    boost::to_block_range( valid, blocks.begin() );
+
+    // row 2 (n = 1): element 2 is null
+    ASSERT_EQ( 1, blocks.size() );
+    EXPECT_EQ( 0x0b, blocks[0] );
+}
+
+TEST_F( NullTest, Unsupported ) {
+
+    bool flag;
+    misFITS::BitSet valid;
+
+    table.add( "l", ID::Logical );
+
+    misFITS::Row row( table );
+    EXPECT_THROW( row.add( "l", &flag, &valid ), misFITS::Exception::Assert );
+}
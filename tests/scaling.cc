@@ -0,0 +1,286 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <string>
+#include <vector>
+
+#include <fitsio.h>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+namespace Entity = misFITS::Entity;
+namespace Mode = misFITS::Mode;
+
+static const int NRows = 100;
+
+static unsigned short u16_value( int n ) { return static_cast<unsigned short>( n * 655 ); }
+static unsigned int u32_value( int n ) { return static_cast<unsigned int>( n ) * 42949672U; }
+static short s8_value( int n ) { return static_cast<short>( 2 * n - 100 ); }
+
+// TSCAL = 0.5, TZERO = 100
+static int scaled_raw( int n ) { return 2 * n - 50; }
+static double scaled_value( int n ) { return n + 75; }
+
+// TSCAL = 2
+static double vec_value( int n, int i ) { return n + i / 4.0; }
+
+// use CFITSIO to write a table with columns stored using the TZERO
+// offset convention for unsigned and signed byte values, and columns
+// with arbitrary scaling.
+static void
+make_table( const std::string& file ) {
+
+    int status = 0;
+    fitsfile* fptr;
+
+    char* ttype[] = { (char*) "u16", (char*) "u32", (char*) "s8", (char*) "scaled", (char*) "vec" };
+    char* tform[] = { (char*) "U", (char*) "V", (char*) "S", (char*) "J", (char*) "3E" };
+
+    fits_create_file( &fptr, ( "!" + file ).c_str(), &status );
+    fits_create_tbl( fptr, BINARY_TBL, 0, 5, ttype, tform, NULL, "SCALED", &status );
+
+    double tscal = 0.5;
+    double tzero = 100;
+    double vscal = 2;
+    fits_write_key( fptr, TDOUBLE, "TSCAL4", &tscal, NULL, &status );
+    fits_write_key( fptr, TDOUBLE, "TZERO4", &tzero, NULL, &status );
+    fits_write_key( fptr, TDOUBLE, "TSCAL5", &vscal, NULL, &status );
+    fits_set_hdustruc( fptr, &status );
+
+    for ( int n = 0 ; n < NRows ; ++n ) {
+
+	unsigned short u16 = u16_value( n );
+	unsigned int u32 = u32_value( n );
+	short s8 = s8_value( n );
+	double scaled = scaled_value( n );
+	double vec[3];
+	for ( int i = 0 ; i < 3 ; ++i )
+	    vec[i] = vec_value( n, i );
+
+	fits_write_col( fptr, TUSHORT, 1, n + 1, 1, 1, &u16, &status );
+	fits_write_col( fptr, TUINT, 2, n + 1, 1, 1, &u32, &status );
+	fits_write_col( fptr, TSHORT, 3, n + 1, 1, 1, &s8, &status );
+	fits_write_col( fptr, TDOUBLE, 4, n + 1, 1, 1, &scaled, &status );
+	fits_write_col( fptr, TDOUBLE, 5, n + 1, 1, 3, vec, &status );
+    }
+
+    fits_close_file( fptr, &status );
+
+    ASSERT_EQ( 0, status );
+}
+
+// what CFITSIO makes of a column
+template< typename T >
+static std::vector<T>
+cfitsio_read( const std::string& file, int colnum, int nelem = 1 ) {
+
+    int status = 0;
+    fitsfile* fptr;
+
+    std::vector<T> data( NRows * nelem );
+
+    fits_open_file( &fptr, ( file + "[SCALED]" ).c_str(), READONLY, &status );
+    fits_read_col( fptr, misFITS::StorageCode<T>::type, colnum, 1, 1, NRows * nelem,
+		   NULL, &data[0], NULL, &status );
+    fits_close_file( fptr, &status );
+
+    EXPECT_EQ( 0, status );
+    return data;
+}
+
+// read a scalar column via a Row
+template< typename T >
+static std::vector<T>
+row_read( misFITS::Table& table, const std::string& name, bool raw = false ) {
+
+    std::vector<T> data;
+    T value;
+
+    misFITS::Row row( table );
+    row.raw( raw );
+    row.add( name, &value );
+
+    while ( row.read() )
+	data.push_back( value );
+
+    return data;
+}
+
+class ScalingTest : public ::testing::Test {
+
+protected:
+
+    void SetUp() {
+	make_table( "scaling.fits" );
+	file = misFITS::open<Entity::File, Mode::ReadOnly>( "scaling.fits" );
+	table = file->table( "SCALED" );
+    }
+
+    misFITS::FilePtr file;
+    misFITS::TablePtr table;
+};
+
+TEST_F( ScalingTest, ColumnInfo ) {
+
+    EXPECT_EQ( 32768, table->colinfo( "u16" ).tzero );
+    EXPECT_EQ( 2147483648.0, table->colinfo( "u32" ).tzero );
+    EXPECT_EQ( -128, table->colinfo( "s8" ).tzero );
+    EXPECT_EQ( 0.5, table->colinfo( "scaled" ).tscal );
+    EXPECT_EQ( 100, table->colinfo( "scaled" ).tzero );
+}
+
+// results must match CFITSIO's, whether or not the conversion is done
+// by misFITS
+TEST_F( ScalingTest, Offset ) {
+
+    EXPECT_EQ( cfitsio_read<unsigned short>( "scaling.fits", 1 ), row_read<unsigned short>( *table, "u16" ) );
+    EXPECT_EQ( cfitsio_read<int>( "scaling.fits", 1 ), row_read<int>( *table, "u16" ) );
+    EXPECT_EQ( cfitsio_read<double>( "scaling.fits", 1 ), row_read<double>( *table, "u16" ) );
+
+    EXPECT_EQ( cfitsio_read<unsigned int>( "scaling.fits", 2 ), row_read<unsigned int>( *table, "u32" ) );
+    EXPECT_EQ( cfitsio_read<LONGLONG>( "scaling.fits", 2 ), row_read<LONGLONG>( *table, "u32" ) );
+    EXPECT_EQ( cfitsio_read<double>( "scaling.fits", 2 ), row_read<double>( *table, "u32" ) );
+
+    EXPECT_EQ( cfitsio_read<short>( "scaling.fits", 3 ), row_read<short>( *table, "s8" ) );
+    EXPECT_EQ( cfitsio_read<float>( "scaling.fits", 3 ), row_read<float>( *table, "s8" ) );
+
+    std::vector<unsigned short> u16 = row_read<unsigned short>( *table, "u16" );
+    for ( int n = 0 ; n < NRows ; ++n )
+	EXPECT_EQ( u16_value( n ), u16[n] );
+}
+
+TEST_F( ScalingTest, Scaled ) {
+
+    EXPECT_EQ( cfitsio_read<double>( "scaling.fits", 4 ), row_read<double>( *table, "scaled" ) );
+    EXPECT_EQ( cfitsio_read<float>( "scaling.fits", 4 ), row_read<float>( *table, "scaled" ) );
+    EXPECT_EQ( cfitsio_read<int>( "scaling.fits", 4 ), row_read<int>( *table, "scaled" ) );
+
+    std::vector<double> vec;
+    misFITS::Row row( *table );
+    row.add( "vec", &vec );
+
+    std::vector<double> expected = cfitsio_read<double>( "scaling.fits", 5, 3 );
+
+    for ( int n = 0 ; row.read() ; ++n ) {
+
+	SCOPED_TRACE( n );
+
+	ASSERT_EQ( 3, vec.size() );
+	for ( int i = 0 ; i < 3 ; ++i ) {
+	    EXPECT_EQ( expected[3 * n + i], vec[i] );
+	    EXPECT_DOUBLE_EQ( vec_value( n, i ), vec[i] );
+	}
+    }
+}
+
+TEST_F( ScalingTest, RawRead ) {
+
+    std::vector<short> u16 = row_read<short>( *table, "u16", true );
+    std::vector<int> u32 = row_read<int>( *table, "u32", true );
+    std::vector<unsigned char> s8 = row_read<unsigned char>( *table, "s8", true );
+    std::vector<int> scaled = row_read<int>( *table, "scaled", true );
+
+    // goes through CFITSIO
+    std::vector<double> dscaled = row_read<double>( *table, "scaled", true );
+
+    for ( int n = 0 ; n < NRows ; ++n ) {
+
+	SCOPED_TRACE( n );
+
+	EXPECT_EQ( static_cast<short>( u16_value( n ) ^ 0x8000 ), u16[n] );
+	EXPECT_EQ( static_cast<int>( u32_value( n ) ^ 0x80000000U ), u32[n] );
+	EXPECT_EQ( s8_value( n ) + 128, s8[n] );
+	EXPECT_EQ( scaled_raw( n ), scaled[n] );
+	EXPECT_EQ( scaled_raw( n ), dscaled[n] );
+    }
+
+    // the column's scaling is restored after raw access
+    EXPECT_EQ( cfitsio_read<float>( "scaling.fits", 4 ), row_read<float>( *table, "scaled" ) );
+}
+
+TEST( Scaling, Write ) {
+
+    make_table( "scaling.fits" );
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadWrite>( "scaling.fits" );
+	misFITS::TablePtr table = file->table( "SCALED" );
+
+	unsigned short u16;
+	short s8;
+	int scaled;
+
+	misFITS::Row row( table );
+	row.add( "u16", &u16 ).add( "s8", &s8 );
+
+	for ( int n = 0 ; n < NRows ; ++n ) {
+	    u16 = u16_value( NRows - n - 1 );
+	    s8 = s8_value( NRows - n - 1 );
+	    row.write();
+	}
+
+	misFITS::Row raw( table );
+	raw.raw( true );
+	raw.add( "scaled", &scaled );
+
+	for ( int n = 0 ; n < NRows ; ++n ) {
+	    scaled = scaled_raw( NRows - n - 1 );
+	    raw.write();
+	}
+
+	// goes through CFITSIO
+	double dscaled;
+	misFITS::Row draw( table );
+	draw.raw( true );
+	draw.add( "scaled", &dscaled );
+
+	dscaled = 0;
+	draw.write( NRows );
+
+	// scaling is restored
+	double physical = 1;
+	misFITS::Row dphysical( table );
+	dphysical.add( "scaled", &physical );
+	dphysical.write( NRows - 1 );
+    }
+
+    std::vector<unsigned short> u16 = cfitsio_read<unsigned short>( "scaling.fits", 1 );
+    std::vector<short> s8 = cfitsio_read<short>( "scaling.fits", 3 );
+    std::vector<double> scaled = cfitsio_read<double>( "scaling.fits", 4 );
+
+    for ( int n = 0 ; n < NRows ; ++n ) {
+
+	SCOPED_TRACE( n );
+
+	EXPECT_EQ( u16_value( NRows - n - 1 ), u16[n] );
+	EXPECT_EQ( s8_value( NRows - n - 1 ), s8[n] );
+    }
+
+    for ( int n = 0 ; n < NRows - 2 ; ++n )
+	EXPECT_EQ( scaled_value( NRows - n - 1 ), scaled[n] );
+
+    EXPECT_EQ( 1, scaled[NRows - 2] );
+    EXPECT_EQ( 100, scaled[NRows - 1] );
+}
@@ -0,0 +1,246 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using namespace misFITS::ColumnType;
+
+namespace Entity = misFITS::Entity;
+namespace Mode = misFITS::Mode;
+
+static const int NumRows = 5000;
+
+class SortTest : public ::testing::Test {
+
+protected:
+
+    SortTest() : layout( "EVENTS" ) {}
+
+    void SetUp() {
+
+	// an odd row length, so that rows don't start on word
+	// boundaries
+	layout.add( "seq", ID::Long ).add( "ccd", ID::Short ).add( "time", ID::Double ).add( "s", ID::String, 5 );
+
+	file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "sort.fits" );
+	input = file->add( layout );
+
+	int seq;
+	short ccd;
+	double time;
+	std::string s;
+
+	misFITS::Row row( input );
+	row.add( "seq", &seq ).add( "ccd", &ccd ).add( "time", &time ).add( "s", &s );
+
+	// plenty of duplicate keys, to check that the sort is stable
+	unsigned long state = 12345;
+
+	for ( seq = 1 ; seq <= NumRows ; ++seq ) {
+
+	    state = ( state * 1103515245UL + 12345UL ) % 2147483648UL;
+
+	    ccd = static_cast<short>( state % 4 ) - 1;
+	    time = static_cast<double>( ( state >> 8 ) % 100 ) / 4 - 10;
+
+	    char buf[8];
+	    std::sprintf( buf, "s%03lu", ( state >> 4 ) % 50 );
+	    s = buf;
+
+	    row.write( seq );
+	}
+    }
+
+    // check the output is sorted by ccd and then time, and is stable.
+    // the output may hold several copies of the input.
+    void check( misFITS::TablePtr& output, int copies = 1 ) {
+
+	ASSERT_EQ( copies * NumRows, output->num_rows() );
+
+	int seq;
+	short ccd;
+	double time;
+
+	misFITS::Row row( output );
+	row.add( "seq", &seq ).add( "ccd", &ccd ).add( "time", &time );
+
+	int last_seq = 0;
+	short last_ccd = -2;
+	double last_time = -100;
+
+	std::vector<int> seen( NumRows + 1, 0 );
+
+	while ( row.read() ) {
+
+	    ASSERT_GE( ccd, last_ccd );
+
+	    if ( ccd == last_ccd ) {
+
+		ASSERT_GE( time, last_time );
+
+		if ( time == last_time && copies == 1 ) {
+		    ASSERT_GT( seq, last_seq );
+		}
+	    }
+
+	    ASSERT_LT( seen[seq], copies );
+	    ++seen[seq];
+
+	    last_seq = seq;
+	    last_ccd = ccd;
+	    last_time = time;
+	}
+    }
+
+    misFITS::Table layout;
+    misFITS::FilePtr file;
+    misFITS::TablePtr input;
+};
+
+static std::vector<std::string>
+keys( const std::string& first, const std::string& second = "" ) {
+
+    std::vector<std::string> names( 1, first );
+    if ( ! second.empty() )
+	names.push_back( second );
+    return names;
+}
+
+// everything fits in memory
+TEST_F( SortTest, InMemory ) {
+
+    misFITS::TablePtr output = file->add( layout );
+    input->sort_by( keys( "ccd", "time" ), *output );
+
+    check( output );
+}
+
+// many runs, merged in several passes, into another file
+TEST_F( SortTest, External ) {
+
+    misFITS::FilePtr ofile = misFITS::open<Entity::File, Mode::CreateOverWrite>( "sort_out.fits" );
+    misFITS::TablePtr output = ofile->add( layout );
+
+    input->sort_by( keys( "ccd", "time" ), *output, 20000, 3 );
+
+    check( output );
+}
+
+TEST_F( SortTest, String ) {
+
+    misFITS::TablePtr output = file->add( layout );
+    input->sort_by( keys( "s" ), *output, 50000 );
+
+    ASSERT_EQ( NumRows, output->num_rows() );
+
+    std::string s, last;
+
+    misFITS::Row row( output );
+    row.add( "s", &s );
+
+    while ( row.read() ) {
+	ASSERT_LE( last, s );
+	last = s;
+    }
+}
+
+// sorted rows are appended to those already in the destination
+TEST_F( SortTest, Append ) {
+
+    misFITS::TablePtr output = file->add( layout );
+
+    input->sort_by( keys( "time" ), *output, 30000 );
+    input->sort_by( keys( "time" ), *output, 30000 );
+
+    EXPECT_EQ( 2 * NumRows, output->num_rows() );
+}
+
+TEST_F( SortTest, Errors ) {
+
+    misFITS::TablePtr output = file->add( layout );
+
+    EXPECT_THROW( input->sort_by( keys( "time" ), *input ), misFITS::Exception::Assert );
+    EXPECT_THROW( input->sort_by( std::vector<std::string>(), *output ), misFITS::Exception::Assert );
+
+    misFITS::Table other( "OTHER" );
+    other.add( "seq", ID::Long ).add( "v", ID::Double, misFITS::Extent( 2 ) );
+    misFITS::TablePtr vector = file->add( other );
+
+    EXPECT_THROW( input->sort_by( keys( "time" ), *vector ), misFITS::Exception::Assert );
+
+    // vector columns can't be keys
+    misFITS::TablePtr vector_out = file->add( other );
+    EXPECT_THROW( vector->sort_by( keys( "v" ), *vector_out ), misFITS::Exception::Assert );
+}
+
+// merge sorted tables, some in the same file as the output, others
+// not, in small blocks
+TEST_F( SortTest, MergeSorted ) {
+
+    misFITS::FilePtr ofile = misFITS::open<Entity::File, Mode::CreateOverWrite>( "sort_out.fits" );
+
+    std::vector<misFITS::TablePtr> inputs;
+    inputs.push_back( file->add( layout ) );
+    inputs.push_back( ofile->add( layout ) );
+    inputs.push_back( file->add( layout ) );
+
+    for ( std::vector<misFITS::TablePtr>::iterator sorted = inputs.begin() ; sorted != inputs.end() ; ++sorted )
+	input->sort_by( keys( "ccd", "time" ), **sorted, 40000 );
+
+    // an empty input
+    inputs.push_back( ofile->add( layout ) );
+
+    misFITS::TablePtr output = file->add( layout );
+    output->merge_sorted( inputs, keys( "ccd", "time" ), 2000 );
+
+    check( output, 3 );
+
+    // without background reads
+    misFITS::TablePtr serial = file->add( layout );
+    serial->merge_sorted( inputs, keys( "ccd", "time" ), 2000, false );
+
+    check( serial, 3 );
+}
+
+TEST_F( SortTest, MergeErrors ) {
+
+    misFITS::TablePtr output = file->add( layout );
+
+    std::vector<misFITS::TablePtr> inputs( 1, output );
+    EXPECT_THROW( output->merge_sorted( inputs, keys( "time" ) ), misFITS::Exception::Assert );
+
+    misFITS::Table other( "OTHER" );
+    other.add( "seq", ID::Long );
+
+    inputs[0] = file->add( other );
+    EXPECT_THROW( output->merge_sorted( inputs, keys( "time" ) ), misFITS::Exception::Assert );
+
+    inputs[0] = input;
+    EXPECT_THROW( output->merge_sorted( inputs, keys( "nonesuch" ) ), misFITS::Exception::CFITSIO );
+}
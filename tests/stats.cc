@@ -0,0 +1,122 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using misFITS::Stats;
+using namespace misFITS::ColumnType;
+
+class StatsTest : public ::testing::Test {
+
+protected:
+
+    StatsTest() : table( "STATS" ) {}
+
+    void SetUp() {
+	table.add( "i", ID::Short ).add( "d", ID::Double, misFITS::Extent( 3 ) );
+	table.file()->reset_stats();
+    }
+
+    misFITS::Table table;
+    static const int nrows = 10;
+};
+
+TEST_F( StatsTest, Rows ) {
+
+    misFITS::FilePtr file = table.file();
+
+    short ival = 0;
+    std::vector<double> dval;
+
+    {
+	misFITS::Row row( table );
+	row.add( "i", &ival ).add( "d", &dval );
+
+	for ( int n = 0 ; n < nrows ; ++n )
+	    row.write();
+    }
+
+    const Stats& stats = file->stats();
+
+    EXPECT_EQ( static_cast<unsigned long long>( nrows ), stats.rows_written );
+    EXPECT_EQ( 0U, stats.rows_read );
+    EXPECT_EQ( nrows * ( sizeof( short ) + 3 * sizeof( double ) ), stats.bytes_written );
+    EXPECT_LT( 0U, stats[Stats::WriteCol].calls + stats[Stats::TblBytes].calls );
+    EXPECT_LT( 0U, stats[Stats::MoveTo].calls );
+
+    {
+	misFITS::Row row( table );
+	row.add( "i", &ival ).add( "d", &dval );
+
+	while ( row.read() )
+	    ;
+    }
+
+    EXPECT_EQ( static_cast<unsigned long long>( nrows ), stats.rows_read );
+    EXPECT_EQ( stats.bytes_written, stats.bytes_read );
+}
+
+TEST_F( StatsTest, Keywords ) {
+
+    misFITS::FilePtr file = table.file();
+    const Stats& stats = file->stats();
+
+    table.set_keyword( misFITS::keyword( "KEY", 1.0 ) );
+    table.add_history( "history" );
+
+    EXPECT_EQ( 2U, stats[Stats::KeywordWrite].calls );
+    EXPECT_EQ( 0U, stats[Stats::KeywordRead].calls );
+
+    EXPECT_EQ( 1.0, table.get_keyword<double>( "KEY" ).value );
+    EXPECT_TRUE( table.has_keyword( "KEY" ) );
+
+    EXPECT_EQ( 2U, stats[Stats::KeywordRead].calls );
+    EXPECT_LE( 0.0, stats[Stats::KeywordRead].seconds );
+}
+
+TEST_F( StatsTest, Reset ) {
+
+    misFITS::FilePtr file = table.file();
+    const Stats& stats = file->stats();
+
+    table.set_keyword( misFITS::keyword( "KEY", 1 ) );
+    EXPECT_LT( 0U, stats[Stats::KeywordWrite].calls );
+
+    file->reset_stats();
+
+    for ( int category = 0 ; category < Stats::NumCategories ; ++category ) {
+	EXPECT_EQ( 0U, stats[static_cast<Stats::Category>( category )].calls );
+	EXPECT_EQ( 0.0, stats[static_cast<Stats::Category>( category )].seconds );
+    }
+
+    EXPECT_EQ( 0U, stats.bytes_read + stats.bytes_written + stats.rows_read + stats.rows_written );
+
+    std::ostringstream os;
+    os << stats;
+    EXPECT_NE( std::string::npos, os.str().find( "keyword_write: 0 calls" ) );
+}
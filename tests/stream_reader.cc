@@ -0,0 +1,182 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include <misfits/fits.hpp>
+#include <misfits/table.hpp>
+#include <misfits/row.hpp>
+#include <misfits/stream_reader.hpp>
+#include <misfits/stream_writer.hpp>
+
+#include "util.hpp"
+
+using namespace misFITS;
+using namespace misFITS::ColumnType;
+
+class StreamReaderTest : public GenFits {};
+
+// rows read from the stream must match those read from the file
+TEST_F( StreamReaderTest, Fiducial ) {
+
+    FilePtr file( open<Entity::Data, Mode::ReadOnly>( TEST_FITS_QFILENAME ) );
+    TablePtr table( file->table() );
+
+    std::ifstream is( TEST_FITS_QFILENAME, std::ios::binary );
+
+    // small blocks, so that there are several of them
+    StreamReader reader( is, 100 );
+
+    ASSERT_TRUE( reader.next_table() );
+    ASSERT_EQ( table->num_rows(), reader.num_rows() );
+    ASSERT_EQ( table->num_columns(), reader.table()->num_columns() );
+    EXPECT_EQ( table->extname(), reader.table()->extname() );
+
+    double expected_d1, got_d1;
+    std::vector<int> expected_jv1, got_jv1;
+    std::string expected_a1, got_a1;
+
+    Row expected( table );
+    expected.add( "D1", &expected_d1 ).add( "JV1", &expected_jv1 ).add( "A1", &expected_a1 );
+
+    reader.row().add( "D1", &got_d1 ).add( "JV1", &got_jv1 ).add( "A1", &got_a1 );
+
+    while ( expected.read() ) {
+
+	ASSERT_TRUE( reader.read() );
+
+	EXPECT_EQ( expected_d1, got_d1 );
+	EXPECT_EQ( expected_jv1, got_jv1 );
+	EXPECT_EQ( expected_a1, got_a1 );
+    }
+
+    EXPECT_FALSE( reader.read() );
+    EXPECT_EQ( reader.num_rows(), reader.idx() );
+
+    EXPECT_FALSE( reader.next_table() );
+    EXPECT_THROW( reader.read(), Exception::Assert );
+}
+
+class StreamReaderPipeTest : public ::testing::Test {
+
+protected:
+
+    StreamReaderPipeTest() : layout( "EVENTS" ) {}
+
+    void SetUp() {
+
+	layout.add( "i", ID::Long ).add( "d", ID::Double, Extent( 3 ) );
+
+	std::ostringstream os;
+	int ival;
+	std::vector<double> dval( 3 );
+
+	// a stream of several tables with the same layout
+	for ( int block = 0 ; block < nblocks ; ++block ) {
+
+	    std::ostringstream ts;
+	    StreamWriter writer( ts, layout );
+	    writer.row().add( "i", &ival ).add( "d", &dval );
+
+	    for ( int n = 0 ; n < nrows ; ++n ) {
+		ival = block * nrows + n;
+		dval[1] = 2.0 * ival;
+		writer.write();
+	    }
+	    writer.close();
+
+	    // drop the primary HDU of all but the first table
+	    std::string contents = ts.str();
+	    os << ( block ? contents.substr( 2880 ) : contents );
+	}
+
+	stream = os.str();
+    }
+
+    Table layout;
+    std::string stream;
+
+    static const int nblocks = 3;
+    static const int nrows = 500;
+};
+
+TEST_F( StreamReaderPipeTest, Tables ) {
+
+    std::istringstream is( stream );
+    StreamReader reader( is, 1000 );
+
+    int ival;
+    std::vector<double> dval;
+    int n = 0;
+    int ntables = 0;
+
+    while ( reader.next_table( "EVENTS" ) ) {
+
+	++ntables;
+	EXPECT_EQ( nrows, reader.num_rows() );
+
+	reader.row().add( "i", &ival ).add( "d", &dval );
+
+	while ( reader.read() ) {
+	    EXPECT_EQ( n, ival );
+	    EXPECT_EQ( 2.0 * n, dval[1] );
+	    ++n;
+	}
+    }
+
+    EXPECT_EQ( nblocks, ntables );
+    EXPECT_EQ( nblocks * nrows, n );
+}
+
+// rows which aren't read are skipped
+TEST_F( StreamReaderPipeTest, Skip ) {
+
+    std::istringstream is( stream );
+    StreamReader reader( is, 1000 );
+
+    int ival;
+
+    for ( int table = 0 ; table < nblocks ; ++table ) {
+
+	ASSERT_TRUE( reader.next_table() );
+	reader.row().add( "i", &ival );
+
+	ASSERT_TRUE( reader.read() );
+	EXPECT_EQ( table * nrows, ival );
+    }
+
+    EXPECT_FALSE( reader.next_table( "EVENTS" ) );
+}
+
+TEST_F( StreamReaderPipeTest, Truncated ) {
+
+    std::istringstream is( stream.substr( 0, stream.size() / 2 ) );
+    StreamReader reader( is );
+
+    ASSERT_TRUE( reader.next_table() );
+
+    EXPECT_THROW( while ( reader.next_table() ) , Exception::Assert );
+}
@@ -0,0 +1,223 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include <misfits/fits.hpp>
+#include <misfits/table.hpp>
+#include <misfits/row.hpp>
+#include <misfits/driver.hpp>
+#include <misfits/stream_writer.hpp>
+
+using namespace misFITS;
+using namespace misFITS::ColumnType;
+
+// a stream buffer which can only be appended to, like a pipe
+class PipeBuf : public std::streambuf {
+
+public:
+
+    std::string contents;
+
+protected:
+
+    int_type overflow( int_type c ) {
+
+	if ( ! traits_type::eq_int_type( c, traits_type::eof() ) )
+	    contents.push_back( traits_type::to_char_type( c ) );
+
+	return traits_type::not_eof( c );
+    }
+
+    std::streamsize xsputn( const char* s, std::streamsize n ) {
+	contents.append( s, static_cast<std::string::size_type>( n ) );
+	return n;
+    }
+};
+
+class StreamWriterTest : public ::testing::Test {
+
+protected:
+
+    StreamWriterTest() : layout( "EVENTS" ) {}
+
+    void SetUp() {
+	layout.add( "i", ID::Long ).add( "d", ID::Double, Extent( 3 ) ).add( "s", ID::String, 8 );
+    }
+
+    // write nrows rows in blocks of block_bytes
+    void write( std::ostream& os, int nrows, std::size_t block_bytes, bool multiple_hdus = false ) {
+
+	int ival;
+	std::vector<double> dval( 3 );
+	std::string sval;
+
+	StreamWriter writer( os, layout, block_bytes, multiple_hdus );
+	writer.row().add( "i", &ival ).add( "d", &dval ).add( "s", &sval );
+
+	for ( int n = 0 ; n < nrows ; ++n ) {
+
+	    ival = n;
+	    dval[0] = n; dval[1] = 2 * n; dval[2] = 3 * n;
+	    std::ostringstream ss;
+	    ss << "row" << n;
+	    sval = ss.str();
+
+	    writer.write();
+	}
+
+	writer.close();
+	EXPECT_EQ( nrows, writer.num_rows() );
+    }
+
+    // check the rows in all of the tables in the stream, returning
+    // the number of table HDUs
+    int check( const std::string& contents, int nrows ) {
+
+	EXPECT_EQ( 0U, contents.size() % 2880 );
+
+	FilePtr file( open<Entity::File, Mode::ReadOnly>( Driver::buffer_url( contents.data(), contents.size() ) ) );
+
+	int ival;
+	std::vector<double> dval;
+	std::string sval;
+	int n = 0;
+
+	for ( int hdu = 2 ; hdu <= file->num_hdus() ; ++hdu ) {
+
+	    TablePtr table( file->table( hdu ) );
+
+	    EXPECT_EQ( "EVENTS", table->get_keyword<std::string>( "EXTNAME" ).value );
+	    EXPECT_EQ( hdu - 1, table->get_keyword<int>( "EXTVER" ).value );
+
+	    Row row( table );
+	    row.add( "i", &ival ).add( "d", &dval ).add( "s", &sval );
+
+	    while ( row.read() ) {
+
+		EXPECT_EQ( n, ival );
+		EXPECT_EQ( 2.0 * n, dval[1] );
+
+		std::ostringstream ss;
+		ss << "row" << n;
+		EXPECT_EQ( ss.str(), sval );
+
+		++n;
+	    }
+	}
+
+	EXPECT_EQ( nrows, n );
+
+	return file->num_hdus() - 1;
+    }
+
+    Table layout;
+};
+
+TEST_F( StreamWriterTest, Seekable ) {
+
+    std::ostringstream os;
+    write( os, 1000, 1024 );
+
+    EXPECT_EQ( 1, check( os.str(), 1000 ) );
+}
+
+TEST_F( StreamWriterTest, Pipe ) {
+
+    PipeBuf buf;
+    std::ostream os( &buf );
+
+    // 36 byte rows, so 28 rows per block
+    write( os, 100, 1024, true );
+
+    EXPECT_EQ( 4, check( buf.contents, 100 ) );
+}
+
+// without permission to split it, a table which won't fit in a block
+// isn't written to a pipe at all
+TEST_F( StreamWriterTest, PipeTooLarge ) {
+
+    PipeBuf buf;
+    std::ostream os( &buf );
+
+    EXPECT_THROW( write( os, 100, 1024 ), Exception::Assert );
+
+    // just the primary HDU
+    EXPECT_EQ( 2880U, buf.contents.size() );
+}
+
+// the layout's checksums don't describe the table written
+TEST_F( StreamWriterTest, Checksums ) {
+
+    layout.write_checksum();
+    ASSERT_TRUE( layout.has_keyword( "CHECKSUM" ) );
+
+    std::ostringstream os;
+    write( os, 10, 1024 );
+
+    std::string contents = os.str();
+    EXPECT_EQ( 1, check( contents, 10 ) );
+
+    FilePtr file( open<Entity::File, Mode::ReadOnly>( Driver::buffer_url( contents.data(), contents.size() ) ) );
+    TablePtr table( file->table( 2 ) );
+
+    EXPECT_FALSE( table->has_keyword( "CHECKSUM" ) );
+    EXPECT_FALSE( table->has_keyword( "DATASUM" ) );
+}
+
+TEST_F( StreamWriterTest, SingleBlock ) {
+
+    PipeBuf buf;
+    std::ostream os( &buf );
+
+    write( os, 10, 1024 );
+
+    EXPECT_EQ( 1, check( buf.contents, 10 ) );
+}
+
+TEST_F( StreamWriterTest, Empty ) {
+
+    PipeBuf buf;
+    std::ostream os( &buf );
+
+    write( os, 0, 1024 );
+
+    EXPECT_EQ( 1, check( buf.contents, 0 ) );
+
+    std::ostringstream ss;
+    write( ss, 0, 1024 );
+
+    EXPECT_EQ( 1, check( ss.str(), 0 ) );
+}
+
+TEST_F( StreamWriterTest, Closed ) {
+
+    std::ostringstream os;
+    StreamWriter writer( os, layout );
+
+    writer.close();
+    EXPECT_THROW( writer.write(), Exception::Assert );
+}
@@ -506,3 +506,79 @@ TEST( TableTest, CopyAllColumns ) {
 
 }
 
+
+TEST( TableTest, ColumnLookup ) {
+
+    misFITS::Table table( "MYEXTENT" );
+
+    table.add( "col1", ID::Double );
+    table.add( "Col2", ID::Double );
+    table.add( "other", ID::Double );
+
+    // exact names are case insensitive
+    EXPECT_TRUE( table.has_column( "COL1" ) );
+    EXPECT_EQ( 2, table.colinfo( "col2" ).colnum );
+    EXPECT_FALSE( table.has_column( "col4" ) );
+    EXPECT_THROW( table.colinfo( "col4" ), misFITS::Exception::CFITSIO );
+
+    // templates
+    EXPECT_EQ( 3, table.colinfo( "oth*" ).colnum );
+    EXPECT_FALSE( table.has_column( "col*" ) );
+
+    // the index must follow changes to the table
+    table.delete_column( "col1" );
+    EXPECT_FALSE( table.has_column( "col1" ) );
+    EXPECT_EQ( 1, table.colinfo( "col2" ).colnum );
+
+    table.add( "col1", ID::Double, "", 1, 1 );
+    EXPECT_EQ( 1, table.colinfo( "col1" ).colnum );
+    EXPECT_EQ( 3, table.colinfo( "other" ).colnum );
+
+    // duplicate names are left to CFITSIO
+    table.add( "other", ID::Double );
+    EXPECT_FALSE( table.has_column( "other" ) );
+}
+
+TEST( TableTest, ReserveRows ) {
+
+    misFITS::Table table( "MYEXTENT" );
+    table.add( "col1", ID::Double );
+
+    // reserved rows aren't visible, but are in the file
+    table.reserve_rows( 100 );
+    EXPECT_EQ( 0, table.num_rows() );
+    EXPECT_EQ( 100, table.get_keyword<LONGLONG>( "NAXIS2" ).value );
+
+    double value;
+    misFITS::Row row( table );
+    row.add( "col1", &value );
+
+    for ( value = 0 ; value < 10 ; ++value )
+	row.write();
+
+    EXPECT_EQ( 10, table.num_rows() );
+    EXPECT_EQ( 100, table.get_keyword<LONGLONG>( "NAXIS2" ).value );
+
+    // unused rows are removed when the file is flushed
+    table.file()->flush();
+    EXPECT_EQ( 10, table.num_rows() );
+    EXPECT_EQ( 10, table.get_keyword<LONGLONG>( "NAXIS2" ).value );
+
+    // appends grow the table geometrically
+    for ( ; value < 1000 ; ++value )
+	row.write();
+
+    EXPECT_EQ( 1000, table.num_rows() );
+    EXPECT_EQ( 1280, table.get_keyword<LONGLONG>( "NAXIS2" ).value );
+
+    table.flush();
+    EXPECT_EQ( 1000, table.get_keyword<LONGLONG>( "NAXIS2" ).value );
+
+    misFITS::Row rrow( table );
+    rrow.add( "col1", &value );
+
+    double expected = 0;
+    while ( rrow.read() )
+	EXPECT_EQ( expected++, value );
+    EXPECT_EQ( 1000, expected );
+}
@@ -0,0 +1,245 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+#include "misfits/table_set.hpp"
+
+using namespace misFITS::ColumnType;
+
+namespace Entity = misFITS::Entity;
+namespace Mode = misFITS::Mode;
+
+// the number of rows in each member; one is empty
+static const int Rows[] = { 10, 0, 25, 1, 7 };
+static const int NumMembers = sizeof( Rows ) / sizeof( Rows[0] );
+
+class TableSetTest : public ::testing::Test {
+
+protected:
+
+    void SetUp() {
+
+	int n = 0;
+
+	for ( int member = 0 ; member < NumMembers ; ++member ) {
+
+	    char file[32];
+	    std::sprintf( file, "table_set_%d.fits", member );
+	    files.push_back( file );
+
+	    misFITS::FilePtr fp = misFITS::open<Entity::File, Mode::CreateOverWrite>( file );
+
+	    misFITS::Table layout( "EVENTS" );
+	    layout.add( "n", ID::Long ).add( "x", ID::Double );
+	    misFITS::TablePtr table = fp->add( layout );
+
+	    int nval;
+	    double xval;
+
+	    misFITS::Row row( table );
+	    row.add( "n", &nval ).add( "x", &xval );
+
+	    for ( int idx = 1 ; idx <= Rows[member] ; ++idx ) {
+		nval = ++n;
+		xval = nval / 2.0;
+		row.write( idx );
+	    }
+	}
+
+	total = n;
+    }
+
+    std::vector<std::string> files;
+    int total;
+};
+
+TEST_F( TableSetTest, Sequential ) {
+
+    misFITS::TableSet set( files, "EVENTS" );
+
+    EXPECT_EQ( NumMembers, set.num_members() );
+    EXPECT_EQ( 0, set.num_open() );
+
+    ASSERT_EQ( total, set.num_rows() );
+    ASSERT_EQ( 2, set.num_columns() );
+    EXPECT_EQ( "x", set.colinfo( "X" ).ttype );
+
+    int nval;
+    double xval;
+
+    misFITS::TableSetRow row( set );
+    row.add( "n", &nval ).add( "x", &xval );
+
+    for ( int n = 1 ; n <= total ; ++n ) {
+
+	ASSERT_EQ( n, row.idx() );
+	ASSERT_TRUE( row.read() );
+	EXPECT_EQ( n, nval );
+	EXPECT_EQ( n / 2.0, xval );
+    }
+
+    EXPECT_FALSE( row.read() );
+    EXPECT_EQ( NumMembers - 1, row.member() );
+
+    EXPECT_THROW( row.add( "y", &xval ), misFITS::Exception::Assert );
+}
+
+TEST_F( TableSetTest, RandomAccess ) {
+
+    misFITS::TableSet set( files );
+
+    std::pair<std::size_t, LONGLONG> where = set.locate( 12 );
+    EXPECT_EQ( 2, where.first );
+    EXPECT_EQ( 2, where.second );
+
+    EXPECT_EQ( 11, set.first_row( 2 ) );
+    EXPECT_EQ( 0, set.member_rows( 1 ) );
+
+    int nval;
+
+    misFITS::TableSetRow row( set );
+    row.add( "n", &nval );
+
+    for ( int n = total ; n >= 1 ; n -= 3 ) {
+	ASSERT_TRUE( row.read( n ) );
+	EXPECT_EQ( n, nval );
+    }
+
+    EXPECT_FALSE( row.read( total + 1 ) );
+    EXPECT_THROW( row.read( 0 ), misFITS::Exception::Assert );
+}
+
+// locate every row, backwards after the set has been counted, and
+// forwards in a fresh set, so the members' starts are found as
+// they're needed
+TEST_F( TableSetTest, Locate ) {
+
+    for ( int pass = 0 ; pass < 2 ; ++pass ) {
+
+	misFITS::TableSet set( files );
+
+	if ( pass == 0 ) {
+	    ASSERT_EQ( total, set.num_rows() );
+	}
+
+	for ( int n = 1 ; n <= total ; ++n ) {
+
+	    std::pair<std::size_t, LONGLONG> where = set.locate( pass ? n : total + 1 - n );
+	    ASSERT_LT( where.first, set.num_members() );
+	    ASSERT_GE( where.second, 1 );
+	    ASSERT_LE( where.second, set.member_rows( where.first ) );
+	    EXPECT_EQ( pass ? n : total + 1 - n, set.first_row( where.first ) + where.second - 1 );
+	}
+
+	std::pair<std::size_t, LONGLONG> past = set.locate( total + 3 );
+	EXPECT_EQ( set.num_members(), past.first );
+	EXPECT_EQ( 3, past.second );
+    }
+}
+
+TEST_F( TableSetTest, MaxOpen ) {
+
+    misFITS::TableSet set( files, "EVENTS", 2 );
+
+    int nval;
+
+    misFITS::TableSetRow row( set );
+    row.add( "n", &nval );
+
+    while ( row.read() )
+	EXPECT_LE( set.num_open(), 2 );
+
+    EXPECT_EQ( total, nval );
+
+    // members in use aren't closed
+    std::vector<misFITS::FilePtr> held;
+    for ( int member = 0 ; member < NumMembers ; ++member )
+	held.push_back( set.file( member ) );
+
+    EXPECT_EQ( NumMembers, set.num_open() );
+
+    held.clear();
+    set.table( 0 );
+    EXPECT_EQ( 2, set.num_open() );
+}
+
+namespace {
+
+    // sum the n column of each member
+    struct Sum : public misFITS::TableSet::Scanner {
+
+	Sum() : sums( NumMembers, 0 ) {}
+
+	void operator()( std::size_t member, misFITS::Table& table ) {
+
+	    int nval;
+
+	    misFITS::Row row( table );
+	    row.add( "n", &nval );
+
+	    while ( row.read() )
+		sums[member] += nval;
+	}
+
+	// each member has its own slot, so no locking is needed
+	std::vector<long> sums;
+    };
+}
+
+TEST_F( TableSetTest, Scan ) {
+
+    misFITS::TableSet set( files, "EVENTS", 2 );
+
+    Sum sum;
+    set.scan( sum, 4 );
+
+    long total_sum = 0;
+    for ( int member = 0 ; member < NumMembers ; ++member )
+	total_sum += sum.sums[member];
+
+    EXPECT_EQ( total * ( total + 1 ) / 2, total_sum );
+    EXPECT_EQ( 0, sum.sums[1] );
+}
+
+TEST_F( TableSetTest, SchemaMismatch ) {
+
+    {
+	misFITS::FilePtr fp = misFITS::open<Entity::File, Mode::CreateOverWrite>( "table_set_odd.fits" );
+	misFITS::Table layout( "EVENTS" );
+	layout.add( "n", ID::Long ).add( "x", ID::Short );
+	fp->add( layout );
+    }
+
+    files.push_back( "table_set_odd.fits" );
+
+    misFITS::TableSet set( files, "EVENTS" );
+
+    EXPECT_EQ( total, set.first_row( NumMembers ) - 1 );
+    EXPECT_THROW( set.table( NumMembers ), misFITS::Exception::Assert );
+}
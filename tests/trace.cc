@@ -0,0 +1,79 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+// exercise the traced operations.  the test suite runs this with
+// MISFITS_TRACE set and checks the spans in the output.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+#include "misfits/trace.hpp"
+
+using namespace misFITS::ColumnType;
+
+TEST( Trace, Operations ) {
+
+    misFITS::FilePtr file( misFITS::open<misFITS::Entity::Memory>() );
+
+    misFITS::Table proto( "TRACE" );
+    proto.add( "i", ID::Short ).add( "d", ID::Double, misFITS::Extent( 3 ) );
+
+    misFITS::TablePtr table( proto.copy( file, misFITS::TableCopy::Header ) );
+
+    table->set_keyword( misFITS::keyword( "KEY", 1.0 ) );
+    EXPECT_EQ( 1.0, table->get_keyword<double>( "KEY" ).value );
+
+    short ival = 0;
+    std::vector<double> dval;
+
+    {
+	misFITS::Row row( table );
+	row.add( "i", &ival ).add( "d", &dval );
+
+	for ( int n = 0 ; n < 100 ; ++n )
+	    row.write();
+    }
+
+    {
+	misFITS::Row row( table );
+	row.add( "i", &ival ).add( "d", &dval );
+
+	int nrows = 0;
+	while ( row.read() )
+	    ++nrows;
+
+	EXPECT_EQ( 100, nrows );
+    }
+
+    table->delete_column( "i" );
+    file->flush();
+}
+
+TEST( Trace, Span ) {
+
+    // spans must be harmless whether or not tracing is enabled
+    misFITS::Trace::Span span( "Trace::Span" );
+    span.arg( "rows", 10 ).arg( "file", std::string( "\"quoted\"\n" ) );
+}
@@ -0,0 +1,157 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using namespace misFITS::ColumnType;
+using misFITS::ColumnInfo;
+using misFITS::VarLength;
+
+TEST( VarLength, ColumnInfo ) {
+
+    misFITS::Table table( "MYEXTENT" );
+
+    table.add( "spec", ID::Double, VarLength( 100 ) );
+    table.add( "big", ID::Short, VarLength( 0, true ) );
+    table.add( "n", ID::Long );
+
+    ColumnInfo spec = table.colinfo( "spec" );
+    EXPECT_TRUE( spec.varlength );
+    EXPECT_FALSE( spec.long_descriptor );
+    EXPECT_EQ( 8, spec.nbytes );
+    EXPECT_EQ( "PD(100)", spec.tform() );
+
+    ColumnInfo big = table.colinfo( "big" );
+    EXPECT_TRUE( big.varlength );
+    EXPECT_TRUE( big.long_descriptor );
+    EXPECT_EQ( 16, big.nbytes );
+
+    // offsets must account for the descriptors
+    EXPECT_EQ( 25, table.colinfo( "n" ).offset );
+    EXPECT_FALSE( table.colinfo( "n" ).varlength );
+
+    // P and Q columns have different layouts
+    EXPECT_EQ( ColumnInfo( "x", ID::Short, "", VarLength( 0, true ) ), big );
+    EXPECT_NE( ColumnInfo( "x", ID::Short, "", VarLength() ), big );
+}
+
+TEST( VarLength, ReadWrite ) {
+
+    misFITS::Table table( "MYEXTENT" );
+
+    table.add( "spec", ID::Double, VarLength( 100 ) );
+    table.add( "flags", ID::Logical, VarLength() );
+    table.add( "n", ID::Long );
+
+    const int nrows = 50;
+
+    {
+	std::vector<double> spec;
+	std::vector<bool> flags;
+	int n;
+
+	misFITS::Row row( table );
+	row.add( "spec", &spec );
+	row.add( "flags", &flags );
+	row.add( "n", &n );
+
+	for ( n = 0 ; n < nrows ; ++n ) {
+
+	    spec.resize( n % 7 );
+	    flags.resize( n % 3 );
+
+	    for ( std::size_t i = 0 ; i < spec.size() ; ++i )
+		spec[i] = n + i / 10.0;
+
+	    for ( std::size_t i = 0 ; i < flags.size() ; ++i )
+		flags[i] = ( n + i ) % 2;
+
+	    row.write();
+	}
+    }
+
+    // rows reserved for growth aren't visible, and are removed on
+    // flush
+    EXPECT_EQ( nrows, table.num_rows() );
+    table.flush();
+    EXPECT_EQ( nrows, table.num_rows() );
+
+    std::vector<double> spec;
+    std::vector<bool> flags;
+    int n;
+
+    misFITS::Row row( table );
+    row.add( "spec", &spec );
+    row.add( "flags", &flags );
+    row.add( "n", &n );
+
+    int nread = 0;
+    while ( row.read() ) {
+
+	SCOPED_TRACE( n );
+
+	ASSERT_EQ( nread++, n );
+	ASSERT_EQ( static_cast<std::size_t>( n % 7 ), spec.size() );
+	ASSERT_EQ( static_cast<std::size_t>( n % 3 ), flags.size() );
+
+	for ( std::size_t i = 0 ; i < spec.size() ; ++i )
+	    EXPECT_DOUBLE_EQ( n + i / 10.0, spec[i] );
+
+	for ( std::size_t i = 0 ; i < flags.size() ; ++i )
+	    EXPECT_EQ( ( n + i ) % 2 == 1, flags[i] );
+    }
+
+    EXPECT_EQ( nrows, nread );
+
+    // overwrite a cell with a shorter array, and then empty it
+    spec.assign( 2, -1.0 );
+    misFITS::Row wrow( table );
+    wrow.add( "spec", &spec );
+    wrow.write( 6 );
+
+    row.read( 6 );
+    ASSERT_EQ( 2, spec.size() );
+    EXPECT_DOUBLE_EQ( -1, spec[1] );
+
+    spec.clear();
+    wrow.write( 6 );
+    row.read( 6 );
+    EXPECT_TRUE( spec.empty() );
+}
+
+TEST( VarLength, FixedDestination ) {
+
+    misFITS::Table table( "MYEXTENT" );
+    table.add( "spec", ID::Double, VarLength() );
+
+    double scalar;
+    std::string str;
+
+    misFITS::Row row( table );
+    EXPECT_THROW( row.add( "spec", &scalar ), misFITS::Exception::Assert );
+    EXPECT_THROW( row.add( "spec", &str ), misFITS::Exception::Assert );
+}
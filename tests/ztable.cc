@@ -0,0 +1,284 @@
+// --8<--8<--8<--8<--
+//
+// Copyright (C) 2015 Smithsonian Astrophysical Observatory
+//
+// This file is part of misfits
+//
+// misfits is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -->8-->8-->8-->8--
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <fitsio.h>
+
+#include "gtest/gtest.h"
+
+#include "misfits/fits.hpp"
+#include "misfits/table.hpp"
+#include "misfits/row.hpp"
+
+using namespace misFITS::ColumnType;
+
+namespace Entity = misFITS::Entity;
+namespace Mode = misFITS::Mode;
+
+static const int NRows = 1000;
+
+static double time_value( int n ) { return 1e8 + n * 0.25; }
+static short pha_value( int n ) { return static_cast<short>( ( n * 37 ) % 1024 ); }
+static int pi_value( int n ) { return n * n - 5000; }
+static std::string name_value( int n ) {
+    char name[16];
+    std::sprintf( name, "EV%05d", n );
+    return name;
+}
+
+// write an ordinary table to plain.fits and use CFITSIO to write a
+// compressed copy to ztable.fits
+static void
+make_ztable() {
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::CreateOverWrite>( "plain.fits" );
+
+	misFITS::Table table( "EVENTS" );
+
+	table.add( "time", ID::Double )
+	    .add( "pha", ID::Short )
+	    .add( "pi", ID::Long )
+	    .add( "flag", ID::Logical )
+	    .add( "name", ID::String, 8 )
+	    .add( "vec", ID::Float, 3 );
+
+	table.set_keyword( misFITS::Keyword<std::string>( "TELESCOP", "TEST" ) );
+
+	double time;
+	short pha;
+	int pi;
+	bool flag;
+	std::string name;
+	std::vector<float> vec( 3 );
+
+	misFITS::Row row( table );
+	row.add( "time", &time )
+	    .add( "pha", &pha )
+	    .add( "pi", &pi )
+	    .add( "flag", &flag )
+	    .add( "name", &name )
+	    .add( "vec", &vec );
+
+	for ( int n = 0 ; n < NRows ; ++n ) {
+
+	    time = time_value( n );
+	    pha = pha_value( n );
+	    pi = pi_value( n );
+	    flag = n % 3 == 0;
+	    name = name_value( n );
+	    for ( int i = 0 ; i < 3 ; ++i )
+		vec[i] = n + i / 4.0f;
+
+	    row.write();
+	}
+
+	file->add( table );
+    }
+
+    int status = 0;
+    fitsfile* in;
+    fitsfile* out;
+
+    fits_open_file( &in, "plain.fits[EVENTS]", READONLY, &status );
+    fits_create_file( &out, "!ztable.fits", &status );
+    fits_compress_table( in, out, &status );
+    fits_close_file( out, &status );
+    fits_close_file( in, &status );
+
+    ASSERT_EQ( 0, status );
+}
+
+static void
+check_rows( misFITS::Table& table, int modified = -1 ) {
+
+    ASSERT_EQ( NRows, table.num_rows() );
+
+    double time;
+    short pha;
+    int pi;
+    bool flag;
+    std::string name;
+    std::vector<float> vec( 3 );
+
+    misFITS::Row row( table );
+    row.add( "time", &time )
+	.add( "pha", &pha )
+	.add( "pi", &pi )
+	.add( "flag", &flag )
+	.add( "name", &name )
+	.add( "vec", &vec );
+
+    for ( int n = 0 ; row.read() ; ++n ) {
+
+	SCOPED_TRACE( n );
+
+	EXPECT_DOUBLE_EQ( time_value( n ), time );
+	EXPECT_EQ( n == modified ? -1 : pha_value( n ), pha );
+	EXPECT_EQ( pi_value( n ), pi );
+	EXPECT_EQ( n % 3 == 0, flag );
+	EXPECT_EQ( name_value( n ), name );
+	for ( int i = 0 ; i < 3 ; ++i )
+	    EXPECT_FLOAT_EQ( n + i / 4.0f, vec[i] );
+    }
+}
+
+TEST( ZTable, Read ) {
+
+    make_ztable();
+
+    misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadOnly>( "ztable.fits" );
+    misFITS::TablePtr table = file->table( "EVENTS" );
+
+    // the rows are decompressed; the header is the compressed one
+    EXPECT_EQ( "TEST", table->get_keyword<std::string>( "TELESCOP" ).value );
+    EXPECT_TRUE( table->has_keyword( "ZTABLE" ) );
+    EXPECT_EQ( "1D", table->colinfo( "time" ).tform() );
+
+    EXPECT_EQ( file, table->file() );
+    EXPECT_EQ( 2, table->hdu_num() );
+
+    check_rows( *table );
+}
+
+TEST( ZTable, Write ) {
+
+    make_ztable();
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadWrite>( "ztable.fits" );
+	misFITS::TablePtr table = file->table( "EVENTS" );
+
+	short pha = -1;
+	misFITS::Row row( *table );
+	row.add( "pha", &pha );
+	row.write( 11 );
+
+	table->flush();
+    }
+
+    // the table must still be compressed, and readable by CFITSIO
+    {
+	int status = 0;
+	fitsfile* in;
+	fitsfile* out;
+	int ztable = 0;
+	short pha = 0;
+
+	fits_open_file( &in, "ztable.fits[EVENTS]", READONLY, &status );
+	fits_read_key( in, TLOGICAL, "ZTABLE", &ztable, NULL, &status );
+	fits_create_file( &out, "mem://", &status );
+	fits_uncompress_table( in, out, &status );
+	fits_read_col( out, TSHORT, 2, 11, 1, 1, NULL, &pha, NULL, &status );
+	fits_close_file( out, &status );
+	fits_close_file( in, &status );
+
+	ASSERT_EQ( 0, status );
+	EXPECT_TRUE( ztable );
+	EXPECT_EQ( -1, pha );
+    }
+
+    misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadOnly>( "ztable.fits" );
+    misFITS::TablePtr table = file->table( "EVENTS" );
+    EXPECT_EQ( "TEST", table->get_keyword<std::string>( "TELESCOP" ).value );
+
+    check_rows( *table, 10 );
+}
+
+TEST( ZTable, Append ) {
+
+    make_ztable();
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadWrite>( "ztable.fits" );
+	misFITS::TablePtr table = file->table( "EVENTS" );
+
+	int pi;
+	misFITS::Row row( *table );
+	row.add( "pi", &pi );
+
+	for ( int n = NRows ; n < NRows + 10 ; ++n ) {
+	    pi = pi_value( n );
+	    row.write( n + 1 );
+	}
+
+	// errors writing the tiles are only reported by flush or close
+	file->close();
+    }
+
+    misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadOnly>( "ztable.fits" );
+    misFITS::TablePtr table = file->table( "EVENTS" );
+
+    ASSERT_EQ( NRows + 10, table->num_rows() );
+
+    int pi;
+    misFITS::Row row( *table );
+    row.add( "pi", &pi );
+
+    for ( int n = NRows - 5 ; n < NRows + 10 ; ++n ) {
+	ASSERT_TRUE( row.read( n + 1 ) );
+	EXPECT_EQ( pi_value( n ), pi );
+    }
+}
+
+// the layout of a compressed table is fixed
+TEST( ZTable, Layout ) {
+
+    make_ztable();
+
+    misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadWrite>( "ztable.fits" );
+    misFITS::TablePtr table = file->table( "EVENTS" );
+
+    EXPECT_THROW( table->add( "x", ID::Short ), misFITS::Exception::Assert );
+    EXPECT_THROW( table->delete_column( "pha" ), misFITS::Exception::Assert );
+
+    check_rows( *table );
+}
+
+// changes are only written by flushing the table or file; if it's
+// destroyed first, they're lost, and the file's close says so
+TEST( ZTable, Discarded ) {
+
+    make_ztable();
+
+    {
+	misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadWrite>( "ztable.fits" );
+
+	{
+	    misFITS::TablePtr table = file->table( "EVENTS" );
+
+	    short pha = -1;
+	    misFITS::Row row( *table );
+	    row.add( "pha", &pha );
+	    row.write( 11 );
+	}
+
+	EXPECT_THROW( file->close(), misFITS::Exception::Assert );
+    }
+
+    misFITS::FilePtr file = misFITS::open<Entity::File, Mode::ReadOnly>( "ztable.fits" );
+    misFITS::TablePtr table = file->table( "EVENTS" );
+
+    check_rows( *table );
+}